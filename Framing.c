@@ -1,10 +1,10 @@
-#include <pigpiod_if2.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <time.h>
+#include "phy.h"
 
 #define HDLC_FLAG 0x7E          //start and end flag/header and trailer 
-#define BIT_DELAY 0.0001        //we need to adjust the timing --- we need to fix this timing/clock/delay issue
+#define BIT_DELAY_US 100        //we need to adjust the timing --- we need to fix this timing/clock/delay issue
 #define MAX_DATA_SIZE 1500      //set a payload size max -- don't know how necessary this might be in the future 
 
 //the struct for the HDLC Frame Structure -- we chose this particular structure/method for our frames 
@@ -33,47 +33,47 @@ uint16_t compute_crc16(const uint8_t *data, size_t length) {
 }
 
 //we want to receive and transmit bytes 
-void transmit_and_receive_byte(int pi, int tx_pin, int rx_pin, uint8_t tx_byte, uint8_t *rx_byte) {
+void transmit_and_receive_byte(int tx_pin, int rx_pin, uint8_t tx_byte, uint8_t *rx_byte) {
   *rx_byte = 0;  //clear the received byte
   for (int bit = 0; bit < 8; bit++) {
       int bit_value = (tx_byte >> bit) & 1;   //extract the bit to send
-      gpio_write(pi, tx_pin, bit_value);      //write it to the TX pin
-      time_sleep(BIT_DELAY / 2);  //there has to be a bit delay to let the receiver process it
+      phy_write(tx_pin, bit_value);             //write it to the TX pin
+      phy_sleep_us(BIT_DELAY_US / 2);  //there has to be a bit delay to let the receiver process it
 
-      int received_bit = gpio_read(pi, rx_pin); //read the bit from RX pin
+      int received_bit = phy_read(rx_pin);       //read the bit from RX pin
       *rx_byte |= (received_bit << bit);        //reconstruct the byte one bit at a time
 
-      time_sleep(BIT_DELAY / 2);  //another bit delay to synchronize for the next bit
+      phy_sleep_us(BIT_DELAY_US / 2);  //another bit delay to synchronize for the next bit
       printf("Tx bit: %d, Rx bit: %d\n", bit_value, received_bit); //log the transmitted and received bits
   }
   printf(" (Transmitted byte: 0x%02X, Received byte: 0x%02X)\n", tx_byte, *rx_byte); //log the full byte transmission
 }
 
 //transmit and receive the frame, byte by byte
-void transmit_and_receive_frame(int pi, int tx_pin, int rx_pin, struct hdlc_frame *frame) {
+void transmit_and_receive_frame(int tx_pin, int rx_pin, struct hdlc_frame *frame) {
   uint8_t received_byte; //where we'll store received bytes
 
   //transmit and receive start flag (0x7E)
-  transmit_and_receive_byte(pi, tx_pin, rx_pin, HDLC_FLAG, &received_byte);
+  transmit_and_receive_byte(tx_pin, rx_pin, HDLC_FLAG, &received_byte);
 
   //transmit and receive address (1 byte)
-  transmit_and_receive_byte(pi, tx_pin, rx_pin, frame->address, &received_byte);
+  transmit_and_receive_byte(tx_pin, rx_pin, frame->address, &received_byte);
 
   //transmit and receive control (1 byte)
-  transmit_and_receive_byte(pi, tx_pin, rx_pin, frame->control, &received_byte);
+  transmit_and_receive_byte(tx_pin, rx_pin, frame->control, &received_byte);
 
   //transmit and receive data, byte by byte
   for (size_t i = 0; i < frame->data_length; i++) {
-      transmit_and_receive_byte(pi, tx_pin, rx_pin, frame->data[i], &received_byte);
+      transmit_and_receive_byte(tx_pin, rx_pin, frame->data[i], &received_byte);
   }
 
   //compute and transmit CRC (2 bytes)
   uint16_t crc = compute_crc16((uint8_t *)frame, frame->data_length + 2); 
-  transmit_and_receive_byte(pi, tx_pin, rx_pin, (crc & 0xFF), &received_byte);
-  transmit_and_receive_byte(pi, tx_pin, rx_pin, ((crc >> 8) & 0xFF), &received_byte); 
+  transmit_and_receive_byte(tx_pin, rx_pin, (crc & 0xFF), &received_byte);
+  transmit_and_receive_byte(tx_pin, rx_pin, ((crc >> 8) & 0xFF), &received_byte); 
 
   //transmit and receive stop flag (0x7E)
-  transmit_and_receive_byte(pi, tx_pin, rx_pin, HDLC_FLAG, &received_byte);
+  transmit_and_receive_byte(tx_pin, rx_pin, HDLC_FLAG, &received_byte);
 }
 
 int main() {
@@ -81,9 +81,11 @@ int main() {
   int P1t = 27;  //TX pin
   int P1r = 26;  //RX pin
 
-  int pi = pigpio_start(NULL, NULL);  //start the pigpio library
-  set_mode(pi, P1t, PI_OUTPUT);       //set the TX pin to output
-  set_mode(pi, P1r, PI_INPUT);        //set the RX pin to input
+  if (phy_start() != 0) {            //start the PHY (pigpio by default)
+    return 1;
+  }
+  phy_set_mode(P1t, PHY_OUTPUT);      //set the TX pin to output
+  phy_set_mode(P1r, PHY_INPUT);       //set the RX pin to input
 
   //example frame to test that we are sending and receiving bits 
   struct hdlc_frame frame;
@@ -97,10 +99,10 @@ int main() {
   frame.data[4] = 'O';
 
   //transmit and receive frame synchronously
-  transmit_and_receive_frame(pi, P1t, P1r, &frame);
+  transmit_and_receive_frame(P1t, P1r, &frame);
 
   //stop the GPIO
-  pigpio_stop(pi);
+  phy_stop();
 
   return 0;
 }
@@ -0,0 +1,144 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+//a benchmark suite, argv[0] is the suite name
+typedef int (*bench_fn_t)(int argc, char *argv[]);
+
+/**
+ * @brief wall clock time for measurements
+ * @return monotonic time in seconds
+ */
+double bench_now(void);
+
+/**
+ * @brief fastest bit duration the Manchester decoder still receives every frame at
+ * over the simulated wire, with jitter and sender/receiver clock skew
+ * args: [jitter_us] [skew_ppm]
+ */
+int bench_clock(int argc, char *argv[]);
+
+/**
+ * @brief node throughput with every port at the base rate, then after each port negotiated
+ * its own rate, over four simulated cables of increasing jitter
+ * args: [base_us]
+ */
+int bench_rates(int argc, char *argv[]);
+
+/**
+ * @brief how long the edge callbacks are held up when every frame's handler is slow, with the
+ * handlers run inline and on 1, 2 and 4 RX workers. The frames arrive as a burst in virtual
+ * time: inline, decoding stalls behind every handler; with workers it keeps going and what the
+ * workers can't keep up with shows as dropped
+ * args: [handler_us]
+ */
+int bench_rxqueue(int argc, char *argv[]);
+
+/**
+ * @brief cost of a forwarding table lookup, with the table left alone and while another
+ * thread keeps inserting and withdrawing routes
+ * args: [num_routes]
+ */
+int bench_fib(int argc, char *argv[]);
+
+/**
+ * @brief convergence time and control-plane bytes of the distance-vector routing daemon on
+ * line, ring, tree and grid networks: from boot, in steady state and after a cable is pulled,
+ * with and without split horizon and triggered updates
+ * args: [bit_us]
+ */
+int bench_routing(int argc, char *argv[]);
+
+/**
+ * @brief one egress port offered far more than it carries, by one bursting port, a quieter port,
+ * the node itself and the routing daemon: who gets through and how long control frames wait,
+ * with frames queued straight on the link layer and through the forwarding engine
+ */
+int bench_forward(int argc, char *argv[]);
+
+/**
+ * @brief line time per frame and frames delivered for small to 1500-byte frames, each sent in
+ * its own wave or queued back to back between shared flags, on a clean wire and one that
+ * inverts some waveform steps, where the receiver picks up again at the next flag
+ * args: [error_rate]
+ */
+int bench_framing(int argc, char *argv[]);
+
+/**
+ * @brief goodput of the selective-repeat ARQ between two ports over cables that invert some
+ * waveform steps: no ARQ, stop and wait and two window sizes, with what it took to recover
+ * args: [error_rate]
+ */
+int bench_arq(int argc, char *argv[]);
+
+/**
+ * @brief throughput of every CRC-16 and CRC-32C implementation in MB/s, after checking each
+ * against the standard check values
+ * args: [len]
+ */
+int bench_crc(int argc, char *argv[]);
+
+/**
+ * @brief delivery over a cable that inverts some waveform steps with no FEC, SECDED and
+ * Reed-Solomon, with what the decoder corrected, then the codecs' throughput in MB/s
+ * args: [error_rate]
+ */
+int bench_fec(int argc, char *argv[]);
+
+/**
+ * @brief compressed size of sample packets with each codec, and the throughput of packet data
+ * over a simulated link without and with compression, with the codecs' MB/s
+ */
+int bench_compress(int argc, char *argv[]);
+
+/**
+ * @brief reassembly speed with fragments in order, reversed and shuffled with duplicates, then
+ * goodput of messages up to the largest over a simulated cable, whole and in fragments
+ * args: [error_rate]
+ */
+int bench_fragment(int argc, char *argv[]);
+
+/**
+ * @brief goodput of long messages between two ends joined by one to four cables, their fragments
+ * striped over the cables, at one rate and at the rates uneven cables negotiate
+ */
+int bench_multipath(int argc, char *argv[]);
+
+/**
+ * @brief CPU throughput of the line code: frames queued and encoded into waves on every port, and
+ * one port's recorded edges fed back through the decoder as fast as it takes them
+ */
+int bench_linecode(int argc, char *argv[]);
+
+/**
+ * @brief latency and goodput of messages through the whole stack, network layer down to the
+ * simulated wire and back up, one at a time and back to back
+ * args: [bit_us]
+ */
+int bench_e2e(int argc, char *argv[]);
+
+/**
+ * @brief how the network emulator scales: meshes of up to 254 virtual nodes for ten minutes of
+ * virtual time each, with the wall time, events per second and delivery, then the largest on
+ * more threads
+ * args: [bit_us]
+ */
+int bench_emu(int argc, char *argv[]);
+
+/**
+ * @brief small messages through the network layer with batching off, while the link is busy and
+ * held for a delay, at loads below and above the line's frame rate: delivery, frames, line bytes
+ * per message and latency
+ * args: none
+ */
+int bench_batch(int argc, char *argv[]);
+
+/**
+ * @brief messages between two processes through the shared-memory rings of the stack daemon,
+ * against a Unix socket pair: round trip latency, and the rate and wakeups of a one-way stream
+ * args: none
+ */
+int bench_ipc(int argc, char *argv[]);
+
+#endif // BENCH_H
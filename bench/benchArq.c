@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "linkArq.h"
+#include "linkLayer.h"
+#include "phy.h"
+
+#define ARQB_MESSAGES 200
+#define ARQB_LEN 64
+#define ARQB_BIT_US 100
+#define ARQB_POLL_BITS 8        //bit times between polls of the TX engine and the ARQ timers
+#define ARQB_LIMIT_US 600000000u //give up after this much wire time
+
+typedef struct {
+    const char *name;
+    int window;                 //0 sends straight on the link layer with nothing to recover losses
+    int both_ways;              //port 1 sends as many back, its data carries the acks
+} ArqbSender;
+
+static const ArqbSender senders[] = {
+    {"no ARQ", 0, 0},
+    {"stop and wait", 1, 0},
+    {"window 4", 4, 0},
+    {"window 16", 16, 0},
+    {"window 16 2way", 16, 1},
+};
+#define NUM_SENDERS (int)(sizeof(senders) / sizeof(senders[0]))
+
+//messages that arrived on port 1 and port 0
+static int received[2];
+static int out_of_order;
+
+static void count_message(uint8_t *data, uint16_t len, int ch) {
+    if (ch > 1 || len != ARQB_LEN) return;
+    int dir = (ch == 1) ? 0 : 1;
+    if (data[0] != (uint8_t)received[dir]) out_of_order++;
+    received[dir]++;
+}
+
+//port 0 sends ARQB_MESSAGES to port 1 over a pair of cables that invert some waveform steps;
+//returns the wire time until the last one arrived, or until the sender ran out of them
+static uint32_t run(const ArqbSender *sender, double error_rate, ArqStats *stats) {
+    int window = sender->window;
+    int ports = sender->both_ways ? 2 : 1;
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(ARQB_BIT_US);
+    if (initialize_link_layer() != 0) {
+        return 0;
+    }
+    PhySimLinkConfig cfg = {.delay_us = 0, .jitter_us = 5, .skew_ppm = 0, .error_rate = error_rate};
+    phy_sim_connect(tx_pins[0], rx_pins[1], &cfg);
+    phy_sim_connect(tx_pins[1], rx_pins[0], &cfg);
+    phy_sim_seed(7);
+    if (window > 0) {
+        ArqConfig config;
+        arq_default_config(&config, ARQB_BIT_US);
+        config.window = window;
+        set_msg_callback(NULL);
+        arq_link_start(&config, count_message);
+    } else {
+        set_arq_callback(NULL);
+        set_msg_callback(count_message);
+    }
+    received[0] = received[1] = 0;
+    out_of_order = 0;
+
+    uint8_t msg[ARQB_LEN];
+    memset(msg, 0xA5, sizeof(msg));
+    uint32_t start = phy_tick();
+    int sent[2] = {0, 0};
+    while (phy_tick() - start < ARQB_LIMIT_US) {
+        for (int ch = 0; ch < ports; ch++) {
+            for (; sent[ch] < ARQB_MESSAGES; sent[ch]++) {
+                msg[0] = (uint8_t)sent[ch];
+                int rc = window > 0 ? arq_link_send(ch, msg, ARQB_LEN) : manchester_transmit(ch, msg, ARQB_LEN);
+                if (rc != 0) break;
+            }
+        }
+        link_tx_poll();
+        if (window > 0) {
+            arq_link_poll();
+            if (received[0] == ARQB_MESSAGES && (ports == 1 || received[1] == ARQB_MESSAGES)) break;
+        } else if (sent[0] == ARQB_MESSAGES && link_tx_pending() == 0) {
+            phy_sim_run();
+            break;
+        }
+        phy_sleep_us(ARQB_POLL_BITS * ARQB_BIT_US);
+    }
+    uint32_t elapsed = phy_tick() - start;
+    memset(stats, 0, sizeof(*stats));
+    if (window > 0) {
+        arq_link_stats(0, stats);
+        ArqStats peer;
+        arq_link_stats(1, &peer);
+        stats->acks_sent = peer.acks_sent;
+        stats->duplicates = peer.duplicates;
+    }
+    //acks and retransmissions still queued must be off the wire before the next run restarts the PHY
+    link_tx_flush();
+    phy_sim_run();
+    if (window > 0) {
+        set_arq_callback(NULL);
+    }
+    phy_stop();
+    set_bit_duration(BIT_DURATION_US);
+    return elapsed;
+}
+
+int bench_arq(int argc, char *argv[]) {
+    double error_rates[4] = {0.0, 1e-4, 3e-4, 1e-3};
+    int num_rates = 4;
+    if (argc > 1) {
+        error_rates[0] = atof(argv[1]);
+        num_rates = 1;
+    }
+    double line_Bps = 1e6 / ARQB_BIT_US / 8;
+
+    printf("%d messages of %d bytes from port 0 to port 1 at %d us per bit (%.0f B/s on the line), "
+           "2way sends as many back\n", ARQB_MESSAGES, ARQB_LEN, ARQB_BIT_US, line_Bps);
+    printf("%-14s %8s %10s %10s %9s %8s %6s %6s %6s %8s\n", "sender", "errors", "delivered", "goodput", "of line",
+           "timeout", "fast", "dups", "acks", "srtt_ms");
+    for (int r = 0; r < num_rates; r++) {
+        for (int i = 0; i < NUM_SENDERS; i++) {
+            ArqStats stats;
+            uint32_t elapsed = run(&senders[i], error_rates[r], &stats);
+            if (elapsed == 0) {
+                return 1;
+            }
+            //goodput and delivery of port 0's messages, the acks are the ones port 1 sent on their own
+            double goodput = (double)received[0] * ARQB_LEN / (elapsed * 1e-6);
+            printf("%-14s %8g %9d%% %6.0f B/s %8.1f%% %8u %6u %6u %6u %8.1f%s\n", senders[i].name, error_rates[r],
+                   received[0] * 100 / ARQB_MESSAGES, goodput, goodput * 100 / line_Bps, stats.timeouts,
+                   stats.fast_retransmits, stats.duplicates, stats.acks_sent, stats.srtt_us / 1e3,
+                   (senders[i].window > 0 && out_of_order > 0) ? "  OUT OF ORDER" : "");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "forwardEngine.h"
+#include "histogram.h"
+#include "linkLayer.h"
+#include "networkLayer.h"
+#include "phy.h"
+#include "routingTable.h"
+
+#define BB_BIT_US 20
+#define BB_MESSAGES 400
+#define BB_MESSAGE_LEN 8            //the send time and a sequence number
+#define BB_POLL_US 100
+#define BB_LIMIT_US 60000000u
+#define BB_CONTROL_EVERY 10         //a control packet goes in behind every this many messages
+#define BB_CONTROL_LEN 3            //tells control packets from the messages
+
+//how the node sends: far apart, at about the frame rate of the line, and in bursts that fit the
+//egress queue but take the line most of the gap between them one frame a message
+static const struct {
+    const char *name;
+    uint32_t every_us;
+    int burst;          //messages each time
+} loads[] = {
+    {"sparse", 20000, 1},
+    {"line", 3000, 1},
+    {"burst", 40000, 12},
+};
+
+//batching off, packed only while the link is busy (Nagle without the timer), and held for others
+static const struct {
+    const char *name;
+    uint32_t max_delay_us;
+    uint16_t max_bytes;
+} modes[] = {
+    {"off", 0, 0},
+    {"busy", 0, FWD_BATCH_BYTES},
+    {"2ms", 2000, FWD_BATCH_BYTES},
+    {"10ms", 10000, FWD_BATCH_BYTES},
+};
+
+#define NUM_LOADS (int)(sizeof(loads) / sizeof(loads[0]))
+#define NUM_MODES (int)(sizeof(modes) / sizeof(modes[0]))
+
+static Histogram latency_us;
+static int delivered;
+static int control_alone;           //control packets that arrived in a frame of their own
+static int control_batched;         //and those packed into a batch, which must never happen
+
+static void message_received(uint8_t src_addr, const uint8_t *data, size_t len, int ch) {
+    (void)src_addr;
+    (void)ch;
+    if (len != BB_MESSAGE_LEN) return;
+    uint32_t sent_at;
+    memcpy(&sent_at, data, sizeof(sent_at));
+    hist_record(&latency_us, phy_tick() - sent_at);
+    delivered++;
+}
+
+//counts where the control packets arrived before the network layer takes the frame
+static void frame_received(Frame *frame, int ch) {
+    const uint8_t *msg = frame_payload(frame);
+    int len = frame_len(frame);
+    int batched = (frame->data[0] & LINK_HDR_BATCH) != 0;
+    while (len >= NETWORK_HEADER_SIZE && msg[2] <= len - NETWORK_HEADER_SIZE) {
+        if (msg[2] == BB_CONTROL_LEN) {
+            if (batched) {
+                control_batched++;
+            } else {
+                control_alone++;
+            }
+        }
+        len -= NETWORK_HEADER_SIZE + msg[2];
+        msg += NETWORK_HEADER_SIZE + msg[2];
+    }
+    receive_frame(frame, ch);
+}
+
+//queue a control packet for the node itself on port 0, as the routing daemon queues its adverts
+static void send_control(void) {
+    Frame *frame = frame_alloc();
+    if (frame == NULL) return;
+    uint8_t *packet = frame_payload(frame);
+    packet[0] = 1;
+    packet[1] = 1;
+    packet[2] = BB_CONTROL_LEN;
+    packet[3] = 0;
+    packet[4] = NETWORK_TTL;
+    memset(packet + NETWORK_HEADER_SIZE, 0xC7, BB_CONTROL_LEN);
+    link_seal_frame(frame, NETWORK_HEADER_SIZE + BB_CONTROL_LEN);
+    fwd_enqueue(0, frame, FWD_SOURCE_LOCAL, FWD_CLASS_CONTROL);
+    frame_release(frame);
+}
+
+//the node sends small messages to itself over a looped cable at one of the loads, and reports
+//what got through, the frames and link bytes (header byte and FCS included) it took and the latency;
+//with_control queues a control packet behind every few messages instead of reporting: each has
+//to go out in a frame of its own. Non-zero if it failed
+static int run_load(int load, int mode, int with_control, int *controls_sent) {
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(BB_BIT_US);
+    if (initialize_link_layer() != 0) {
+        return 1;
+    }
+    PhySimLinkConfig cfg = {.delay_us = 0, .jitter_us = 1, .skew_ppm = 0, .error_rate = 0};
+    phy_sim_connect(tx_pins[0], rx_pins[0], &cfg);
+    phy_sim_seed(3);
+    network_set_address(1);
+    network_layer_init();
+    network_set_compression(0);
+    network_set_message_callback(message_received);
+    set_frame_callback(frame_received);
+    route_insert(1, 0, 1);
+    fwd_set_batching(0, modes[mode].max_delay_us, modes[mode].max_bytes);
+    hist_clear(&latency_us);
+    delivered = 0;
+    control_alone = control_batched = 0;
+    int controls = 0;
+
+    uint32_t start = phy_tick();
+    uint32_t next = start;
+    int sent = 0;
+    while (phy_tick() - start < BB_LIMIT_US) {
+        if (sent < BB_MESSAGES && (int32_t)(phy_tick() - next) >= 0) {
+            for (int b = 0; b < loads[load].burst && sent < BB_MESSAGES; b++) {
+                uint8_t message[BB_MESSAGE_LEN];
+                uint32_t now = phy_tick();
+                memcpy(message, &now, sizeof(now));
+                memcpy(message + 4, &sent, sizeof(sent));
+                send_packet(1, message, sizeof(message));
+                sent++;
+                if (with_control && sent % BB_CONTROL_EVERY == 0) {
+                    send_control();
+                    controls++;
+                }
+            }
+            next += loads[load].every_us;
+        }
+        if (sent == BB_MESSAGES) {
+            FwdStats fwd;
+            fwd_get_stats(0, &fwd);
+            if (fwd.depth == 0 && link_tx_pending() == 0) break;
+        }
+        link_tx_poll();
+        phy_sleep_us(BB_POLL_US);
+    }
+    link_tx_flush();
+    phy_sim_run();
+    uint32_t elapsed = phy_tick() - start;
+
+    FwdStats fwd;
+    fwd_get_stats(0, &fwd);
+    LinkStats link;
+    link_get_stats(0, &link);
+    HistSnapshot snap;
+    hist_snapshot(&latency_us, &snap);
+    if (!with_control) {
+        printf("%-7s %-5s %5d of %d %8.0f %7llu %7.1f %10.1f %8.1f %8.1f\n", loads[load].name, modes[mode].name,
+               delivered, BB_MESSAGES, delivered / (elapsed * 1e-6), (unsigned long long)link.tx_frames,
+               fwd.batches ? (double)fwd.batched / fwd.batches : 1.0,
+               delivered ? (double)(link.tx_bytes + link.tx_frames * (1 + LINK_FCS_SIZE)) / delivered : 0,
+               hist_percentile(&snap, 50) / 1e3, hist_percentile(&snap, 99) / 1e3);
+    }
+
+    int rc = 0;
+    *controls_sent += controls;
+    if (control_batched > 0 || control_alone != controls) {
+        printf("%-7s %-5s control packets: %d sent, %d arrived alone, %d in batches\n", loads[load].name,
+               modes[mode].name, controls, control_alone, control_batched);
+        rc = 1;
+    }
+
+    network_set_message_callback(NULL);
+    network_set_compression(NETWORK_CODECS_ALL);
+    set_frame_callback(NULL);
+    phy_stop();
+    set_bit_duration(BIT_DURATION_US);
+    return rc;
+}
+
+int bench_batch(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("%d messages of %d bytes to the node itself over a looped cable at %d us/bit, small packets\n"
+           "packed into shared frames per egress port\n", BB_MESSAGES, BB_MESSAGE_LEN, BB_BIT_US);
+    printf("%-7s %-5s %10s %8s %7s %7s %10s %8s %8s\n", "load", "batch", "delivered", "msgs/s", "frames", "per_frm",
+           "link_B/msg", "p50_ms", "p99_ms");
+    int rc = 0;
+    int controls = 0;
+    for (int l = 0; l < NUM_LOADS; l++) {
+        for (int m = 0; m < NUM_MODES; m++) {
+            rc |= run_load(l, m, 0, &controls);
+        }
+    }
+    //routing adverts and other control packets queued among a burst of messages are never batched
+    int failed = 0;
+    for (int m = 0; m < NUM_MODES; m++) {
+        failed |= run_load(NUM_LOADS - 1, m, 1, &controls);
+    }
+    if (!failed) {
+        printf("%d control packets queued among the messages, every one sent in a frame of its own\n", controls);
+    }
+    return rc | failed;
+}
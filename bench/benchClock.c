@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "linkLayer.h"
+#include "phy.h"
+
+#define CLOCK_FRAMES 100
+#define CLOCK_FRAME_LEN 32
+
+static const uint32_t bit_durations[] = {5000, 2000, 1000, 500, 300, 200, 150, 100, 75, 50, 30, 20};
+#define NUM_DURATIONS (int)(sizeof(bit_durations) / sizeof(bit_durations[0]))
+
+static int frames_ok;
+
+//frame i carries i followed by bytes derived from i, so the receiver can check it
+static void fill_frame(uint8_t *frame, uint8_t seq) {
+    frame[0] = seq;
+    for (int i = 1; i < CLOCK_FRAME_LEN; i++) {
+        frame[i] = (uint8_t)(seq * 31 + i * 7);
+    }
+}
+
+static void count_frame(uint8_t *data, uint16_t len, int ch) {
+    (void)ch;
+    uint8_t expected[CLOCK_FRAME_LEN];
+    if (len != CLOCK_FRAME_LEN) return;
+    fill_frame(expected, data[0]);
+    if (memcmp(data, expected, CLOCK_FRAME_LEN) == 0) {
+        frames_ok++;
+    }
+}
+
+//queue a frame, pumping the TX engine while the queue is full
+static void send_frame(int ch, const uint8_t *frame, uint8_t len) {
+    while (manchester_transmit_async(ch, frame, len, NULL, NULL) != 0) {
+        link_tx_poll();
+        phy_sleep_us(get_bit_duration());
+    }
+}
+
+int bench_clock(int argc, char *argv[]) {
+    uint32_t jitter_us = (argc > 1) ? (uint32_t)atoi(argv[1]) : 5;
+    int32_t skew_ppm = (argc > 2) ? atoi(argv[2]) : 20000;
+
+    printf("jitter +-%u us, receiver clock skew %d ppm, %d frames of %d bytes per rate\n",
+           jitter_us, skew_ppm, CLOCK_FRAMES, CLOCK_FRAME_LEN);
+    printf("%8s %10s %10s %10s %12s\n", "bit_us", "bit/s", "delivered", "wall_ms", "x realtime");
+
+    uint32_t best_us = 0;
+    phy_set_backend(&phy_sim_backend);
+    for (int r = 0; r < NUM_DURATIONS; r++) {
+        uint32_t bit_us = bit_durations[r];
+        set_bit_duration(bit_us);
+        if (initialize_link_layer() != 0) {
+            return 1;
+        }
+        set_msg_callback(count_frame);
+        PhySimLinkConfig cfg = {.delay_us = 0, .jitter_us = jitter_us, .skew_ppm = skew_ppm, .error_rate = 0.0};
+        phy_sim_connect(tx_pins[0], rx_pins[0], &cfg);
+        phy_sim_seed(r + 1);
+
+        frames_ok = 0;
+        uint32_t virtual_start = phy_tick();
+        double start = bench_now();
+
+        uint8_t frame[CLOCK_FRAME_LEN];
+        for (int i = 0; i < CLOCK_FRAMES; i++) {
+            fill_frame(frame, (uint8_t)i);
+            send_frame(0, frame, CLOCK_FRAME_LEN);
+        }
+        link_tx_flush();
+        phy_sim_run();
+
+        double wall = bench_now() - start;
+        double virtual_s = (phy_tick() - virtual_start) * 1e-6;
+        printf("%8u %10u %9d%% %10.1f %12.0f\n", bit_us, 1000000 / bit_us,
+               frames_ok * 100 / CLOCK_FRAMES, wall * 1e3, virtual_s / wall);
+        if (frames_ok == CLOCK_FRAMES) {
+            best_us = bit_us;
+        }
+        phy_stop();
+    }
+    set_bit_duration(BIT_DURATION_US);
+
+    if (best_us > 0) {
+        printf("maximum stable bitrate: %u bit/s (%u us per bit)\n", 1000000 / best_us, best_us);
+    } else {
+        printf("no rate delivered every frame\n");
+    }
+    return 0;
+}
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "compress.h"
+#include "linkLayer.h"
+#include "networkLayer.h"
+#include "phy.h"
+
+#define CMPB_BYTES_PER_RUN (8u << 20)  //packet bytes each codec measurement goes through
+#define CMPB_ROUNDS 20                  //times the samples are sent over the link
+#define CMPB_BIT_US 100
+#define CMPB_POLL_BITS 8
+
+//what goes over the network: chat, sensor reports, a routing advert and bytes that don't compress
+static const char *texts[] = {
+    "hi",
+    "ok, thanks!",
+    "hello world",
+    "Are you there? Please reply when you get this message.",
+    "temperature 21.5 humidity 40 battery 87 status ok",
+    "Node 4 lost its route to node 9 again, I think the cable on port 2 is loose. Can you check it tomorrow "
+    "morning before the meeting?",
+    "The quick brown fox jumps over the lazy dog. The quick brown fox jumps over the lazy dog again and again.",
+    "sensor 3 reading: 1013 1012 1012 1011 1011 1010 1010 1009 1009 1008 1008 1007",
+};
+#define NUM_TEXTS (int)(sizeof(texts) / sizeof(texts[0]))
+#define NUM_SAMPLES (NUM_TEXTS + 2)
+
+typedef struct {
+    uint8_t data[COMPRESS_MAX_INPUT];
+    int len;
+} CmpbSample;
+
+static CmpbSample samples[NUM_SAMPLES];
+static CompressState state;
+
+static void make_samples(void) {
+    for (int i = 0; i < NUM_TEXTS; i++) {
+        samples[i].len = (int)strlen(texts[i]);
+        memcpy(samples[i].data, texts[i], samples[i].len);
+    }
+    //a routing advert: entries of destination and metric
+    CmpbSample *ad = &samples[NUM_TEXTS];
+    ad->len = 0;
+    for (int d = 1; d <= 40; d++) {
+        ad->data[ad->len++] = (uint8_t)d;
+        ad->data[ad->len++] = (uint8_t)(1 + d % 5);
+    }
+    CmpbSample *noise = &samples[NUM_TEXTS + 1];
+    srand(3);
+    noise->len = 64;
+    for (int i = 0; i < noise->len; i++) {
+        noise->data[i] = (uint8_t)rand();
+    }
+}
+
+//what the network layer does: the smallest of the codecs, or the packet as it is if none pays
+static CompressCodec pack(int codecs, const CmpbSample *s, uint8_t *out, int *len) {
+    CompressCodec best = COMPRESS_NONE;
+    int best_len = s->len;
+    uint8_t buf[COMPRESS_MAX_INPUT];
+    for (int codec = COMPRESS_NONE + 1; codec < COMPRESS_NUM_CODECS; codec++) {
+        if (!(codecs & (1 << codec))) continue;
+        int n = compress_packet(&state, codec, s->data, s->len, buf, best_len - 1);
+        if (n >= 0) {
+            best = codec;
+            best_len = n;
+            memcpy(out, buf, n);
+        }
+    }
+    if (best == COMPRESS_NONE) {
+        memcpy(out, s->data, s->len);
+    }
+    *len = best_len;
+    return best;
+}
+
+static int received_bytes;
+
+static void count_packet(uint8_t *data, uint16_t len, int ch) {
+    (void)data;
+    if (ch == 1) received_bytes += len - NETWORK_HEADER_SIZE;
+}
+
+//the samples as network packets from port 0 to port 1; returns the wire time they took
+static uint32_t run_link(int codecs, int *app_bytes) {
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(CMPB_BIT_US);
+    if (initialize_link_layer() != 0) {
+        return 0;
+    }
+    PhySimLinkConfig cfg = {.delay_us = 0, .jitter_us = 5, .skew_ppm = 0, .error_rate = 0};
+    phy_sim_connect(tx_pins[0], rx_pins[1], &cfg);
+    set_msg_callback(count_packet);
+    received_bytes = 0;
+    *app_bytes = 0;
+
+    uint8_t packet[NETWORK_HEADER_SIZE + COMPRESS_MAX_INPUT];
+    uint32_t start = phy_tick();
+    int next = 0;
+    while (next < CMPB_ROUNDS * NUM_SAMPLES || link_tx_pending() > 0) {
+        while (next < CMPB_ROUNDS * NUM_SAMPLES) {
+            const CmpbSample *s = &samples[next % NUM_SAMPLES];
+            int len;
+            CompressCodec codec = pack(codecs, s, packet + NETWORK_HEADER_SIZE, &len);
+            packet[0] = 1;
+            packet[1] = 2;
+            packet[2] = (uint8_t)len;
+            packet[3] = (uint8_t)(codec | codecs << NET_FLAG_ACCEPTS_SHIFT);
+            packet[4] = NETWORK_TTL;
+            if (manchester_transmit(0, packet, (uint16_t)(NETWORK_HEADER_SIZE + len)) != 0) break;
+            *app_bytes += s->len;
+            next++;
+        }
+        link_tx_poll();
+        phy_sleep_us(CMPB_POLL_BITS * CMPB_BIT_US);
+    }
+    phy_sim_run();
+    uint32_t elapsed = phy_tick() - start;
+    phy_stop();
+    set_bit_duration(BIT_DURATION_US);
+    return elapsed;
+}
+
+//every sample comes back as it went in
+static int check(int codecs) {
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        uint8_t packed[COMPRESS_MAX_INPUT], back[COMPRESS_MAX_INPUT];
+        int len;
+        CompressCodec codec = pack(codecs, &samples[i], packed, &len);
+        int n = codec == COMPRESS_NONE ? len : decompress_packet(codec, packed, len, back, sizeof(back));
+        if (n != samples[i].len || (codec != COMPRESS_NONE && memcmp(back, samples[i].data, n) != 0)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//MB/s of packet bytes through compression and decompression
+static void run_codec(int codecs, double *comp, double *decomp) {
+    uint8_t packed[NUM_SAMPLES][COMPRESS_MAX_INPUT];
+    int len[NUM_SAMPLES];
+    CompressCodec codec[NUM_SAMPLES];
+    int total = 0;
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        total += samples[i].len;
+    }
+    int rounds = CMPB_BYTES_PER_RUN / total;
+    double start = bench_now();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < NUM_SAMPLES; i++) {
+            codec[i] = pack(codecs, &samples[i], packed[i], &len[i]);
+        }
+    }
+    *comp = (double)rounds * total / (bench_now() - start) / 1e6;
+    uint8_t out[COMPRESS_MAX_INPUT];
+    start = bench_now();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < NUM_SAMPLES; i++) {
+            if (codec[i] != COMPRESS_NONE) decompress_packet(codec[i], packed[i], len[i], out, sizeof(out));
+        }
+    }
+    *decomp = (double)rounds * total / (bench_now() - start) / 1e6;
+}
+
+int bench_compress(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    static const struct {
+        const char *name;
+        int codecs;
+    } modes[] = {
+        {"none", 0},
+        {"lz", 1 << COMPRESS_LZ},
+        {"huffman", 1 << COMPRESS_HUFFMAN},
+        {"both", NETWORK_CODECS_ALL},
+    };
+    make_samples();
+    compress_init(&state);
+
+    printf("%d sample packets (chat, sensor readings, a routing advert, random bytes), data bytes\n", NUM_SAMPLES);
+    printf("%-8s", "codecs");
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        printf(" %4d", samples[i].len);
+    }
+    printf("\n");
+    for (int m = 0; m < 4; m++) {
+        printf("%-8s", modes[m].name);
+        for (int i = 0; i < NUM_SAMPLES; i++) {
+            uint8_t packed[COMPRESS_MAX_INPUT];
+            int len;
+            pack(modes[m].codecs, &samples[i], packed, &len);
+            printf(" %4d", len);
+        }
+        printf("\n");
+    }
+
+    printf("\n%d rounds of the samples from port 0 to port 1 at %d us per bit\n", CMPB_ROUNDS, CMPB_BIT_US);
+    printf("%-8s %6s %9s %12s %8s %12s %12s\n", "codecs", "check", "wire_ms", "throughput", "gain", "compress",
+           "decompress");
+    double base = 0;
+    int rc = 0;
+    for (int m = 0; m < 4; m++) {
+        int ok = check(modes[m].codecs);
+        rc |= !ok;
+        int app_bytes;
+        uint32_t elapsed = run_link(modes[m].codecs, &app_bytes);
+        if (elapsed == 0) {
+            return 1;
+        }
+        if (received_bytes == 0) {
+            rc = 1;
+        }
+        double throughput = app_bytes / (elapsed * 1e-6);
+        if (m == 0) base = throughput;
+        double comp = 0, decomp = 0;
+        if (modes[m].codecs != 0) {
+            run_codec(modes[m].codecs, &comp, &decomp);
+        }
+        printf("%-8s %6s %9.0f %8.0f B/s %7.2fx %7.1f MB/s %7.1f MB/s\n", modes[m].name, ok ? "ok" : "FAIL",
+               elapsed / 1e3, throughput, throughput / base, comp, decomp);
+    }
+    return rc;
+}
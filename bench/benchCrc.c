@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "fcs.h"
+
+#define CRC_BYTES_PER_RUN (64u << 20)
+
+typedef struct {
+    const char *name;
+    uint16_t (*fn16)(uint16_t, const uint8_t *, size_t);
+    uint32_t (*fn32)(uint32_t, const uint8_t *, size_t);
+} CrcVariant;
+
+//the bytewise variants are what the receiver does per byte, the rest are for whole buffers
+static const CrcVariant variants[] = {
+    {"crc16 bitwise", fcs16_bitwise, NULL},
+    {"crc16 table", fcs16_bytewise, NULL},
+    {"crc16 slice-by-4", fcs16_slice4, NULL},
+    {"crc32c bitwise", NULL, fcs32c_bitwise},
+    {"crc32c table", NULL, fcs32c_bytewise},
+    {"crc32c slice-by-8", NULL, fcs32c_slice8},
+    {"crc32c crc32 insn", NULL, fcs32c_hw},
+};
+
+#define NUM_VARIANTS (int)(sizeof(variants) / sizeof(variants[0]))
+
+//the standard check value of each CRC over "123456789", and that the residue property holds
+static int check(const CrcVariant *v) {
+    static const uint8_t digits[] = "123456789";
+    uint8_t buf[13];
+    memcpy(buf, digits, 9);
+    if (v->fn16) {
+        uint16_t fcs = ~v->fn16(FCS16_INIT, digits, 9);
+        buf[9] = fcs & 0xFF;
+        buf[10] = fcs >> 8;
+        return fcs == 0x906E && v->fn16(FCS16_INIT, buf, 11) == FCS16_GOOD;
+    }
+    uint32_t fcs = ~v->fn32(FCS32C_INIT, digits, 9);
+    for (int i = 0; i < 4; i++) {
+        buf[9 + i] = (uint8_t)(fcs >> (8 * i));
+    }
+    return fcs == 0xE3069283u && v->fn32(FCS32C_INIT, buf, 13) == FCS32C_GOOD;
+}
+
+static double run(const CrcVariant *v, const uint8_t *data, size_t len, uint32_t *sink) {
+    size_t rounds = CRC_BYTES_PER_RUN / len;
+    if (v->fn16 == fcs16_bitwise || v->fn32 == fcs32c_bitwise) {
+        rounds /= 8;
+    }
+    if (rounds == 0) rounds = 1;
+    uint32_t acc = 0;
+    double start = bench_now();
+    for (size_t r = 0; r < rounds; r++) {
+        acc += v->fn16 ? v->fn16(FCS16_INIT, data, len) : v->fn32(FCS32C_INIT, data, len);
+    }
+    double elapsed = bench_now() - start;
+    *sink += acc;
+    return rounds * len / elapsed / 1e6;
+}
+
+int bench_crc(int argc, char *argv[]) {
+    //a short control frame, a full link frame and a full HDLC-sized frame, or the size given
+    size_t sizes[3] = {16, 128, 1500};
+    int num_sizes = 3;
+    if (argc > 1 && atoi(argv[1]) > 0) {
+        sizes[0] = (size_t)atoi(argv[1]);
+        num_sizes = 1;
+    }
+    size_t max_size = 0;
+    for (int s = 0; s < num_sizes; s++) {
+        if (sizes[s] > max_size) max_size = sizes[s];
+    }
+    uint8_t *data = malloc(max_size);
+    if (data == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < max_size; i++) {
+        data[i] = (uint8_t)(i * 131 + 7);
+    }
+
+    printf("crc32 instruction %s\n", fcs32c_hw_available() ? "available" : "not available, falls back to slice-by-8");
+    printf("%-20s %6s", "variant", "check");
+    for (int s = 0; s < num_sizes; s++) {
+        printf(" %9zuB", sizes[s]);
+    }
+    printf("   (MB/s)\n");
+
+    uint32_t sink = 0;
+    int rc = 0;
+    for (int i = 0; i < NUM_VARIANTS; i++) {
+        int ok = check(&variants[i]);
+        rc |= !ok;
+        printf("%-20s %6s", variants[i].name, ok ? "ok" : "FAIL");
+        for (int s = 0; s < num_sizes; s++) {
+            printf(" %10.0f", run(&variants[i], data, sizes[s], &sink));
+        }
+        printf("\n");
+    }
+    free(data);
+    return rc | (sink == 0x12345678);
+}
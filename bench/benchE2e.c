@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "forwardEngine.h"
+#include "histogram.h"
+#include "linkLayer.h"
+#include "networkLayer.h"
+#include "phy.h"
+#include "routingTable.h"
+
+#define E2E_BIT_US 100
+#define E2E_PINGS 16                //messages of each size sent one at a time, for the latency
+#define E2E_BURST 8                 //messages of each size sent back to back, for the goodput
+#define E2E_POLL_US 100
+#define E2E_LIMIT_US 600000000u
+#define E2E_RELAY_RUNS 8            //messages sent one at a time over each number of relays
+
+static const size_t message_sizes[] = {16, 200, 2048, NETWORK_MAX_MESSAGE};
+#define NUM_SIZES (int)(sizeof(message_sizes) / sizeof(message_sizes[0]))
+
+static uint8_t message[NETWORK_MAX_MESSAGE];
+static size_t expected_len;
+static int delivered;
+static int corrupted;
+
+static void count_message(uint8_t src_addr, const uint8_t *data, size_t len, int ch) {
+    (void)src_addr;
+    (void)ch;
+    if (len != expected_len || memcmp(data, message, len) != 0) {
+        corrupted++;
+    }
+    delivered++;
+}
+
+//runs the engines until want messages arrived, the queues ran dry without them, or the limit;
+//returns 0 if they all arrived
+static int wait_delivered(int want, uint32_t start) {
+    while (delivered < want && phy_tick() - start < E2E_LIMIT_US) {
+        FwdStats fwd;
+        fwd_get_stats(0, &fwd);
+        if (fwd.depth == 0 && link_tx_pending() == 0) {
+            //the last frame can still be on the wire
+            phy_sim_run();
+            if (delivered < want) break;
+        }
+        link_tx_poll();
+        phy_sleep_us(E2E_POLL_US);
+    }
+    return delivered < want;
+}
+
+//the whole stack on one node: network layer, forwarding engine and link layer, with port 0 cabled
+//to rx_port on a simulated cable
+static int start_stack(uint32_t bit_us, int rx_port) {
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(bit_us);
+    if (initialize_link_layer() != 0) {
+        return 1;
+    }
+    PhySimLinkConfig cfg = {.delay_us = 0, .jitter_us = bit_us / 50, .skew_ppm = 0, .error_rate = 0};
+    phy_sim_connect(tx_pins[0], rx_pins[rx_port], &cfg);
+    phy_sim_seed(11);
+    network_set_address(1);
+    network_layer_init();
+    network_set_compression(0);
+    network_set_message_callback(count_message);
+    return 0;
+}
+
+static void stop_stack(void) {
+    link_tx_flush();
+    phy_sim_run();
+    network_set_message_callback(NULL);
+    network_set_compression(NETWORK_CODECS_ALL);
+    network_set_address(1);
+    set_frame_callback(NULL);
+    phy_stop();
+    set_bit_duration(BIT_DURATION_US);
+}
+
+//runs the engines until the node has nothing left to send or receive
+static void wait_idle(void) {
+    for (;;) {
+        FwdStats fwd;
+        fwd_get_stats(0, &fwd);
+        if (fwd.depth == 0 && link_tx_pending() == 0) {
+            phy_sim_run();
+            fwd_get_stats(0, &fwd);
+            if (fwd.depth == 0 && link_tx_pending() == 0) break;
+        }
+        link_tx_poll();
+        phy_sleep_us(E2E_POLL_US);
+    }
+}
+
+//a message to address 2 that node 1 relays: port 0 is cabled to port 1 and address 2 is routed
+//out of port 0, so each packet comes back in and is forwarded again, one hop further every time.
+//The one stack plays every relay and takes address 2 once the packet has been forwarded relays
+//times, so it is delivered on the next arrival. Returns 0 if it arrived intact, with the wire
+//time it took in latency_us
+static int relay_message(int relays, size_t len, uint32_t *latency_us) {
+    NetworkStats before, now;
+    network_get_stats(&before);
+    expected_len = len;
+    delivered = corrupted = 0;
+    network_set_address(1);
+    uint32_t start = phy_tick();
+    if (send_packet(2, message, len) != 0) {
+        return 1;
+    }
+    while (delivered == 0 && phy_tick() - start < E2E_LIMIT_US) {
+        network_get_stats(&now);
+        if (now.forwarded - before.forwarded >= (uint64_t)relays) {
+            network_set_address(2);
+        }
+        FwdStats fwd;
+        fwd_get_stats(0, &fwd);
+        if (fwd.depth == 0 && link_tx_pending() == 0) {
+            phy_sim_run();
+            if (delivered == 0) break;
+        }
+        link_tx_poll();
+        phy_sleep_us(E2E_POLL_US);
+    }
+    *latency_us = phy_tick() - start;
+    network_set_address(1);
+    network_get_stats(&now);
+    return delivered != 1 || corrupted > 0 || now.forwarded - before.forwarded != (uint64_t)relays;
+}
+
+//packets forwarded over several hops have to arrive, and one caught in a routing loop has to be
+//dropped once its TTL runs out instead of going round for ever; returns 0 if both hold
+static int check_relays(uint32_t bit_us) {
+    if (start_stack(bit_us, 1) != 0) {
+        return 1;
+    }
+    route_insert(2, 0, 1);
+    int rc = 0;
+    size_t len = message_sizes[1];
+    printf("\n%zu byte messages relayed by 1 to 8 nodes on the way, each through the real forwarding path\n", len);
+    printf("%6s %10s %10s %12s %12s\n", "relays", "p50 ms", "max ms", "per hop ms", "B/s");
+    static Histogram latency;
+    for (int relays = 1; relays <= 8 && rc == 0; relays *= 2) {
+        hist_clear(&latency);
+        for (int i = 0; i < E2E_RELAY_RUNS; i++) {
+            uint32_t latency_us;
+            if (relay_message(relays, len, &latency_us) != 0) {
+                printf("a message relayed %d times was not delivered intact\n", relays);
+                rc = 1;
+                break;
+            }
+            hist_record(&latency, latency_us);
+        }
+        HistSnapshot snap;
+        hist_snapshot(&latency, &snap);
+        double p50_us = hist_percentile(&snap, 50);
+        printf("%6d %10.1f %10.1f %12.1f %12.0f\n", relays, p50_us / 1e3, hist_percentile(&snap, 100) / 1e3,
+               p50_us / (relays + 1) / 1e3, len / (p50_us * 1e-6));
+    }
+
+    //node 1 never takes address 2 now, so the packet loops until its TTL is used up
+    NetworkStats before, after;
+    network_get_stats(&before);
+    delivered = 0;
+    send_packet(2, message, message_sizes[0]);
+    wait_idle();
+    network_get_stats(&after);
+    if (delivered != 0 || after.forwarded - before.forwarded != NETWORK_TTL - 1 ||
+        after.ttl_expired - before.ttl_expired != 1) {
+        printf("a looping packet was forwarded %llu times and expired %llu times, expected %d and 1\n",
+               (unsigned long long)(after.forwarded - before.forwarded),
+               (unsigned long long)(after.ttl_expired - before.ttl_expired), NETWORK_TTL - 1);
+        rc = 1;
+    }
+    LinkStats link;
+    link_get_stats(1, &link);
+    if (link.rx_fcs_errors != 0) {
+        printf("%llu forwarded frames arrived with a bad FCS\n", (unsigned long long)link.rx_fcs_errors);
+        rc = 1;
+    }
+    if (rc == 0) {
+        printf("caught in a loop: dropped after %d hops\n", NETWORK_TTL);
+    }
+    stop_stack();
+    return rc;
+}
+
+int bench_e2e(int argc, char *argv[]) {
+    uint32_t bit_us = argc > 0 ? (uint32_t)atoi(argv[0]) : E2E_BIT_US;
+    if (bit_us == 0) bit_us = E2E_BIT_US;
+    for (int i = 0; i < NETWORK_MAX_MESSAGE; i++) {
+        message[i] = (uint8_t)(i * 167 + i / 256);
+    }
+
+    //the node sends to its own address over port 0 looped back
+    if (start_stack(bit_us, 0) != 0) {
+        return 1;
+    }
+    route_insert(1, 0, 1);
+
+    double line_Bps = 1e6 / bit_us / 8;
+    printf("End-to-end over a simulated cable at %u us/bit (%.0f B/s on the line): latency from send_packet "
+           "to delivery one message at a time, goodput of %d back to back\n", bit_us, line_Bps, E2E_BURST);
+    printf("%6s %10s %10s %10s %12s %7s %12s %7s\n", "bytes", "p50 ms", "p99 ms", "max ms", "single B/s", "line",
+           "burst B/s", "line");
+
+    static Histogram latency;
+    int rc = 0;
+    for (int s = 0; s < NUM_SIZES && rc == 0; s++) {
+        size_t len = message_sizes[s];
+        expected_len = len;
+        delivered = corrupted = 0;
+        hist_clear(&latency);
+        uint32_t pings_start = phy_tick();
+        for (int i = 0; i < E2E_PINGS; i++) {
+            uint32_t start = phy_tick();
+            send_packet(1, message, len);
+            if (wait_delivered(i + 1, start) != 0) {
+                rc = 1;
+                break;
+            }
+            hist_record(&latency, phy_tick() - start);
+        }
+        uint32_t pings_elapsed = phy_tick() - pings_start;
+
+        delivered = 0;
+        uint32_t burst_start = phy_tick();
+        for (int i = 0; i < E2E_BURST && rc == 0; i++) {
+            send_packet(1, message, len);
+        }
+        rc |= wait_delivered(E2E_BURST, burst_start);
+        uint32_t burst_elapsed = phy_tick() - burst_start;
+
+        HistSnapshot snap;
+        hist_snapshot(&latency, &snap);
+        double single = (double)E2E_PINGS * len / (pings_elapsed * 1e-6);
+        double burst = (double)delivered * len / (burst_elapsed * 1e-6);
+        printf("%6zu %10.1f %10.1f %10.1f %12.0f %6.1f%% %12.0f %6.1f%%\n", len, hist_percentile(&snap, 50) / 1e3,
+               hist_percentile(&snap, 99) / 1e3, hist_percentile(&snap, 100) / 1e3, single, single * 100 / line_Bps,
+               burst, burst * 100 / line_Bps);
+        rc |= corrupted > 0;
+    }
+    if (rc != 0) {
+        printf("messages were lost or corrupted\n");
+    }
+    stop_stack();
+
+    rc |= check_relays(bit_us);
+    return rc;
+}
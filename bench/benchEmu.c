@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "netEmu.h"
+
+#define EB_SECONDS 600              //virtual time every network runs
+#define EB_WARMUP_S 30
+#define EB_PACKETS_PER_S 0.5        //per node
+#define EB_PACKET_LEN 64
+
+static const int node_counts[] = {16, 64, 144, 254};
+#define NUM_COUNTS (int)(sizeof(node_counts) / sizeof(node_counts[0]))
+
+//one mesh of num_nodes nodes on num_threads threads, returns non-zero if it failed
+static int run_mesh(int num_nodes, int num_threads, uint32_t bit_us) {
+    DvConfig dv;
+    dv_default_config(&dv);
+    EmuLinkConfig link = {.bit_us = bit_us, .delay_us = 50, .jitter_us = bit_us / 50, .bit_error_rate = 1e-6};
+    EmuTraffic traffic = {.packets_per_s = EB_PACKETS_PER_S, .packet_len = EB_PACKET_LEN,
+                          .start_us = EB_WARMUP_S * 1000000ULL};
+    if (emu_init(num_nodes, &dv, 1) != 0 || emu_build(EMU_MESH, &link) != 0) {
+        return 1;
+    }
+    emu_set_traffic(&traffic);
+    double start = bench_now();
+    if (emu_run(EB_SECONDS * 1000000ULL, num_threads) != 0) {
+        emu_free();
+        return 1;
+    }
+    double seconds = bench_now() - start;
+    EmuStats s;
+    emu_get_stats(&s);
+    printf("%5d %7d %8.2f %8.0fx %12.0f %9llu %7.2f%% %8.1f %8.1f %5.2f %6.2f%%\n", num_nodes, num_threads, seconds,
+           EB_SECONDS / seconds, s.events / seconds, (unsigned long long)s.windows,
+           s.offered ? s.delivered * 100.0 / s.offered : 0, hist_percentile(&s.latency_us, 50) / 1e3,
+           hist_percentile(&s.latency_us, 99) / 1e3, s.delivered ? (double)s.hops / s.delivered : 0,
+           s.max_link_busy * 100);
+    emu_free();
+    return 0;
+}
+
+int bench_emu(int argc, char *argv[]) {
+    uint32_t bit_us = argc > 0 ? (uint32_t)atoi(argv[0]) : 100;
+    if (bit_us == 0) bit_us = 100;
+    printf("Square meshes of virtual nodes in the emulator, %d s of virtual time at %u us/bit, every node sending "
+           "%.1f packets/s of %d bytes to random nodes; deliveries beyond 15 hops fail, the routing metric's limit\n",
+           EB_SECONDS, bit_us, EB_PACKETS_PER_S, EB_PACKET_LEN);
+    printf("%5s %7s %8s %9s %12s %9s %8s %8s %8s %5s %7s\n", "nodes", "threads", "wall_s", "speed", "events/s",
+           "windows", "deliv", "p50_ms", "p99_ms", "hops", "busiest");
+    int rc = 0;
+    for (int i = 0; i < NUM_COUNTS; i++) {
+        rc |= run_mesh(node_counts[i], 1, bit_us);
+    }
+    //the largest one again, split over threads
+    for (int threads = 2; threads <= 4; threads *= 2) {
+        rc |= run_mesh(node_counts[NUM_COUNTS - 1], threads, bit_us);
+    }
+    return rc;
+}
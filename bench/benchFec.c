@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "fec.h"
+#include "linkLayer.h"
+#include "phy.h"
+
+#define FECB_MESSAGES 200
+#define FECB_LEN 128
+#define FECB_BIT_US 100
+#define FECB_POLL_BITS 8
+#define FECB_CODEC_BYTES (16u << 20)    //data bytes each codec measurement goes through
+#define FECB_CHECK_TRIALS 200
+
+static const FecMode modes[FEC_NUM_MODES] = {FEC_NONE, FEC_SECDED, FEC_RS};
+
+static int received;
+
+static void count_message(uint8_t *data, uint16_t len, int ch) {
+    (void)data;
+    if (ch == 1 && len == FECB_LEN) received++;
+}
+
+//port 0 sends FECB_MESSAGES to port 1 with both ends in the mode, over a cable that inverts some
+//waveform steps; returns the wire time it took
+static uint32_t run_link(FecMode mode, double error_rate, LinkFecStats *stats) {
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(FECB_BIT_US);
+    if (initialize_link_layer() != 0) {
+        return 0;
+    }
+    PhySimLinkConfig cfg = {.delay_us = 0, .jitter_us = 5, .skew_ppm = 0, .error_rate = error_rate};
+    phy_sim_connect(tx_pins[0], rx_pins[1], &cfg);
+    phy_sim_seed(11);
+    link_set_fec(0, mode);
+    link_set_fec(1, mode);
+    set_msg_callback(count_message);
+    received = 0;
+
+    uint8_t msg[FECB_LEN];
+    for (int i = 0; i < FECB_LEN; i++) {
+        msg[i] = (uint8_t)(i * 37 + 1);
+    }
+    uint32_t start = phy_tick();
+    int sent = 0;
+    while (sent < FECB_MESSAGES || link_tx_pending() > 0) {
+        for (; sent < FECB_MESSAGES; sent++) {
+            if (manchester_transmit(0, msg, FECB_LEN) != 0) break;
+        }
+        link_tx_poll();
+        phy_sleep_us(FECB_POLL_BITS * FECB_BIT_US);
+    }
+    phy_sim_run();
+    uint32_t elapsed = phy_tick() - start;
+    link_fec_stats(1, stats);
+    link_set_fec(0, FEC_NONE);
+    link_set_fec(1, FEC_NONE);
+    phy_stop();
+    set_bit_duration(BIT_DURATION_US);
+    return elapsed;
+}
+
+//every mode gets back a frame that has as many errors as it is meant to correct
+static int check(FecMode mode, uint8_t *coded, uint8_t *out) {
+    uint8_t data[LINK_MAX_DATA];
+    srand(5);
+    for (int t = 0; t < FECB_CHECK_TRIALS; t++) {
+        int len = 1 + rand() % LINK_MAX_DATA;
+        for (int i = 0; i < len; i++) {
+            data[i] = (uint8_t)rand();
+        }
+        int n = fec_encode(mode, data, len, coded);
+        if (n != fec_encoded_len(mode, len)) return 0;
+        if (mode == FEC_SECDED) {
+            //one bit in every codeword
+            for (int i = 0; i < n; i++) {
+                coded[i] ^= (uint8_t)(1u << (rand() % 8));
+            }
+        } else if (mode == FEC_RS) {
+            //a burst as long as every interleaved block can take
+            int blocks = (n + 254) / 255;
+            int burst = blocks * (FEC_RS_PARITY / 2);
+            int at = rand() % (n - burst + 1);
+            for (int i = at; i < at + burst; i++) {
+                coded[i] ^= (uint8_t)(1 + rand() % 255);
+            }
+        }
+        FecResult result = {0, 0};
+        if (fec_decode(mode, coded, n, out, &result) != len || result.uncorrectable != 0 ||
+            memcmp(out, data, len) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//MB/s of data through the encoder, and through the decoder with nothing to correct
+static void run_codec(FecMode mode, const uint8_t *data, int len, uint8_t *coded, uint8_t *out, double *enc, double *dec) {
+    size_t rounds = FECB_CODEC_BYTES / len;
+    int n = 0;
+    double start = bench_now();
+    for (size_t r = 0; r < rounds; r++) {
+        n = fec_encode(mode, data, len, coded);
+    }
+    *enc = rounds * len / (bench_now() - start) / 1e6;
+    FecResult result = {0, 0};
+    start = bench_now();
+    for (size_t r = 0; r < rounds; r++) {
+        fec_decode(mode, coded, n, out, &result);
+    }
+    *dec = rounds * len / (bench_now() - start) / 1e6;
+}
+
+int bench_fec(int argc, char *argv[]) {
+    double error_rates[4] = {0.0, 1e-4, 3e-4, 1e-3};
+    int num_rates = 4;
+    if (argc > 1) {
+        error_rates[0] = atof(argv[1]);
+        num_rates = 1;
+    }
+
+    printf("%d frames of %d bytes from port 0 to port 1 at %d us per bit\n", FECB_MESSAGES, FECB_LEN, FECB_BIT_US);
+    printf("%-8s %8s %10s %8s %10s %10s %14s\n", "mode", "errors", "delivered", "wire_ms", "goodput", "corrected",
+           "uncorrectable");
+    for (int r = 0; r < num_rates; r++) {
+        for (int m = 0; m < FEC_NUM_MODES; m++) {
+            LinkFecStats stats;
+            uint32_t elapsed = run_link(modes[m], error_rates[r], &stats);
+            if (elapsed == 0) {
+                return 1;
+            }
+            printf("%-8s %8g %9d%% %8.0f %6.0f B/s %10llu %14llu\n", fec_mode_name(modes[m]), error_rates[r],
+                   received * 100 / FECB_MESSAGES, elapsed / 1e3, (double)received * FECB_LEN / (elapsed * 1e-6),
+                   (unsigned long long)stats.corrected, (unsigned long long)stats.uncorrectable);
+        }
+    }
+
+    uint8_t data[LINK_MAX_DATA];
+    static uint8_t coded[FEC_MAX_ENCODED(LINK_MAX_DATA)];
+    static uint8_t out[FEC_MAX_ENCODED(LINK_MAX_DATA)];
+    for (int i = 0; i < LINK_MAX_DATA; i++) {
+        data[i] = (uint8_t)(i * 131 + 7);
+    }
+    printf("\n%-8s %6s %10s %14s %14s   (MB/s of data, %d byte frames)\n", "codec", "check", "overhead", "encode",
+           "decode", LINK_MAX_DATA);
+    int rc = 0;
+    for (int m = 1; m < FEC_NUM_MODES; m++) {
+        int ok = check(modes[m], coded, out);
+        rc |= !ok;
+        double enc, dec;
+        run_codec(modes[m], data, LINK_MAX_DATA, coded, out, &enc, &dec);
+        printf("%-8s %6s %9.1f%% %14.1f %14.1f\n", fec_mode_name(modes[m]), ok ? "ok" : "FAIL",
+               (fec_encoded_len(modes[m], LINK_MAX_DATA) - LINK_MAX_DATA) * 100.0 / LINK_MAX_DATA, enc, dec);
+    }
+    return rc;
+}
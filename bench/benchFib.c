@@ -0,0 +1,72 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "routingTable.h"
+
+#define FIB_LOOKUPS 20000000
+#define FIB_ROUTES 64
+
+static _Atomic int churn_running;
+static _Atomic unsigned long churn_updates;
+
+//keeps inserting and withdrawing routes like a routing daemon reacting to a flapping link
+static void *churn(void *arg) {
+    (void)arg;
+    unsigned n = 0;
+    while (atomic_load_explicit(&churn_running, memory_order_relaxed)) {
+        uint8_t dest = (uint8_t)(n % FIB_ROUTES);
+        if ((n / FIB_ROUTES) & 1) {
+            route_withdraw(dest);
+        } else {
+            route_insert(dest, (int)(n & 3), (uint8_t)(1 + (n & 7)));
+        }
+        n++;
+        atomic_fetch_add_explicit(&churn_updates, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+//lookups over the whole address space, returns ns per lookup
+static double lookups(unsigned *sink) {
+    unsigned sum = 0;
+    double start = bench_now();
+    for (unsigned i = 0; i < FIB_LOOKUPS; i++) {
+        sum += (unsigned)route_lookup((uint8_t)(i * 167));
+    }
+    double elapsed = bench_now() - start;
+    *sink += sum;
+    return elapsed * 1e9 / FIB_LOOKUPS;
+}
+
+int bench_fib(int argc, char *argv[]) {
+    int num_routes = (argc > 1) ? atoi(argv[1]) : FIB_ROUTES;
+    unsigned sink = 0;
+
+    route_clear();
+    for (int i = 0; i < num_routes && i < ROUTE_NUM_ADDRESSES; i++) {
+        route_insert((uint8_t)i, i & 3, 1);
+    }
+    route_set_default(0, ROUTE_METRIC_INFINITY - 1);
+
+    printf("%d routes plus a default, %d lookups\n", num_routes, FIB_LOOKUPS);
+    printf("%12s %12s %14s\n", "writer", "ns/lookup", "updates/s");
+    printf("%12s %12.2f %14s\n", "idle", lookups(&sink), "-");
+
+    pthread_t writer;
+    atomic_store(&churn_running, 1);
+    atomic_store(&churn_updates, 0);
+    if (pthread_create(&writer, NULL, churn, NULL) != 0) {
+        return 1;
+    }
+    double start = bench_now();
+    double ns = lookups(&sink);
+    double elapsed = bench_now() - start;
+    atomic_store(&churn_running, 0);
+    pthread_join(writer, NULL);
+    printf("%12s %12.2f %14.0f\n", "churning", ns, atomic_load(&churn_updates) / elapsed);
+
+    route_clear();
+    return sink == 0xFFFFFFFF;
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "forwardEngine.h"
+#include "linkLayer.h"
+#include "phy.h"
+
+#define FWDB_STEPS 300
+#define FWDB_FRAME_LEN 24
+#define FWDB_BIT_US 100
+#define FWDB_TAG_CONTROL FWD_NUM_SOURCES
+
+//what each source offers per frame time on the egress port: one port bursts at twice the line
+//rate, another port and the node itself send a little, and the routing daemon a trickle
+static const struct {
+    int tag;
+    int every;          //frame times between sends
+    int count;          //frames each time
+} offered[] = {
+    {1, 1, 2},
+    {2, 4, 1},
+    {FWD_SOURCE_LOCAL, 4, 1},
+    {FWDB_TAG_CONTROL, 10, 1},
+};
+
+#define FWDB_NUM_OFFERED (int)(sizeof(offered) / sizeof(offered[0]))
+
+static int num_sent[FWDB_TAG_CONTROL + 1];
+static int num_received[FWDB_TAG_CONTROL + 1];
+static double control_wait_sum;
+static uint32_t control_wait_max;
+
+static void frame_received(Frame *frame, int ch) {
+    (void)ch;
+    uint8_t *payload = frame_payload(frame);
+    if (frame_len(frame) != FWDB_FRAME_LEN || payload[0] > FWDB_TAG_CONTROL) return;
+    num_received[payload[0]]++;
+    if (payload[0] == FWDB_TAG_CONTROL) {
+        uint32_t sent_at;
+        memcpy(&sent_at, &payload[1], sizeof(sent_at));
+        uint32_t wait = phy_tick() - sent_at;
+        control_wait_sum += wait;
+        if (wait > control_wait_max) control_wait_max = wait;
+    }
+}
+
+static void offer(int tag, int use_engine) {
+    Frame *frame = frame_alloc();
+    if (frame == NULL) {
+        return;
+    }
+    uint8_t *payload = frame_payload(frame);
+    memset(payload, 0, FWDB_FRAME_LEN);
+    payload[0] = (uint8_t)tag;
+    uint32_t now = phy_tick();
+    memcpy(&payload[1], &now, sizeof(now));
+    link_seal_frame(frame, FWDB_FRAME_LEN);
+
+    num_sent[tag]++;
+    if (use_engine) {
+        int control = tag == FWDB_TAG_CONTROL;
+        fwd_enqueue(0, frame, control ? FWD_SOURCE_LOCAL : tag, control ? FWD_CLASS_CONTROL : FWD_CLASS_DATA);
+    } else {
+        link_transmit_frame(0, frame, NULL, NULL);
+    }
+    frame_release(frame);
+}
+
+static int queued_in_engine(void) {
+    FwdStats stats;
+    fwd_get_stats(0, &stats);
+    return (int)stats.depth;
+}
+
+static int run(int use_engine) {
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(FWDB_BIT_US);
+    if (initialize_link_layer() != 0) {
+        return 1;
+    }
+    set_frame_callback(frame_received);
+    phy_sim_connect(tx_pins[0], rx_pins[0], NULL);
+    fwd_init();
+    memset(num_sent, 0, sizeof(num_sent));
+    memset(num_received, 0, sizeof(num_received));
+    control_wait_sum = 0;
+    control_wait_max = 0;
+
+    uint32_t frame_us = ((FWDB_FRAME_LEN + 1 + LINK_FCS_SIZE + 1) * 8 + 12) * FWDB_BIT_US;
+    for (int step = 0; step < FWDB_STEPS; step++) {
+        for (int i = 0; i < FWDB_NUM_OFFERED; i++) {
+            if (step % offered[i].every == 0) {
+                for (int n = 0; n < offered[i].count; n++) {
+                    offer(offered[i].tag, use_engine);
+                }
+            }
+        }
+        for (uint32_t t = 0; t < frame_us; t += 1000) {
+            link_tx_poll();
+            phy_sleep_us(1000);
+        }
+    }
+    while (link_tx_pending() > 0 || queued_in_engine() > 0) {
+        link_tx_poll();
+        phy_sleep_us(1000);
+    }
+    phy_sim_run();
+
+    const char *label = use_engine ? "engine" : "direct";
+    static const char *names[] = {"port 0", "port 1", "port 2", "port 3", "local", "control"};
+    for (int tag = 0; tag <= FWDB_TAG_CONTROL; tag++) {
+        if (num_sent[tag] == 0) continue;
+        printf("%-8s %-8s %8d %10d %9d%%\n", label, names[tag], num_sent[tag], num_received[tag],
+               num_received[tag] * 100 / num_sent[tag]);
+    }
+    if (num_received[FWDB_TAG_CONTROL] > 0) {
+        printf("%-8s control frames waited %.1f ms on average, %.1f ms at most\n", label,
+               control_wait_sum / num_received[FWDB_TAG_CONTROL] / 1e3, control_wait_max / 1e3);
+    }
+    if (use_engine) {
+        FwdStats stats;
+        fwd_get_stats(0, &stats);
+        uint32_t tail = 0, red = 0;
+        for (int i = 0; i < FWD_NUM_SOURCES; i++) {
+            tail += stats.tail_drops[i];
+            red += stats.red_drops[i];
+        }
+        printf("%-8s %u tail drops, %u RED drops, at most %u frames queued\n", label, tail, red, stats.max_depth);
+    }
+    set_frame_callback(NULL);
+    phy_stop();
+    set_bit_duration(BIT_DURATION_US);
+    return 0;
+}
+
+int bench_forward(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("one egress port at %d us per bit for %d frame times, offered 2.6x what it carries\n",
+           FWDB_BIT_US, FWDB_STEPS);
+    printf("%-8s %-8s %8s %10s %10s\n", "", "source", "offered", "delivered", "share");
+    if (run(0) != 0 || run(1) != 0) {
+        return 1;
+    }
+    return 0;
+}
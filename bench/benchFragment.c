@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "forwardEngine.h"
+#include "fragment.h"
+#include "networkLayer.h"
+#include "phy.h"
+#include "routingTable.h"
+
+#define FRAGB_REASM_MESSAGES 20000
+#define FRAGB_FRAG_LEN 248
+#define FRAGB_BIT_US 100
+#define FRAGB_POLL_US 1000
+#define FRAGB_MESSAGES 4            //messages of each size sent over the wire
+#define FRAGB_LIMIT_US 300000000u
+
+static uint8_t message[FRAG_MAX_MESSAGE];
+static ReasmTable table;
+
+//how the fragments of a message arrive
+typedef enum {
+    ORDER_IN_ORDER,
+    ORDER_REVERSED,
+    ORDER_SHUFFLED,         //and every fourth one twice
+} FragOrder;
+
+static const char *order_names[] = {"in order", "reversed", "shuffled+dups"};
+
+//put FRAGB_REASM_MESSAGES messages of len bytes together; returns fragments per second, or -1
+//if a message came out wrong
+static double run_reasm(FragOrder order, int len) {
+    int num = (len + FRAGB_FRAG_LEN - 1) / FRAGB_FRAG_LEN;
+    int seq[2 * (FRAG_MAX_MESSAGE / FRAGB_FRAG_LEN + 1)];
+    int count = 0;
+    for (int i = 0; i < num; i++) {
+        seq[count++] = order == ORDER_REVERSED ? num - 1 - i : i;
+    }
+    if (order == ORDER_SHUFFLED) {
+        srand(9);
+        for (int i = 0; i < num; i += 4) {
+            seq[count++] = i;
+        }
+        for (int i = count - 1; i > 0; i--) {
+            int j = rand() % (i + 1);
+            int t = seq[i];
+            seq[i] = seq[j];
+            seq[j] = t;
+        }
+    }
+
+    reasm_init(&table, FRAG_TIMEOUT_MS);
+    int ok = 1;
+    long fragments = 0;
+    double start = bench_now();
+    for (int m = 0; m < FRAGB_REASM_MESSAGES; m++) {
+        for (int k = 0; k < count; k++) {
+            uint32_t offset = (uint32_t)seq[k] * FRAGB_FRAG_LEN;
+            int n = (len - (int)offset < FRAGB_FRAG_LEN) ? len - (int)offset : FRAGB_FRAG_LEN;
+            ReasmSlot *slot;
+            uint8_t *place = reasm_place(&table, 1, (uint16_t)m, offset, 0, &slot);
+            fragments++;
+            if (place == NULL) continue;
+            memcpy(place, message + offset, n);
+            if (reasm_commit(&table, slot, offset, n, offset + n < (uint32_t)len) == 1) {
+                ok &= slot->total == (uint32_t)len && memcmp(slot->data, message, len) == 0;
+                reasm_release(&table, slot);
+            }
+        }
+    }
+    double elapsed = bench_now() - start;
+    ok &= table.stats.completed == FRAGB_REASM_MESSAGES;
+    return ok ? fragments / elapsed : -1;
+}
+
+static int delivered;
+static int corrupted;
+
+static void count_message(uint8_t src_addr, const uint8_t *data, size_t len, int ch) {
+    (void)src_addr;
+    (void)ch;
+    if (memcmp(data, message, len) != 0) {
+        corrupted++;
+    }
+    delivered++;
+}
+
+//the node sends messages of len bytes to itself over a cable from port 0 to port 1, as
+//fragments when they don't fit a packet; returns the wire time until the last one arrived
+static uint32_t run_wire(int len, double error_rate, ReasmStats *stats) {
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(FRAGB_BIT_US);
+    if (initialize_link_layer() != 0) {
+        return 0;
+    }
+    PhySimLinkConfig cfg = {.delay_us = 0, .jitter_us = 5, .skew_ppm = 0, .error_rate = error_rate};
+    phy_sim_connect(tx_pins[0], rx_pins[1], &cfg);
+    phy_sim_seed(5);
+    network_set_address(1);
+    network_layer_init();
+    network_set_compression(0);
+    network_set_message_callback(count_message);
+    route_insert(1, 0, 1);
+    delivered = corrupted = 0;
+
+    uint32_t start = phy_tick();
+    for (int m = 0; m < FRAGB_MESSAGES; m++) {
+        send_packet(1, message, len);
+    }
+    //until the last fragment is through, or a lost one has timed out
+    while (delivered < FRAGB_MESSAGES && phy_tick() - start < FRAGB_LIMIT_US) {
+        FwdStats fwd;
+        fwd_get_stats(0, &fwd);
+        if (fwd.depth == 0 && link_tx_pending() == 0) break;
+        link_tx_poll();
+        phy_sleep_us(FRAGB_POLL_US);
+    }
+    phy_sim_run();
+    uint32_t elapsed = phy_tick() - start;
+    network_reasm_stats(stats);
+    //what the link layer still holds goes out before the next run restarts the PHY
+    link_tx_flush();
+    phy_sim_run();
+    network_set_message_callback(NULL);
+    network_set_compression(NETWORK_CODECS_ALL);
+    set_frame_callback(NULL);
+    phy_stop();
+    set_bit_duration(BIT_DURATION_US);
+    return elapsed;
+}
+
+int bench_fragment(int argc, char *argv[]) {
+    double error_rates[2] = {0.0, 1e-5};
+    int num_rates = 2;
+    if (argc > 1) {
+        error_rates[0] = atof(argv[1]);
+        num_rates = 1;
+    }
+    for (int i = 0; i < FRAG_MAX_MESSAGE; i++) {
+        message[i] = (uint8_t)(i * 131 + i / 256);
+    }
+
+    printf("reassembly of %d messages, %d byte fragments (Mfragments/s)\n", FRAGB_REASM_MESSAGES, FRAGB_FRAG_LEN);
+    static const int sizes[] = {1000, 4000, FRAG_MAX_MESSAGE};
+    printf("%-14s", "order");
+    for (int s = 0; s < 3; s++) {
+        printf(" %9dB", sizes[s]);
+    }
+    printf("\n");
+    int rc = 0;
+    for (int o = 0; o < 3; o++) {
+        printf("%-14s", order_names[o]);
+        for (int s = 0; s < 3; s++) {
+            double rate = run_reasm((FragOrder)o, sizes[s]);
+            rc |= rate < 0;
+            if (rate < 0) {
+                printf(" %10s", "FAIL");
+            } else {
+                printf(" %10.1f", rate / 1e6);
+            }
+        }
+        printf("\n");
+    }
+
+    double line_Bps = 1e6 / FRAGB_BIT_US / 8;
+    printf("\n%d messages of each size to the node itself over one cable at %d us per bit (%.0f B/s on the line)\n",
+           FRAGB_MESSAGES, FRAGB_BIT_US, line_Bps);
+    printf("%8s %8s %10s %8s %10s %8s %9s %8s\n", "bytes", "errors", "delivered", "wire_ms", "goodput", "of line",
+           "timeouts", "corrupt");
+    static const int wire_sizes[] = {200, 1000, 4000, FRAG_MAX_MESSAGE};
+    for (int r = 0; r < num_rates; r++) {
+        for (int s = 0; s < 4; s++) {
+            ReasmStats stats;
+            uint32_t elapsed = run_wire(wire_sizes[s], error_rates[r], &stats);
+            if (elapsed == 0) {
+                return 1;
+            }
+            double goodput = (double)delivered * wire_sizes[s] / (elapsed * 1e-6);
+            rc |= corrupted > 0;
+            printf("%8d %8g %5d of %2d %8.0f %6.0f B/s %7.1f%% %9u %8d\n", wire_sizes[s], error_rates[r], delivered,
+                   FRAGB_MESSAGES, elapsed / 1e3, goodput, goodput * 100 / line_Bps, stats.timeouts, corrupted);
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "linkLayer.h"
+#include "phy.h"
+
+#define FRAMING_FRAMES 64
+#define FRAMING_BIT_US 100
+
+static const uint16_t frame_sizes[] = {16, 128, LINK_MAX_DATA};
+#define NUM_SIZES (int)(sizeof(frame_sizes) / sizeof(frame_sizes[0]))
+
+static int frames_ok;
+static uint16_t expected_len;
+
+//frame i carries i followed by bytes derived from i, so the receiver can check it
+static void fill_frame(uint8_t *frame, uint16_t len, uint8_t seq) {
+    frame[0] = seq;
+    for (int i = 1; i < len; i++) {
+        frame[i] = (uint8_t)(seq * 29 + i * 3);
+    }
+}
+
+static void count_frame(uint8_t *data, uint16_t len, int ch) {
+    (void)ch;
+    uint8_t expected[LINK_MAX_DATA];
+    if (len != expected_len) return;
+    fill_frame(expected, len, data[0]);
+    if (memcmp(data, expected, len) == 0) {
+        frames_ok++;
+    }
+}
+
+//play out what is queued, polling the TX engine every bit so idle gaps stay short
+static void drain(void) {
+    while (link_tx_pending() > 0) {
+        link_tx_poll();
+        phy_sleep_us(FRAMING_BIT_US);
+    }
+    phy_sim_run();
+}
+
+//sends the frames each in its own wave, or queued together so they go back to back between
+//shared flags; returns the wire time per frame in us
+static double run(uint16_t len, int back_to_back, double error_rate) {
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(FRAMING_BIT_US);
+    if (initialize_link_layer() != 0) {
+        return -1;
+    }
+    set_msg_callback(count_frame);
+    PhySimLinkConfig cfg = {.delay_us = 0, .jitter_us = 5, .skew_ppm = 0, .error_rate = error_rate};
+    phy_sim_connect(tx_pins[0], rx_pins[0], &cfg);
+    phy_sim_seed(len);
+    frames_ok = 0;
+    expected_len = len;
+
+    uint8_t *frame = malloc(len);
+    if (frame == NULL) {
+        phy_stop();
+        return -1;
+    }
+    uint32_t virtual_start = phy_tick();
+    for (int i = 0; i < FRAMING_FRAMES; i++) {
+        fill_frame(frame, len, (uint8_t)i);
+        while (manchester_transmit(0, frame, len) != 0) {
+            link_tx_poll();
+            phy_sleep_us(FRAMING_BIT_US);
+        }
+        if (!back_to_back) {
+            drain();
+        }
+    }
+    drain();
+    double us_per_frame = (double)(phy_tick() - virtual_start) / FRAMING_FRAMES;
+    free(frame);
+    phy_stop();
+    set_bit_duration(BIT_DURATION_US);
+    return us_per_frame;
+}
+
+int bench_framing(int argc, char *argv[]) {
+    double error_rate = (argc > 1) ? atof(argv[1]) : 1e-4;
+    double rates[2] = {0.0, error_rate};
+
+    printf("%d frames per size on one port at %d us per bit, clean and with %g of the waveform steps inverted\n",
+           FRAMING_FRAMES, FRAMING_BIT_US, error_rate);
+    printf("%6s %-13s %10s %12s %10s %12s\n", "bytes", "sent", "errors", "us/frame", "efficiency", "delivered");
+    for (int s = 0; s < NUM_SIZES; s++) {
+        for (int mode = 0; mode < 2; mode++) {
+            for (int r = 0; r < 2; r++) {
+                double us = run(frame_sizes[s], mode, rates[r]);
+                if (us < 0) {
+                    return 1;
+                }
+                //payload bits against the bit times the line was busy for them
+                double efficiency = frame_sizes[s] * 8.0 * FRAMING_BIT_US / us;
+                printf("%6u %-13s %10g %12.0f %9.1f%% %11d%%\n", frame_sizes[s], mode ? "back to back" : "one per wave",
+                       rates[r], us, efficiency * 100, frames_ok * 100 / FRAMING_FRAMES);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "bench.h"
+#include "histogram.h"
+#include "kanIpc.h"
+
+#define IB_MESSAGE_LEN 64
+#define IB_ROUND_TRIPS 20000
+#define IB_STREAM 1000000
+
+//the two processes of a run: the parent plays the application, the child the daemon
+typedef struct {
+    IpcRegion *region;
+    int app_efd;            //wakes the parent
+    int stack_efd;          //wakes the child
+    int sock[2];            //the socket pair the rings are compared with
+    uint32_t wakeups;       //eventfds the parent wrote to wake the child
+} IpcPair;
+
+static uint32_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+//the next record in a ring, sleeping on the eventfd while there is none
+static IpcRecord *ring_wait(IpcRing *ring, int efd) {
+    IpcRecord *record;
+    while ((record = ipc_ring_peek(ring)) == NULL) {
+        if (ipc_ring_wait_readable(ring)) {
+            struct pollfd fd = {.fd = efd, .events = POLLIN};
+            poll(&fd, 1, -1);
+            ipc_drain(efd);
+        }
+    }
+    return record;
+}
+
+//a message into a ring, sleeping on own_efd while it is full; counts the wakeups it makes
+static void ring_put(IpcRing *ring, int peer_efd, int own_efd, const uint8_t *data, uint32_t len, uint32_t *wakeups) {
+    IpcRecord *record;
+    while ((record = ipc_ring_reserve(ring, len)) == NULL) {
+        if (ipc_ring_wait_writable(ring, len)) {
+            struct pollfd fd = {.fd = own_efd, .events = POLLIN};
+            poll(&fd, 1, -1);
+            ipc_drain(own_efd);
+        }
+    }
+    memcpy(ipc_record_data(record), data, len);
+    if (ipc_ring_commit(ring)) {
+        ipc_notify(peer_efd);
+        (*wakeups)++;
+    }
+}
+
+static void ring_done(IpcRing *ring, int peer_efd) {
+    if (ipc_ring_release(ring)) {
+        ipc_notify(peer_efd);
+    }
+}
+
+//the child: echoes every message back through the rings (mode 0) or the socket (mode 1), or
+//swallows count of them and answers once (modes 2 and 3)
+static void child(IpcPair *pair, int mode, int count) {
+    uint8_t buf[IB_MESSAGE_LEN];
+    uint32_t wakeups = 0;
+    IpcRegion *r = pair->region;
+    for (int i = 0; i < count; i++) {
+        if (mode == 0 || mode == 2) {
+            IpcRecord *record = ring_wait(&r->to_stack, pair->stack_efd);
+            memcpy(buf, ipc_record_data(record), IB_MESSAGE_LEN);
+            ring_done(&r->to_stack, pair->app_efd);
+            if (mode == 0) ring_put(&r->to_app, pair->app_efd, pair->stack_efd, buf, IB_MESSAGE_LEN, &wakeups);
+        } else {
+            if (recv(pair->sock[1], buf, sizeof(buf), 0) != IB_MESSAGE_LEN) _exit(1);
+            if (mode == 1 && send(pair->sock[1], buf, sizeof(buf), 0) != IB_MESSAGE_LEN) _exit(1);
+        }
+    }
+    if (mode == 2) ring_put(&r->to_app, pair->app_efd, pair->stack_efd, buf, IB_MESSAGE_LEN, &wakeups);
+    if (mode == 3 && send(pair->sock[1], buf, sizeof(buf), 0) != IB_MESSAGE_LEN) _exit(1);
+    _exit(0);
+}
+
+static void report(const char *label, int mode, double seconds, int count, const Histogram *rtt, uint32_t wakeups) {
+    printf("%-7s %-6s %10.0f", label, mode == 0 || mode == 2 ? "rings" : "socket", count / seconds);
+    if (rtt != NULL) {
+        HistSnapshot snap;
+        hist_snapshot(rtt, &snap);
+        printf(" %8.1f %8.1f", hist_percentile(&snap, 50) / 1e3, hist_percentile(&snap, 99) / 1e3);
+    } else {
+        printf(" %8s %8s", "-", "-");
+    }
+    if (mode == 0 || mode == 2) {
+        printf(" %11.4f\n", (double)wakeups / count);
+    } else {
+        printf(" %11.4f\n", 1.0);
+    }
+}
+
+//one run in a fresh pair of processes, non-zero if it failed
+static int run(int mode, int count) {
+    IpcPair pair = {0};
+    pair.region = mmap(NULL, sizeof(IpcRegion), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (pair.region == MAP_FAILED) {
+        return 1;
+    }
+    ipc_ring_init(&pair.region->to_stack);
+    ipc_ring_init(&pair.region->to_app);
+    pair.app_efd = eventfd(0, EFD_NONBLOCK);
+    pair.stack_efd = eventfd(0, EFD_NONBLOCK);
+    if (pair.app_efd < 0 || pair.stack_efd < 0 || socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair.sock) != 0) {
+        munmap(pair.region, sizeof(IpcRegion));
+        return 1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        child(&pair, mode, count);
+    }
+    int rc = pid < 0;
+    if (pid > 0) {
+        static Histogram rtt;
+        hist_clear(&rtt);
+        uint8_t buf[IB_MESSAGE_LEN];
+        memset(buf, 0x5A, sizeof(buf));
+        IpcRegion *r = pair.region;
+        double start = bench_now();
+        for (int i = 0; i < count && rc == 0; i++) {
+            uint32_t sent_at = now_ns();
+            if (mode == 0 || mode == 2) {
+                ring_put(&r->to_stack, pair.stack_efd, pair.app_efd, buf, IB_MESSAGE_LEN, &pair.wakeups);
+                if (mode == 0) {
+                    ring_wait(&r->to_app, pair.app_efd);
+                    ring_done(&r->to_app, pair.stack_efd);
+                }
+            } else {
+                rc = send(pair.sock[0], buf, sizeof(buf), 0) != IB_MESSAGE_LEN;
+                if (mode == 1 && rc == 0) rc = recv(pair.sock[0], buf, sizeof(buf), 0) != IB_MESSAGE_LEN;
+            }
+            if (mode < 2) hist_record(&rtt, now_ns() - sent_at);
+        }
+        //a stream ends when the child has taken every message and answered
+        if (mode == 2) {
+            ring_wait(&r->to_app, pair.app_efd);
+            ring_done(&r->to_app, pair.stack_efd);
+        } else if (mode == 3 && rc == 0) {
+            rc = recv(pair.sock[0], buf, sizeof(buf), 0) != IB_MESSAGE_LEN;
+        }
+        double seconds = bench_now() - start;
+        if (rc != 0) kill(pid, SIGKILL);
+        int child_status;
+        waitpid(pid, &child_status, 0);
+        rc |= !WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0;
+        if (rc == 0) {
+            report(mode < 2 ? "ping" : "stream", mode, seconds, count, mode < 2 ? &rtt : NULL, pair.wakeups);
+        }
+    }
+    close(pair.app_efd);
+    close(pair.stack_efd);
+    close(pair.sock[0]);
+    close(pair.sock[1]);
+    munmap(pair.region, sizeof(IpcRegion));
+    return rc;
+}
+
+int bench_ipc(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    printf("%d-byte messages between two processes, through the shared rings the stack daemon uses and\n"
+           "through a Unix socket pair: round trips one at a time, then a one-way stream\n", IB_MESSAGE_LEN);
+    printf("%-7s %-6s %10s %8s %8s %11s\n", "test", "via", "msgs/s", "p50_us", "p99_us", "wakeups/msg");
+    int rc = 0;
+    rc |= run(0, IB_ROUND_TRIPS);
+    rc |= run(1, IB_ROUND_TRIPS);
+    rc |= run(2, IB_STREAM);
+    rc |= run(3, IB_STREAM);
+    return rc;
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "edgeCapture.h"
+#include "linkLayer.h"
+#include "phy.h"
+
+#define LC_BIT_US 100
+#define LC_FRAMES 64            //frames per port for every size
+#define LC_ROUNDS 8             //times the recorded edges are decoded
+#define LC_SPY_GPIO 4           //a pin no port uses, port 0's wire is copied to it to record the edges
+#define LC_ROUND_GAP_US 1000000u
+
+static const uint16_t frame_sizes[] = {16, 255, LINK_MAX_DATA};
+#define NUM_SIZES (int)(sizeof(frame_sizes) / sizeof(frame_sizes[0]))
+
+static EdgeRecord *edges;
+static int num_edges;
+static int edge_room;
+static int frames_ok;
+static uint16_t expected_len;
+
+static void fill_frame(uint8_t *frame, uint16_t len, int seq) {
+    for (int i = 0; i < len; i++) {
+        frame[i] = (uint8_t)(seq * 31 + i * 7 + (i >> 3));
+    }
+}
+
+static void record_edge(unsigned gpio, unsigned level, uint32_t tick) {
+    if (num_edges == edge_room) {
+        int room = edge_room ? edge_room * 2 : 1 << 16;
+        EdgeRecord *grown = realloc(edges, room * sizeof(*edges));
+        if (grown == NULL) return;
+        edges = grown;
+        edge_room = room;
+    }
+    edges[num_edges++] = (EdgeRecord){.tick = tick, .gpio = (uint8_t)gpio, .level = (uint8_t)level};
+}
+
+static void count_frame(uint8_t *data, uint16_t len, int ch) {
+    (void)data;
+    (void)ch;
+    frames_ok += (len == expected_len);
+}
+
+//a frame's time on the line with room for the stuffed bits, so waiting for room in the TX queue
+//costs a few polls instead of one per bit
+static uint32_t frame_line_us(uint16_t len) {
+    return (uint32_t)(len + 8) * 10 * LC_BIT_US;
+}
+
+static int start_link(void) {
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(LC_BIT_US);
+    return initialize_link_layer();
+}
+
+static void stop_link(void) {
+    set_msg_callback(NULL);
+    phy_stop();
+    set_bit_duration(BIT_DURATION_US);
+}
+
+//CPU time to queue frames on every port and turn them into waves, over a wire that goes
+//nowhere so nothing is decoded; returns frames per second
+static double encode(uint16_t len, const uint8_t *frame) {
+    if (start_link() != 0) {
+        return 0;
+    }
+    double start = bench_now();
+    for (int i = 0; i < LC_FRAMES; i++) {
+        for (int port = 0; port < 4; port++) {
+            while (manchester_transmit(port, (uint8_t *)frame, len) != 0) {
+                link_tx_poll();
+                phy_sleep_us(frame_line_us(len));
+            }
+        }
+    }
+    link_tx_flush();
+    double seconds = bench_now() - start;
+    stop_link();
+    return 4.0 * LC_FRAMES / seconds;
+}
+
+//records the edges of frames on port 0's wire, then feeds them to the decoder LC_ROUNDS times
+//as fast as it takes them; returns the edges per second, frames_ok counts what was delivered
+static double decode(uint16_t len, const uint8_t *frame) {
+    if (start_link() != 0) {
+        return 0;
+    }
+    PhySimLinkConfig cfg = {.delay_us = 0, .jitter_us = 2, .skew_ppm = 0, .error_rate = 0};
+    phy_sim_connect(tx_pins[0], LC_SPY_GPIO, &cfg);
+    phy_callback(LC_SPY_GPIO, record_edge);
+    phy_sim_seed(len);
+    num_edges = 0;
+    for (int i = 0; i < LC_FRAMES; i++) {
+        while (manchester_transmit(0, (uint8_t *)frame, len) != 0) {
+            link_tx_poll();
+            phy_sleep_us(frame_line_us(len));
+        }
+    }
+    link_tx_flush();
+    phy_sim_run();
+
+    set_msg_callback(count_frame);
+    expected_len = len;
+    frames_ok = 0;
+    uint32_t span = (num_edges > 0 ? edges[num_edges - 1].tick - edges[0].tick : 0) + LC_ROUND_GAP_US;
+    double start = bench_now();
+    for (int round = 0; round < LC_ROUNDS; round++) {
+        uint32_t offset = (uint32_t)round * span;
+        for (int i = 0; i < num_edges; i++) {
+            link_rx_edge((unsigned)rx_pins[0], edges[i].level, edges[i].tick + offset);
+        }
+    }
+    double seconds = bench_now() - start;
+    stop_link();
+    return (double)num_edges * LC_ROUNDS / seconds;
+}
+
+int bench_linecode(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    static uint8_t frame[LINK_MAX_DATA];
+    int rc = 0;
+
+    printf("CPU throughput of the Manchester line code: %d frames per port queued and encoded into waves on "
+           "four ports, then one port's edges decoded %d times\n", LC_FRAMES, LC_ROUNDS);
+    printf("%6s %12s %10s %14s %12s %10s %10s\n", "bytes", "enc frames/s", "enc MB/s", "dec edges/s", "dec frames/s",
+           "dec MB/s", "delivered");
+    for (int s = 0; s < NUM_SIZES; s++) {
+        uint16_t len = frame_sizes[s];
+        fill_frame(frame, len, s);
+        double enc_fps = encode(len, frame);
+        double edges_per_s = decode(len, frame);
+        if (enc_fps == 0 || edges_per_s == 0) {
+            rc = 1;
+            break;
+        }
+        double edges_per_frame = (double)num_edges / LC_FRAMES;
+        double dec_fps = edges_per_s / edges_per_frame;
+        printf("%6u %12.0f %10.1f %14.0f %12.0f %10.1f %9d%%\n", len, enc_fps, enc_fps * len / 1e6, edges_per_s,
+               dec_fps, dec_fps * len / 1e6, frames_ok * 100 / (LC_FRAMES * LC_ROUNDS));
+        rc |= frames_ok != LC_FRAMES * LC_ROUNDS;
+    }
+    free(edges);
+    edges = NULL;
+    num_edges = edge_room = 0;
+    return rc;
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+//benchmarks for the KAN stack, all of them run over the simulated PHY
+//usage: bench <suite> [args]   or   bench all
+//built by CMake as the kanBench target, see Description.md
+
+typedef struct {
+    const char *name;
+    bench_fn_t fn;
+    const char *description;
+} BenchSuite;
+
+static const BenchSuite suites[] = {
+    {"clock", bench_clock, "maximum stable bitrate of the Manchester decoder [jitter_us] [skew_ppm]"},
+    {"rxqueue", bench_rxqueue, "edge decoding with slow handlers inline vs on RX workers [handler_us]"},
+    {"fib", bench_fib, "forwarding table lookups while routes are inserted and withdrawn [num_routes]"},
+    {"routing", bench_routing, "routing convergence time and control bandwidth on simulated networks [bit_us]"},
+    {"forward", bench_forward, "egress scheduling and drops under overload, direct vs forwarding engine"},
+    {"framing", bench_framing, "flag framing: line time and recovery, one frame per wave vs back to back [error_rate]"},
+    {"arq", bench_arq, "reliable delivery goodput vs error rate, stop and wait vs selective repeat [error_rate]"},
+    {"crc", bench_crc, "frame check sequence implementations in MB/s [len]"},
+    {"fec", bench_fec, "frame delivery vs error rate with SECDED and Reed-Solomon FEC, codec MB/s [error_rate]"},
+    {"compress", bench_compress, "packet compression ratio and link throughput gain, LZ vs static Huffman"},
+    {"fragment", bench_fragment, "reassembly speed and goodput of long messages sent in fragments [error_rate]"},
+    {"multipath", bench_multipath, "goodput scaling of long messages striped over parallel cables"},
+    {"linecode", bench_linecode, "Manchester encoder and decoder CPU throughput in frames/s and edges/s"},
+    {"e2e", bench_e2e, "end-to-end message latency percentiles and goodput through the whole stack [bit_us]"},
+    {"emu", bench_emu, "network emulator speed and delivery on meshes of up to 254 virtual nodes [bit_us]"},
+    {"batch", bench_batch, "small messages packed into shared link frames, throughput and latency"},
+    {"ipc", bench_ipc, "shared-memory rings between processes against a Unix socket, latency and rate"},
+    {"rates", bench_rates, "aggregate throughput with per-port rate negotiation over uneven cables [base_us]"},
+};
+
+#define NUM_SUITES (int)(sizeof(suites) / sizeof(suites[0]))
+
+double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s <suite> [args] | all\n", prog);
+    for (int i = 0; i < NUM_SUITES; i++) {
+        fprintf(stderr, "  %-10s %s\n", suites[i].name, suites[i].description);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (strcmp(argv[1], "all") == 0) {
+        int rc = 0;
+        for (int i = 0; i < NUM_SUITES; i++) {
+            char *suite_argv[] = {(char *)suites[i].name, NULL};
+            printf("== %s ==\n", suites[i].name);
+            rc |= suites[i].fn(1, suite_argv);
+        }
+        return rc;
+    }
+
+    for (int i = 0; i < NUM_SUITES; i++) {
+        if (strcmp(argv[1], suites[i].name) == 0) {
+            return suites[i].fn(argc - 1, argv + 1);
+        }
+    }
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "forwardEngine.h"
+#include "linkLayer.h"
+#include "networkLayer.h"
+#include "phy.h"
+#include "routingTable.h"
+
+#define MPB_BIT_US 100
+#define MPB_MESSAGES 8              //16 KB messages sent in every run
+#define MPB_POLL_US 1000
+#define MPB_LIMIT_US 300000000u
+
+//uneven cables: two clean ones, and two noisier ones that negotiate slower rates
+static const uint32_t uneven_jitter_us[4] = {1, 1, 3, 8};
+
+static uint8_t message[NETWORK_MAX_MESSAGE];
+static int delivered;
+static int corrupted;
+
+static void count_message(uint8_t src_addr, const uint8_t *data, size_t len, int ch) {
+    (void)src_addr;
+    (void)ch;
+    if (len != NETWORK_MAX_MESSAGE || memcmp(data, message, len) != 0) {
+        corrupted++;
+    }
+    delivered++;
+}
+
+//the node sends messages to itself over num_cables cables, every port looped back to itself,
+//with a route to its own address through all of them; returns the wire time until the last one
+//arrived, and the line rate the cables add up to and the frames each port sent. With negotiate
+//set every port first finds the rate its cable carries
+static uint32_t run_cables(int num_cables, const uint32_t *jitter_us, int negotiate, double *line_Bps,
+                           uint32_t sent[4], uint32_t bit_us[4]) {
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(MPB_BIT_US);
+    if (initialize_link_layer() != 0) {
+        return 0;
+    }
+    for (int i = 0; i < num_cables; i++) {
+        PhySimLinkConfig cfg = {.delay_us = 0, .jitter_us = jitter_us[i], .skew_ppm = 0, .error_rate = 0};
+        phy_sim_connect(tx_pins[i], rx_pins[i], &cfg);
+    }
+    phy_sim_seed(7);
+    if (negotiate) {
+        link_negotiate(-1);
+        while (link_negotiation_pending() > 0) {
+            link_tx_poll();
+            phy_sleep_us(MPB_POLL_US);
+        }
+    }
+    *line_Bps = 0;
+    for (int i = 0; i < 4; i++) {
+        bit_us[i] = get_port_bit_duration(i);
+        if (i < num_cables) *line_Bps += 1e6 / bit_us[i] / 8;
+    }
+    network_set_address(1);
+    network_layer_init();
+    network_set_compression(0);
+    network_set_message_callback(count_message);
+    route_insert_multipath(1, (uint8_t)((1 << num_cables) - 1), 1);
+    delivered = corrupted = 0;
+
+    uint32_t start = phy_tick();
+    for (int m = 0; m < MPB_MESSAGES; m++) {
+        send_packet(1, message, NETWORK_MAX_MESSAGE);
+    }
+    while (delivered < MPB_MESSAGES && phy_tick() - start < MPB_LIMIT_US) {
+        int depth = 0;
+        for (int i = 0; i < num_cables; i++) {
+            FwdStats fwd;
+            fwd_get_stats(i, &fwd);
+            depth += fwd.depth;
+        }
+        if (depth == 0 && link_tx_pending() == 0) break;
+        link_tx_poll();
+        phy_sleep_us(MPB_POLL_US);
+    }
+    //the last frames are retired too, so nothing of this run is left in the engines for the next
+    link_tx_flush();
+    phy_sim_run();
+    uint32_t elapsed = phy_tick() - start;
+    for (int i = 0; i < 4; i++) {
+        FwdStats fwd;
+        fwd_get_stats(i, &fwd);
+        sent[i] = fwd.sent;
+    }
+    network_set_message_callback(NULL);
+    network_set_compression(NETWORK_CODECS_ALL);
+    set_frame_callback(NULL);
+    phy_stop();
+    set_bit_duration(BIT_DURATION_US);
+    return elapsed;
+}
+
+static int report(const char *label, int num_cables, const uint32_t *jitter_us, int negotiate, double *single) {
+    double line_Bps;
+    uint32_t sent[4], bit_us[4];
+    uint32_t elapsed = run_cables(num_cables, jitter_us, negotiate, &line_Bps, sent, bit_us);
+    if (elapsed == 0) {
+        return 1;
+    }
+    double goodput = (double)delivered * NETWORK_MAX_MESSAGE / (elapsed * 1e-6);
+    if (*single == 0) *single = goodput;
+    printf("%-8s %6d %8.0f %5d of %d %8.0f B/s %6.2fx %7.1f%%  ", label, num_cables, elapsed / 1e3, delivered,
+           MPB_MESSAGES, goodput, goodput / *single, goodput * 100 / line_Bps);
+    for (int i = 0; i < 4; i++) {
+        printf(" %4u@%-3u", sent[i], bit_us[i]);
+    }
+    printf("\n");
+    return delivered != MPB_MESSAGES || corrupted > 0;
+}
+
+int bench_multipath(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+    for (int i = 0; i < NETWORK_MAX_MESSAGE; i++) {
+        message[i] = (uint8_t)(i * 167 + i / 256);
+    }
+    static const uint32_t even_jitter_us[4] = {5, 5, 5, 5};
+
+    printf("%d messages of %d bytes to the node itself over parallel cables, fragments striped over them\n",
+           MPB_MESSAGES, NETWORK_MAX_MESSAGE);
+    printf("%-8s %6s %8s %10s %12s %7s %8s  %s\n", "cables", "count", "wire_ms", "delivered", "goodput", "scale",
+           "of lines", "frames@bit_us per port");
+    int rc = 0;
+    double single = 0;
+    for (int n = 1; n <= 4; n++) {
+        rc |= report("even", n, even_jitter_us, 0, &single);
+    }
+    //every cable at the rate it negotiated, the faster ones take more of the fragments
+    single = 0;
+    rc |= report("uneven", 1, uneven_jitter_us, 1, &single);
+    rc |= report("uneven", 4, uneven_jitter_us, 1, &single);
+    return rc;
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "linkLayer.h"
+#include "phy.h"
+
+#define RATES_FRAMES 40
+#define RATES_FRAME_LEN 32
+
+//one cable per port, from short and clean to long and noisy
+static const uint32_t port_jitter_us[4] = {1, 5, 20, 60};
+
+static int frames_ok[4];
+
+//frame i carries i followed by bytes derived from i, so the receiver can check it
+static void fill_frame(uint8_t *frame, uint8_t seq) {
+    frame[0] = seq;
+    for (int i = 1; i < RATES_FRAME_LEN; i++) {
+        frame[i] = (uint8_t)(seq * 13 + i * 5);
+    }
+}
+
+static void count_frame(uint8_t *data, uint16_t len, int ch) {
+    uint8_t expected[RATES_FRAME_LEN];
+    if (len != RATES_FRAME_LEN) return;
+    fill_frame(expected, data[0]);
+    if (memcmp(data, expected, RATES_FRAME_LEN) == 0) {
+        frames_ok[ch]++;
+    }
+}
+
+//every port loops back to itself over its own cable
+static int bring_up(void) {
+    if (initialize_link_layer() != 0) {
+        return 1;
+    }
+    set_msg_callback(count_frame);
+    for (int i = 0; i < 4; i++) {
+        PhySimLinkConfig cfg = {.delay_us = 0, .jitter_us = port_jitter_us[i], .skew_ppm = 0, .error_rate = 0.0};
+        phy_sim_connect(tx_pins[i], rx_pins[i], &cfg);
+    }
+    phy_sim_seed(1);
+    return 0;
+}
+
+//send the same frames on every port and report what got through per second of wire time
+static void run_traffic(const char *label) {
+    memset(frames_ok, 0, sizeof(frames_ok));
+    uint32_t virtual_start = phy_tick();
+    double start = bench_now();
+
+    uint8_t frame[RATES_FRAME_LEN];
+    for (int i = 0; i < RATES_FRAMES; i++) {
+        fill_frame(frame, (uint8_t)i);
+        for (int ch = 0; ch < 4; ch++) {
+            while (manchester_transmit_async(ch, frame, RATES_FRAME_LEN, NULL, NULL) != 0) {
+                link_tx_poll();
+                phy_sleep_us(get_port_bit_duration(ch));
+            }
+        }
+    }
+    link_tx_flush();
+    phy_sim_run();
+
+    double wall = bench_now() - start;
+    double virtual_s = (phy_tick() - virtual_start) * 1e-6;
+    int total_ok = 0;
+    for (int ch = 0; ch < 4; ch++) {
+        printf("%-12s %4d %8u %10u %9d%%\n", label, ch, port_jitter_us[ch], get_port_bit_duration(ch),
+               frames_ok[ch] * 100 / RATES_FRAMES);
+        total_ok += frames_ok[ch];
+    }
+    printf("%-12s aggregate %.0f payload bytes/s over %.1f s of wire time (%.1f ms wall)\n", label,
+           total_ok * RATES_FRAME_LEN / virtual_s, virtual_s, wall * 1e3);
+}
+
+int bench_rates(int argc, char *argv[]) {
+    uint32_t base_us = (argc > 1) ? (uint32_t)atoi(argv[1]) : BIT_DURATION_US;
+
+    printf("%d frames of %d bytes per port, base rate %u us per bit\n", RATES_FRAMES, RATES_FRAME_LEN, base_us);
+    printf("%-12s %4s %8s %10s %10s\n", "", "port", "jitter", "bit_us", "delivered");
+
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(base_us);
+
+    //every port at the worst-case rate
+    if (bring_up() != 0) {
+        return 1;
+    }
+    run_traffic("fixed");
+    phy_stop();
+
+    //every port at what its cable carries
+    if (bring_up() != 0) {
+        return 1;
+    }
+    uint32_t virtual_start = phy_tick();
+    link_negotiate(-1);
+    while (link_negotiation_pending() > 0) {
+        link_tx_poll();
+        phy_sleep_us(1000);
+    }
+    printf("negotiation took %.1f s of wire time\n", (phy_tick() - virtual_start) * 1e-6);
+    run_traffic("negotiated");
+    phy_stop();
+
+    set_bit_duration(BIT_DURATION_US);
+    return 0;
+}
@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "distanceVector.h"
+#include "networkLayer.h"
+
+#define RT_MAX_NODES 32
+#define RT_SYNC_BITS 12         //sync preamble, opening flag and idle tail, in bit times
+
+//the routing daemons of a whole network in one process. Links are modelled by the time a frame
+//takes on the wire at the given bit rate; every port sends one frame at a time
+typedef struct {
+    int node;                   //-1 if the port is not cabled
+    int port;
+    int up;
+} RtPeer;
+
+typedef struct {
+    DvRouter router;
+    RtPeer peers[4];
+    uint64_t port_busy_us[4];
+} RtNode;
+
+typedef struct {
+    uint64_t at_us;
+    int node;
+    int port;
+    int len;
+    uint8_t ad[DV_AD_MAX_SIZE];
+} RtEvent;
+
+static RtNode nodes[RT_MAX_NODES];
+static int num_nodes;
+static uint64_t now_us;
+static uint32_t bit_us;
+static uint64_t wire_bytes;
+static int routes_dirty;
+
+//frames in flight, a binary heap on arrival time
+static RtEvent *events;
+static int num_events;
+static int max_events;
+
+static void push_event(const RtEvent *event) {
+    if (num_events == max_events) {
+        max_events = max_events ? max_events * 2 : 256;
+        events = realloc(events, max_events * sizeof(RtEvent));
+    }
+    int i = num_events++;
+    while (i > 0 && events[(i - 1) / 2].at_us > event->at_us) {
+        events[i] = events[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    events[i] = *event;
+}
+
+static RtEvent pop_event(void) {
+    RtEvent top = events[0];
+    RtEvent last = events[--num_events];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= num_events) break;
+        if (child + 1 < num_events && events[child + 1].at_us < events[child].at_us) child++;
+        if (events[child].at_us >= last.at_us) break;
+        events[i] = events[child];
+        i = child;
+    }
+    if (num_events > 0) events[i] = last;
+    return top;
+}
+
+static void send_advert(void *ctx, int port, const uint8_t *ad, int len) {
+    RtNode *node = ctx;
+    //an advert is a network packet in a link frame: header byte, packet header, advert, FCS and
+    //the flag closing it, stuffed bits aside
+    int bytes = 1 + NETWORK_HEADER_SIZE + len + LINK_FCS_SIZE + 1;
+    uint64_t start = node->port_busy_us[port] > now_us ? node->port_busy_us[port] : now_us;
+    node->port_busy_us[port] = start + (uint64_t)(bytes * 8 + RT_SYNC_BITS) * bit_us;
+    wire_bytes += bytes;
+
+    RtPeer *peer = &node->peers[port];
+    if (peer->node < 0 || !peer->up) {
+        return;
+    }
+    RtEvent event = {.at_us = node->port_busy_us[port], .node = peer->node, .port = peer->port, .len = len};
+    memcpy(event.ad, ad, len);
+    push_event(&event);
+}
+
+static void route_changed(void *ctx, uint8_t dest, int port, uint8_t ports, uint8_t metric) {
+    (void)ctx;
+    (void)dest;
+    (void)port;
+    (void)ports;
+    (void)metric;
+    routes_dirty = 1;
+}
+
+static void connect_nodes(int a, int b) {
+    int pa = 0, pb = 0;
+    while (nodes[a].peers[pa].node >= 0) pa++;
+    while (nodes[b].peers[pb].node >= 0) pb++;
+    nodes[a].peers[pa] = (RtPeer){b, pb, 1};
+    nodes[b].peers[pb] = (RtPeer){a, pa, 1};
+}
+
+static void set_link(int a, int b, int up) {
+    for (int p = 0; p < 4; p++) {
+        if (nodes[a].peers[p].node == b) {
+            nodes[a].peers[p].up = up;
+            nodes[b].peers[nodes[a].peers[p].port].up = up;
+        }
+    }
+}
+
+//build a topology, returns the pair of nodes whose link is cut in the failure run
+static void build(const char *topology, int *cut_a, int *cut_b) {
+    for (int i = 0; i < RT_MAX_NODES; i++) {
+        for (int p = 0; p < 4; p++) {
+            nodes[i].peers[p] = (RtPeer){-1, 0, 0};
+        }
+    }
+    if (strcmp(topology, "line") == 0) {
+        num_nodes = 8;
+        for (int i = 0; i + 1 < num_nodes; i++) connect_nodes(i, i + 1);
+        *cut_a = 3, *cut_b = 4;
+    } else if (strcmp(topology, "ring") == 0) {
+        num_nodes = 8;
+        for (int i = 0; i < num_nodes; i++) connect_nodes(i, (i + 1) % num_nodes);
+        *cut_a = 0, *cut_b = 1;
+    } else if (strcmp(topology, "tree") == 0) {
+        num_nodes = 15;
+        for (int i = 1; i < num_nodes; i++) connect_nodes((i - 1) / 2, i);
+        *cut_a = 0, *cut_b = 1;
+    } else {
+        num_nodes = 16;     //4x4 grid
+        for (int i = 0; i < num_nodes; i++) {
+            if (i % 4 < 3) connect_nodes(i, i + 1);
+            if (i + 4 < num_nodes) connect_nodes(i, i + 4);
+        }
+        *cut_a = 5, *cut_b = 6;
+    }
+}
+
+//every node holds the shortest hop count over the links that are up, and nothing else
+static int converged(void) {
+    for (int s = 0; s < num_nodes; s++) {
+        int dist[RT_MAX_NODES], queue[RT_MAX_NODES], head = 0, tail = 0;
+        for (int i = 0; i < num_nodes; i++) dist[i] = DV_INFINITY;
+        dist[s] = 0;
+        queue[tail++] = s;
+        while (head < tail) {
+            int n = queue[head++];
+            for (int p = 0; p < 4; p++) {
+                RtPeer *peer = &nodes[n].peers[p];
+                if (peer->node >= 0 && peer->up && dist[peer->node] == DV_INFINITY) {
+                    dist[peer->node] = dist[n] + 1;
+                    queue[tail++] = peer->node;
+                }
+            }
+        }
+        for (int t = 0; t < num_nodes; t++) {
+            DvRoute *route = &nodes[s].router.routes[t + 1];
+            int reachable = route->in_use && route->metric < DV_INFINITY;
+            if (dist[t] < DV_INFINITY ? (!reachable || route->metric != dist[t]) : reachable) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+//run until end_us, returns when the routes last became right, or 0 if they are not at the end
+static uint64_t run(uint64_t end_us, uint64_t *bytes_at_convergence) {
+    uint64_t converged_us = converged() ? now_us : 0;
+    uint64_t next_tick_us = now_us;
+    while (now_us < end_us) {
+        if (num_events > 0 && events[0].at_us <= next_tick_us) {
+            RtEvent event = pop_event();
+            now_us = event.at_us;
+            dv_receive(&nodes[event.node].router, event.port, event.ad, event.len, (uint32_t)(now_us / 1000));
+        } else {
+            now_us = next_tick_us;
+            for (int i = 0; i < num_nodes; i++) {
+                dv_tick(&nodes[i].router, (uint32_t)(now_us / 1000));
+            }
+            next_tick_us += ROUTING_TICK_MS * 1000;
+        }
+        if (routes_dirty) {
+            routes_dirty = 0;
+            if (!converged()) {
+                converged_us = 0;
+            } else if (converged_us == 0) {
+                converged_us = now_us;
+                *bytes_at_convergence = wire_bytes;
+            }
+        }
+    }
+    return converged_us;
+}
+
+static void run_topology(const char *topology, const char *label, const DvConfig *base) {
+    int cut_a, cut_b;
+    build(topology, &cut_a, &cut_b);
+    now_us = 0;
+    wire_bytes = 0;
+    num_events = 0;
+    for (int i = 0; i < num_nodes; i++) {
+        DvConfig config = *base;
+        config.port_mask = 0;
+        for (int p = 0; p < 4; p++) {
+            if (nodes[i].peers[p].node >= 0) config.port_mask |= 1 << p;
+            nodes[i].port_busy_us[p] = 0;
+        }
+        dv_init(&nodes[i].router, (uint8_t)(i + 1), &config, send_advert, route_changed, &nodes[i]);
+    }
+
+    //every node boots at once
+    for (int i = 0; i < num_nodes; i++) {
+        dv_start(&nodes[i].router, 0);
+    }
+    uint64_t interval_us = base->update_interval_ms * 1000ULL;
+    uint64_t cold_bytes = 0;
+    //without triggered updates news travels one hop per full update
+    uint64_t settle_us = (num_nodes + 1) * interval_us;
+    uint64_t cold_us = run(settle_us, &cold_bytes);
+
+    //steady state: only the periodic updates are left
+    uint64_t steady_start_bytes = wire_bytes;
+    uint64_t steady_start_us = now_us;
+    uint64_t unused = 0;
+    run(now_us + 4 * interval_us, &unused);
+    double steady_bps = (wire_bytes - steady_start_bytes) * 1e6 / (double)(now_us - steady_start_us);
+
+    //a cable is pulled, found only when its routes time out
+    set_link(cut_a, cut_b, 0);
+    uint64_t cut_us = now_us;
+    uint64_t cut_bytes = wire_bytes;
+    uint64_t fail_bytes = 0;
+    routes_dirty = 1;
+    uint64_t fail_us = run(now_us + base->route_timeout_ms * 1000ULL + settle_us, &fail_bytes);
+
+    char cold[16], fail[16];
+    snprintf(cold, sizeof(cold), cold_us ? "%.2f" : "never", cold_us / 1e6);
+    snprintf(fail, sizeof(fail), fail_us ? "%.2f" : "never", (fail_us - cut_us) / 1e6);
+    printf("%-6s %-16s %5d %10s %10lu %10s %10lu %10.1f\n", topology, label, num_nodes, cold,
+           (unsigned long)cold_bytes, fail, (unsigned long)(fail_us ? fail_bytes - cut_bytes : 0), steady_bps);
+}
+
+int bench_routing(int argc, char *argv[]) {
+    bit_us = (argc > 1) ? (uint32_t)atoi(argv[1]) : 100;
+    static const char *topologies[] = {"line", "ring", "tree", "grid"};
+
+    DvConfig base;
+    dv_default_config(&base);
+    DvConfig no_split = base;
+    no_split.split_horizon = 0;
+    DvConfig periodic_only = base;
+    periodic_only.triggered_updates = 0;
+
+    printf("%u us per bit, full update every %u s, routes time out after %u s\n",
+           bit_us, base.update_interval_ms / 1000, base.route_timeout_ms / 1000);
+    printf("times are from boot and from the cable being pulled, bytes are all adverts on the wire until then\n");
+    printf("%-6s %-16s %5s %10s %10s %10s %10s %10s\n", "topo", "config", "nodes", "boot_s", "boot_B",
+           "cut_s", "cut_B", "steady_B/s");
+    for (int t = 0; t < 4; t++) {
+        run_topology(topologies[t], "split+triggered", &base);
+        run_topology(topologies[t], "no split horizon", &no_split);
+        run_topology(topologies[t], "periodic only", &periodic_only);
+    }
+    free(events);
+    events = NULL;
+    max_events = 0;
+    return 0;
+}
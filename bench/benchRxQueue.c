@@ -0,0 +1,91 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "linkLayer.h"
+#include "phy.h"
+
+#define RXQ_FRAMES 100
+#define RXQ_FRAME_LEN 16
+#define RXQ_BIT_US 100
+
+static double handler_cost_s;
+static _Atomic int frames_handled;
+
+//stands in for routing or printing: burns CPU for a fixed time per frame
+static void slow_handler(uint8_t *data, uint16_t len, int ch) {
+    (void)data;
+    (void)len;
+    (void)ch;
+    double until = bench_now() + handler_cost_s;
+    while (bench_now() < until) {
+    }
+    atomic_fetch_add(&frames_handled, 1);
+}
+
+//every port looped back sends RXQ_FRAMES frames; returns how long the decoding thread was busy
+static double run(int num_workers, LinkRxQueueStats *total) {
+    phy_set_backend(&phy_sim_backend);
+    set_bit_duration(RXQ_BIT_US);
+    if (initialize_link_layer() != 0) {
+        return -1;
+    }
+    set_msg_callback(slow_handler);
+    for (int i = 0; i < 4; i++) {
+        phy_sim_connect(tx_pins[i], rx_pins[i], NULL);
+    }
+    if (num_workers > 0 && link_rx_start(num_workers) != 0) {
+        return -1;
+    }
+    atomic_store(&frames_handled, 0);
+
+    uint8_t frame[RXQ_FRAME_LEN] = {0};
+    double start = bench_now();
+    for (int n = 0; n < RXQ_FRAMES; n++) {
+        for (int ch = 0; ch < 4; ch++) {
+            frame[0] = (uint8_t)n;
+            while (manchester_transmit(ch, frame, RXQ_FRAME_LEN) != 0) {
+                link_tx_poll();
+                phy_sleep_us(RXQ_BIT_US);
+            }
+        }
+    }
+    link_tx_flush();
+    phy_sim_run();
+    double decode_s = bench_now() - start;
+
+    link_rx_stop();
+    *total = (LinkRxQueueStats){0};
+    for (int ch = 0; ch < 4; ch++) {
+        LinkRxQueueStats stats;
+        link_rx_queue_stats(ch, &stats);
+        if (stats.max_depth > total->max_depth) total->max_depth = stats.max_depth;
+        total->delivered += stats.delivered;
+        total->dropped += stats.dropped;
+        total->overflows += stats.overflows;
+    }
+    phy_stop();
+    set_bit_duration(BIT_DURATION_US);
+    return decode_s;
+}
+
+int bench_rxqueue(int argc, char *argv[]) {
+    int cost_us = (argc > 1) ? atoi(argv[1]) : 200;
+    handler_cost_s = cost_us * 1e-6;
+
+    printf("4 ports x %d frames, handler takes %d us per frame\n", RXQ_FRAMES, cost_us);
+    printf("%8s %12s %10s %10s %10s %10s\n", "workers", "decode_ms", "handled", "dropped", "queue_full", "max_depth");
+    for (int workers = 0; workers <= 4; workers = workers ? workers * 2 : 1) {
+        LinkRxQueueStats total;
+        double decode_s = run(workers, &total);
+        if (decode_s < 0) {
+            return 1;
+        }
+        char label[12];
+        snprintf(label, sizeof(label), "%d", workers);
+        printf("%8s %12.1f %10d %10lu %10lu %10u\n", workers ? label : "inline", decode_s * 1e3,
+               atomic_load(&frames_handled), (unsigned long)total.dropped, (unsigned long)total.overflows,
+               total.max_depth);
+    }
+    return 0;
+}
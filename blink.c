@@ -1,5 +1,5 @@
 #include <stdio.h>
-#include <pigpiod_if2.h>
+#include "phy.h"
 
 int main(){
     int P1t=27;
@@ -11,63 +11,65 @@ int main(){
     int P4t=21;
     int P4r=20;
 
-    int pi = pigpio_start(NULL, NULL);
+    if (phy_start() != 0) {
+        return 1;
+    }
 
-    set_mode(pi, P1t, PI_OUTPUT);
-    set_mode(pi, P1r, PI_INPUT);
-    set_mode(pi, P3t, PI_OUTPUT);
-    set_mode(pi, P3r, PI_INPUT);
-    set_mode(pi, P2t, PI_OUTPUT);
-    set_mode(pi, P2r, PI_INPUT);
-    set_mode(pi, P4t, PI_OUTPUT);
-    set_mode(pi, P4r, PI_INPUT);
+    phy_set_mode(P1t, PHY_OUTPUT);
+    phy_set_mode(P1r, PHY_INPUT);
+    phy_set_mode(P3t, PHY_OUTPUT);
+    phy_set_mode(P3r, PHY_INPUT);
+    phy_set_mode(P2t, PHY_OUTPUT);
+    phy_set_mode(P2r, PHY_INPUT);
+    phy_set_mode(P4t, PHY_OUTPUT);
+    phy_set_mode(P4r, PHY_INPUT);
 
     //turn on the LEDs by setting the GPIO pins high
-    gpio_write(pi, P1t, 1); 
-    gpio_read(pi, P1r);
-    set_pull_up_down(pi, P1r, PI_PUD_DOWN);
+    phy_write(P1t, 1); 
+    phy_read(P1r);
+    phy_set_pull_up_down(P1r, PHY_PUD_DOWN);
    
-    time_sleep(2); 
+    phy_sleep_us(2000000); 
 
-    gpio_write(pi, P3t, 1);
-    gpio_read(pi, P3r);
-    set_pull_up_down(pi, P3r, PI_PUD_DOWN);
+    phy_write(P3t, 1);
+    phy_read(P3r);
+    phy_set_pull_up_down(P3r, PHY_PUD_DOWN);
 
-    time_sleep(2);
+    phy_sleep_us(2000000);
 
-    gpio_write(pi, P2t, 1); 
-    gpio_read(pi, P2r);
-    set_pull_up_down(pi, P2r, PI_PUD_DOWN);
+    phy_write(P2t, 1); 
+    phy_read(P2r);
+    phy_set_pull_up_down(P2r, PHY_PUD_DOWN);
    
-    time_sleep(2);
+    phy_sleep_us(2000000);
 
-    gpio_write(pi, P4t, 1); 
-    gpio_read(pi, P4r);
-    set_pull_up_down(pi, P4r, PI_PUD_DOWN);
+    phy_write(P4t, 1); 
+    phy_read(P4r);
+    phy_set_pull_up_down(P4r, PHY_PUD_DOWN);
 
     printf("LEDs for Port 1 and Port 3 are now ON\n");
 
-    time_sleep(5);
+    phy_sleep_us(5000000);
 
     //turn off the LEDs by setting the GPIO pins low
-    gpio_write(pi, P1t, 0); 
-    gpio_read(pi, P1r);
-    time_sleep(2);  
-    gpio_write(pi, P3t, 0); 
-    gpio_read(pi, P3r); 
-    time_sleep(2);
-    gpio_write(pi, P2t, 0);
-    gpio_read(pi, P2r);
-    time_sleep(2);  
-    gpio_write(pi, P4t, 0);
-    gpio_read(pi, P4r); 
+    phy_write(P1t, 0); 
+    phy_read(P1r);
+    phy_sleep_us(2000000);  
+    phy_write(P3t, 0); 
+    phy_read(P3r); 
+    phy_sleep_us(2000000);
+    phy_write(P2t, 0);
+    phy_read(P2r);
+    phy_sleep_us(2000000);  
+    phy_write(P4t, 0);
+    phy_read(P4r); 
 
     printf("LEDs for Port 1 and Port 3 are now OFF\n");
 
-    time_sleep(2); 
+    phy_sleep_us(2000000); 
 
-    //stop PIGPIO 
-    pigpio_stop(pi); 
+    //stop the PHY 
+    phy_stop(); 
 
     return 0;
 }
@@ -0,0 +1,326 @@
+#include <string.h>
+#include "compress.h"
+
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 15)
+#define LZ_MAX_DIST 2048
+#define LZ_MAX_LITERALS 128
+#define HUFFMAN_SYMBOLS 256
+
+//words and endings that short messages are made of, the most common last. A packet's matches
+//reach back into it as if it had been sent right before
+static const char dictionary[] =
+    "please thanks thank you sorry okay yes no maybe today tomorrow tonight morning evening "
+    "again later soon now here there where when what which who why how much many more most "
+    "about after before because between through during without under over into onto "
+    "message network node port route packet link address received sent send status error "
+    "data value temperature sensor reading level battery power update request reply ping pong "
+    "hello world everyone friend meet time day week year number name people thing place "
+    "could would should might must will shall can can't don't doesn't isn't it's I'm you're "
+    "ing tion ment ness able ight ould ough ally ence ance ther ever very just like know think "
+    "make take come good new first last long great little other some any all your our their "
+    "have has had been being was were are is was not but with from this that they them then "
+    "than for and the ";
+
+#define DICT_LEN (int)(sizeof(dictionary) - 1)
+_Static_assert(DICT_LEN + COMPRESS_MAX_INPUT <= LZ_MAX_DIST, "every match has to be in reach");
+_Static_assert(DICT_LEN + COMPRESS_MAX_INPUT <= (int)sizeof(((CompressState *)0)->window), "window too small");
+
+//how often each character turns up in English text, per mille or so; bytes that aren't listed
+//count as 1 so that binary data still has a code
+static const uint16_t text_freq[128] = {
+    [' '] = 180, ['e'] = 95, ['t'] = 70, ['a'] = 62, ['o'] = 60, ['i'] = 54, ['n'] = 54, ['s'] = 50,
+    ['h'] = 44, ['r'] = 46, ['d'] = 32, ['l'] = 31, ['u'] = 22, ['c'] = 21, ['m'] = 19, ['w'] = 17,
+    ['f'] = 17, ['g'] = 15, ['y'] = 15, ['p'] = 14, ['b'] = 11, ['v'] = 8, ['k'] = 6, ['x'] = 2,
+    ['j'] = 2, ['q'] = 2, ['z'] = 2, ['.'] = 10, [','] = 9, ['\''] = 3, ['?'] = 3, ['!'] = 3,
+    ['-'] = 2, [':'] = 2, ['\n'] = 2, ['0'] = 4, ['1'] = 4, ['2'] = 3, ['3'] = 3, ['4'] = 3,
+    ['5'] = 3, ['6'] = 3, ['7'] = 3, ['8'] = 3, ['9'] = 3, ['A'] = 4, ['B'] = 3, ['C'] = 3,
+    ['D'] = 3, ['E'] = 3, ['F'] = 2, ['G'] = 2, ['H'] = 4, ['I'] = 6, ['J'] = 2, ['K'] = 2,
+    ['L'] = 2, ['M'] = 3, ['N'] = 3, ['O'] = 3, ['P'] = 3, ['R'] = 2, ['S'] = 4, ['T'] = 5,
+    ['U'] = 2, ['V'] = 2, ['W'] = 3, ['Y'] = 3,
+};
+
+//latest dictionary position of each hash, + 1; the per-packet table in CompressState only
+//ever holds packet positions, so the dictionary's are never overwritten
+static uint16_t dict_head[1 << COMPRESS_HASH_BITS];
+static uint8_t huffman_len[HUFFMAN_SYMBOLS];
+static uint16_t huffman_code[HUFFMAN_SYMBOLS];
+//every COMPRESS_HUFFMAN_MAX_BITS-bit prefix: the symbol of the code it starts with, and the
+//code's length in the high byte
+static uint16_t huffman_decode[1 << COMPRESS_HUFFMAN_MAX_BITS];
+
+static inline int hash3(const uint8_t *p) {
+    return (int)(((uint32_t)p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u >> (32 - COMPRESS_HASH_BITS));
+}
+
+//code lengths of a Huffman tree over the weights, returns the longest
+static int huffman_lengths(const uint32_t *weight_in, uint8_t *len) {
+    uint32_t weight[2 * HUFFMAN_SYMBOLS];
+    int parent[2 * HUFFMAN_SYMBOLS];
+    memcpy(weight, weight_in, HUFFMAN_SYMBOLS * sizeof(weight[0]));
+    int nodes = HUFFMAN_SYMBOLS;
+    //a node is free until it has a parent, join the two lightest until one is left
+    for (int i = 0; i < 2 * HUFFMAN_SYMBOLS; i++) {
+        parent[i] = -1;
+    }
+    while (nodes < 2 * HUFFMAN_SYMBOLS - 1) {
+        int a = -1, b = -1;
+        for (int i = 0; i < nodes; i++) {
+            if (parent[i] != -1) continue;
+            if (a < 0 || weight[i] < weight[a]) {
+                b = a;
+                a = i;
+            } else if (b < 0 || weight[i] < weight[b]) {
+                b = i;
+            }
+        }
+        weight[nodes] = weight[a] + weight[b];
+        parent[a] = parent[b] = nodes;
+        nodes++;
+    }
+    int longest = 0;
+    for (int s = 0; s < HUFFMAN_SYMBOLS; s++) {
+        int depth = 0;
+        for (int n = s; parent[n] != -1; n = parent[n]) {
+            depth++;
+        }
+        len[s] = (uint8_t)depth;
+        if (depth > longest) longest = depth;
+    }
+    return longest;
+}
+
+//the tables have to be there before the first packet, so they are built before main
+__attribute__((constructor)) static void build_tables(void) {
+    for (int p = 0; p + LZ_MIN_MATCH <= DICT_LEN; p++) {
+        dict_head[hash3((const uint8_t *)dictionary + p)] = (uint16_t)(p + 1);
+    }
+
+    //flatten the weights until no code is longer than the decode table
+    uint32_t weight[HUFFMAN_SYMBOLS];
+    for (int s = 0; s < HUFFMAN_SYMBOLS; s++) {
+        weight[s] = (s < 128 && text_freq[s]) ? 16u * text_freq[s] : 1;
+    }
+    while (huffman_lengths(weight, huffman_len) > COMPRESS_HUFFMAN_MAX_BITS) {
+        for (int s = 0; s < HUFFMAN_SYMBOLS; s++) {
+            weight[s] = (weight[s] + 1) / 2;
+        }
+    }
+
+    //canonical codes: shorter codes first, in symbol order within a length
+    int count[COMPRESS_HUFFMAN_MAX_BITS + 1] = {0};
+    for (int s = 0; s < HUFFMAN_SYMBOLS; s++) {
+        count[huffman_len[s]]++;
+    }
+    uint16_t next[COMPRESS_HUFFMAN_MAX_BITS + 1];
+    uint16_t code = 0;
+    count[0] = 0;
+    for (int bits = 1; bits <= COMPRESS_HUFFMAN_MAX_BITS; bits++) {
+        code = (uint16_t)((code + count[bits - 1]) << 1);
+        next[bits] = code;
+    }
+    for (int s = 0; s < HUFFMAN_SYMBOLS; s++) {
+        int bits = huffman_len[s];
+        huffman_code[s] = next[bits]++;
+        int shift = COMPRESS_HUFFMAN_MAX_BITS - bits;
+        for (int i = 0; i < (1 << shift); i++) {
+            huffman_decode[(huffman_code[s] << shift) | i] = (uint16_t)(bits << 8 | s);
+        }
+    }
+}
+
+const char *compress_codec_name(CompressCodec codec) {
+    switch (codec) {
+    case COMPRESS_NONE:
+        return "none";
+    case COMPRESS_LZ:
+        return "lz";
+    case COMPRESS_HUFFMAN:
+        return "huffman";
+    }
+    return "?";
+}
+
+void compress_init(CompressState *state) {
+    memset(state->head, 0, sizeof(state->head));
+    memcpy(state->window, dictionary, DICT_LEN);
+}
+
+static int put_literals(const uint8_t *from, int n, uint8_t *out, int o, int max_out) {
+    while (n > 0) {
+        int run = n < LZ_MAX_LITERALS ? n : LZ_MAX_LITERALS;
+        if (o + 1 + run > max_out) {
+            return -1;
+        }
+        out[o++] = (uint8_t)(run - 1);
+        memcpy(out + o, from, run);
+        o += run;
+        from += run;
+        n -= run;
+    }
+    return o;
+}
+
+static int compress_lz(CompressState *state, const uint8_t *in, int len, uint8_t *out, int max_out) {
+    uint8_t *w = state->window;
+    memcpy(w + DICT_LEN, in, len);
+    int end = DICT_LEN + len;
+    int literals = DICT_LEN;
+    int o = 0;
+    int p = DICT_LEN;
+    while (p < end) {
+        int best_len = 0, best_pos = 0;
+        if (p + LZ_MIN_MATCH <= end) {
+            int h = hash3(w + p);
+            //a packet position left over from an earlier packet is still a position in the
+            //window, the bytes are compared anyway
+            int candidates[2] = {state->head[h] - 1, dict_head[h] - 1};
+            state->head[h] = (uint16_t)(p + 1);
+            for (int c = 0; c < 2; c++) {
+                int from = candidates[c];
+                if (from < 0 || from >= p) continue;
+                int n = 0;
+                while (n < LZ_MAX_MATCH && p + n < end && w[from + n] == w[p + n]) {
+                    n++;
+                }
+                if (n > best_len) {
+                    best_len = n;
+                    best_pos = from;
+                }
+            }
+        }
+        if (best_len < LZ_MIN_MATCH) {
+            p++;
+            continue;
+        }
+        o = put_literals(w + literals, p - literals, out, o, max_out);
+        if (o < 0 || o + 2 > max_out) {
+            return -1;
+        }
+        int dist = p - best_pos - 1;
+        out[o++] = (uint8_t)(0x80 | (best_len - LZ_MIN_MATCH) << 3 | dist >> 8);
+        out[o++] = (uint8_t)dist;
+        //the positions inside the match can start the next one
+        for (int q = p + 1; q < p + best_len && q + LZ_MIN_MATCH <= end; q++) {
+            state->head[hash3(w + q)] = (uint16_t)(q + 1);
+        }
+        p += best_len;
+        literals = p;
+    }
+    return put_literals(w + literals, end - literals, out, o, max_out);
+}
+
+static int decompress_lz(const uint8_t *in, int len, uint8_t *out, int max_out) {
+    int o = 0;
+    int i = 0;
+    while (i < len) {
+        uint8_t token = in[i++];
+        if (!(token & 0x80)) {
+            int run = token + 1;
+            if (i + run > len || o + run > max_out) {
+                return -1;
+            }
+            memcpy(out + o, in + i, run);
+            i += run;
+            o += run;
+            continue;
+        }
+        if (i == len) {
+            return -1;
+        }
+        int n = ((token >> 3) & 0x0F) + LZ_MIN_MATCH;
+        int dist = ((token & 0x07) << 8 | in[i++]) + 1;
+        if (dist > o + DICT_LEN || o + n > max_out) {
+            return -1;
+        }
+        //byte by byte, a match may overlap what it produces
+        for (int k = 0; k < n; k++, o++) {
+            int from = o - dist;
+            out[o] = from >= 0 ? out[from] : (uint8_t)dictionary[DICT_LEN + from];
+        }
+    }
+    return o;
+}
+
+static int compress_huffman(const uint8_t *in, int len, uint8_t *out, int max_out) {
+    if (max_out < 1) {
+        return -1;
+    }
+    out[0] = (uint8_t)len;
+    int o = 1;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (int i = 0; i < len; i++) {
+        acc = acc << huffman_len[in[i]] | huffman_code[in[i]];
+        bits += huffman_len[in[i]];
+        while (bits >= 8) {
+            if (o == max_out) {
+                return -1;
+            }
+            bits -= 8;
+            out[o++] = (uint8_t)(acc >> bits);
+        }
+    }
+    if (bits > 0) {
+        if (o == max_out) {
+            return -1;
+        }
+        out[o++] = (uint8_t)(acc << (8 - bits));
+    }
+    return o;
+}
+
+static int decompress_huffman(const uint8_t *in, int len, uint8_t *out, int max_out) {
+    if (len < 1 || in[0] > max_out) {
+        return -1;
+    }
+    int n = in[0];
+    int available = 8 * (len - 1);
+    int i = 1;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (int k = 0; k < n; k++) {
+        //past the end the stream reads as 0s, a code that needs them is caught below
+        while (bits < COMPRESS_HUFFMAN_MAX_BITS) {
+            acc = acc << 8 | (i < len ? in[i] : 0);
+            i++;
+            bits += 8;
+        }
+        uint16_t entry = huffman_decode[(acc >> (bits - COMPRESS_HUFFMAN_MAX_BITS)) &
+                                        ((1u << COMPRESS_HUFFMAN_MAX_BITS) - 1)];
+        int code_len = entry >> 8;
+        bits -= code_len;
+        available -= code_len;
+        if (available < 0) {
+            return -1;
+        }
+        out[k] = (uint8_t)entry;
+    }
+    return n;
+}
+
+int compress_packet(CompressState *state, CompressCodec codec, const uint8_t *in, int len, uint8_t *out,
+                    int max_out) {
+    if (len > COMPRESS_MAX_INPUT) {
+        return -1;
+    }
+    switch (codec) {
+    case COMPRESS_LZ:
+        return compress_lz(state, in, len, out, max_out);
+    case COMPRESS_HUFFMAN:
+        return compress_huffman(in, len, out, max_out);
+    default:
+        return -1;
+    }
+}
+
+int decompress_packet(CompressCodec codec, const uint8_t *in, int len, uint8_t *out, int max_out) {
+    switch (codec) {
+    case COMPRESS_LZ:
+        return decompress_lz(in, len, out, max_out);
+    case COMPRESS_HUFFMAN:
+        return decompress_huffman(in, len, out, max_out);
+    default:
+        return -1;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdint.h>
+
+//packet compression for slow links, where a byte on the wire costs far more than the CPU time
+//to save it. Both codecs are tuned for short text messages:
+//COMPRESS_LZ is LZ77 over a window that starts with a built-in dictionary of common words, so
+//even a packet's first words can be matches. A token is one byte: 0LLLLLLL is a run of L + 1
+//literals that follow it, 1LLLLDDD with one more byte is a match of L + 3 bytes, D + 1 back.
+//COMPRESS_HUFFMAN is a static canonical Huffman code built from the letter frequencies of
+//English text, with codes of at most COMPRESS_HUFFMAN_MAX_BITS; the stream starts with the
+//number of bytes it decodes to
+typedef enum {
+    COMPRESS_NONE,
+    COMPRESS_LZ,
+    COMPRESS_HUFFMAN,
+} CompressCodec;
+
+#define COMPRESS_NUM_CODECS 3
+#define COMPRESS_MAX_INPUT 255          //longest input, one packet
+#define COMPRESS_HASH_BITS 10
+#define COMPRESS_HUFFMAN_MAX_BITS 12
+
+//what the compressor keeps between packets, so nothing is allocated or cleared per packet
+typedef struct {
+    uint16_t head[1 << COMPRESS_HASH_BITS];    //latest window position of each 3-byte hash, + 1
+    uint8_t window[2048];                       //the dictionary, then the packet being compressed
+} CompressState;
+
+/**
+ * @brief name of a codec, for logs and benchmarks
+ */
+const char *compress_codec_name(CompressCodec codec);
+
+/**
+ * @brief set up a compressor, once before its first packet
+ */
+void compress_init(CompressState *state);
+
+/**
+ * @brief compress a packet
+ * @param state the compressor, one caller at a time
+ * @param codec COMPRESS_LZ or COMPRESS_HUFFMAN
+ * @param in the packet
+ * @param len bytes of in, at most COMPRESS_MAX_INPUT
+ * @param out where the compressed bytes go
+ * @param max_out room in out; the packet is given up on as soon as it would not fit
+ * @return compressed bytes, -1 if they take more than max_out
+ */
+int compress_packet(CompressState *state, CompressCodec codec, const uint8_t *in, int len, uint8_t *out,
+                    int max_out);
+
+/**
+ * @brief decompress a packet
+ * @param codec the codec it was compressed with
+ * @param in the compressed bytes
+ * @param len bytes of in
+ * @param out room for max_out bytes
+ * @param max_out room in out
+ * @return bytes of the packet, -1 if in is not a valid stream of the codec or does not fit
+ */
+int decompress_packet(CompressCodec codec, const uint8_t *in, int len, uint8_t *out, int max_out);
+
+#endif // COMPRESS_H
@@ -0,0 +1,223 @@
+#include <string.h>
+#include "distanceVector.h"
+
+//timers are compared by difference so the millisecond clock may wrap
+static int time_reached(uint32_t now_ms, uint32_t at_ms) {
+    return (int32_t)(now_ms - at_ms) >= 0;
+}
+
+void dv_default_config(DvConfig *config) {
+    //a full table takes a few frames, at the default bit rate that is seconds of line time,
+    //so full updates are rare and changes go out as triggered updates
+    config->update_interval_ms = 30000;
+    config->route_timeout_ms = 180000;
+    config->gc_timeout_ms = 120000;
+    config->triggered_delay_ms = 500;
+    config->port_mask = 0x0F;
+    config->split_horizon = 1;
+    config->triggered_updates = 1;
+}
+
+void dv_init(DvRouter *router, uint8_t address, const DvConfig *config,
+             dv_send_t send, dv_route_t route_changed, void *ctx) {
+    memset(router, 0, sizeof(*router));
+    router->address = address;
+    router->config = *config;
+    router->send = send;
+    router->route_changed = route_changed;
+    router->ctx = ctx;
+    router->routes[address] = (DvRoute){.in_use = 1, .metric = 0, .port = ROUTE_NO_PORT};
+}
+
+static void send_ad(DvRouter *router, int port, const uint8_t *ad, int len) {
+    router->stats.ads_sent++;
+    router->stats.ad_bytes_sent += len;
+    router->send(router->ctx, port, ad, len);
+}
+
+//advertise the routes to a port, all of them or only the changed ones
+static void send_routes(DvRouter *router, int port, int changed_only) {
+    uint8_t ad[DV_AD_MAX_SIZE];
+    int len = 1;
+    ad[0] = DV_AD_UPDATE;
+    for (int dest = 0; dest < ROUTE_NUM_ADDRESSES; dest++) {
+        DvRoute *route = &router->routes[dest];
+        if (!route->in_use || (changed_only && !route->changed)) {
+            continue;
+        }
+        //the neighbours we learned it from know better, telling them only risks a loop;
+        //a withdrawal is still sent so they are not waiting for a timeout
+        if (router->config.split_horizon && (route->ports & (1 << port)) && route->metric < DV_INFINITY) {
+            continue;
+        }
+        ad[len++] = (uint8_t)dest;
+        ad[len++] = route->metric;
+        if (len == DV_AD_MAX_SIZE) {
+            send_ad(router, port, ad, len);
+            len = 1;
+        }
+    }
+    //a full update goes out even if empty, it keeps our routes alive at the neighbour
+    if (len > 1 || !changed_only) {
+        send_ad(router, port, ad, len);
+    }
+}
+
+static void send_request(DvRouter *router, int port) {
+    uint8_t request = DV_AD_REQUEST;
+    send_ad(router, port, &request, 1);
+}
+
+static void send_to_all(DvRouter *router, int changed_only) {
+    for (int port = 0; port < 4; port++) {
+        if (router->config.port_mask & (1 << port)) {
+            send_routes(router, port, changed_only);
+            if (router->request_pending) {
+                send_request(router, port);
+            }
+        }
+    }
+    router->request_pending = 0;
+    for (int dest = 0; dest < ROUTE_NUM_ADDRESSES; dest++) {
+        router->routes[dest].changed = 0;
+    }
+    router->triggered_pending = 0;
+}
+
+//record a new best route and schedule it to go out
+static void set_route(DvRouter *router, uint8_t dest, int port, uint8_t metric, uint32_t now_ms) {
+    DvRoute *route = &router->routes[dest];
+    int reachable = metric < DV_INFINITY;
+    int was_reachable = route->in_use && route->metric < DV_INFINITY;
+
+    route->in_use = 1;
+    route->port = (int8_t)port;
+    route->ports = reachable ? (uint8_t)(1 << port) : 0;
+    route->metric = metric;
+    route->changed = 1;
+    route->expires_ms = now_ms + (reachable ? router->config.route_timeout_ms : router->config.gc_timeout_ms);
+    router->stats.route_changes++;
+    router->route_changed(router->ctx, dest, reachable ? port : ROUTE_NO_PORT, route->ports, metric);
+
+    if (router->config.triggered_updates && (reachable || was_reachable)) {
+        //neighbours only advertise their other routes to us in full updates, so when one is lost
+        //they are asked for them rather than waiting for the next one
+        router->request_pending |= was_reachable && !reachable;
+        if (!router->triggered_pending) {
+            router->triggered_pending = 1;
+            router->triggered_ms = now_ms + router->config.triggered_delay_ms;
+        }
+    }
+}
+
+//the next hops of a route changed but not its metric, so the neighbours aren't told
+static void set_ports(DvRouter *router, uint8_t dest, uint8_t ports) {
+    DvRoute *route = &router->routes[dest];
+    route->ports = ports;
+    router->stats.route_changes++;
+    router->route_changed(router->ctx, dest, route->port, ports, route->metric);
+}
+
+//the next hop stopped offering the route at its metric; another one that still does takes
+//over without the route going down. Returns 0 if there is none
+static int promote_alternate(DvRouter *router, uint8_t dest) {
+    DvRoute *route = &router->routes[dest];
+    uint8_t others = route->ports & (uint8_t)~(1 << route->port);
+    if (others == 0) {
+        return 0;
+    }
+    route->port = (int8_t)__builtin_ctz(others);
+    route->expires_ms = route->alt_expires_ms[route->port];
+    set_ports(router, dest, others);
+    return 1;
+}
+
+void dv_start(DvRouter *router, uint32_t now_ms) {
+    router->request_pending = 1;
+    send_to_all(router, 0);
+    router->next_update_ms = now_ms + router->config.update_interval_ms;
+}
+
+void dv_receive(DvRouter *router, int port, const uint8_t *ad, int len, uint32_t now_ms) {
+    if (len < 1 || port < 0 || port >= 4) {
+        return;
+    }
+    router->stats.ads_received++;
+    if (ad[0] == DV_AD_REQUEST) {
+        //a neighbour just came up or lost a route, it gets our table straight away
+        send_routes(router, port, 0);
+        return;
+    }
+    if (ad[0] != DV_AD_UPDATE) {
+        return;
+    }
+
+    for (int i = 1; i + 1 < len; i += 2) {
+        uint8_t dest = ad[i];
+        uint8_t metric = ad[i + 1] < DV_INFINITY ? ad[i + 1] + 1 : DV_INFINITY;
+        DvRoute *route = &router->routes[dest];
+        if (dest == router->address) {
+            continue;
+        }
+
+        if (route->in_use && route->port == port) {
+            //our next hop speaks for this route: follow it up or down, and it is still alive
+            if (metric != route->metric) {
+                if (metric > route->metric && promote_alternate(router, dest)) {
+                    continue;
+                }
+                if (metric < DV_INFINITY || route->metric < DV_INFINITY) {
+                    set_route(router, dest, port, metric, now_ms);
+                }
+            } else if (metric < DV_INFINITY) {
+                route->expires_ms = now_ms + router->config.route_timeout_ms;
+            }
+        } else if (metric < DV_INFINITY && (!route->in_use || metric < route->metric)) {
+            set_route(router, dest, port, metric, now_ms);
+        } else if (metric < DV_INFINITY && metric == route->metric) {
+            //as good a way there as the one we use, traffic is spread over both
+            route->alt_expires_ms[port] = now_ms + router->config.route_timeout_ms;
+            if (!(route->ports & (1 << port))) {
+                set_ports(router, dest, route->ports | (uint8_t)(1 << port));
+            }
+        } else if (route->ports & (1 << port)) {
+            set_ports(router, dest, route->ports & (uint8_t)~(1 << port));
+        }
+    }
+}
+
+void dv_tick(DvRouter *router, uint32_t now_ms) {
+    for (int dest = 0; dest < ROUTE_NUM_ADDRESSES; dest++) {
+        DvRoute *route = &router->routes[dest];
+        if (!route->in_use || route->port == ROUTE_NO_PORT) {
+            continue;
+        }
+        uint8_t ports = route->ports;
+        for (int port = 0; port < 4; port++) {
+            if (port != route->port && (ports & (1 << port)) && time_reached(now_ms, route->alt_expires_ms[port])) {
+                ports &= (uint8_t)~(1 << port);
+            }
+        }
+        if (ports != route->ports) {
+            set_ports(router, (uint8_t)dest, ports);
+        }
+        if (!time_reached(now_ms, route->expires_ms)) {
+            continue;
+        }
+        if (route->metric < DV_INFINITY) {
+            //the next hop went quiet
+            if (!promote_alternate(router, (uint8_t)dest)) {
+                set_route(router, (uint8_t)dest, route->port, DV_INFINITY, now_ms);
+            }
+        } else {
+            route->in_use = 0;
+        }
+    }
+
+    if (time_reached(now_ms, router->next_update_ms)) {
+        send_to_all(router, 0);
+        router->next_update_ms = now_ms + router->config.update_interval_ms;
+    } else if (router->triggered_pending && time_reached(now_ms, router->triggered_ms)) {
+        send_to_all(router, 1);
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef DISTANCE_VECTOR_H
+#define DISTANCE_VECTOR_H
+
+#include <stdint.h>
+#include "routingTable.h"
+
+#define DV_INFINITY 16          //hop count meaning unreachable, also bounds counting to infinity
+#define DV_AD_REQUEST 1         //advert type: asks the neighbour for its whole table
+#define DV_AD_UPDATE 2          //advert type: followed by (dest, metric) pairs
+#define DV_AD_MAX_ROUTES 60     //pairs in one advert, a bigger table goes out in several
+#define DV_AD_MAX_SIZE (1 + 2 * DV_AD_MAX_ROUTES)
+
+//sends an advert out of a port
+typedef void (*dv_send_t)(void *ctx, int port, const uint8_t *ad, int len);
+//the best route to dest changed: port is the next hop, ROUTE_NO_PORT when it became
+//unreachable, and ports has bit n set for every port n with a route of that metric
+typedef void (*dv_route_t)(void *ctx, uint8_t dest, int port, uint8_t ports, uint8_t metric);
+
+typedef struct {
+    uint32_t update_interval_ms;    //full table to every neighbour this often
+    uint32_t route_timeout_ms;      //a route not heard of for this long becomes unreachable
+    uint32_t gc_timeout_ms;         //an unreachable route is advertised this long, then forgotten
+    uint32_t triggered_delay_ms;    //changes are collected this long before they go out
+    uint8_t port_mask;              //ports to advertise on, bit n for port n
+    uint8_t split_horizon;          //leave routes out of adverts to the port they were learned on
+    uint8_t triggered_updates;      //send changes as they happen instead of with the next full update
+} DvConfig;
+
+typedef struct {
+    uint8_t in_use;
+    uint8_t metric;         //hops, 0 for ourselves, DV_INFINITY while being withdrawn
+    int8_t port;            //next hop, ROUTE_NO_PORT for ourselves
+    uint8_t ports;          //port and the other next hops advertising the same metric, bit n for port n
+    uint8_t changed;        //goes out with the next triggered update
+    uint32_t expires_ms;    //timeout, or when a withdrawn route is forgotten
+    uint32_t alt_expires_ms[4]; //timeouts of the other next hops in ports
+} DvRoute;
+
+typedef struct {
+    uint32_t ads_sent;
+    uint32_t ad_bytes_sent;
+    uint32_t ads_received;
+    uint32_t route_changes;
+} DvStats;
+
+//one node's routing state, every call on it must come from one thread at a time
+typedef struct {
+    uint8_t address;
+    DvConfig config;
+    DvRoute routes[ROUTE_NUM_ADDRESSES];
+    uint32_t next_update_ms;
+    uint32_t triggered_ms;
+    int triggered_pending;
+    int request_pending;    //lost a route, ask the neighbours for alternatives with the triggered update
+    dv_send_t send;
+    dv_route_t route_changed;
+    void *ctx;
+    DvStats stats;
+} DvRouter;
+
+/**
+ * @brief timers and flags the routing daemon uses by default, advertising on every port
+ * @param config filled in
+ */
+void dv_default_config(DvConfig *config);
+
+/**
+ * @brief set up a router that only knows a route to itself
+ * @param router the router
+ * @param address the node's own address
+ * @param config timers and flags, copied
+ * @param send called to send an advert
+ * @param route_changed called when the best route to an address changes
+ * @param ctx passed to both callbacks
+ */
+void dv_init(DvRouter *router, uint8_t address, const DvConfig *config,
+             dv_send_t send, dv_route_t route_changed, void *ctx);
+
+/**
+ * @brief announce the router to its neighbours and ask them for their tables
+ * @param router the router
+ * @param now_ms the current time
+ */
+void dv_start(DvRouter *router, uint32_t now_ms);
+
+/**
+ * @brief handle an advert received from a neighbour
+ * @param router the router
+ * @param port the port it arrived on
+ * @param ad the advert
+ * @param len its length
+ * @param now_ms the current time
+ */
+void dv_receive(DvRouter *router, int port, const uint8_t *ad, int len, uint32_t now_ms);
+
+/**
+ * @brief run the timers: route timeouts, triggered and periodic updates; call often
+ * compared to triggered_delay_ms
+ * @param router the router
+ * @param now_ms the current time
+ */
+void dv_tick(DvRouter *router, uint32_t now_ms);
+
+#endif // DISTANCE_VECTOR_H
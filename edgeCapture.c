@@ -0,0 +1,187 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "edgeCapture.h"
+
+#define EDGE_RING_SIZE 16384    //edges, must be a power of two; a 10 ms drain keeps up with 1.6M edges/s
+#define EDGE_IDLE_US 10000      //how long the drain thread sleeps when the ring is empty
+#define EDGE_READ_CHUNK 256     //records the drain thread packs before writing them
+#define EDGE_WAIT_US 100        //how long a lossless capture waits for the drain thread when the ring is full
+
+//the same bounded multi-producer ring as trace.c: a slot is free for position p when its seq is p,
+//and holds an edge for position p when its seq is p + 1, stored minus the slot index
+typedef struct {
+    _Atomic uint32_t seq;
+    EdgeRecord rec;
+} EdgeSlot;
+
+static EdgeSlot ring[EDGE_RING_SIZE];
+static _Atomic uint32_t enqueue_pos;
+static uint32_t dequeue_pos;
+static _Atomic uint32_t dropped;
+
+_Atomic int edge_capture_active;
+static int wait_when_full;
+static pthread_t drain_thread;
+static _Atomic int drain_running;
+static FILE *capture_file;
+
+static uint32_t slot_seq(uint32_t idx) {
+    return atomic_load_explicit(&ring[idx].seq, memory_order_acquire) + idx;
+}
+
+static void set_slot_seq(uint32_t idx, uint32_t seq) {
+    atomic_store_explicit(&ring[idx].seq, seq - idx, memory_order_release);
+}
+
+void edge_capture_record(unsigned gpio, unsigned level, uint32_t tick) {
+    uint32_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    uint32_t idx;
+    for (;;) {
+        idx = pos & (EDGE_RING_SIZE - 1);
+        int32_t diff = (int32_t)(slot_seq(idx) - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            //ring full, only a simulated line may be held up until the drain thread catches up
+            if (!wait_when_full) {
+                atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+                return;
+            }
+            usleep(EDGE_WAIT_US);
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+    EdgeRecord *rec = &ring[idx].rec;
+    rec->tick = tick;
+    rec->gpio = (uint8_t)gpio;
+    rec->level = (uint8_t)level;
+    set_slot_seq(idx, pos + 1);
+}
+
+//take the oldest edge, only the drain thread calls this
+static int ring_pop(EdgeRecord *rec) {
+    uint32_t idx = dequeue_pos & (EDGE_RING_SIZE - 1);
+    if (slot_seq(idx) != dequeue_pos + 1) return 0;
+    *rec = ring[idx].rec;
+    set_slot_seq(idx, dequeue_pos + EDGE_RING_SIZE);
+    dequeue_pos++;
+    return 1;
+}
+
+static void pack_record(const EdgeRecord *rec, uint8_t *out) {
+    out[0] = (uint8_t)rec->tick;
+    out[1] = (uint8_t)(rec->tick >> 8);
+    out[2] = (uint8_t)(rec->tick >> 16);
+    out[3] = (uint8_t)(rec->tick >> 24);
+    out[4] = (uint8_t)(rec->gpio << 1 | (rec->level & 1));
+}
+
+static void drain(void) {
+    uint8_t buf[EDGE_READ_CHUNK * EDGE_RECORD_SIZE];
+    EdgeRecord rec;
+    int n = 0;
+    while (ring_pop(&rec)) {
+        pack_record(&rec, buf + n * EDGE_RECORD_SIZE);
+        if (++n == EDGE_READ_CHUNK) {
+            fwrite(buf, EDGE_RECORD_SIZE, (size_t)n, capture_file);
+            n = 0;
+        }
+    }
+    fwrite(buf, EDGE_RECORD_SIZE, (size_t)n, capture_file);
+    fflush(capture_file);
+}
+
+static void *drain_main(void *arg) {
+    (void)arg;
+    while (atomic_load(&drain_running)) {
+        drain();
+        usleep(EDGE_IDLE_US);
+    }
+    drain();
+    return NULL;
+}
+
+int edge_capture_start(const char *path, const EdgeCaptureInfo *info, int lossless) {
+    if (atomic_load(&drain_running)) return 0;
+    wait_when_full = lossless;
+    capture_file = fopen(path, "wb");
+    if (capture_file == NULL) {
+        perror("edge capture file");
+        return 1;
+    }
+    //header: magic, record size and the receiver's setup
+    uint32_t rec_size = EDGE_RECORD_SIZE;
+    fwrite(EDGE_FILE_MAGIC, sizeof(EDGE_FILE_MAGIC), 1, capture_file);
+    fwrite(&rec_size, sizeof(rec_size), 1, capture_file);
+    fwrite(info, sizeof(*info), 1, capture_file);
+
+    atomic_store(&drain_running, 1);
+    if (pthread_create(&drain_thread, NULL, drain_main, NULL) != 0) {
+        atomic_store(&drain_running, 0);
+        fclose(capture_file);
+        capture_file = NULL;
+        return 1;
+    }
+    atomic_store(&edge_capture_active, 1);
+    return 0;
+}
+
+void edge_capture_stop(void) {
+    if (!atomic_load(&drain_running)) return;
+    atomic_store(&edge_capture_active, 0);
+    atomic_store(&drain_running, 0);
+    pthread_join(drain_thread, NULL);
+    fclose(capture_file);
+    capture_file = NULL;
+    if (edge_capture_dropped() > 0) {
+        fprintf(stderr, "edge capture lost %u edges, the ring was full\n", edge_capture_dropped());
+    }
+}
+
+uint32_t edge_capture_dropped(void) {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+FILE *edge_capture_open(const char *path, EdgeCaptureInfo *info) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return NULL;
+    }
+    char magic[sizeof(EDGE_FILE_MAGIC)];
+    uint32_t rec_size = 0;
+    if (fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, EDGE_FILE_MAGIC, sizeof(magic)) != 0 ||
+        fread(&rec_size, sizeof(rec_size), 1, f) != 1 || rec_size != EDGE_RECORD_SIZE ||
+        fread(info, sizeof(*info), 1, f) != 1) {
+        fprintf(stderr, "%s is not an edge capture\n", path);
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+int edge_capture_read(FILE *f, EdgeRecord *recs, int max) {
+    uint8_t buf[EDGE_READ_CHUNK * EDGE_RECORD_SIZE];
+    int total = 0;
+    while (total < max) {
+        int want = (max - total < EDGE_READ_CHUNK) ? max - total : EDGE_READ_CHUNK;
+        int n = (int)fread(buf, EDGE_RECORD_SIZE, (size_t)want, f);
+        for (int i = 0; i < n; i++) {
+            const uint8_t *in = buf + i * EDGE_RECORD_SIZE;
+            EdgeRecord *rec = &recs[total + i];
+            rec->tick = (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+            rec->gpio = in[4] >> 1;
+            rec->level = in[4] & 1;
+        }
+        total += n;
+        if (n < want) break;
+    }
+    return total;
+}
@@ -0,0 +1,85 @@
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//capture of the raw edges the receiver sees, so they can be replayed through the decoder later.
+//A file is EDGE_FILE_MAGIC, the record size, an EdgeCaptureInfo and then one record per edge:
+//the tick as 4 bytes little endian and a byte holding gpio << 1 | level
+#define EDGE_FILE_MAGIC "KANEDG1"
+#define EDGE_RECORD_SIZE 5
+
+//how the receiver was set up when the capture started, so a replay can set it up the same way
+typedef struct {
+    uint32_t bit_us;        //base bit duration
+    uint8_t rx_gpio[4];     //RX pin of each port
+    uint8_t fec[4];         //FecMode of each port
+} EdgeCaptureInfo;
+
+//one captured edge, as the PHY reported it
+typedef struct {
+    uint32_t tick;
+    uint8_t gpio;
+    uint8_t level;
+} EdgeRecord;
+
+//set while a capture is running, read on every edge
+extern _Atomic int edge_capture_active;
+
+/**
+ * @brief queue an edge for the capture file without blocking, use edge_capture instead
+ */
+void edge_capture_record(unsigned gpio, unsigned level, uint32_t tick);
+
+/**
+ * @brief capture an edge if a capture is running, cheap enough to call from every edge callback
+ * @param gpio the pin
+ * @param level the level after the edge
+ * @param tick the PHY's time of the edge in microseconds
+ */
+static inline void edge_capture(unsigned gpio, unsigned level, uint32_t tick) {
+    if (atomic_load_explicit(&edge_capture_active, memory_order_relaxed)) {
+        edge_capture_record(gpio, level, tick);
+    }
+}
+
+/**
+ * @brief start capturing edges into a file, a background thread writes them out
+ * @param path the capture file to write
+ * @param info the receiver's setup, stored in the file's header
+ * @param lossless set to make edge_capture wait for room instead of dropping edges when the ring
+ * is full; only for the simulated PHY, whose edges come faster than real time and never miss a deadline
+ * @return 0 on success, non-zero if failed
+ */
+int edge_capture_start(const char *path, const EdgeCaptureInfo *info, int lossless);
+
+/**
+ * @brief write out what is left and stop capturing
+ */
+void edge_capture_stop(void);
+
+/**
+ * @brief number of edges lost because the ring was full
+ */
+uint32_t edge_capture_dropped(void);
+
+/**
+ * @brief open a capture file and read its header
+ * @param path the capture file
+ * @param info filled in from the header
+ * @return the file positioned at the first record, NULL if it can't be opened or isn't a capture
+ */
+FILE *edge_capture_open(const char *path, EdgeCaptureInfo *info);
+
+/**
+ * @brief read the next records of a capture file
+ * @param f the file from edge_capture_open
+ * @param recs where to put them
+ * @param max room in recs
+ * @return the number of records read, 0 at the end of the file
+ */
+int edge_capture_read(FILE *f, EdgeRecord *recs, int max);
+
+#endif // EDGE_CAPTURE_H
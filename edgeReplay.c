@@ -0,0 +1,199 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "edgeCapture.h"
+#include "linkLayer.h"
+#include "phy.h"
+
+#define REPLAY_ROUND_GAP_US 1000000u    //quiet line between rounds, the decoder drops back to hunting for sync
+
+//what the decoder delivered on a port, the digest covers every frame in order so two replays
+//of a capture that decode the same way print the same line
+typedef struct {
+    uint64_t edges;
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t digest;        //FNV-1a over the length and bytes of every frame
+    double seconds;         //time the port's thread took, with -j
+} PortResult;
+
+typedef struct {
+    EdgeRecord *recs;
+    int count;
+} EdgeList;
+
+static PortResult results[4];
+static EdgeList port_edges[4];
+static int print_frames;
+static int rounds = 1;
+static uint32_t round_span;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void count_frame(Frame *frame, int ch) {
+    PortResult *r = &results[ch];
+    uint16_t len = frame_len(frame);
+    uint64_t h = r->frames == 0 ? 0xcbf29ce484222325ULL : r->digest;
+    h = (h ^ (len & 0xFF)) * 0x100000001b3ULL;
+    h = (h ^ (len >> 8)) * 0x100000001b3ULL;
+    for (int i = 0; i <= len; i++) {
+        h = (h ^ frame->data[i]) * 0x100000001b3ULL;
+    }
+    r->digest = h;
+    r->frames++;
+    r->bytes += len;
+    if (print_frames) {
+        print_callback(frame_payload(frame), len, ch);
+    }
+}
+
+//every round is the capture again, later in time so the gaps between edges stay the same
+static void replay(const EdgeRecord *recs, int count) {
+    for (int round = 0; round < rounds; round++) {
+        uint32_t offset = (uint32_t)round * round_span;
+        for (int i = 0; i < count; i++) {
+            link_rx_edge(recs[i].gpio, recs[i].level, recs[i].tick + offset);
+        }
+    }
+}
+
+static void *port_main(void *arg) {
+    int ch = (int)(intptr_t)arg;
+    double start = now_s();
+    replay(port_edges[ch].recs, port_edges[ch].count);
+    results[ch].seconds = now_s() - start;
+    return NULL;
+}
+
+static int port_of(const EdgeCaptureInfo *info, uint8_t gpio) {
+    for (int i = 0; i < 4; i++) {
+        if (info->rx_gpio[i] == gpio) return i;
+    }
+    return -1;
+}
+
+//pushes the edges of a capture from link_capture_start through the receive decoder as fast as it goes
+//usage: edgeReplay <capture file> [-n rounds] [-j] [-p]
+//  -n replays the capture that many times, -j gives every port its own thread to measure the
+//  edges per second one core decodes, -p prints the frames
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <capture file> [-n rounds] [-j] [-p]\n", argv[0]);
+        return 1;
+    }
+    int threaded = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+            if (rounds < 1) rounds = 1;
+        } else if (strcmp(argv[i], "-j") == 0) {
+            threaded = 1;
+        } else if (strcmp(argv[i], "-p") == 0) {
+            print_frames = 1;
+        }
+    }
+
+    EdgeCaptureInfo info;
+    FILE *f = edge_capture_open(argv[1], &info);
+    if (f == NULL) {
+        return 1;
+    }
+    int count = 0, room = 1 << 16;
+    EdgeRecord *recs = malloc(room * sizeof(*recs));
+    int n;
+    while (recs != NULL && (n = edge_capture_read(f, recs + count, room - count)) > 0) {
+        count += n;
+        if (count == room) {
+            room *= 2;
+            EdgeRecord *grown = realloc(recs, room * sizeof(*recs));
+            if (grown == NULL) free(recs);
+            recs = grown;
+        }
+    }
+    fclose(f);
+    if (recs == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    round_span = (count > 0 ? recs[count - 1].tick - recs[0].tick : 0) + REPLAY_ROUND_GAP_US;
+
+    //the decoder set up as the capture's receiver was, over a PHY that goes nowhere: whatever the
+    //link layer answers the peer is queued and never sent
+    phy_set_backend(&phy_sim_backend);
+    for (int i = 0; i < 4; i++) {
+        rx_pins[i] = info.rx_gpio[i];
+    }
+    set_bit_duration(info.bit_us);
+    if (initialize_link_layer() != 0) {
+        return 1;
+    }
+    for (int i = 0; i < 4; i++) {
+        link_set_fec(i, (FecMode)info.fec[i]);
+    }
+    set_frame_callback(count_frame);
+    set_arq_callback(count_frame);
+
+    for (int i = 0; i < count; i++) {
+        int ch = port_of(&info, recs[i].gpio);
+        if (ch >= 0) port_edges[ch].count++;
+    }
+    for (int ch = 0; ch < 4; ch++) {
+        port_edges[ch].recs = malloc((port_edges[ch].count + 1) * sizeof(EdgeRecord));
+        if (port_edges[ch].recs == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        results[ch].edges = (uint64_t)port_edges[ch].count * rounds;
+        port_edges[ch].count = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        int ch = port_of(&info, recs[i].gpio);
+        if (ch >= 0) port_edges[ch].recs[port_edges[ch].count++] = recs[i];
+    }
+
+    printf("%d edges at base %u us per bit, %d round%s\n", count, info.bit_us, rounds, rounds == 1 ? "" : "s");
+    double start = now_s();
+    if (threaded) {
+        pthread_t threads[4];
+        for (int ch = 0; ch < 4; ch++) {
+            pthread_create(&threads[ch], NULL, port_main, (void *)(intptr_t)ch);
+        }
+        for (int ch = 0; ch < 4; ch++) {
+            pthread_join(threads[ch], NULL);
+        }
+    } else {
+        replay(recs, count);
+    }
+    double elapsed = now_s() - start;
+
+    printf("port %5s %10s %8s %10s %16s %12s %12s\n", "fec", "edges", "frames", "bytes", "digest", "fec_fixed",
+           threaded ? "edges/s" : "");
+    for (int ch = 0; ch < 4; ch++) {
+        PortResult *r = &results[ch];
+        LinkFecStats fec;
+        link_fec_stats(ch, &fec);
+        printf("%4d %5u %10llu %8llu %10llu %016llx %12llu", ch, info.fec[ch], (unsigned long long)r->edges,
+               (unsigned long long)r->frames, (unsigned long long)r->bytes, (unsigned long long)r->digest,
+               (unsigned long long)fec.corrected);
+        if (threaded && r->seconds > 0) {
+            printf(" %12.0f", r->edges / r->seconds);
+        }
+        printf("\n");
+    }
+    uint64_t total = (uint64_t)count * rounds;
+    printf("%llu edges in %.3f s, %.0f edges/s%s\n", (unsigned long long)total, elapsed,
+           elapsed > 0 ? total / elapsed : 0, threaded ? " over every port's thread" : " on one thread");
+
+    phy_stop();
+    for (int ch = 0; ch < 4; ch++) {
+        free(port_edges[ch].recs);
+    }
+    free(recs);
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <string.h>
+#include "fcs.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define FCS_HW_X86 1
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define FCS_HW_ARM 1
+#endif
+
+#define FCS16_POLY 0x8408       //0x1021 bit-reversed
+#define FCS32C_POLY 0x82F63B78u //0x1EDC6F41 bit-reversed
+
+uint16_t fcs16_table[4][256];
+uint32_t fcs32c_table[8][256];
+static int hw_available;
+
+//the tables have to be there before the first frame is received, so they are built before main
+__attribute__((constructor)) static void build_tables(void) {
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc16 = (uint16_t)i;
+        uint32_t crc32 = (uint32_t)i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc16 = (crc16 & 1) ? (crc16 >> 1) ^ FCS16_POLY : crc16 >> 1;
+            crc32 = (crc32 & 1) ? (crc32 >> 1) ^ FCS32C_POLY : crc32 >> 1;
+        }
+        fcs16_table[0][i] = crc16;
+        fcs32c_table[0][i] = crc32;
+    }
+    //slice n: the byte is followed by n more, so its table entry is pushed through n zero bytes
+    for (int i = 0; i < 256; i++) {
+        for (int n = 1; n < 4; n++) {
+            uint16_t prev = fcs16_table[n - 1][i];
+            fcs16_table[n][i] = (prev >> 8) ^ fcs16_table[0][prev & 0xFF];
+        }
+        for (int n = 1; n < 8; n++) {
+            uint32_t prev = fcs32c_table[n - 1][i];
+            fcs32c_table[n][i] = (prev >> 8) ^ fcs32c_table[0][prev & 0xFF];
+        }
+    }
+#if defined(FCS_HW_X86)
+    hw_available = __builtin_cpu_supports("sse4.2");
+#elif defined(FCS_HW_ARM)
+    hw_available = 1;
+#endif
+}
+
+uint16_t fcs16_bitwise(uint16_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ FCS16_POLY : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+uint16_t fcs16_bytewise(uint16_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc = fcs16_byte(crc, data[i]);
+    }
+    return crc;
+}
+
+//four bytes per step: the first two are folded into the register, all four are looked up at once
+uint16_t fcs16_slice4(uint16_t crc, const uint8_t *data, size_t len) {
+    while (len >= 4) {
+        crc ^= (uint16_t)(data[0] | (data[1] << 8));
+        crc = fcs16_table[3][crc & 0xFF] ^ fcs16_table[2][crc >> 8] ^
+              fcs16_table[1][data[2]] ^ fcs16_table[0][data[3]];
+        data += 4;
+        len -= 4;
+    }
+    return fcs16_bytewise(crc, data, len);
+}
+
+uint16_t fcs16(uint16_t crc, const uint8_t *data, size_t len) {
+    return fcs16_slice4(crc, data, len);
+}
+
+uint32_t fcs32c_bitwise(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ FCS32C_POLY : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+uint32_t fcs32c_bytewise(uint32_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc = fcs32c_byte(crc, data[i]);
+    }
+    return crc;
+}
+
+static uint32_t load32_le(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+//eight bytes per step, the first four folded into the register
+uint32_t fcs32c_slice8(uint32_t crc, const uint8_t *data, size_t len) {
+    while (len >= 8) {
+        crc ^= load32_le(data);
+        uint32_t hi = load32_le(data + 4);
+        crc = fcs32c_table[7][crc & 0xFF] ^ fcs32c_table[6][(crc >> 8) & 0xFF] ^
+              fcs32c_table[5][(crc >> 16) & 0xFF] ^ fcs32c_table[4][crc >> 24] ^
+              fcs32c_table[3][hi & 0xFF] ^ fcs32c_table[2][(hi >> 8) & 0xFF] ^
+              fcs32c_table[1][(hi >> 16) & 0xFF] ^ fcs32c_table[0][hi >> 24];
+        data += 8;
+        len -= 8;
+    }
+    return fcs32c_bytewise(crc, data, len);
+}
+
+#if defined(FCS_HW_X86)
+__attribute__((target("sse4.2"))) static uint32_t crc32c_instruction(uint32_t crc, const uint8_t *data, size_t len) {
+#if defined(__x86_64__)
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = (uint32_t)_mm_crc32_u64(crc, word);
+        data += 8;
+        len -= 8;
+    }
+#endif
+    while (len >= 4) {
+        uint32_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+        data += 4;
+        len -= 4;
+    }
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+#elif defined(FCS_HW_ARM)
+static uint32_t crc32c_instruction(uint32_t crc, const uint8_t *data, size_t len) {
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = __crc32cd(crc, word);
+        data += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = __crc32cb(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+uint32_t fcs32c_hw(uint32_t crc, const uint8_t *data, size_t len) {
+#if defined(FCS_HW_X86) || defined(FCS_HW_ARM)
+    if (hw_available) {
+        return crc32c_instruction(crc, data, len);
+    }
+#endif
+    return fcs32c_slice8(crc, data, len);
+}
+
+int fcs32c_hw_available(void) {
+    return hw_available;
+}
+
+uint32_t fcs32c(uint32_t crc, const uint8_t *data, size_t len) {
+    return fcs32c_hw(crc, data, len);
+}
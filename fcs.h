@@ -0,0 +1,76 @@
+#ifndef FCS_H
+#define FCS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//frame check sequences. Both CRCs are the reflected (LSB first) forms used by HDLC and iSCSI:
+//CRC-16/CCITT as in X.25 (poly 0x1021) and CRC-32C (Castagnoli, poly 0x1EDC6F41).
+//Every function works on the running register: start from the INIT value, feed the bytes in as
+//many calls as needed, and send the register inverted, low byte first. Running the receiver's
+//register over the data and that FCS leaves the GOOD residue, so nothing has to be compared or
+//recomputed once the frame is complete
+#define FCS16_INIT 0xFFFF
+#define FCS16_GOOD 0xF0B8
+#define FCS16_SIZE 2
+#define FCS32C_INIT 0xFFFFFFFFu
+#define FCS32C_GOOD 0xB798B438u
+#define FCS32C_SIZE 4
+
+//lookup tables, slice n advances a byte that is n bytes further from the end; built at startup
+extern uint16_t fcs16_table[4][256];
+extern uint32_t fcs32c_table[8][256];
+
+/**
+ * @brief add one byte to a CRC-16, for receivers that see a byte at a time
+ */
+static inline uint16_t fcs16_byte(uint16_t crc, uint8_t byte) {
+    return (crc >> 8) ^ fcs16_table[0][(crc ^ byte) & 0xFF];
+}
+
+/**
+ * @brief add one byte to a CRC-32C
+ */
+static inline uint32_t fcs32c_byte(uint32_t crc, uint8_t byte) {
+    return (crc >> 8) ^ fcs32c_table[0][(crc ^ byte) & 0xFF];
+}
+
+/**
+ * @brief add bytes to a CRC-16 with the fastest implementation
+ * @param crc the running register, FCS16_INIT to start
+ * @param data the bytes
+ * @param len number of bytes
+ * @return the new register
+ */
+uint16_t fcs16(uint16_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief add bytes to a CRC-32C with the fastest implementation: the CPU's crc32 instruction
+ * where there is one, slice-by-8 otherwise
+ * @param crc the running register, FCS32C_INIT to start
+ * @param data the bytes
+ * @param len number of bytes
+ * @return the new register
+ */
+uint32_t fcs32c(uint32_t crc, const uint8_t *data, size_t len);
+
+//the individual implementations, same arguments as above, for benchmarking and cross-checking
+uint16_t fcs16_bitwise(uint16_t crc, const uint8_t *data, size_t len);
+uint16_t fcs16_bytewise(uint16_t crc, const uint8_t *data, size_t len);
+uint16_t fcs16_slice4(uint16_t crc, const uint8_t *data, size_t len);
+uint32_t fcs32c_bitwise(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t fcs32c_bytewise(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t fcs32c_slice8(uint32_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief CRC-32C with the crc32 instruction (SSE4.2 on x86, the CRC extension on ARMv8)
+ * @return the new register; falls back to slice-by-8 when fcs32c_hw_available() is 0
+ */
+uint32_t fcs32c_hw(uint32_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief whether fcs32c_hw runs on the CPU's crc32 instruction
+ */
+int fcs32c_hw_available(void);
+
+#endif // FCS_H
@@ -0,0 +1,289 @@
+#include <string.h>
+#include "fec.h"
+
+#define GF_POLY 0x11D           //x^8 + x^4 + x^3 + x^2 + 1, α = 2 generates the field
+#define SECDED_CORRECTED 0x10   //flags next to the nibble in secded_dec
+#define SECDED_BAD 0x20
+
+uint8_t gf_exp[512];
+uint8_t gf_log[256];
+//generator polynomial of the RS code, highest power first: (x - α^0)(x - α^1)...(x - α^(P-1))
+static uint8_t rs_gen[FEC_RS_PARITY + 1];
+static uint8_t secded_enc[16];
+//every byte: the nibble of the nearest codeword, or SECDED_BAD if two bits are off
+static uint8_t secded_dec[256];
+
+static inline uint8_t gf_div(uint8_t a, uint8_t b) {
+    return a ? gf_exp[gf_log[a] + 255 - gf_log[b]] : 0;
+}
+
+//Hamming(7,4) as p1 p2 d1 p3 d2 d3 d4, then the parity of all seven for the double error detection
+static uint8_t secded_codeword(uint8_t nibble) {
+    int d1 = (nibble >> 3) & 1, d2 = (nibble >> 2) & 1, d3 = (nibble >> 1) & 1, d4 = nibble & 1;
+    int p1 = d1 ^ d2 ^ d4, p2 = d1 ^ d3 ^ d4, p3 = d2 ^ d3 ^ d4;
+    uint8_t c = (uint8_t)(p1 << 7 | p2 << 6 | d1 << 5 | p3 << 4 | d2 << 3 | d3 << 2 | d4 << 1);
+    return c | (__builtin_parity(c) & 1);
+}
+
+//the tables have to be there before the first frame is received, so they are built before main
+__attribute__((constructor)) static void build_tables(void) {
+    int x = 1;
+    for (int i = 0; i < 255; i++) {
+        gf_exp[i] = (uint8_t)x;
+        gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100) x ^= GF_POLY;
+    }
+    for (int i = 255; i < 512; i++) {
+        gf_exp[i] = gf_exp[i - 255];
+    }
+
+    rs_gen[0] = 1;
+    for (int i = 0; i < FEC_RS_PARITY; i++) {
+        //multiply by (x + α^i), the degree grows from i to i + 1
+        rs_gen[i + 1] = gf_mul(gf_exp[i], rs_gen[i]);
+        for (int j = i; j > 0; j--) {
+            rs_gen[j] ^= gf_mul(gf_exp[i], rs_gen[j - 1]);
+        }
+    }
+
+    //codewords are 4 bits apart: a byte one bit off a codeword is nearer to it than to any other,
+    //and every byte that is no codeword and not one bit off one is a double error
+    memset(secded_dec, SECDED_BAD, sizeof(secded_dec));
+    for (uint8_t n = 0; n < 16; n++) {
+        uint8_t c = secded_codeword(n);
+        secded_enc[n] = c;
+        secded_dec[c] = n;
+        for (int bit = 0; bit < 8; bit++) {
+            secded_dec[c ^ (1u << bit)] = n | SECDED_CORRECTED;
+        }
+    }
+}
+
+const char *fec_mode_name(FecMode mode) {
+    switch (mode) {
+    case FEC_NONE:
+        return "none";
+    case FEC_SECDED:
+        return "secded";
+    case FEC_RS:
+        return "rs";
+    }
+    return "?";
+}
+
+static int rs_blocks(int len) {
+    return (len + FEC_RS_DATA - 1) / FEC_RS_DATA;
+}
+
+int fec_encoded_len(FecMode mode, int len) {
+    switch (mode) {
+    case FEC_SECDED:
+        return 2 * len;
+    case FEC_RS:
+        return len + FEC_RS_PARITY * rs_blocks(len);
+    default:
+        return len;
+    }
+}
+
+void rs_encode_block(const uint8_t *data, int len, int stride, uint8_t *parity) {
+    //the remainder of data * x^P divided by the generator, in a shift register
+    memset(parity, 0, FEC_RS_PARITY);
+    for (int i = 0; i < len; i++) {
+        uint8_t feedback = data[i * stride] ^ parity[0];
+        if (feedback == 0) {
+            memmove(parity, parity + 1, FEC_RS_PARITY - 1);
+            parity[FEC_RS_PARITY - 1] = 0;
+            continue;
+        }
+        for (int j = 0; j < FEC_RS_PARITY - 1; j++) {
+            parity[j] = parity[j + 1] ^ gf_mul(feedback, rs_gen[j + 1]);
+        }
+        parity[FEC_RS_PARITY - 1] = gf_mul(feedback, rs_gen[FEC_RS_PARITY]);
+    }
+}
+
+int rs_decode_block(uint8_t *block, int len, int stride) {
+    //syndromes: the block evaluated at each root of the generator, all 0 for a codeword
+    uint8_t syn[FEC_RS_PARITY];
+    uint8_t any = 0;
+    for (int i = 0; i < FEC_RS_PARITY; i++) {
+        uint8_t s = 0;
+        for (int j = 0; j < len; j++) {
+            s = (s ? gf_exp[gf_log[s] + i] : 0) ^ block[j * stride];
+        }
+        syn[i] = s;
+        any |= s;
+    }
+    if (any == 0) {
+        return 0;
+    }
+
+    //Berlekamp-Massey: the shortest error locator that generates the syndromes, lowest power first
+    uint8_t lambda[FEC_RS_PARITY + 1] = {1};
+    uint8_t prev[FEC_RS_PARITY + 1] = {1};
+    uint8_t tmp[FEC_RS_PARITY + 1];
+    int errors = 0;
+    int shift = 1;
+    uint8_t prev_d = 1;
+    for (int r = 0; r < FEC_RS_PARITY; r++) {
+        uint8_t d = syn[r];
+        for (int i = 1; i <= errors; i++) {
+            d ^= gf_mul(lambda[i], syn[r - i]);
+        }
+        if (d == 0) {
+            shift++;
+            continue;
+        }
+        uint8_t coef = gf_div(d, prev_d);
+        memcpy(tmp, lambda, sizeof(tmp));
+        for (int i = 0; i + shift <= FEC_RS_PARITY; i++) {
+            lambda[i + shift] ^= gf_mul(coef, prev[i]);
+        }
+        if (2 * errors <= r) {
+            errors = r + 1 - errors;
+            memcpy(prev, tmp, sizeof(prev));
+            prev_d = d;
+            shift = 1;
+        } else {
+            shift++;
+        }
+    }
+    if (errors > FEC_RS_PARITY / 2) {
+        return -1;
+    }
+
+    //error evaluator: syndromes times locator, mod x^P
+    uint8_t omega[FEC_RS_PARITY];
+    for (int i = 0; i < FEC_RS_PARITY; i++) {
+        uint8_t o = 0;
+        for (int k = 0; k <= i && k <= errors; k++) {
+            o ^= gf_mul(syn[i - k], lambda[k]);
+        }
+        omega[i] = o;
+    }
+
+    //Chien search over the positions the block has: byte j is the coefficient of x^(len-1-j),
+    //it is wrong if the locator has a root at the inverse of α^(len-1-j)
+    int pos[FEC_RS_PARITY / 2];
+    uint8_t val[FEC_RS_PARITY / 2];
+    int found = 0;
+    for (int j = 0; j < len; j++) {
+        int power = len - 1 - j;
+        int inv = (255 - power) % 255;
+        uint8_t sum = 0, deriv = 0;
+        for (int i = 0; i <= errors; i++) {
+            if (lambda[i] == 0) continue;
+            uint8_t term = gf_exp[gf_log[lambda[i]] + (inv * i) % 255];
+            sum ^= term;
+            //the formal derivative keeps the odd powers, one lower
+            if (i & 1) deriv ^= gf_exp[gf_log[lambda[i]] + (inv * (i - 1)) % 255];
+        }
+        if (sum != 0) continue;
+        if (found == errors || deriv == 0) {
+            return -1;
+        }
+        //Forney: the error value is X * omega(X^-1) / lambda'(X^-1)
+        uint8_t om = 0;
+        for (int i = 0; i < FEC_RS_PARITY; i++) {
+            if (omega[i]) om ^= gf_exp[gf_log[omega[i]] + (inv * i) % 255];
+        }
+        pos[found] = j;
+        val[found] = gf_mul(gf_exp[power], gf_div(om, deriv));
+        found++;
+    }
+    //fewer roots than the locator's degree: errors beyond the block, or more than it can hold
+    if (found != errors) {
+        return -1;
+    }
+    for (int i = 0; i < found; i++) {
+        block[pos[i] * stride] ^= val[i];
+    }
+    return found;
+}
+
+//a frame's RS blocks share its bytes out evenly, the first len % blocks get one more. On the wire
+//they take turns byte by byte, so byte j of block b is at j * blocks + b
+static inline int rs_block_len(int len, int blocks, int b) {
+    return len / blocks + (b < len % blocks);
+}
+
+int fec_encode(FecMode mode, const uint8_t *data, int len, uint8_t *out) {
+    switch (mode) {
+    case FEC_SECDED:
+        for (int i = 0; i < len; i++) {
+            out[2 * i] = secded_enc[data[i] >> 4];
+            out[2 * i + 1] = secded_enc[data[i] & 0x0F];
+        }
+        return 2 * len;
+    case FEC_RS: {
+        int blocks = rs_blocks(len);
+        uint8_t parity[FEC_RS_PARITY];
+        int offset = 0;
+        for (int b = 0; b < blocks; b++) {
+            int block_len = rs_block_len(len, blocks, b);
+            rs_encode_block(data + offset, block_len, 1, parity);
+            for (int j = 0; j < block_len; j++) {
+                out[j * blocks + b] = data[offset + j];
+            }
+            for (int j = 0; j < FEC_RS_PARITY; j++) {
+                out[(block_len + j) * blocks + b] = parity[j];
+            }
+            offset += block_len;
+        }
+        return len + FEC_RS_PARITY * blocks;
+    }
+    default:
+        memcpy(out, data, len);
+        return len;
+    }
+}
+
+int fec_decode(FecMode mode, uint8_t *coded, int len, uint8_t *out, FecResult *result) {
+    switch (mode) {
+    case FEC_SECDED: {
+        if (len & 1) {
+            return -1;
+        }
+        uint8_t flags = 0;
+        for (int i = 0; i < len / 2; i++) {
+            uint8_t hi = secded_dec[coded[2 * i]];
+            uint8_t lo = secded_dec[coded[2 * i + 1]];
+            result->corrected += ((hi & SECDED_CORRECTED) != 0) + ((lo & SECDED_CORRECTED) != 0);
+            result->uncorrectable += ((hi & SECDED_BAD) != 0) + ((lo & SECDED_BAD) != 0);
+            flags |= hi | lo;
+            out[i] = (uint8_t)(hi << 4 | (lo & 0x0F));
+        }
+        return (flags & SECDED_BAD) ? -1 : len / 2;
+    }
+    case FEC_RS: {
+        //a block is at most 255 bytes, so the length gives the block count
+        int blocks = (len + 254) / 255;
+        int data_len = len - FEC_RS_PARITY * blocks;
+        if (data_len <= 0 || rs_blocks(data_len) != blocks) {
+            return -1;
+        }
+        int failed = 0;
+        int offset = 0;
+        for (int b = 0; b < blocks; b++) {
+            int block_len = rs_block_len(data_len, blocks, b);
+            int fixed = rs_decode_block(coded + b, block_len + FEC_RS_PARITY, blocks);
+            if (fixed < 0) {
+                result->uncorrectable++;
+                failed = 1;
+            } else {
+                result->corrected += fixed;
+            }
+            for (int j = 0; j < block_len; j++) {
+                out[offset + j] = coded[j * blocks + b];
+            }
+            offset += block_len;
+        }
+        return failed ? -1 : data_len;
+    }
+    default:
+        memcpy(out, coded, len);
+        return len;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include <stdint.h>
+
+//forward error correction of link frames, between the frame and the bit stuffing.
+//SECDED is the extended Hamming(8,4) code: each nibble goes out as a byte that has any single
+//bit error corrected and any double one detected, for twice the bytes.
+//FEC_RS is Reed-Solomon over GF(256) (poly 0x11D, first root 1): blocks of up to FEC_RS_DATA
+//bytes get FEC_RS_PARITY check bytes, so up to FEC_RS_PARITY/2 wrong bytes per block are fixed
+//wherever they are. A frame's blocks are interleaved byte by byte, a burst is spread over all of them
+typedef enum {
+    FEC_NONE,
+    FEC_SECDED,
+    FEC_RS,
+} FecMode;
+
+#define FEC_NUM_MODES 3
+#define FEC_RS_PARITY 16
+#define FEC_RS_DATA (255 - FEC_RS_PARITY)
+//encoded bytes of n data bytes in any mode at most
+#define FEC_MAX_ENCODED(n) (2 * (n) + FEC_RS_PARITY)
+
+//what decoding a frame found
+typedef struct {
+    uint32_t corrected;             //bits (SECDED) or bytes (RS) put right
+    uint32_t uncorrectable;         //codewords (SECDED) or blocks (RS) with more errors than the code fixes
+} FecResult;
+
+//GF(256) tables: exp is doubled so the sum of two logs needs no reduction; built at startup
+extern uint8_t gf_exp[512];
+extern uint8_t gf_log[256];
+
+static inline uint8_t gf_mul(uint8_t a, uint8_t b) {
+    return (a && b) ? gf_exp[gf_log[a] + gf_log[b]] : 0;
+}
+
+/**
+ * @brief name of a mode, for logs and benchmarks
+ */
+const char *fec_mode_name(FecMode mode);
+
+/**
+ * @brief bytes on the wire for a frame
+ * @param mode the code
+ * @param len data bytes
+ * @return encoded bytes, at most FEC_MAX_ENCODED(len)
+ */
+int fec_encoded_len(FecMode mode, int len);
+
+/**
+ * @brief encode a frame
+ * @param mode the code
+ * @param data the frame
+ * @param len bytes of data
+ * @param out room for fec_encoded_len(mode, len) bytes
+ * @return bytes written to out
+ */
+int fec_encode(FecMode mode, const uint8_t *data, int len, uint8_t *out);
+
+/**
+ * @brief correct and decode a received frame
+ * @param mode the code
+ * @param coded what arrived, corrected in place
+ * @param len bytes of coded
+ * @param out room for the data, at most len bytes
+ * @param result what was corrected, added to
+ * @return data bytes, -1 if a codeword or block had too many errors or len fits no frame
+ */
+int fec_decode(FecMode mode, uint8_t *coded, int len, uint8_t *out, FecResult *result);
+
+/**
+ * @brief Reed-Solomon check bytes of one block
+ * @param data the block's data, at most FEC_RS_DATA bytes
+ * @param len bytes of data
+ * @param stride distance between the block's bytes in data
+ * @param parity FEC_RS_PARITY bytes, sent after the data
+ */
+void rs_encode_block(const uint8_t *data, int len, int stride, uint8_t *parity);
+
+/**
+ * @brief correct one Reed-Solomon block in place
+ * @param block the data followed by the check bytes
+ * @param len bytes of the block, data and check bytes, at most 255
+ * @param stride distance between the block's bytes in memory
+ * @return bytes corrected, -1 if there were too many errors
+ */
+int rs_decode_block(uint8_t *block, int len, int stride);
+
+#endif // FEC_H
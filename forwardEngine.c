@@ -0,0 +1,369 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "forwardEngine.h"
+#include "linkLayer.h"
+#include "phy.h"
+
+typedef struct {
+    Frame *frames[FWD_QUEUE_DEPTH];
+    int head;
+    int count;
+    int deficit;                //bytes the queue may still send this round
+} FwdQueue;
+
+//the queues of one egress port. Frames are handed to the link layer only a few at a time,
+//so a control frame never waits behind more than FWD_LINK_DEPTH data frames
+typedef struct {
+    pthread_mutex_t lock;
+    FwdQueue control;
+    FwdQueue data[FWD_NUM_SOURCES];
+    int drr_next;               //data queue being served
+    int drr_fresh;              //drr_next hasn't had its quantum for this round yet
+    int in_link;                //frames given to the link layer and not yet sent
+    int data_depth;
+    uint32_t random;            //xorshift state for RED
+    Frame *held;                //taken by the scheduler but didn't fit the last batch, goes out next
+    FwdClass held_cls;
+    int queued_bytes;           //packet bytes of the frames queued, held one included
+    uint32_t hold_tick;         //when the first of the frames queued now arrived
+    uint32_t max_delay_us;      //see fwd_set_batching
+    uint16_t max_batch;
+    FwdStats stats;
+} FwdPort;
+
+static FwdPort ports[4];
+static int weights[FWD_NUM_SOURCES];
+static pthread_once_t locks_once = PTHREAD_ONCE_INIT;
+
+static void fwd_poll(void);
+
+static void init_locks(void) {
+    for (int i = 0; i < 4; i++) {
+        pthread_mutex_init(&ports[i].lock, NULL);
+    }
+}
+
+static void queue_clear(FwdQueue *q) {
+    while (q->count > 0) {
+        frame_release(q->frames[q->head]);
+        q->head = (q->head + 1) % FWD_QUEUE_DEPTH;
+        q->count--;
+    }
+    q->head = 0;
+    q->deficit = 0;
+}
+
+void fwd_init(void) {
+    pthread_once(&locks_once, init_locks);
+    for (int i = 0; i < 4; i++) {
+        FwdPort *p = &ports[i];
+        pthread_mutex_lock(&p->lock);
+        queue_clear(&p->control);
+        for (int s = 0; s < FWD_NUM_SOURCES; s++) {
+            queue_clear(&p->data[s]);
+        }
+        if (p->held != NULL) {
+            frame_release(p->held);
+            p->held = NULL;
+        }
+        p->drr_next = 0;
+        p->drr_fresh = 1;
+        p->data_depth = 0;
+        p->queued_bytes = 0;
+        p->max_delay_us = 0;
+        p->max_batch = 0;
+        p->random = 0x9E3779B9u + i;
+        memset(&p->stats, 0, sizeof(p->stats));
+        pthread_mutex_unlock(&p->lock);
+    }
+    for (int s = 0; s < FWD_NUM_SOURCES; s++) {
+        weights[s] = 1;
+    }
+    //packets held back for a batch are let go from the TX engine's polls
+    set_tx_poll_callback(fwd_poll);
+}
+
+void fwd_set_weight(int source, int weight) {
+    if (source >= 0 && source < FWD_NUM_SOURCES) {
+        weights[source] = weight < 1 ? 1 : weight;
+    }
+}
+
+static void queue_push(FwdQueue *q, Frame *frame) {
+    q->frames[(q->head + q->count) % FWD_QUEUE_DEPTH] = frame;
+    q->count++;
+}
+
+static Frame *queue_pop(FwdQueue *q) {
+    Frame *frame = q->frames[q->head];
+    q->head = (q->head + 1) % FWD_QUEUE_DEPTH;
+    q->count--;
+    return frame;
+}
+
+static uint32_t next_random(FwdPort *p) {
+    uint32_t x = p->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    p->random = x;
+    return x;
+}
+
+//random early detection: the longer the port has been backed up, the likelier a data frame is
+//dropped now, so senders see loss before the queues overflow. Call with the port lock held
+static int red_drop(FwdPort *p) {
+    int32_t avg = (int32_t)p->stats.avg_depth_q8;
+    avg += ((p->data_depth << 8) - avg) / 8;
+    p->stats.avg_depth_q8 = (uint32_t)avg;
+
+    if (avg < (FWD_RED_MIN << 8)) {
+        return 0;
+    }
+    if (avg >= (FWD_RED_MAX << 8)) {
+        return 1;
+    }
+    //drop probability rises linearly from 0 at FWD_RED_MIN to 1/FWD_RED_MAX_P at FWD_RED_MAX
+    uint32_t range = (uint32_t)(FWD_RED_MAX - FWD_RED_MIN) << 8;
+    uint32_t over = (uint32_t)avg - (FWD_RED_MIN << 8);
+    return (uint64_t)(next_random(p) % (range * FWD_RED_MAX_P)) < over;
+}
+
+//next frame to send: control first, then deficit round robin over the data sources.
+//Call with the port lock held
+static Frame *schedule(FwdPort *p) {
+    if (p->control.count > 0) {
+        return queue_pop(&p->control);
+    }
+    if (p->data_depth == 0) {
+        return NULL;
+    }
+    //a queue with frames gains a quantum every round, so a frame longer than one quantum is found
+    //after a few rounds; giving up after a fixed number left a port idle with frames queued
+    for (;;) {
+        FwdQueue *q = &p->data[p->drr_next];
+        if (q->count == 0) {
+            q->deficit = 0;
+        } else {
+            if (p->drr_fresh) {
+                q->deficit += FWD_QUANTUM_BYTES * weights[p->drr_next];
+                p->drr_fresh = 0;
+            }
+            int bytes = frame_len(q->frames[q->head]) + 1 + LINK_FCS_SIZE;
+            if (bytes <= q->deficit) {
+                q->deficit -= bytes;
+                p->data_depth--;
+                return queue_pop(q);
+            }
+        }
+        p->drr_next = (p->drr_next + 1) % FWD_NUM_SOURCES;
+        p->drr_fresh = 1;
+    }
+}
+
+//next frame to send, the one left over from the last batch first, and its class. Call with the
+//port lock held
+static Frame *take_frame(FwdPort *p, FwdClass *cls) {
+    Frame *frame = p->held;
+    *cls = p->held_cls;
+    p->held = NULL;
+    if (frame == NULL) {
+        *cls = (p->control.count > 0) ? FWD_CLASS_CONTROL : FWD_CLASS_DATA;
+        frame = schedule(p);
+    }
+    if (frame != NULL) {
+        p->stats.depth--;
+        p->queued_bytes -= frame_len(frame);
+    }
+    return frame;
+}
+
+//put back a frame that didn't fit a batch, it is the next one sent
+static void hold_frame(FwdPort *p, Frame *frame, FwdClass cls) {
+    p->held = frame;
+    p->held_cls = cls;
+    p->stats.depth++;
+    p->queued_bytes += frame_len(frame);
+}
+
+//a lone small packet at an idle link waits up to max_delay_us for others to share its frame,
+//unless enough are queued to fill one; routing adverts never wait
+static int holding(FwdPort *p) {
+    if (p->max_delay_us == 0 || p->max_batch == 0 || p->in_link > 0 || p->stats.depth == 0) {
+        return 0;
+    }
+    if (p->control.count > 0 || (p->held != NULL && p->held_cls == FWD_CLASS_CONTROL) ||
+        p->queued_bytes >= p->max_batch) {
+        return 0;
+    }
+    return phy_tick() - p->hold_tick < p->max_delay_us;
+}
+
+//the packets queued behind the first one go out in its frame, back to back, while they fit;
+//only plain network packets of the data class are batched, control frames such as routing adverts
+//always go alone. Returns the frame to send, first itself if nothing joined it. Call with the
+//port lock held
+static Frame *batch(FwdPort *p, Frame *first, FwdClass cls) {
+    if (p->max_batch == 0 || cls != FWD_CLASS_DATA || first->data[0] != 0) {
+        return first;
+    }
+    Frame *out = NULL;
+    int len = frame_len(first);
+    uint32_t count = 1;
+    for (;;) {
+        FwdClass next_cls;
+        Frame *next = take_frame(p, &next_cls);
+        if (next == NULL) {
+            break;
+        }
+        if (next_cls != FWD_CLASS_DATA || next->data[0] != 0 || len + frame_len(next) > p->max_batch) {
+            hold_frame(p, next, next_cls);
+            break;
+        }
+        if (out == NULL) {
+            out = frame_alloc();
+            if (out == NULL) {
+                hold_frame(p, next, next_cls);
+                break;
+            }
+            memcpy(frame_payload(out), frame_payload(first), len);
+        }
+        memcpy(frame_payload(out) + len, frame_payload(next), frame_len(next));
+        len += frame_len(next);
+        count++;
+        frame_release(next);
+    }
+    if (out == NULL) {
+        return first;
+    }
+    frame_release(first);
+    link_seal_frame_header(out, (uint16_t)len, LINK_HDR_BATCH);
+    p->stats.batches++;
+    p->stats.batched += count;
+    return out;
+}
+
+static void frame_sent(int ch, int status, void *ctx);
+
+//keep the link layer's queue for the port topped up, call with the port lock held
+static void kick(int port) {
+    FwdPort *p = &ports[port];
+    while (p->in_link < FWD_LINK_DEPTH && !holding(p)) {
+        FwdClass cls;
+        Frame *frame = take_frame(p, &cls);
+        if (frame == NULL) {
+            break;
+        }
+        frame = batch(p, frame, cls);
+        if (link_transmit_frame(port, frame, frame_sent, NULL) == 0) {
+            p->in_link++;
+        } else {
+            p->stats.link_errors++;
+        }
+        frame_release(frame);
+    }
+}
+
+//link layer completion, runs on whichever thread polls the TX engine
+static void frame_sent(int ch, int status, void *ctx) {
+    (void)ctx;
+    FwdPort *p = &ports[ch];
+    pthread_mutex_lock(&p->lock);
+    p->in_link--;
+    if (status == 0) {
+        p->stats.sent++;
+    } else {
+        p->stats.link_errors++;
+    }
+    kick(ch);
+    pthread_mutex_unlock(&p->lock);
+}
+
+int fwd_enqueue(int port, Frame *frame, int source, FwdClass cls) {
+    if (port < 0 || port >= 4 || source < 0 || source >= FWD_NUM_SOURCES) {
+        return -1;
+    }
+    FwdPort *p = &ports[port];
+    int counter = (cls == FWD_CLASS_CONTROL) ? FWD_NUM_SOURCES : source;
+    FwdQueue *q = (cls == FWD_CLASS_CONTROL) ? &p->control : &p->data[source];
+
+    pthread_mutex_lock(&p->lock);
+    if (cls == FWD_CLASS_DATA && red_drop(p)) {
+        p->stats.red_drops[source]++;
+        pthread_mutex_unlock(&p->lock);
+        return -1;
+    }
+    if (q->count == FWD_QUEUE_DEPTH) {
+        p->stats.tail_drops[counter]++;
+        pthread_mutex_unlock(&p->lock);
+        return -1;
+    }
+    frame_ref(frame);
+    queue_push(q, frame);
+    if (cls == FWD_CLASS_DATA) {
+        p->data_depth++;
+    }
+    if (p->stats.depth == 0) {
+        p->hold_tick = phy_tick();
+    }
+    p->queued_bytes += frame_len(frame);
+    p->stats.enqueued[counter]++;
+    p->stats.depth++;
+    if (p->stats.depth > p->stats.max_depth) {
+        p->stats.max_depth = p->stats.depth;
+    }
+    kick(port);
+    pthread_mutex_unlock(&p->lock);
+    return 0;
+}
+
+void fwd_set_batching(int port, uint32_t max_delay_us, uint16_t max_bytes) {
+    if (max_bytes > LINK_MAX_DATA) max_bytes = LINK_MAX_DATA;
+    for (int i = 0; i < 4; i++) {
+        if (port != -1 && port != i) continue;
+        FwdPort *p = &ports[i];
+        pthread_mutex_lock(&p->lock);
+        p->max_delay_us = max_delay_us;
+        p->max_batch = max_bytes;
+        kick(i);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+//sends what a port held back for a batch once it has waited long enough
+static void fwd_poll(void) {
+    for (int i = 0; i < 4; i++) {
+        FwdPort *p = &ports[i];
+        pthread_mutex_lock(&p->lock);
+        if (p->stats.depth > 0 && p->in_link == 0) {
+            kick(i);
+        }
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+void fwd_get_stats(int port, FwdStats *stats) {
+    FwdPort *p = &ports[port];
+    pthread_mutex_lock(&p->lock);
+    *stats = p->stats;
+    stats->in_link = (uint32_t)p->in_link;
+    pthread_mutex_unlock(&p->lock);
+}
+
+void fwd_dump_stats(void) {
+    printf("port %8s %8s %8s %8s %8s %8s %6s %6s\n", "queued", "sent", "batched", "tail", "red", "link_err", "depth",
+           "max");
+    for (int i = 0; i < 4; i++) {
+        FwdStats s;
+        fwd_get_stats(i, &s);
+        uint32_t queued = 0, tail = 0, red = 0;
+        for (int j = 0; j <= FWD_NUM_SOURCES; j++) {
+            queued += s.enqueued[j];
+            tail += s.tail_drops[j];
+            red += (j < FWD_NUM_SOURCES) ? s.red_drops[j] : 0;
+        }
+        printf("%4d %8u %8u %8u %8u %8u %8u %6u %6u\n", i, queued, s.sent, s.batched, tail, red, s.link_errors, s.depth,
+               s.max_depth);
+    }
+}
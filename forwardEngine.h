@@ -0,0 +1,86 @@
+#ifndef FORWARD_ENGINE_H
+#define FORWARD_ENGINE_H
+
+#include <stdint.h>
+#include "framePool.h"
+
+#define FWD_QUEUE_DEPTH 16      //frames waiting per queue, more are tail-dropped
+#define FWD_LINK_DEPTH 2        //frames handed to the link layer per port, the rest wait here to be scheduled
+#define FWD_SOURCE_LOCAL 4      //source of packets sent by this node, 0-3 are the ports packets arrive on
+#define FWD_NUM_SOURCES 5
+#define FWD_QUANTUM_BYTES 128   //bytes a data queue may send per round for each unit of weight
+#define FWD_RED_MIN 12          //average data frames queued on a port before RED starts dropping
+#define FWD_RED_MAX 36          //average above which every data frame is dropped
+#define FWD_RED_MAX_P 16        //1 in this many frames is dropped as the average reaches FWD_RED_MAX
+#define FWD_BATCH_BYTES 255     //largest batch frame the network layer sets, see fwd_set_batching
+
+//what a packet is: control traffic goes out ahead of any data
+typedef enum {
+    FWD_CLASS_CONTROL,
+    FWD_CLASS_DATA,
+} FwdClass;
+
+//counters of one egress port
+typedef struct {
+    uint32_t enqueued[FWD_NUM_SOURCES + 1];    //data frames by source, then control frames
+    uint32_t tail_drops[FWD_NUM_SOURCES + 1];  //queue was full
+    uint32_t red_drops[FWD_NUM_SOURCES];       //dropped early as the port backed up
+    uint32_t sent;                  //frames the link layer put on the wire
+    uint32_t batches;               //of them, frames carrying several packets
+    uint32_t batched;               //packets sent in those frames
+    uint32_t link_errors;           //frames the link layer refused or failed to send
+    uint32_t depth;                 //frames queued now, not counting those in the link layer
+    uint32_t in_link;               //frames handed to the link layer and not sent yet
+    uint32_t max_depth;
+    uint32_t avg_depth_q8;          //RED average of the data frames queued, 1/256ths
+} FwdStats;
+
+/**
+ * @brief empty every queue and reset the counters and weights
+ */
+void fwd_init(void);
+
+/**
+ * @brief queue a frame to be sent out of a port. The engine takes its own reference, the
+ * caller keeps its own. Control frames are always sent first; data frames share the rest of
+ * the port between their sources by weight
+ * @param port the egress port (0-3)
+ * @param frame a sealed frame
+ * @param source the port it arrived on, or FWD_SOURCE_LOCAL
+ * @param cls FWD_CLASS_CONTROL or FWD_CLASS_DATA
+ * @return 0 if queued, -1 if dropped
+ */
+int fwd_enqueue(int port, Frame *frame, int source, FwdClass cls);
+
+/**
+ * @brief set the share of every egress port a source gets when ports are congested
+ * @param source 0-3 or FWD_SOURCE_LOCAL
+ * @param weight relative share, at least 1 (the default)
+ */
+void fwd_set_weight(int source, int weight);
+
+/**
+ * @brief coalesce small packets for a port into one link frame, as Nagle's algorithm does.
+ * Packets that queue up while the link is busy go out together once it has room, and with
+ * max_delay_us a packet that finds the link idle waits that long for others to join it.
+ * Only frames that hold one network packet each can be batched, so it is off after fwd_init;
+ * network_layer_init batches what queues up, up to FWD_BATCH_BYTES, without holding anything back
+ * @param port the egress port (0-3), or -1 for every port
+ * @param max_delay_us longest a packet waits at an idle link, 0 to never hold one back
+ * @param max_bytes largest batch, the packets' headers included; 0 turns batching off
+ */
+void fwd_set_batching(int port, uint32_t max_delay_us, uint16_t max_bytes);
+
+/**
+ * @brief read the counters of an egress port
+ * @param port the port (0-3)
+ * @param stats filled in
+ */
+void fwd_get_stats(int port, FwdStats *stats);
+
+/**
+ * @brief print the counters of every port
+ */
+void fwd_dump_stats(void);
+
+#endif // FORWARD_ENGINE_H
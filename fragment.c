@@ -0,0 +1,137 @@
+#include <string.h>
+#include "fragment.h"
+
+//timers are compared by difference so the millisecond clock may wrap
+static int timed_out(const ReasmTable *table, const ReasmSlot *slot, uint32_t now_ms) {
+    return (int32_t)(now_ms - slot->last_ms) >= (int32_t)table->timeout_ms;
+}
+
+static uint32_t recent_key(uint8_t src, uint16_t id) {
+    return 1u << 24 | (uint32_t)src << 16 | id;
+}
+
+static void free_slot(ReasmSlot *slot) {
+    slot->in_use = 0;
+    slot->complete = 0;
+}
+
+void reasm_init(ReasmTable *table, uint32_t timeout_ms) {
+    for (int i = 0; i < FRAG_SLOTS; i++) {
+        free_slot(&table->slots[i]);
+    }
+    table->timeout_ms = timeout_ms;
+    memset(table->recent, 0, sizeof(table->recent));
+    table->recent_next = 0;
+    memset(&table->stats, 0, sizeof(table->stats));
+}
+
+void reasm_expire(ReasmTable *table, uint32_t now_ms) {
+    for (int i = 0; i < FRAG_SLOTS; i++) {
+        ReasmSlot *slot = &table->slots[i];
+        if (slot->in_use && !slot->complete && timed_out(table, slot, now_ms)) {
+            table->stats.timeouts++;
+            free_slot(slot);
+        }
+    }
+}
+
+uint8_t *reasm_place(ReasmTable *table, uint8_t src, uint16_t id, uint32_t offset, uint32_t now_ms, ReasmSlot **slot) {
+    if (offset % FRAG_UNIT != 0 || offset >= FRAG_MAX_MESSAGE) {
+        table->stats.invalid++;
+        return NULL;
+    }
+    ReasmSlot *free = NULL;
+    int from_src = 0;
+    for (int i = 0; i < FRAG_SLOTS; i++) {
+        ReasmSlot *s = &table->slots[i];
+        if (s->in_use && !s->complete && timed_out(table, s, now_ms)) {
+            table->stats.timeouts++;
+            free_slot(s);
+        }
+        if (!s->in_use) {
+            if (free == NULL) free = s;
+            continue;
+        }
+        if (s->src == src && s->id == id) {
+            if (s->complete) {
+                //a late copy of a fragment of a message that is already complete
+                table->stats.duplicates++;
+                return NULL;
+            }
+            s->last_ms = now_ms;
+            *slot = s;
+            return s->data + offset;
+        }
+        from_src += (s->src == src);
+    }
+    //a fragment of a message that was delivered a moment ago arrived twice
+    for (int i = 0; i < FRAG_RECENT; i++) {
+        if (table->recent[i] == recent_key(src, id)) {
+            table->stats.duplicates++;
+            return NULL;
+        }
+    }
+    if (free == NULL || from_src >= FRAG_SLOTS_PER_SOURCE) {
+        table->stats.no_slot++;
+        return NULL;
+    }
+    free->in_use = 1;
+    free->complete = 0;
+    free->src = src;
+    free->id = id;
+    free->total = 0;
+    free->units = 0;
+    free->last_ms = now_ms;
+    memset(free->have, 0, sizeof(free->have));
+    *slot = free;
+    return free->data + offset;
+}
+
+int reasm_commit(ReasmTable *table, ReasmSlot *slot, uint32_t offset, int len, int more) {
+    uint32_t end = offset + (uint32_t)len;
+    //every fragment but the last ends on a unit, and none goes past the end once it is known
+    int fits = len > 0 && end <= FRAG_MAX_MESSAGE && (!more || end % FRAG_UNIT == 0) &&
+               (slot->total == 0 || (more ? end <= slot->total : end == slot->total));
+    if (!fits) {
+        table->stats.invalid++;
+        if (slot->units == 0) {
+            free_slot(slot);
+        }
+        return -1;
+    }
+    table->stats.fragments++;
+    if (!more) {
+        slot->total = end;
+    }
+    int added = 0;
+    for (uint32_t unit = offset / FRAG_UNIT; unit < (end + FRAG_UNIT - 1) / FRAG_UNIT; unit++) {
+        uint8_t bit = (uint8_t)(1u << (unit & 7));
+        if (!(slot->have[unit >> 3] & bit)) {
+            slot->have[unit >> 3] |= bit;
+            added++;
+        }
+    }
+    if (added == 0) {
+        table->stats.duplicates++;
+    }
+    slot->units += added;
+    uint32_t needed = (slot->total + FRAG_UNIT - 1) / FRAG_UNIT;
+    if (slot->total == 0 || slot->units < needed) {
+        return 0;
+    }
+    //units past the end from before the last fragment was in count too, so look for holes
+    for (uint32_t unit = 0; unit < needed; unit++) {
+        if (!(slot->have[unit >> 3] & (1u << (unit & 7)))) {
+            return 0;
+        }
+    }
+    slot->complete = 1;
+    table->stats.completed++;
+    return 1;
+}
+
+void reasm_release(ReasmTable *table, ReasmSlot *slot) {
+    table->recent[table->recent_next] = recent_key(slot->src, slot->id);
+    table->recent_next = (table->recent_next + 1) % FRAG_RECENT;
+    free_slot(slot);
+}
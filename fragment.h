@@ -0,0 +1,94 @@
+#ifndef FRAGMENT_H
+#define FRAGMENT_H
+
+#include <stdint.h>
+
+//reassembly of messages that were sent in several packets. A fragment's data starts with its
+//message's id and its offset in the message, both big endian; the packet's flags say whether
+//more fragments follow. Offsets count bytes and are multiples of FRAG_UNIT, as is the length
+//of every fragment but the last, so what has arrived is kept as a bit per unit.
+//Every message gets a slot of FRAG_MAX_MESSAGE bytes when its first fragment arrives, and each
+//fragment is written straight to its place there
+#define FRAG_HEADER_SIZE 4
+#define FRAG_UNIT 8
+#define FRAG_MAX_MESSAGE 16384      //longest message, and the room every slot has
+#define FRAG_SLOTS 4                //messages being put together at once, FRAG_SLOTS * FRAG_MAX_MESSAGE bytes
+#define FRAG_SLOTS_PER_SOURCE 2     //so one sender can't hold every slot
+#define FRAG_TIMEOUT_MS 10000       //a message is given up on once no fragment of it came for this long
+#define FRAG_RECENT 8               //messages remembered after delivery, so a late duplicate doesn't start them again
+
+typedef struct {
+    uint8_t in_use;
+    uint8_t complete;               //being delivered, no more fragments are taken for it
+    uint8_t src;
+    uint16_t id;
+    uint32_t total;                 //length of the message once its last fragment is in, 0 before
+    uint32_t units;                 //units that have arrived
+    uint32_t last_ms;               //when the latest fragment arrived
+    uint8_t have[FRAG_MAX_MESSAGE / FRAG_UNIT / 8];
+    uint8_t data[FRAG_MAX_MESSAGE];
+} ReasmSlot;
+
+typedef struct {
+    uint32_t fragments;             //fragments taken
+    uint32_t completed;             //messages put together
+    uint32_t timeouts;              //messages given up on, missing fragments
+    uint32_t duplicates;            //fragments that brought nothing new
+    uint32_t no_slot;               //fragments of a new message dropped, every slot was busy
+    uint32_t invalid;               //fragments that didn't fit their message
+} ReasmStats;
+
+//the messages being put together, every call on it must come from one thread at a time
+typedef struct {
+    ReasmSlot slots[FRAG_SLOTS];
+    uint32_t timeout_ms;
+    uint32_t recent[FRAG_RECENT];   //source << 16 | id of the last messages delivered, + 1 << 24
+    int recent_next;
+    ReasmStats stats;
+} ReasmTable;
+
+/**
+ * @brief empty a reassembly table
+ * @param table the table
+ * @param timeout_ms how long a message may go without a fragment, FRAG_TIMEOUT_MS by default
+ */
+void reasm_init(ReasmTable *table, uint32_t timeout_ms);
+
+/**
+ * @brief find where a fragment goes, taking a slot if it is the first of its message
+ * @param table the table
+ * @param src the message's source address
+ * @param id the message's id at its source
+ * @param offset the fragment's offset in the message
+ * @param now_ms the time, for the timeouts
+ * @param slot set to the message's slot
+ * @return the place in the slot at the offset, with room up to FRAG_MAX_MESSAGE; NULL if the
+ * fragment has to be dropped. reasm_commit is called once the data has been written there
+ */
+uint8_t *reasm_place(ReasmTable *table, uint8_t src, uint16_t id, uint32_t offset, uint32_t now_ms, ReasmSlot **slot);
+
+/**
+ * @brief account for a fragment written where reasm_place said
+ * @param table the table
+ * @param slot the message's slot
+ * @param offset the fragment's offset in the message
+ * @param len bytes of the fragment
+ * @param more set if more fragments follow it
+ * @return 1 if that completed the message, its data and total are in the slot until
+ * reasm_release; 0 if it is still missing fragments; -1 if the fragment didn't fit the message
+ */
+int reasm_commit(ReasmTable *table, ReasmSlot *slot, uint32_t offset, int len, int more);
+
+/**
+ * @brief free the slot of a message that was delivered
+ */
+void reasm_release(ReasmTable *table, ReasmSlot *slot);
+
+/**
+ * @brief give up on messages that have gone without a fragment for the timeout
+ * @param table the table
+ * @param now_ms the time
+ */
+void reasm_expire(ReasmTable *table, uint32_t now_ms);
+
+#endif // FRAGMENT_H
@@ -0,0 +1,84 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include "framePool.h"
+
+static Frame pool[FRAME_POOL_SIZE];
+
+//Treiber stack of released frames: the low half is the index of the top frame plus one (0 when
+//empty), the high half a tag bumped on every change so a stale compare-exchange can't succeed
+static _Atomic uint64_t free_top;
+static _Atomic int num_free;
+//frames below this index have been handed out at least once, the rest were never used
+static _Atomic uint32_t num_touched;
+
+#define TOP_INDEX(top) ((uint32_t)(top))
+#define TOP_TAG(top) ((uint32_t)((top) >> 32))
+#define MAKE_TOP(tag, index) (((uint64_t)(tag) << 32) | (index))
+
+static void push_free(Frame *frame) {
+    uint32_t index = (uint32_t)(frame - pool) + 1;
+    uint64_t top = atomic_load_explicit(&free_top, memory_order_relaxed);
+    do {
+        frame->next_free = TOP_INDEX(top);
+    } while (!atomic_compare_exchange_weak_explicit(&free_top, &top, MAKE_TOP(TOP_TAG(top) + 1, index),
+                                                    memory_order_release, memory_order_relaxed));
+    atomic_fetch_add_explicit(&num_free, 1, memory_order_relaxed);
+}
+
+static Frame *pop_free(void) {
+    uint64_t top = atomic_load_explicit(&free_top, memory_order_acquire);
+    Frame *frame;
+    do {
+        if (TOP_INDEX(top) == 0) {
+            return NULL;
+        }
+        frame = &pool[TOP_INDEX(top) - 1];
+        //next_free may be stale if another thread took the frame meanwhile, the tag catches it
+    } while (!atomic_compare_exchange_weak_explicit(&free_top, &top, MAKE_TOP(TOP_TAG(top) + 1, frame->next_free),
+                                                    memory_order_acquire, memory_order_acquire));
+    atomic_fetch_sub_explicit(&num_free, 1, memory_order_relaxed);
+    return frame;
+}
+
+//a frame that was never handed out, so the pool needs no setup
+static Frame *take_untouched(void) {
+    uint32_t touched = atomic_load_explicit(&num_touched, memory_order_relaxed);
+    while (touched < FRAME_POOL_SIZE) {
+        if (atomic_compare_exchange_weak_explicit(&num_touched, &touched, touched + 1,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            return &pool[touched];
+        }
+    }
+    return NULL;
+}
+
+Frame *frame_alloc(void) {
+    Frame *frame = pop_free();
+    if (frame == NULL) {
+        frame = take_untouched();
+        if (frame == NULL) {
+            return NULL;
+        }
+    }
+    atomic_store_explicit(&frame->refs, 1, memory_order_relaxed);
+    frame->ch = -1;
+    return frame;
+}
+
+void frame_ref(Frame *frame) {
+    atomic_fetch_add_explicit(&frame->refs, 1, memory_order_relaxed);
+}
+
+void frame_release(Frame *frame) {
+    if (frame == NULL) {
+        return;
+    }
+    if (atomic_fetch_sub_explicit(&frame->refs, 1, memory_order_acq_rel) == 1) {
+        push_free(frame);
+    }
+}
+
+int frame_pool_available(void) {
+    return atomic_load_explicit(&num_free, memory_order_relaxed) +
+           FRAME_POOL_SIZE - (int)atomic_load_explicit(&num_touched, memory_order_relaxed);
+}
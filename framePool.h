@@ -0,0 +1,59 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define FRAME_SIZE 1503         //same as BUFFER_SIZE: [header][data][fcs]
+#define FRAME_POOL_SIZE 256     //frames shared by every port: being received, held by the stack, queued to send
+
+//a frame in the pool. Receivers decode straight into data and the same buffer is handed
+//up the stack and back down to a TX queue, so a forwarded frame is never copied
+typedef struct {
+    uint8_t data[FRAME_SIZE];   //[header][data][fcs], as between the flags on the wire
+    uint16_t len;               //number of data bytes, the flags delimit the frame so it isn't sent
+    int ch;                     //port the frame was received on, -1 if built locally
+    uint32_t rx_tick;           //PHY tick its opening flag was received at, for the latency stats
+    _Atomic int refs;           //the frame goes back to the pool when this drops to 0
+    uint32_t next_free;         //free list link, only meaningful while in the pool
+} Frame;
+
+/**
+ * @brief take a frame from the pool, lock-free so it can be called from edge callbacks
+ * @return a frame holding one reference, NULL if the pool is exhausted
+ */
+Frame *frame_alloc(void);
+
+/**
+ * @brief take another reference on a frame, e.g. to keep it after a callback returns
+ * or to queue it on another port
+ * @param frame the frame
+ */
+void frame_ref(Frame *frame);
+
+/**
+ * @brief drop a reference, the last one returns the frame to the pool
+ * @param frame the frame (may be NULL)
+ */
+void frame_release(Frame *frame);
+
+/**
+ * @brief number of frames in the pool that nobody holds
+ */
+int frame_pool_available(void);
+
+/**
+ * @brief number of data bytes in a frame
+ */
+static inline uint16_t frame_len(const Frame *frame) {
+    return frame->len;
+}
+
+/**
+ * @brief the data bytes of a frame
+ */
+static inline uint8_t *frame_payload(Frame *frame) {
+    return &frame->data[1];
+}
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,69 @@
+#include "histogram.h"
+
+void hist_clear(Histogram *h) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        atomic_store_explicit(&h->counts[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&h->sum, 0, memory_order_relaxed);
+}
+
+void hist_snapshot(const Histogram *h, HistSnapshot *snap) {
+    snap->total = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        snap->counts[i] = atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        snap->total += snap->counts[i];
+    }
+    snap->sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+}
+
+uint32_t hist_bucket_low(int bucket) {
+    if (bucket < HIST_SUB_BUCKETS) {
+        return (uint32_t)bucket;
+    }
+    int shift = bucket / HIST_SUB_BUCKETS - 1;
+    return (uint32_t)(HIST_SUB_BUCKETS + bucket % HIST_SUB_BUCKETS) << shift;
+}
+
+uint32_t hist_bucket_high(int bucket) {
+    if (bucket < HIST_SUB_BUCKETS) {
+        return (uint32_t)bucket;
+    }
+    int shift = bucket / HIST_SUB_BUCKETS - 1;
+    //computed in 64 bits, the top bucket ends at 2^32 - 1
+    return (uint32_t)(((uint64_t)(HIST_SUB_BUCKETS + bucket % HIST_SUB_BUCKETS + 1) << shift) - 1);
+}
+
+uint32_t hist_percentile(const HistSnapshot *snap, double percentile) {
+    if (snap->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100 * snap->total + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > snap->total) rank = snap->total;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += snap->counts[i];
+        if (seen >= rank) {
+            return hist_bucket_high(i);
+        }
+    }
+    return hist_bucket_high(HIST_BUCKETS - 1);
+}
+
+double hist_mean(const HistSnapshot *snap) {
+    return snap->total ? (double)snap->sum / snap->total : 0;
+}
+
+void hist_print_json(FILE *out, const HistSnapshot *snap) {
+    fprintf(out, "{\"count\":%llu,\"mean\":%.1f,\"p50\":%u,\"p90\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u,\"buckets\":[",
+            (unsigned long long)snap->total, hist_mean(snap), hist_percentile(snap, 50), hist_percentile(snap, 90),
+            hist_percentile(snap, 99), hist_percentile(snap, 99.9), hist_percentile(snap, 100));
+    int first = 1;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        if (snap->counts[i] == 0) continue;
+        fprintf(out, "%s[%u,%u,%llu]", first ? "" : ",", hist_bucket_low(i), hist_bucket_high(i),
+                (unsigned long long)snap->counts[i]);
+        first = 0;
+    }
+    fprintf(out, "]}");
+}
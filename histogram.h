@@ -0,0 +1,96 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//log-linear histogram of 32-bit values, as in HdrHistogram: values below HIST_SUB_BUCKETS have a
+//bucket each, above that every power of two is split into HIST_SUB_BUCKETS equal buckets, so any
+//value is known to within 1/HIST_SUB_BUCKETS (about 6%). Recording is a bucket index and one
+//relaxed atomic add, cheap enough for every edge
+#define HIST_SUB_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((32 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+typedef struct {
+    _Atomic uint64_t counts[HIST_BUCKETS];
+    _Atomic uint64_t sum;           //of every value recorded, for the mean
+} Histogram;
+
+//a copy of a histogram taken at one moment, for reading and printing
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;                 //values recorded
+    uint64_t sum;
+} HistSnapshot;
+
+/**
+ * @brief the bucket a value falls in
+ */
+static inline int hist_bucket(uint32_t value) {
+    if (value < HIST_SUB_BUCKETS) {
+        return (int)value;
+    }
+    int shift = 31 - __builtin_clz(value) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_BUCKETS + (int)(value >> shift) - HIST_SUB_BUCKETS;
+}
+
+/**
+ * @brief record a value, from any thread
+ */
+static inline void hist_record(Histogram *h, uint32_t value) {
+    atomic_fetch_add_explicit(&h->counts[hist_bucket(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, value, memory_order_relaxed);
+}
+
+/**
+ * @brief record a value into a histogram only one thread writes, without a locked instruction
+ */
+static inline void hist_record_owned(Histogram *h, uint32_t value) {
+    _Atomic uint64_t *count = &h->counts[hist_bucket(value)];
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&h->sum, atomic_load_explicit(&h->sum, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+/**
+ * @brief empty a histogram, while nothing records into it
+ */
+void hist_clear(Histogram *h);
+
+/**
+ * @brief copy a histogram while it is being recorded into; every count is exact, but values
+ * recorded during the copy may be in some buckets and not yet in others
+ * @param h the histogram
+ * @param snap filled in
+ */
+void hist_snapshot(const Histogram *h, HistSnapshot *snap);
+
+/**
+ * @brief smallest and largest value a bucket stands for
+ */
+uint32_t hist_bucket_low(int bucket);
+uint32_t hist_bucket_high(int bucket);
+
+/**
+ * @brief the value at a percentile: the largest value of the bucket it falls in
+ * @param snap the snapshot
+ * @param percentile 0 to 100, 100 for the largest value recorded
+ * @return the value, 0 if nothing was recorded
+ */
+uint32_t hist_percentile(const HistSnapshot *snap, double percentile);
+
+/**
+ * @brief mean of the values recorded, 0 if there are none
+ */
+double hist_mean(const HistSnapshot *snap);
+
+/**
+ * @brief write a snapshot as a JSON object: count, mean, percentiles, and the buckets that
+ * aren't empty as [low, high, count]
+ * @param out where to write it
+ * @param snap the snapshot
+ */
+void hist_print_json(FILE *out, const HistSnapshot *snap);
+
+#endif // HISTOGRAM_H
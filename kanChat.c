@@ -0,0 +1,70 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kanClient.h"
+
+#define CHAT_POLL_MS 1000       //kan_recv notices the daemon has gone at the latest this often
+
+//a local application on top of the stack daemon: sends the lines typed to an application on
+//another node and prints what arrives for its own port
+//usage: kanChat <port> [socket_path]
+//  then lines of "<dest_addr> <dest_port> <message>"
+int main(int argc, char *argv[]) {
+    if (argc < 2 || atoi(argv[1]) < 1 || atoi(argv[1]) > 255) {
+        fprintf(stderr, "usage: %s <port 1-255> [socket_path]\n", argv[0]);
+        return 1;
+    }
+    int status;
+    KanClient *client = kan_open(argc > 2 ? argv[2] : NULL, (uint8_t)atoi(argv[1]), &status);
+    if (client == NULL) {
+        fprintf(stderr, "Can't bind port %s: %s\n", argv[1],
+                status == IPC_ERR_PORT ? "taken" : status == IPC_ERR_FULL ? "too many applications"
+                : status == IPC_ERR_VERSION ? "the daemon was built differently" : "no daemon");
+        return 1;
+    }
+    printf("Node %d port %s, enter <dest_addr> <dest_port> <message>\n", kan_address(client), argv[1]);
+    fflush(stdout);
+
+    //lines are read as poll sees them arrive, none may sit in stdio's buffer
+    setvbuf(stdin, NULL, _IONBF, 0);
+    static char line[KAN_MAX_MESSAGE + 16];
+    struct pollfd fds[2] = {{.fd = 0, .events = POLLIN}, {.fd = kan_fd(client), .events = POLLIN}};
+    for (;;) {
+        KanMessage msg;
+        int rc;
+        while ((rc = kan_recv(client, &msg, 0)) == 1) {
+            printf("[Received from %d:%d]: %.*s\n", msg.src_addr, msg.src_port, (int)msg.len, msg.data);
+            kan_recv_done(client);
+        }
+        fflush(stdout);
+        if (rc < 0) {
+            fprintf(stderr, "The daemon has gone\n");
+            break;
+        }
+        if (poll(fds, 2, CHAT_POLL_MS) <= 0 || !(fds[0].revents & (POLLIN | POLLHUP))) {
+            continue;
+        }
+        if (fgets(line, sizeof(line), stdin) == NULL) {
+            break;
+        }
+        unsigned dest_addr, dest_port;
+        int offset;
+        if (sscanf(line, "%u %u %n", &dest_addr, &dest_port, &offset) != 2 || dest_addr < 1 || dest_addr > 255 ||
+            dest_port < 1 || dest_port > 255) {
+            printf("Enter <dest_addr 1-255> <dest_port 1-255> <message>\n");
+            continue;
+        }
+        size_t len = strcspn(line + offset, "\n");
+        if (kan_send(client, (uint8_t)dest_addr, (uint8_t)dest_port, line + offset, len) != 0) {
+            fprintf(stderr, "The daemon has gone\n");
+            break;
+        }
+    }
+    IpcCounters counters;
+    kan_counters(client, &counters);
+    printf("Sent %u (%u refused by the network layer), received %u, %u dropped with the ring full\n",
+           counters.sent, counters.send_errors, counters.delivered, counters.rx_drops);
+    kan_close(client);
+    return 0;
+}
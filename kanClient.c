@@ -0,0 +1,200 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "kanClient.h"
+
+#define KAN_ERR_CONNECT -5
+
+struct KanClient {
+    int sock;               //held open for as long as the port is bound, the daemon sees us go by it closing
+    int app_efd;            //the daemon wakes us on it
+    int stack_efd;          //we wake the daemon on it
+    IpcRegion *region;
+    IpcRecord *sending;     //reserved by kan_send_buffer
+};
+
+static int connect_daemon(const char *socket_path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+    int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+KanClient *kan_open(const char *socket_path, uint8_t port, int *status) {
+    int rc = KAN_ERR_CONNECT;
+    KanClient *client = NULL;
+    int fds[3] = {-1, -1, -1};
+    int sock = connect_daemon(socket_path != NULL ? socket_path : IPC_SOCKET_PATH);
+    if (sock < 0) {
+        goto out;
+    }
+    IpcHello hello = {.magic = IPC_MAGIC, .size = sizeof(IpcRegion), .port = port};
+    IpcWelcome welcome;
+    if (ipc_send_fds(sock, &hello, sizeof(hello), NULL, 0) != 0 ||
+        ipc_recv_fds(sock, &welcome, sizeof(welcome), fds, 3) != (int)sizeof(welcome)) {
+        goto out;
+    }
+    rc = welcome.status;
+    if (rc != 0) {
+        goto out;
+    }
+    rc = KAN_ERR_CONNECT;
+    if (fds[0] < 0 || fds[1] < 0 || fds[2] < 0) {
+        goto out;
+    }
+    void *region = mmap(NULL, sizeof(IpcRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    if (region == MAP_FAILED) {
+        goto out;
+    }
+    client = calloc(1, sizeof(*client));
+    if (client == NULL) {
+        munmap(region, sizeof(IpcRegion));
+        goto out;
+    }
+    client->sock = sock;
+    client->app_efd = fds[1];
+    client->stack_efd = fds[2];
+    client->region = region;
+    close(fds[0]);
+    rc = 0;
+
+out:
+    if (client == NULL) {
+        for (int i = 0; i < 3; i++) {
+            if (fds[i] >= 0) close(fds[i]);
+        }
+        if (sock >= 0) close(sock);
+    }
+    if (status != NULL) {
+        *status = rc;
+    }
+    return client;
+}
+
+void kan_close(KanClient *client) {
+    if (client == NULL) return;
+    munmap(client->region, sizeof(IpcRegion));
+    close(client->app_efd);
+    close(client->stack_efd);
+    close(client->sock);
+    free(client);
+}
+
+uint8_t kan_address(const KanClient *client) {
+    return client->region->address;
+}
+
+int kan_fd(const KanClient *client) {
+    return client->app_efd;
+}
+
+//sleep until our eventfd is written or the daemon goes, -1 if it has gone
+static int wait_daemon(KanClient *client, int timeout_ms) {
+    struct pollfd fds[2] = {{.fd = client->app_efd, .events = POLLIN}, {.fd = client->sock, .events = POLLIN}};
+    int n;
+    do {
+        n = poll(fds, 2, timeout_ms);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 || (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+        return -1;
+    }
+    if (fds[0].revents & POLLIN) {
+        ipc_drain(client->app_efd);
+    }
+    return n;
+}
+
+uint8_t *kan_send_buffer(KanClient *client, size_t len) {
+    if (len > KAN_MAX_MESSAGE) {
+        return NULL;
+    }
+    IpcRing *ring = &client->region->to_stack;
+    uint32_t bytes = (uint32_t)(len + IPC_APP_HEADER);
+    IpcRecord *record;
+    while ((record = ipc_ring_reserve(ring, bytes)) == NULL) {
+        if (ipc_ring_wait_writable(ring, bytes) && wait_daemon(client, -1) < 0) {
+            return NULL;
+        }
+        //the eventfd also says messages have arrived, keep it readable for whoever polls kan_fd
+        if (ipc_ring_peek(&client->region->to_app) != NULL) {
+            ipc_notify(client->app_efd);
+        }
+    }
+    client->sending = record;
+    return ipc_record_data(record) + IPC_APP_HEADER;
+}
+
+void kan_send_commit(KanClient *client, uint8_t dest_addr, uint8_t dest_port) {
+    IpcRecord *record = client->sending;
+    if (record == NULL) return;
+    record->addr = dest_addr;
+    record->port = dest_port;
+    client->sending = NULL;
+    if (ipc_ring_commit(&client->region->to_stack)) {
+        ipc_notify(client->stack_efd);
+    }
+}
+
+int kan_send(KanClient *client, uint8_t dest_addr, uint8_t dest_port, const void *data, size_t len) {
+    uint8_t *buffer = kan_send_buffer(client, len);
+    if (buffer == NULL) {
+        return -1;
+    }
+    memcpy(buffer, data, len);
+    kan_send_commit(client, dest_addr, dest_port);
+    return 0;
+}
+
+int kan_recv(KanClient *client, KanMessage *msg, int timeout_ms) {
+    IpcRing *ring = &client->region->to_app;
+    for (;;) {
+        IpcRecord *record = ipc_ring_peek(ring);
+        if (record != NULL) {
+            msg->src_addr = record->addr;
+            msg->src_port = record->port;
+            msg->data = ipc_record_data(record);
+            msg->len = record->len;
+            return 1;
+        }
+        //the flag stays set when we return empty-handed, so kan_fd wakes for the next one
+        if (!ipc_ring_wait_readable(ring)) {
+            continue;
+        }
+        if (timeout_ms == 0) {
+            return 0;
+        }
+        int rc = wait_daemon(client, timeout_ms);
+        if (rc <= 0) {
+            return rc;
+        }
+    }
+}
+
+void kan_recv_done(KanClient *client) {
+    if (ipc_ring_release(&client->region->to_app)) {
+        ipc_notify(client->stack_efd);
+    }
+}
+
+void kan_counters(const KanClient *client, IpcCounters *counters) {
+    const IpcCounters *c = &client->region->counters;
+    atomic_store(&counters->sent, atomic_load(&c->sent));
+    atomic_store(&counters->send_errors, atomic_load(&c->send_errors));
+    atomic_store(&counters->delivered, atomic_load(&c->delivered));
+    atomic_store(&counters->rx_drops, atomic_load(&c->rx_drops));
+}
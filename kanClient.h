@@ -0,0 +1,96 @@
+#ifndef KAN_CLIENT_H
+#define KAN_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "kanIpc.h"
+
+//the library local applications use to send and receive through the stack daemon (kanDaemon)
+//instead of linking the stack and calling send_packet. An application binds a port, 1-255, and
+//gets the messages other nodes' applications send to that port on this node. Messages pass
+//through rings in memory shared with the daemon, see kanIpc.h; the data is written and read in
+//place there, so a message is copied only between the ring and a link frame
+#define KAN_MAX_MESSAGE IPC_MAX_MESSAGE
+
+typedef struct KanClient KanClient;
+
+//a message received, in the ring until kan_recv_done
+typedef struct {
+    uint8_t src_addr;       //the node it came from
+    uint8_t src_port;       //the port of the application that sent it
+    const uint8_t *data;
+    size_t len;
+} KanMessage;
+
+/**
+ * @brief connect to the daemon and bind a port
+ * @param socket_path the daemon's socket, NULL for IPC_SOCKET_PATH
+ * @param port the port messages for this application are sent to, 1-255
+ * @param status if not NULL, set to 0 or the IPC_ERR_* the daemon refused with, -5 if it could
+ * not be reached
+ * @return the client, NULL if failed
+ */
+KanClient *kan_open(const char *socket_path, uint8_t port, int *status);
+
+/**
+ * @brief close the connection, the port is free for another application afterwards
+ */
+void kan_close(KanClient *client);
+
+/**
+ * @brief the address of the node the daemon runs
+ */
+uint8_t kan_address(const KanClient *client);
+
+/**
+ * @brief room in the ring for a message of len bytes, waiting for the daemon to make some if
+ * the ring is full; write the message there and send it with kan_send_commit
+ * @param len the message bytes, at most KAN_MAX_MESSAGE
+ * @return where to write the message, NULL if it is too long or the daemon has gone
+ */
+uint8_t *kan_send_buffer(KanClient *client, size_t len);
+
+/**
+ * @brief send the message written in the buffer kan_send_buffer returned
+ * @param dest_addr the node to send to
+ * @param dest_port the port of the application there
+ */
+void kan_send_commit(KanClient *client, uint8_t dest_addr, uint8_t dest_port);
+
+/**
+ * @brief send a message, as send_packet does: copied into the ring, and the daemon sends it in
+ * the background. Whether it could be queued for the link shows in kan_counters
+ * @param dest_addr the node to send to
+ * @param dest_port the port of the application there
+ * @param data the message
+ * @param len its bytes, at most KAN_MAX_MESSAGE
+ * @return 0 on success, -1 if the message is too long or the daemon has gone
+ */
+int kan_send(KanClient *client, uint8_t dest_addr, uint8_t dest_port, const void *data, size_t len);
+
+/**
+ * @brief the next message for the application, read in place
+ * @param msg filled in, valid until kan_recv_done
+ * @param timeout_ms how long to wait for one, 0 not to wait, -1 for ever
+ * @return 1 if there is a message, 0 if none came in time, -1 if the daemon has gone
+ */
+int kan_recv(KanClient *client, KanMessage *msg, int timeout_ms);
+
+/**
+ * @brief done with the message kan_recv returned, its room in the ring is reused
+ */
+void kan_recv_done(KanClient *client);
+
+/**
+ * @brief a descriptor to poll with the application's others: it is readable when a message may
+ * have arrived after kan_recv found none, or when the daemon has made room kan_send_buffer
+ * waits for. Call kan_recv with a timeout of 0 until it returns 0 after it wakes
+ */
+int kan_fd(const KanClient *client);
+
+/**
+ * @brief the daemon's counters for this application
+ */
+void kan_counters(const KanClient *client, IpcCounters *counters);
+
+#endif // KAN_CLIENT_H
@@ -0,0 +1,330 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "edgeCapture.h"
+#include "kanIpc.h"
+#include "networkLayer.h"
+#include "phy.h"
+#include "statsDump.h"
+
+#define DAEMON_MAX_APPS 16
+#define DAEMON_POLL_MS 200          //how often the loop looks for a signal to stop
+#define DAEMON_HELLO_MS 1000        //an application that connects has this long to say which port it wants
+
+_Static_assert(IPC_MAX_MESSAGE + IPC_APP_HEADER == NETWORK_MAX_MESSAGE, "a message and its ports fill a network message");
+
+//an application, port 0 when the slot is free
+typedef struct {
+    uint8_t port;
+    int sock;
+    int app_efd;
+    int stack_efd;
+    IpcRegion *region;
+} App;
+
+static App apps[DAEMON_MAX_APPS];
+static App *by_port[256];
+//the network layer's RX thread delivers to the applications while the main loop adds and removes them
+static pthread_mutex_t apps_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t node_address = 1;
+static unsigned long unclaimed;     //messages for a port nobody has bound
+static _Atomic int running = 1;          //lock-free, so the signal handler may store to it
+
+static void stop(int sig) {
+    (void)sig;
+    atomic_store(&running, 0);
+}
+
+//messages for this node: the first byte is the port they are for, the second the sender's
+static void deliver(uint8_t src_addr, const uint8_t *data, size_t len, int ch) {
+    (void)ch;
+    pthread_mutex_lock(&apps_lock);
+    App *app = (len >= IPC_APP_HEADER) ? by_port[data[0]] : NULL;
+    if (app == NULL) {
+        unclaimed++;
+        pthread_mutex_unlock(&apps_lock);
+        return;
+    }
+    IpcRegion *region = app->region;
+    IpcRecord *record = ipc_ring_reserve(&region->to_app, (uint32_t)(len - IPC_APP_HEADER));
+    if (record == NULL) {
+        atomic_fetch_add(&region->counters.rx_drops, 1);
+    } else {
+        record->addr = src_addr;
+        record->port = data[1];
+        memcpy(ipc_record_data(record), data + IPC_APP_HEADER, len - IPC_APP_HEADER);
+        atomic_fetch_add(&region->counters.delivered, 1);
+        if (ipc_ring_commit(&region->to_app)) {
+            ipc_notify(app->app_efd);
+        }
+    }
+    pthread_mutex_unlock(&apps_lock);
+}
+
+//send what an application has queued, the network layer takes the message where it lies in the ring
+static void serve(App *app) {
+    IpcRegion *region = app->region;
+    for (;;) {
+        IpcRecord *record;
+        while ((record = ipc_ring_peek(&region->to_stack)) != NULL) {
+            uint8_t *data = ipc_record_data(record);
+            if (record->len >= IPC_APP_HEADER && record->len <= NETWORK_MAX_MESSAGE) {
+                data[0] = record->port;
+                data[1] = app->port;
+                atomic_fetch_add(&region->counters.sent, 1);
+                if (record->addr == node_address) {
+                    //another application on this node, it never goes near a link
+                    deliver(node_address, data, record->len, -1);
+                } else if (send_packet(record->addr, data, record->len) != 0) {
+                    atomic_fetch_add(&region->counters.send_errors, 1);
+                }
+            }
+            if (ipc_ring_release(&region->to_stack)) {
+                ipc_notify(app->app_efd);
+            }
+        }
+        //a ring left with a record that can't be read was corrupted by the application, leave it be
+        if (ipc_ring_wait_readable(&region->to_stack) || ipc_ring_peek(&region->to_stack) == NULL) {
+            return;
+        }
+    }
+}
+
+static void remove_app(App *app) {
+    pthread_mutex_lock(&apps_lock);
+    by_port[app->port] = NULL;
+    app->port = 0;
+    pthread_mutex_unlock(&apps_lock);
+    munmap(app->region, sizeof(IpcRegion));
+    close(app->app_efd);
+    close(app->stack_efd);
+    close(app->sock);
+    printf("Application left\n");
+    fflush(stdout);
+}
+
+//a region in shared memory with no name left in the filesystem, only the descriptor
+static int create_region(IpcRegion **region) {
+    static unsigned serial;
+    char name[64];
+    snprintf(name, sizeof(name), "/kan-%d-%u", (int)getpid(), serial++);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    shm_unlink(name);
+    void *mem = MAP_FAILED;
+    if (ftruncate(fd, sizeof(IpcRegion)) == 0) {
+        mem = mmap(NULL, sizeof(IpcRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (mem == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    *region = mem;
+    return fd;
+}
+
+//an application connecting: it names its port, and gets its region and the two eventfds
+static void accept_app(int listen_fd) {
+    int sock = accept(listen_fd, NULL, NULL);
+    if (sock < 0) {
+        return;
+    }
+    fcntl(sock, F_SETFD, FD_CLOEXEC);
+    struct timeval timeout = {.tv_sec = DAEMON_HELLO_MS / 1000, .tv_usec = DAEMON_HELLO_MS % 1000 * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    IpcHello hello;
+    IpcWelcome welcome = {.status = 0};
+    if (ipc_recv_fds(sock, &hello, sizeof(hello), NULL, 0) != (int)sizeof(hello)) {
+        close(sock);
+        return;
+    }
+    App *app = NULL;
+    if (hello.magic != IPC_MAGIC || hello.size != sizeof(IpcRegion)) {
+        welcome.status = IPC_ERR_VERSION;
+    } else if (hello.port == 0 || by_port[hello.port] != NULL) {
+        welcome.status = IPC_ERR_PORT;
+    } else {
+        for (int i = 0; i < DAEMON_MAX_APPS && app == NULL; i++) {
+            if (apps[i].port == 0) app = &apps[i];
+        }
+        if (app == NULL) welcome.status = IPC_ERR_FULL;
+    }
+
+    IpcRegion *region = NULL;
+    int fds[3] = {-1, -1, -1};
+    if (welcome.status == 0) {
+        fds[0] = create_region(&region);
+        fds[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        fds[2] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (fds[0] < 0 || fds[1] < 0 || fds[2] < 0) {
+            welcome.status = IPC_ERR_RESOURCES;
+        } else {
+            region->magic = IPC_MAGIC;
+            region->size = sizeof(IpcRegion);
+            region->address = node_address;
+            region->port = hello.port;
+            ipc_ring_init(&region->to_stack);
+            ipc_ring_init(&region->to_app);
+        }
+    }
+    int num_fds = (welcome.status == 0) ? 3 : 0;
+    if (ipc_send_fds(sock, &welcome, sizeof(welcome), fds, num_fds) != 0 && welcome.status == 0) {
+        welcome.status = IPC_ERR_RESOURCES;
+    }
+    if (fds[0] >= 0) close(fds[0]);
+    if (welcome.status != 0) {
+        if (region != NULL) munmap(region, sizeof(IpcRegion));
+        if (fds[1] >= 0) close(fds[1]);
+        if (fds[2] >= 0) close(fds[2]);
+        close(sock);
+        return;
+    }
+
+    app->sock = sock;
+    app->app_efd = fds[1];
+    app->stack_efd = fds[2];
+    app->region = region;
+    //the application may send before we first poll its eventfd
+    ipc_ring_wait_readable(&region->to_stack);
+    pthread_mutex_lock(&apps_lock);
+    app->port = hello.port;
+    by_port[hello.port] = app;
+    pthread_mutex_unlock(&apps_lock);
+    printf("Application bound port %d\n", hello.port);
+    fflush(stdout);
+}
+
+static int listen_on(const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path %s is too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    //a socket left behind by a daemon that died is in the way
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, DAEMON_MAX_APPS) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//runs the stack for the local applications: they connect on a Unix socket, bind a port each and
+//then send and receive through rings in shared memory, see kanClient.h
+//usage: kanDaemon [address] [socket_path]
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        node_address = (uint8_t)atoi(argv[1]);
+    }
+    const char *socket_path = (argc > 2) ? argv[2] : IPC_SOCKET_PATH;
+    network_set_address(node_address);
+
+    if (initialize_link_layer() != 0) {
+        return 1;
+    }
+    //KAN_EDGE_CAPTURE=<path> records every edge the receiver sees for edgeReplay
+    if (getenv("KAN_EDGE_CAPTURE") != NULL && link_capture_start(getenv("KAN_EDGE_CAPTURE")) != 0) {
+        return 1;
+    }
+    if (link_tx_start() != 0 || link_rx_start(1) != 0) {
+        fprintf(stderr, "Failed to start TX engine or RX worker\n");
+        return 1;
+    }
+    link_negotiate(-1);
+    while (link_negotiation_pending() > 0) {
+        phy_sleep_us(1000);
+    }
+    network_layer_init();
+    network_set_message_callback(deliver);
+    if (network_routing_start() != 0) {
+        fprintf(stderr, "Failed to start routing\n");
+        return 1;
+    }
+    //KAN_STATS_FILE=<path> appends a JSON line of statistics every KAN_STATS_INTERVAL_MS (10 s by default)
+    if (getenv("KAN_STATS_FILE") != NULL) {
+        uint32_t interval_ms = STATS_DUMP_INTERVAL_MS;
+        if (getenv("KAN_STATS_INTERVAL_MS") != NULL && atoi(getenv("KAN_STATS_INTERVAL_MS")) > 0) {
+            interval_ms = (uint32_t)atoi(getenv("KAN_STATS_INTERVAL_MS"));
+        }
+        if (stats_dump_start(getenv("KAN_STATS_FILE"), interval_ms, STATS_JSON) != 0) {
+            return 1;
+        }
+    }
+
+    int listen_fd = listen_on(socket_path);
+    if (listen_fd < 0) {
+        return 1;
+    }
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    signal(SIGPIPE, SIG_IGN);
+    printf("Node %d serving applications on %s\n", node_address, socket_path);
+    fflush(stdout);
+
+    while (atomic_load(&running)) {
+        struct pollfd fds[1 + 2 * DAEMON_MAX_APPS];
+        App *owner[1 + 2 * DAEMON_MAX_APPS];
+        int n = 0;
+        fds[n++] = (struct pollfd){.fd = listen_fd, .events = POLLIN};
+        for (int i = 0; i < DAEMON_MAX_APPS; i++) {
+            if (apps[i].port == 0) continue;
+            owner[n] = &apps[i];
+            fds[n++] = (struct pollfd){.fd = apps[i].sock, .events = POLLIN};
+            owner[n] = &apps[i];
+            fds[n++] = (struct pollfd){.fd = apps[i].stack_efd, .events = POLLIN};
+        }
+        if (poll(fds, n, DAEMON_POLL_MS) <= 0) {
+            continue;
+        }
+        //the applications' sockets come in pairs with their eventfds, an application that
+        //closed its socket has gone and its eventfd isn't looked at
+        for (int i = 1; i < n; i += 2) {
+            if (fds[i].revents) {
+                remove_app(owner[i]);
+            } else if (fds[i + 1].revents & POLLIN) {
+                ipc_drain(fds[i + 1].fd);
+                serve(owner[i + 1]);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_app(listen_fd);
+        }
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    stats_dump_stop();
+    network_routing_stop();
+    link_tx_stop();
+    link_rx_stop();
+    phy_stop();
+    edge_capture_stop();
+    //the applications see their sockets close
+    for (int i = 0; i < DAEMON_MAX_APPS; i++) {
+        if (apps[i].port != 0) remove_app(&apps[i]);
+    }
+    printf("Stopped, %lu messages were for ports nobody bound\n", unclaimed);
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "netEmu.h"
+
+#define EMU_USAGE "[-t line|ring|mesh|tree] [-n nodes] [-T seconds] [-b bit_us] [-d delay_us] [-j jitter_us] " \
+                  "[-e bit_error_rate] [-r packets/s] [-s bytes] [-w warmup_s] [-p threads] [-i report_s] [-x seed]"
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const EmuStats *s) {
+    double t = s->now_us / 1e6;
+    printf("%8.0f %9llu %7.2f%% %8.1f %8.1f %8.1f %5.2f %9.1f %6.2f%% %6.2f%% %8llu %7llu %6llu %6llu\n", t,
+           (unsigned long long)s->offered, s->offered ? s->delivered * 100.0 / s->offered : 0,
+           hist_percentile(&s->latency_us, 50) / 1e3, hist_percentile(&s->latency_us, 99) / 1e3,
+           hist_percentile(&s->latency_us, 100) / 1e3, s->delivered ? (double)s->hops / s->delivered : 0,
+           t > 0 ? s->advert_bytes / t : 0, s->link_busy * 100, s->max_link_busy * 100,
+           (unsigned long long)s->no_route, (unsigned long long)s->queue_drops, (unsigned long long)s->wire_losses,
+           (unsigned long long)s->looped);
+}
+
+//runs a network of virtual nodes in virtual time, every one with its own routing daemon, and
+//reports delivery, latency and routing overhead as the simulated time goes by
+//usage: kanEmu [-t topology] [-n nodes] [-T seconds] [-b bit_us] [-d delay_us] [-j jitter_us]
+//              [-e bit_error_rate] [-r packets/s] [-s bytes] [-w warmup_s] [-p threads] [-i report_s] [-x seed]
+//  -r is the packets each node sends per second to random other nodes, starting after -w seconds
+//  for the routes to settle; -p spreads the nodes over that many threads
+int main(int argc, char *argv[]) {
+    EmuTopology topology = EMU_MESH;
+    int num_nodes = 100;
+    double seconds = 3600;
+    EmuLinkConfig link = {.bit_us = 100, .delay_us = 50, .jitter_us = 0, .bit_error_rate = 0};
+    EmuTraffic traffic = {.packets_per_s = 0.2, .packet_len = 64};
+    double warmup_s = 60;
+    int threads = 1;
+    double report_s = 600;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (value == NULL || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            fprintf(stderr, "usage: %s %s\n", argv[0], EMU_USAGE);
+            return 1;
+        }
+        switch (argv[i][1]) {
+        case 't':
+            if (emu_parse_topology(value, &topology) != 0) {
+                fprintf(stderr, "unknown topology %s\n", value);
+                return 1;
+            }
+            break;
+        case 'n': num_nodes = atoi(value); break;
+        case 'T': seconds = atof(value); break;
+        case 'b': link.bit_us = (uint32_t)atoi(value); break;
+        case 'd': link.delay_us = (uint32_t)atoi(value); break;
+        case 'j': link.jitter_us = (uint32_t)atoi(value); break;
+        case 'e': link.bit_error_rate = atof(value); break;
+        case 'r': traffic.packets_per_s = atof(value); break;
+        case 's': traffic.packet_len = (uint16_t)atoi(value); break;
+        case 'w': warmup_s = atof(value); break;
+        case 'p': threads = atoi(value); break;
+        case 'i': report_s = atof(value); break;
+        case 'x': seed = strtoull(value, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s %s\n", argv[0], EMU_USAGE);
+            return 1;
+        }
+        i++;
+    }
+    if (link.bit_us == 0 || seconds <= 0 || report_s <= 0) {
+        fprintf(stderr, "usage: %s %s\n", argv[0], EMU_USAGE);
+        return 1;
+    }
+
+    DvConfig dv;
+    dv_default_config(&dv);
+    if (emu_init(num_nodes, &dv, seed) != 0) {
+        fprintf(stderr, "between 1 and %d nodes\n", EMU_MAX_NODES);
+        return 1;
+    }
+    if (emu_build(topology, &link) != 0) {
+        fprintf(stderr, "the topology doesn't fit in four ports per node\n");
+        return 1;
+    }
+    traffic.start_us = (uint64_t)(warmup_s * 1e6);
+    emu_set_traffic(&traffic);
+
+    printf("%d nodes, %u us per bit, %u us delay, %u us jitter, bit error rate %g, %.3g packets/s of %u bytes "
+           "per node after %.0f s, %d thread%s\n", num_nodes, link.bit_us, link.delay_us, link.jitter_us,
+           link.bit_error_rate, traffic.packets_per_s, traffic.packet_len, warmup_s, threads, threads == 1 ? "" : "s");
+    printf("%8s %9s %8s %8s %8s %8s %5s %9s %7s %7s %8s %7s %6s %6s\n", "time_s", "offered", "deliv", "p50_ms",
+           "p99_ms", "max_ms", "hops", "advert_B/s", "busy", "max", "no_route", "q_drop", "wire", "looped");
+
+    uint64_t end_us = (uint64_t)(seconds * 1e6);
+    uint64_t step_us = (uint64_t)(report_s * 1e6);
+    EmuStats stats;
+    double start = now_s();
+    uint64_t t = 0;
+    while (t < end_us) {
+        t = (end_us - t > step_us) ? t + step_us : end_us;
+        if (emu_run(t, threads) != 0) {
+            fprintf(stderr, "emulator failed\n");
+            emu_free();
+            return 1;
+        }
+        emu_get_stats(&stats);
+        report(&stats);
+    }
+    double elapsed = now_s() - start;
+
+    printf("routes last changed at %.1f s, %s\n", stats.routes_changed_us / 1e6,
+           emu_converged() ? "converged" : "not converged");
+    printf("%.0f s of virtual time in %.2f s: %.0fx real time, %llu events (%.0f/s) in %llu windows\n", seconds,
+           elapsed, elapsed > 0 ? seconds / elapsed : 0, (unsigned long long)stats.events,
+           elapsed > 0 ? stats.events / elapsed : 0, (unsigned long long)stats.windows);
+    emu_free();
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "kanIpc.h"
+
+#define IPC_MASK (IPC_RING_BYTES - 1)
+#define IPC_MAX_FDS 4
+
+//the shared indexes work across processes only if the atomics are lock-free
+_Static_assert(ATOMIC_INT_LOCK_FREE == 2, "the rings need lock-free 32-bit atomics");
+_Static_assert((IPC_RING_BYTES & IPC_MASK) == 0, "IPC_RING_BYTES must be a power of two");
+_Static_assert(sizeof(IpcRecord) % IPC_RECORD_ALIGN == 0, "records must stay aligned");
+
+static uint32_t record_bytes(uint32_t len) {
+    return (uint32_t)(sizeof(IpcRecord) + len + IPC_RECORD_ALIGN - 1) & ~(uint32_t)(IPC_RECORD_ALIGN - 1);
+}
+
+void ipc_ring_init(IpcRing *ring) {
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->reader_waiting, 0);
+    ring->pending = 0;
+    atomic_store(&ring->tail, 0);
+    atomic_store(&ring->writer_waiting, 0);
+}
+
+//bytes a record of need bytes takes at head, the filler up to the ring's end included; 0 if it doesn't fit
+static uint32_t room_for(uint32_t head, uint32_t tail, uint32_t need) {
+    uint32_t free = IPC_RING_BYTES - (head - tail);
+    uint32_t to_end = IPC_RING_BYTES - (head & IPC_MASK);
+    uint32_t take = (need <= to_end) ? need : to_end + need;
+    return take <= free ? take : 0;
+}
+
+IpcRecord *ipc_ring_reserve(IpcRing *ring, uint32_t len) {
+    if (len > IPC_RING_BYTES / 2) {
+        return NULL;
+    }
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t need = record_bytes(len);
+    uint32_t take = room_for(head, tail, need);
+    if (take == 0) {
+        return NULL;
+    }
+    if (take > need) {
+        //a record never wraps, the space left at the end is filler the consumer skips
+        ((IpcRecord *)&ring->data[head & IPC_MASK])->len = IPC_RECORD_SKIP;
+        head += take - need;
+    }
+    IpcRecord *record = (IpcRecord *)&ring->data[head & IPC_MASK];
+    record->len = len;
+    record->reserved = 0;
+    ring->pending = take;
+    return record;
+}
+
+int ipc_ring_commit(IpcRing *ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + ring->pending, memory_order_release);
+    ring->pending = 0;
+    //pairs with the fence in ipc_ring_wait_readable: either the consumer sees the record or we see its flag
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->reader_waiting, memory_order_relaxed)) {
+        return atomic_exchange_explicit(&ring->reader_waiting, 0, memory_order_relaxed) != 0;
+    }
+    return 0;
+}
+
+IpcRecord *ipc_ring_peek(IpcRing *ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    while (tail != head) {
+        IpcRecord *record = (IpcRecord *)&ring->data[tail & IPC_MASK];
+        if (record->len != IPC_RECORD_SKIP) {
+            //the other process writes the ring, a record running past its end is not read
+            if (record->len > IPC_RING_BYTES - (tail & IPC_MASK) - sizeof(IpcRecord)) {
+                return NULL;
+            }
+            return record;
+        }
+        tail += IPC_RING_BYTES - (tail & IPC_MASK);
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+    return NULL;
+}
+
+int ipc_ring_release(IpcRing *ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    IpcRecord *record = (IpcRecord *)&ring->data[tail & IPC_MASK];
+    atomic_store_explicit(&ring->tail, tail + record_bytes(record->len), memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->writer_waiting, memory_order_relaxed)) {
+        return atomic_exchange_explicit(&ring->writer_waiting, 0, memory_order_relaxed) != 0;
+    }
+    return 0;
+}
+
+int ipc_ring_wait_readable(IpcRing *ring) {
+    atomic_store_explicit(&ring->reader_waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load_explicit(&ring->head, memory_order_relaxed) ==
+           atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+int ipc_ring_wait_writable(IpcRing *ring, uint32_t len) {
+    atomic_store_explicit(&ring->writer_waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    return room_for(head, tail, record_bytes(len)) == 0;
+}
+
+void ipc_notify(int efd) {
+    uint64_t one = 1;
+    //the counter only saturates after 2^64 - 2 wakeups nobody read, nothing to do if it fails
+    while (write(efd, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+}
+
+void ipc_drain(int efd) {
+    uint64_t count;
+    while (read(efd, &count, sizeof(count)) < 0 && errno == EINTR) {
+    }
+}
+
+int ipc_send_fds(int sock, const void *msg, size_t len, const int *fds, int num_fds) {
+    if (num_fds < 0 || num_fds > IPC_MAX_FDS) {
+        return -1;
+    }
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof(int) * IPC_MAX_FDS)];
+    } control;
+    struct iovec iov = {.iov_base = (void *)msg, .iov_len = len};
+    struct msghdr mh = {.msg_iov = &iov, .msg_iovlen = 1};
+    if (num_fds > 0) {
+        memset(&control, 0, sizeof(control));
+        mh.msg_control = control.buf;
+        mh.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&mh);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
+    }
+    return sendmsg(sock, &mh, MSG_NOSIGNAL) == (ssize_t)len ? 0 : -1;
+}
+
+int ipc_recv_fds(int sock, void *msg, size_t len, int *fds, int num_fds) {
+    for (int i = 0; i < num_fds; i++) {
+        fds[i] = -1;
+    }
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof(int) * IPC_MAX_FDS)];
+    } control;
+    struct iovec iov = {.iov_base = msg, .iov_len = len};
+    struct msghdr mh = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buf,
+                        .msg_controllen = sizeof(control.buf)};
+    ssize_t n = recvmsg(sock, &mh, MSG_CMSG_CLOEXEC);
+    if (n <= 0) {
+        return -1;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        int count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        int *passed = (int *)CMSG_DATA(cmsg);
+        for (int i = 0; i < count; i++) {
+            int fd;
+            memcpy(&fd, &passed[i], sizeof(fd));
+            if (i < num_fds) {
+                fds[i] = fd;
+            } else {
+                close(fd);
+            }
+        }
+    }
+    return (int)n;
+}
@@ -0,0 +1,151 @@
+#ifndef KAN_IPC_H
+#define KAN_IPC_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//how local applications talk to the stack daemon (kanDaemon) through shared memory. Every
+//application gets a region of its own holding two rings, one each way. A ring has one producer
+//and one consumer, each moving only its own index, so passing a message takes no lock and no
+//syscall. A side that finds its ring empty (or full) flags that it is waiting and sleeps on an
+//eventfd; the other side writes the eventfd only when that flag is set, so a busy stream of
+//messages costs a wakeup per burst, not per message
+#define IPC_RING_BYTES (256 * 1024)     //a power of two, so an index wraps with a mask
+#define IPC_RECORD_ALIGN 8
+#define IPC_RECORD_SKIP 0xFFFFFFFFu     //length of the filler up to the end of the ring
+#define IPC_APP_HEADER 2                //destination and source port in front of every message
+#define IPC_MAX_MESSAGE (16384 - IPC_APP_HEADER)    //NETWORK_MAX_MESSAGE less the ports
+#define IPC_MAGIC 0x314E414Bu           //"KAN1"
+#define IPC_SOCKET_PATH "/tmp/kan.sock" //where the daemon listens by default
+
+//a message in a ring, its data follows
+typedef struct {
+    uint32_t len;           //data bytes, IPC_RECORD_SKIP for filler
+    uint8_t addr;           //destination node on the way to the stack, source node on the way back
+    uint8_t port;           //destination port on the way to the stack, source port on the way back
+    uint16_t reserved;
+} IpcRecord;
+
+typedef struct {
+    _Alignas(64) _Atomic uint32_t head;     //bytes ever written, moved by the producer
+    _Atomic uint32_t reader_waiting;        //the consumer is asleep, or about to be
+    uint32_t pending;                       //bytes reserved and not committed yet, the producer's own
+    _Alignas(64) _Atomic uint32_t tail;     //bytes ever read, moved by the consumer
+    _Atomic uint32_t writer_waiting;        //the producer is waiting for room
+    _Alignas(64) uint8_t data[IPC_RING_BYTES];
+} IpcRing;
+
+//counters of one application, kept by the daemon
+typedef struct {
+    _Atomic uint32_t sent;          //messages handed to the network layer
+    _Atomic uint32_t send_errors;   //of them, refused: no route, or a full queue
+    _Atomic uint32_t delivered;     //messages put in the application's ring
+    _Atomic uint32_t rx_drops;      //messages for the application dropped because its ring was full
+} IpcCounters;
+
+//the memory an application shares with the daemon
+typedef struct {
+    uint32_t magic;
+    uint32_t size;                  //sizeof(IpcRegion), so both sides agree on the layout
+    uint8_t address;                //the node's
+    uint8_t port;                   //the application's
+    IpcCounters counters;
+    IpcRing to_stack;
+    IpcRing to_app;
+} IpcRegion;
+
+//what an application sends first on the daemon's socket
+typedef struct {
+    uint32_t magic;
+    uint32_t size;                  //sizeof(IpcRegion) it was built with
+    uint8_t port;                   //the port it wants, 1-255
+} IpcHello;
+
+//the daemon's answer, with the region, the application's eventfd and the daemon's if status is 0
+typedef struct {
+    int32_t status;                 //0, or one of IPC_ERR_*
+} IpcWelcome;
+
+#define IPC_ERR_VERSION -1          //the region layouts differ
+#define IPC_ERR_PORT -2             //the port is 0 or taken
+#define IPC_ERR_FULL -3             //no room for another application
+#define IPC_ERR_RESOURCES -4        //the daemon could not set up the region
+
+/**
+ * @brief set up an empty ring
+ */
+void ipc_ring_init(IpcRing *ring);
+
+/**
+ * @brief room for a record in the ring, to be filled in place and then committed
+ * @param ring the ring, by its producer
+ * @param len the data bytes, at most IPC_RING_BYTES / 2
+ * @return the record with len set, its data at ipc_record_data; NULL if the ring is full
+ */
+IpcRecord *ipc_ring_reserve(IpcRing *ring, uint32_t len);
+
+/**
+ * @brief publish the record last reserved
+ * @param ring the ring, by its producer
+ * @return 1 if the consumer is waiting and has to be woken on its eventfd, 0 if not
+ */
+int ipc_ring_commit(IpcRing *ring);
+
+/**
+ * @brief the oldest record in the ring, left in place until ipc_ring_release
+ * @param ring the ring, by its consumer
+ * @return the record, NULL if the ring is empty
+ */
+IpcRecord *ipc_ring_peek(IpcRing *ring);
+
+/**
+ * @brief drop the record ipc_ring_peek returned
+ * @param ring the ring, by its consumer
+ * @return 1 if the producer is waiting for room and has to be woken on its eventfd, 0 if not
+ */
+int ipc_ring_release(IpcRing *ring);
+
+/**
+ * @brief flag that the consumer is going to sleep; call it, and sleep on the eventfd only if it
+ * returns 1, so a record committed in between is not missed
+ * @return 1 if the ring is still empty, 0 if a record has arrived
+ */
+int ipc_ring_wait_readable(IpcRing *ring);
+
+/**
+ * @brief flag that the producer is going to sleep until there is room for len bytes, as
+ * ipc_ring_wait_readable
+ * @return 1 if there is still no room, 0 if there is
+ */
+int ipc_ring_wait_writable(IpcRing *ring, uint32_t len);
+
+static inline uint8_t *ipc_record_data(IpcRecord *record) {
+    return (uint8_t *)(record + 1);
+}
+
+/**
+ * @brief wake the side sleeping on an eventfd
+ */
+void ipc_notify(int efd);
+
+/**
+ * @brief clear an eventfd after waking on it
+ */
+void ipc_drain(int efd);
+
+/**
+ * @brief send a message on a Unix socket with file descriptors attached
+ * @param fds descriptors to pass, up to 4
+ * @return 0 on success, -1 if failed
+ */
+int ipc_send_fds(int sock, const void *msg, size_t len, const int *fds, int num_fds);
+
+/**
+ * @brief receive a message sent by ipc_send_fds
+ * @param fds filled with the descriptors passed, the rest set to -1
+ * @return the message bytes, -1 if failed or the peer has gone
+ */
+int ipc_recv_fds(int sock, void *msg, size_t len, int *fds, int num_fds);
+
+#endif // KAN_IPC_H
@@ -0,0 +1,416 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include "linkArq.h"
+#include "phy.h"
+
+#define ARQ_SACK_BITS (ARQ_MAX_WINDOW - 1) //frames after nr that fit the reorder buffer
+#define ARQ_DEFAULT_WINDOW 8
+#define ARQ_REF_FRAME_BITS 1100 //bit times of a 128-byte frame on the wire, what the default timers scale with
+//the timeout doubles at most this many times: losses on a link are noise, not congestion that
+//backing off relieves, so it only has to outgrow a round trip that was underestimated
+#define ARQ_MAX_BACKOFF 2
+
+void arq_default_config(ArqConfig *config, uint32_t bit_us) {
+    uint32_t frame_us = ARQ_REF_FRAME_BITS * bit_us;
+    config->window = ARQ_DEFAULT_WINDOW;
+    config->rto_init_us = 3 * frame_us;
+    //the wave on the wire is shared by all ports, so an ack that misses the start of one waits it out
+    config->rto_min_us = 2 * frame_us;
+    config->rto_max_us = 64 * frame_us;
+    config->ack_delay_us = 128 * bit_us;
+}
+
+void arq_init(ArqSession *session, const ArqConfig *config, arq_send_t send, arq_deliver_t deliver, void *ctx) {
+    memset(session, 0, sizeof(*session));
+    session->config = *config;
+    if (session->config.window < 1) session->config.window = 1;
+    if (session->config.window > ARQ_MAX_WINDOW) session->config.window = ARQ_MAX_WINDOW;
+    session->send = send;
+    session->deliver = deliver;
+    session->ctx = ctx;
+    session->rto_us = config->rto_init_us;
+    session->stats.rto_us = session->rto_us;
+}
+
+int arq_unacked(const ArqSession *session) {
+    return (uint8_t)(session->snd_nxt - session->snd_una);
+}
+
+//bit k set for frame rcv_nxt + 1 + k waiting in the reorder buffer
+static uint32_t sack_bitmap(const ArqSession *s) {
+    uint32_t sack = 0;
+    for (int k = 0; k < ARQ_SACK_BITS; k++) {
+        if (s->rx[(uint8_t)(s->rcv_nxt + 1 + k) % ARQ_MAX_WINDOW].present) {
+            sack |= 1u << k;
+        }
+    }
+    return sack;
+}
+
+//send a frame with the current acks, and the data of tx slot seq if data is set
+static int send_frame(ArqSession *s, int data, uint8_t seq) {
+    uint8_t pdu[LINK_MAX_DATA];
+    uint8_t ctl = 0;
+    int n = 0;
+
+    pdu[n++] = s->rcv_nxt;
+    if (data) {
+        ctl |= ARQ_CTL_DATA;
+        pdu[n++] = seq;
+    }
+    uint32_t sack = sack_bitmap(s);
+    if (sack != 0) {
+        ctl |= ARQ_CTL_SACK;
+        for (int i = 0; i < 4; i++) {
+            pdu[n++] = (uint8_t)(sack >> (8 * i));
+        }
+    }
+    if (data) {
+        const ArqTxSlot *slot = &s->tx[seq % ARQ_MAX_WINDOW];
+        memcpy(&pdu[n], slot->data, slot->len);
+        n += slot->len;
+    }
+    int rc = s->send(s->ctx, ctl, pdu, (uint16_t)n);
+    if (rc < 0) {
+        return -1;
+    }
+    //whatever ack was waiting has gone out with the frame
+    s->ack_pending = 0;
+    return rc;
+}
+
+static int transmit(ArqSession *s, uint8_t seq, uint32_t now_us) {
+    ArqTxSlot *slot = &s->tx[seq % ARQ_MAX_WINDOW];
+    uint32_t sent_us = slot->sent_us;
+    uint32_t order = slot->order;
+    //numbered before the send, arq_sent may be called from inside it
+    slot->sent_us = now_us;
+    slot->order = ++s->order;
+    slot->queued = 1;
+    int rc = send_frame(s, 1, seq);
+    if (rc < 0) {
+        slot->sent_us = sent_us;
+        slot->order = order;
+        slot->queued = 0;
+        s->order--;
+        return -1;
+    }
+    if (rc == 0) {
+        slot->queued = 0;
+    }
+    return 0;
+}
+
+static void send_ack(ArqSession *s) {
+    if (send_frame(s, 0, 0) >= 0) {
+        s->stats.acks_sent++;
+    }
+}
+
+int arq_send(ArqSession *session, const uint8_t *data, uint16_t len, uint32_t now_us) {
+    if (len > ARQ_MAX_DATA || arq_unacked(session) >= session->config.window) {
+        return -1;
+    }
+    ArqTxSlot *slot = &session->tx[session->snd_nxt % ARQ_MAX_WINDOW];
+    memcpy(slot->data, data, len);
+    slot->len = len;
+    slot->acked = 0;
+    slot->retransmitted = 0;
+    if (transmit(session, session->snd_nxt, now_us) != 0) {
+        return -1;
+    }
+    session->snd_nxt++;
+    session->stats.sent++;
+    return 0;
+}
+
+void arq_sent(ArqSession *session, uint8_t seq, uint32_t order, uint32_t now_us) {
+    ArqTxSlot *slot = &session->tx[seq % ARQ_MAX_WINDOW];
+    if ((uint8_t)(seq - session->snd_una) >= arq_unacked(session) || slot->order != order) {
+        //acked already, or sent again since
+        return;
+    }
+    slot->queued = 0;
+    slot->sent_us = now_us;
+}
+
+//retransmission timeout from the smoothed round trip and its variation (Jacobson/Karels)
+//doubled for every timeout since the last ack of new frames
+static void update_rto(ArqSession *s) {
+    uint32_t rto = (s->srtt_us != 0) ? s->srtt_us + 4 * s->rttvar_us : s->config.rto_init_us;
+    if (rto < s->config.rto_min_us) rto = s->config.rto_min_us;
+    rto <<= s->backoff;
+    if (rto > s->config.rto_max_us) rto = s->config.rto_max_us;
+    s->rto_us = rto;
+    s->stats.srtt_us = s->srtt_us;
+    s->stats.rto_us = rto;
+}
+
+static void rtt_sample(ArqSession *s, uint32_t rtt_us) {
+    if (rtt_us == 0) rtt_us = 1;
+    if (s->srtt_us == 0) {
+        s->srtt_us = rtt_us;
+        s->rttvar_us = rtt_us / 2;
+    } else {
+        uint32_t err = (s->srtt_us > rtt_us) ? s->srtt_us - rtt_us : rtt_us - s->srtt_us;
+        s->rttvar_us = (3 * s->rttvar_us + err) / 4;
+        s->srtt_us = (7 * s->srtt_us + rtt_us) / 8;
+    }
+    update_rto(s);
+}
+
+//mark a frame acked, keeps track of the newest one that tells the round trip
+static void mark_acked(ArqSession *s, uint8_t seq, const ArqTxSlot **newest) {
+    ArqTxSlot *slot = &s->tx[seq % ARQ_MAX_WINDOW];
+    if (slot->acked) {
+        return;
+    }
+    slot->acked = 1;
+    if (slot->retransmitted) {
+        //which copy arrived is unknown, so it tells neither the round trip nor what went before it
+        return;
+    }
+    if (slot->order > s->acked_order) {
+        s->acked_order = slot->order;
+    }
+    if (*newest == NULL || slot->order > (*newest)->order) {
+        *newest = slot;
+    }
+}
+
+static void take_acks(ArqSession *s, uint8_t nr, uint32_t sack, uint32_t now_us) {
+    uint8_t outstanding = s->snd_nxt - s->snd_una;
+    if ((uint8_t)(nr - s->snd_una) > outstanding) {
+        //acks something never sent, an old frame
+        return;
+    }
+    const ArqTxSlot *newest = NULL;
+    int advanced = s->snd_una != nr;
+    while (s->snd_una != nr) {
+        mark_acked(s, s->snd_una++, &newest);
+    }
+    for (int k = 0; k < ARQ_SACK_BITS; k++) {
+        uint8_t seq = nr + 1 + k;
+        if (((sack >> k) & 1) && (uint8_t)(seq - s->snd_una) < (uint8_t)(s->snd_nxt - s->snd_una)) {
+            mark_acked(s, seq, &newest);
+        }
+    }
+    if (advanced) {
+        //the link delivers again, even if only retransmissions were acked, which Karn's rule
+        //keeps out of the estimate
+        s->backoff = 0;
+    }
+    if (newest != NULL) {
+        rtt_sample(s, now_us - newest->sent_us);
+    } else if (advanced) {
+        update_rto(s);
+    }
+
+    //the link keeps frames in order, so a frame that went out before one that has arrived
+    //and isn't acked itself was lost: send it again without waiting for the timer
+    for (uint8_t seq = s->snd_una; seq != s->snd_nxt; seq++) {
+        ArqTxSlot *slot = &s->tx[seq % ARQ_MAX_WINDOW];
+        if (!slot->acked && !slot->queued && slot->order < s->acked_order) {
+            slot->retransmitted = 1;
+            if (transmit(s, seq, now_us) == 0) {
+                s->stats.fast_retransmits++;
+            }
+        }
+    }
+}
+
+static void receive_data(ArqSession *s, uint8_t ns, const uint8_t *data, uint16_t len, uint32_t now_us) {
+    uint8_t offset = ns - s->rcv_nxt;
+    ArqRxSlot *slot = &s->rx[ns % ARQ_MAX_WINDOW];
+    if (offset >= ARQ_MAX_WINDOW || slot->present) {
+        //already received, its ack was lost or is still on the way: ack again straight away
+        s->stats.duplicates++;
+        send_ack(s);
+        return;
+    }
+    slot->present = 1;
+    slot->len = len;
+    memcpy(slot->data, data, len);
+    if (offset > 0) {
+        //a gap, the sender learns of it from the selective ack
+        send_ack(s);
+        return;
+    }
+
+    int delivered = 0;
+    while (s->rx[s->rcv_nxt % ARQ_MAX_WINDOW].present) {
+        slot = &s->rx[s->rcv_nxt % ARQ_MAX_WINDOW];
+        slot->present = 0;
+        s->rcv_nxt++;
+        s->stats.delivered++;
+        delivered++;
+        s->deliver(s->ctx, slot->data, slot->len);
+    }
+    if (delivered > 1) {
+        //a gap was filled, the sender is waiting to move its window on
+        send_ack(s);
+    } else if (!s->ack_pending) {
+        //in order: give reverse data a moment to carry the ack
+        s->ack_pending = 1;
+        s->ack_due_us = now_us + s->config.ack_delay_us;
+    }
+}
+
+void arq_receive(ArqSession *session, uint8_t ctl, const uint8_t *pdu, uint16_t len, uint32_t now_us) {
+    int data = (ctl & ARQ_CTL_DATA) != 0;
+    int n = 1 + data;
+    uint32_t sack = 0;
+    if (ctl & ARQ_CTL_SACK) {
+        if (len < n + 4) return;
+        for (int i = 0; i < 4; i++) {
+            sack |= (uint32_t)pdu[n + i] << (8 * i);
+        }
+        n += 4;
+    }
+    if (len < n || len - n > ARQ_MAX_DATA) {
+        return;
+    }
+    take_acks(session, pdu[0], sack, now_us);
+    if (data) {
+        receive_data(session, pdu[1], &pdu[n], (uint16_t)(len - n), now_us);
+    }
+}
+
+void arq_tick(ArqSession *session, uint32_t now_us) {
+    //only the oldest frame that timed out goes again: the peer acks it at once, with a selective
+    //ack that tells the frames lost from the ones whose acks were, and those fast retransmit
+    for (uint8_t seq = session->snd_una; seq != session->snd_nxt; seq++) {
+        ArqTxSlot *slot = &session->tx[seq % ARQ_MAX_WINDOW];
+        if (slot->acked || slot->queued || (int32_t)(now_us - slot->sent_us) < (int32_t)session->rto_us) {
+            continue;
+        }
+        slot->retransmitted = 1;
+        if (transmit(session, seq, now_us) != 0) {
+            break;
+        }
+        session->stats.timeouts++;
+        for (uint8_t other = seq + 1; other != session->snd_nxt; other++) {
+            ArqTxSlot *later = &session->tx[other % ARQ_MAX_WINDOW];
+            if (!later->queued) later->sent_us = now_us;
+        }
+        if (session->backoff < ARQ_MAX_BACKOFF) {
+            //back off until the peer acks new frames again
+            session->backoff++;
+            update_rto(session);
+        }
+        break;
+    }
+    if (session->ack_pending && (int32_t)(now_us - session->ack_due_us) >= 0) {
+        send_ack(session);
+    }
+}
+
+//one session per port of the link layer
+static ArqSession sessions[4];
+//recursive, the deliver callback may send on the same port
+static pthread_mutex_t session_locks[4];
+static pthread_once_t locks_once = PTHREAD_ONCE_INIT;
+static msg_callback_t link_deliver;
+
+static void init_locks(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    for (int i = 0; i < 4; i++) {
+        pthread_mutex_init(&session_locks[i], &attr);
+    }
+    pthread_mutexattr_destroy(&attr);
+}
+
+//a data frame's port, sequence number and order, packed into the completion's ctx
+#define SENT_CTX(ch, seq, order) ((void *)(intptr_t)((ch) | (seq) << 2 | (intptr_t)((order) & 0xFFFF) << 10))
+
+static void link_sent(int ch, int status, void *ctx) {
+    (void)status;
+    intptr_t tag = (intptr_t)ctx;
+    uint8_t seq = (uint8_t)(tag >> 2);
+    pthread_mutex_lock(&session_locks[ch]);
+    ArqSession *s = &sessions[ch];
+    //the order's high bits are the session's, a frame can't stay queued for 65536 transmissions
+    uint32_t order = (s->order & ~0xFFFFu) | (uint32_t)(tag >> 10);
+    if (order > s->order) order -= 0x10000;
+    arq_sent(s, seq, order, phy_tick());
+    pthread_mutex_unlock(&session_locks[ch]);
+}
+
+static int link_send(void *ctx, uint8_t ctl, const uint8_t *pdu, uint16_t len) {
+    int ch = (int)(intptr_t)ctx;
+    Frame *frame = frame_alloc();
+    if (frame == NULL) {
+        return -1;
+    }
+    memcpy(frame_payload(frame), pdu, len);
+    link_seal_frame_header(frame, len, LINK_HDR_ARQ | ctl);
+    int rc;
+    if (ctl & ARQ_CTL_DATA) {
+        //the session numbered the frame before sending it
+        rc = link_transmit_frame(ch, frame, link_sent, SENT_CTX(ch, pdu[1], sessions[ch].order));
+        rc = (rc == 0) ? 1 : rc;
+    } else {
+        rc = link_transmit_frame(ch, frame, NULL, NULL);
+    }
+    frame_release(frame);
+    return rc;
+}
+
+static void link_data(void *ctx, const uint8_t *data, uint16_t len) {
+    if (link_deliver != NULL) {
+        link_deliver((uint8_t *)data, len, (int)(intptr_t)ctx);
+    }
+}
+
+static void arq_frame(Frame *frame, int ch) {
+    pthread_mutex_lock(&session_locks[ch]);
+    arq_receive(&sessions[ch], frame->data[0] & (ARQ_CTL_DATA | ARQ_CTL_SACK), frame_payload(frame),
+                frame_len(frame), phy_tick());
+    pthread_mutex_unlock(&session_locks[ch]);
+}
+
+void arq_link_start(const ArqConfig *config, msg_callback_t deliver) {
+    pthread_once(&locks_once, init_locks);
+    link_deliver = deliver;
+    for (int i = 0; i < 4; i++) {
+        pthread_mutex_lock(&session_locks[i]);
+        arq_init(&sessions[i], config, link_send, link_data, (void *)(intptr_t)i);
+        pthread_mutex_unlock(&session_locks[i]);
+    }
+    set_arq_callback(arq_frame);
+}
+
+int arq_link_send(int ch, const uint8_t *data, uint16_t len) {
+    if (ch < 0 || ch >= 4) {
+        return -1;
+    }
+    pthread_mutex_lock(&session_locks[ch]);
+    int rc = arq_send(&sessions[ch], data, len, phy_tick());
+    pthread_mutex_unlock(&session_locks[ch]);
+    return rc;
+}
+
+void arq_link_poll(void) {
+    uint32_t now = phy_tick();
+    for (int i = 0; i < 4; i++) {
+        pthread_mutex_lock(&session_locks[i]);
+        arq_tick(&sessions[i], now);
+        pthread_mutex_unlock(&session_locks[i]);
+    }
+}
+
+int arq_link_unacked(int ch) {
+    pthread_mutex_lock(&session_locks[ch]);
+    int unacked = arq_unacked(&sessions[ch]);
+    pthread_mutex_unlock(&session_locks[ch]);
+    return unacked;
+}
+
+void arq_link_stats(int ch, ArqStats *stats) {
+    pthread_mutex_lock(&session_locks[ch]);
+    *stats = sessions[ch].stats;
+    pthread_mutex_unlock(&session_locks[ch]);
+}
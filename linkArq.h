@@ -0,0 +1,174 @@
+#ifndef LINK_ARQ_H
+#define LINK_ARQ_H
+
+#include <stdint.h>
+#include "linkLayer.h"
+
+//reliable delivery over one link: selective repeat, with cumulative and selective acks that ride
+//on the reverse traffic and a retransmission timer that follows the measured round trip.
+//The header byte of an ARQ frame is its control byte, LINK_HDR_ARQ and the ARQ_CTL bits; the
+//sequence numbers follow as an extended control field, as in HDLC's modulo-128 mode:
+//[nr][ns, data frames only][selective ack bitmap, 4 bytes LE, with ARQ_CTL_SACK][data]
+#define ARQ_CTL_DATA 0x01       //an I-frame: carries ns and data, otherwise the frame only acks
+#define ARQ_CTL_SACK 0x02       //the bitmap follows nr: bit k is frame nr + 1 + k having arrived
+#define ARQ_MAX_WINDOW 32       //most frames a sender has unacked, also the receiver's reorder buffer
+#define ARQ_MAX_OVERHEAD 6      //extended control bytes of a data frame at most
+#define ARQ_MAX_DATA (LINK_MAX_DATA - ARQ_MAX_OVERHEAD)
+
+//sends a frame to the peer with the given ARQ_CTL bits; returns 0 if it went out, 1 if it was
+//queued and arq_sent follows once it has left, so its timer doesn't run while it waits, -1 if it failed
+typedef int (*arq_send_t)(void *ctx, uint8_t ctl, const uint8_t *pdu, uint16_t len);
+//data from the peer, in order and each frame once
+typedef void (*arq_deliver_t)(void *ctx, const uint8_t *data, uint16_t len);
+
+typedef struct {
+    int window;                     //frames sent ahead of the acks, 1 (stop and wait) to ARQ_MAX_WINDOW
+    uint32_t rto_init_us;           //retransmission timeout until the first round trip is measured
+    uint32_t rto_min_us;
+    uint32_t rto_max_us;            //the timeout backs off on expiries up to this
+    uint32_t ack_delay_us;          //an ack waits this long for data to ride on before it goes alone
+} ArqConfig;
+
+typedef struct {
+    uint32_t sent;                  //data frames sent for the first time
+    uint32_t timeouts;              //retransmitted because the timer ran out
+    uint32_t fast_retransmits;      //retransmitted because a frame sent after them was acked
+    uint32_t acks_sent;             //frames that only carried an ack
+    uint32_t delivered;
+    uint32_t duplicates;            //data frames received again
+    uint32_t srtt_us;               //smoothed round trip
+    uint32_t rto_us;                //retransmission timeout now
+} ArqStats;
+
+typedef struct {
+    uint16_t len;
+    uint8_t acked;                  //cumulatively or selectively
+    uint8_t retransmitted;          //its acks say nothing about the round trip (Karn)
+    uint8_t queued;                 //waiting to go out, its timer starts when it has
+    uint32_t sent_us;               //last time it went out
+    uint32_t order;                 //transmission count at that time
+    uint8_t data[ARQ_MAX_DATA];
+} ArqTxSlot;
+
+typedef struct {
+    uint16_t len;
+    uint8_t present;
+    uint8_t data[ARQ_MAX_DATA];
+} ArqRxSlot;
+
+//both directions of one link, every call on it must come from one thread at a time
+typedef struct {
+    ArqConfig config;
+    arq_send_t send;
+    arq_deliver_t deliver;
+    void *ctx;
+    //sender: frames snd_una up to snd_nxt are unacked, slot seq % ARQ_MAX_WINDOW
+    uint8_t snd_una;
+    uint8_t snd_nxt;
+    uint32_t order;                 //transmissions so far
+    uint32_t acked_order;           //latest transmission known to have arrived
+    uint32_t srtt_us;               //0 until the first round trip is measured
+    uint32_t rttvar_us;
+    uint32_t rto_us;
+    uint8_t backoff;                //timeouts since new frames were last acked, doubling rto_us
+    ArqTxSlot tx[ARQ_MAX_WINDOW];
+    //receiver: rcv_nxt is the next frame to deliver, the ones after it wait in rx
+    uint8_t rcv_nxt;
+    uint8_t ack_pending;
+    uint32_t ack_due_us;
+    ArqRxSlot rx[ARQ_MAX_WINDOW];
+    ArqStats stats;
+} ArqSession;
+
+/**
+ * @brief window and timers scaled to a link's bit duration
+ * @param config filled in
+ * @param bit_us the link's bit duration
+ */
+void arq_default_config(ArqConfig *config, uint32_t bit_us);
+
+/**
+ * @brief set up a session with nothing sent or received
+ * @param session the session
+ * @param config window and timers, copied
+ * @param send called to send a frame
+ * @param deliver called with the peer's data
+ * @param ctx passed to both callbacks
+ */
+void arq_init(ArqSession *session, const ArqConfig *config, arq_send_t send, arq_deliver_t deliver, void *ctx);
+
+/**
+ * @brief send data reliably, the acks of received data ride along
+ * @param session the session
+ * @param data the data (copied)
+ * @param len at most ARQ_MAX_DATA bytes
+ * @param now_us the current time
+ * @return 0 if it was sent, -1 if the window is full, the frame couldn't be queued or len is too long
+ */
+int arq_send(ArqSession *session, const uint8_t *data, uint16_t len, uint32_t now_us);
+
+/**
+ * @brief start the timer of a data frame that the send callback queued
+ * @param session the session
+ * @param seq its sequence number, pdu[1]
+ * @param order session->order right after it was queued, tells it from later copies
+ * @param now_us when it left the wire, or failed to
+ */
+void arq_sent(ArqSession *session, uint8_t seq, uint32_t order, uint32_t now_us);
+
+/**
+ * @brief handle an ARQ frame from the peer
+ * @param session the session
+ * @param ctl the frame's ARQ_CTL bits
+ * @param pdu the extended control field and the data
+ * @param len bytes of pdu
+ * @param now_us the current time
+ */
+void arq_receive(ArqSession *session, uint8_t ctl, const uint8_t *pdu, uint16_t len, uint32_t now_us);
+
+/**
+ * @brief run the timers: retransmit what timed out, send acks that waited long enough
+ * @param session the session
+ * @param now_us the current time
+ */
+void arq_tick(ArqSession *session, uint32_t now_us);
+
+/**
+ * @brief number of frames sent and not acked yet
+ */
+int arq_unacked(const ArqSession *session);
+
+/**
+ * @brief start a session on every port of the link layer, ARQ frames from the peers go to them
+ * @param config window and timers
+ * @param deliver called with each port's data in order, from the thread that receives frames
+ */
+void arq_link_start(const ArqConfig *config, msg_callback_t deliver);
+
+/**
+ * @brief send data to the peer on a port reliably
+ * @param ch the index of the channel (0-3)
+ * @param data the data (copied)
+ * @param len at most ARQ_MAX_DATA bytes
+ * @return 0 if it was sent, -1 if the window or the port's TX queue is full
+ */
+int arq_link_send(int ch, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief run the timers of every port, call every few bit times
+ */
+void arq_link_poll(void);
+
+/**
+ * @brief number of frames sent on a port and not acked yet
+ */
+int arq_link_unacked(int ch);
+
+/**
+ * @brief read the counters of a port's session
+ * @param ch the index of the channel (0-3)
+ * @param stats filled in
+ */
+void arq_link_stats(int ch, ArqStats *stats);
+
+#endif // LINK_ARQ_H
@@ -1,39 +1,227 @@
-#include <pigpiod_if2.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
-//#include "linkLayer.h"
+#include "phy.h"
+#include "edgeCapture.h"
+#include "linkLayer.h"
+#include "trace.h"
 
-#define BUFFER_SIZE 128
-#define BIT_DURATION_US 5000
+_Static_assert(FRAME_SIZE == BUFFER_SIZE, "pool frames hold a whole link frame");
 
 int rx_pins[] = {26, 24, 22, 20};
 int tx_pins[] = {27, 25, 23, 21};
-int gpio_handle = -1;
 
 //structure to maintain the state of each communication link (port)
 typedef struct {
     uint8_t half_bit_signal;        //flag for detecting half bits in Manchester decoding
     uint8_t sync_detected;          //flag to indicate if synchronization has been detected
     uint32_t prev_tick;             //timestamp of the previous GPIO event
-    uint32_t margin;                //time margin for timing comparisons
-    uint8_t bit_buffer[8];          //buffer to store bits of a byte during reception
-    int bit_pos;                    //current position in the bit buffer
-    uint8_t msg_buffer[BUFFER_SIZE];//buffer to store the received message
-    int msg_pos;                    //current position in the message buffer
+    uint32_t margin;                //nominal bit duration the receiver starts from, follows the peer's rate
+    uint32_t half_bit_q4;           //recovered half-bit time of the sender in 1/16 us
+    uint8_t rx_byte;                //bits of the byte being received, the first one ends up on top
+    int bit_pos;                    //number of bits received into rx_byte
+    Frame *rx_frame;                //pool frame the message is decoded into, taken at its first byte
+    Frame rx_overflow;              //decoded into instead when the pool is empty, the frame is then dropped
+    int msg_pos;                    //current position in rx_frame
+    uint16_t rx_fcs;                //CRC-16 register over the bytes of rx_frame so far
+    uint8_t ones;                   //1 bits in a row, for the bit stuffing and the flags
+    uint8_t hunting;                //bit sync is there but no frame is open, waiting for a flag
+    //forward error correction, the frame's bytes are decoded once its closing flag is in
+    _Atomic uint8_t fec_mode;       //FecMode of the port, set by link_set_fec
+    uint8_t rx_fec;                 //mode of the frame being received, taken at its opening flag
+    uint8_t rx_coded[FEC_MAX_ENCODED(BUFFER_SIZE)];
+    _Atomic uint64_t fec_frames;    //decoder counters, written by the edge callback
+    _Atomic uint64_t fec_corrected;
+    _Atomic uint64_t fec_uncorrectable;
+    //receive statistics, see link_get_stats; written by the edge callback but for rx_latency_us,
+    //which whoever delivers the port's frames records into
+    uint32_t frame_tick;            //tick of the opening flag of the frame being received
+    _Atomic uint32_t edge_clock;    //tick of the latest edge, the port's clock for whoever delivers its frames
+    _Atomic uint64_t rx_frames;
+    _Atomic uint64_t rx_bytes;
+    _Atomic uint64_t rx_fcs_errors;
+    _Atomic uint64_t rx_aborts;
+    _Atomic uint64_t rx_timing_errors;
+    _Atomic uint64_t rx_sync_losses;
+    Histogram edge_us;
+    Histogram rx_latency_us;
+    //receive side of the rate negotiation, only touched by the RX callback
+    uint8_t probe_rx_idx;           //rate step of the probes the peer is sending
+    uint8_t probe_rx_mask;          //which of them arrived intact
+    uint16_t rx_errors;             //errors in the current error window
+    uint16_t rx_good;               //good frames in the current error window
+    //transmit side of the rate negotiation, guarded by tx_lock
+    uint8_t rate_idx;               //negotiated step on the rate ladder, used by the TX pulse builder
+    uint8_t rate_state;             //RATE_IDLE or where the probing is at
+    uint8_t probe_idx;              //rate step being probed
+    uint8_t probe_seq;              //next probe to send
+    uint32_t probe_deadline;        //tick by which the peer's report must have arrived
 } ChannelState;
 
-//reimplement callback function 
-typedef void (*msg_callback_t)(uint8_t* msg, int ch);
+//handlers for complete messages, a frame handler takes precedence
 static msg_callback_t user_msg_handler;
+static frame_callback_t user_frame_handler;
+static frame_callback_t arq_handler;
+static _Atomic(tx_poll_callback_t) tx_poll_handler;   //set while the TX thread may be polling
 
 //array to hold state of each port
 ChannelState port_states[4];
 
-//buffer to hold the final message received
-uint8_t received_msg[BUFFER_SIZE];
+#define TX_QUEUE_DEPTH 8        //frames waiting per queue
+#define TX_BROADCAST 4          //index of the queue for frames sent on every port
+#define TX_NUM_QUEUES 5         //one queue per port plus the broadcast queue
+#define TX_MAX_IN_FLIGHT 2      //the wave being sent and the one chained behind it
+#define TX_POLL_US 1000         //how often the TX engine thread checks the wave generator
+#define SYNC_SLOTS 4            //half-bit slots of the sync preamble
+#define TX_LINE_FRAMES 8        //frames of one queue that can share a wave, back to back between flags
+#define TX_LINE_BUDGET_BITS 1200 //frames are added to a line while its bits stay below this
+#define TX_BATCH_FRAMES (4 * TX_LINE_FRAMES)
+//most bits a frame of n bytes takes on the wire: a stuffed 0 after every five 1s, and its closing flag
+#define STUFFED_BITS(n) ((n) * 8 * 6 / 5 + 8)
+#define TX_LINE_MAX_BITS (8 + STUFFED_BITS(FEC_MAX_ENCODED(BUFFER_SIZE))) //opening flag, then the largest frame encoded
+#define MAX_LINE_SLOTS (SYNC_SLOTS + 2 * TX_LINE_MAX_BITS)
+#define CLOCK_FRAC_BITS 4       //fraction bits of the recovered half-bit time
+#define CLOCK_GAIN_SHIFT 3      //clock recovery follows 1/8 of each measured error
+#define MAX_EDGE_GAP_US (1u << 20) //longer gaps are clamped before fixed-point math
+#define FEC_MAX_GAP_SLOTS 8     //longest bad gap, in half bits, a receiver in FEC mode clocks through
+#ifndef RX_RING_SIZE
+#define RX_RING_SIZE 32         //completed frames waiting per port, a power of two; 32 holds a full ARQ window
+#endif
+#define RX_MAX_WORKERS 4        //workers draining the rings, each owns every port p with p % workers == its index
+#define WAVE_CACHE_SIZE 8       //uploaded waves kept for frames that are sent again
+#define WAVE_CACHE_MAX_LEN 32   //only short frames are cached, pigpio's pulse memory is small
+#define LINK_CTRL_FLAG 0x80     //set in the header byte of link control frames
+#define LINK_RATE_STEPS 24      //most rungs on the rate ladder
+#define LINK_MIN_BIT_US 20      //the ladder stops above this
+#define LINK_PROBE_COUNT 8      //probes sent per rate
+#define LINK_PROBE_MAX_LOSS 0   //probes that may go missing for the rate to be taken
+#define LINK_PROBE_PATTERN 32   //payload bytes of a probe, they exercise both half and full bit gaps
+#define LINK_REPORT_TIMEOUT_BITS 2000 //base bit times to wait for the peer's report
+#define LINK_ERROR_WINDOW 32    //good frames after which the error count starts over
+#define LINK_DEGRADE_ERRORS 4   //errors within a window that make the peer fall back one rate
+
+//link control frames, the first payload byte is the type
+enum {
+    LINK_CTRL_PROBE = 1,        //[type][rate step][seq][pattern], sent at the rate being probed
+    LINK_CTRL_REPORT,           //[type][rate step][probes received], the answer to the last probe
+    LINK_CTRL_DEGRADED          //[type], errors are climbing on the link from the peer
+};
+
+//transmit side of the negotiation on a port
+enum {
+    RATE_IDLE,                  //settled on rate_idx
+    RATE_PROBE_SEND,            //the next probe has to be queued
+    RATE_PROBE_SENT,            //a probe is queued or on the wire
+    RATE_PROBE_WAIT             //all probes are out, waiting for the report
+};
+
+//a frame waiting to be sent
+typedef struct {
+    Frame *frame;               //sealed pool frame, the request holds a reference until it is sent
+    uint32_t bit_us;            //bit duration of the frame, 0 for the rate negotiated on the port
+    tx_done_callback_t done;    //called once the frame has left the wire (may be NULL)
+    void *ctx;
+    uint32_t queued_tick;       //TX engine's poll before the frame was queued, for the latency stats
+} TxRequest;
+
+typedef struct {
+    TxRequest entries[TX_QUEUE_DEPTH];
+    int head;
+    int count;
+} TxQueue;
+
+//frames sent together as one wave: broadcast frames, or frames for up to every port.
+//The frames of a queue are next to each other and go out back to back on its pins
+typedef struct {
+    int wave_id;
+    int cache_idx;              //wave cache entry holding wave_id, -1 if the wave is deleted after use
+    int status;
+    int num_frames;
+    int queues[TX_BATCH_FRAMES];
+    TxRequest reqs[TX_BATCH_FRAMES];
+} TxInFlight;
+
+//transmit statistics of a port, see link_get_stats; completions run on whichever thread polls
+typedef struct {
+    _Atomic uint64_t frames;
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t errors;
+    _Atomic uint64_t drops;
+    Histogram latency_us;
+} TxStats;
+
+static TxQueue tx_queues[TX_NUM_QUEUES];
+static TxStats tx_stats[4];
+static TxInFlight in_flight[TX_MAX_IN_FLIGHT];
+static int num_in_flight;
+static int tx_prefer_broadcast;
+//tick the TX engine's last poll read: frames are timed by it instead of each asking the PHY for the time
+static uint32_t tx_clock;
+//every slot boundary of up to four lines running at different rates, plus their return to idle
+static PhyPulse tx_pulses[4 * (MAX_LINE_SLOTS + 1)];
+//the stuffed bit stream of each line in the wave being encoded, the first bit is the top one
+static uint8_t tx_bits[4][(TX_LINE_MAX_BITS + 7) / 8];
+//a frame after forward error correction, before it is stuffed
+static uint8_t tx_coded[FEC_MAX_ENCODED(BUFFER_SIZE)];
+_Static_assert(TX_LINE_BUDGET_BITS <= TX_LINE_MAX_BITS, "a line that is full still fits tx_bits");
+
+//an uploaded wave for a single frame, reused when the same frame goes to the same pins again
+typedef struct {
+    int wave_id;                //-1 if the entry is free
+    uint32_t hash;
+    uint32_t gpio_pin;
+    uint32_t bit_us[4];         //bit duration on each line of the wave
+    uint8_t fec[4];             //and its FecMode
+    uint8_t len;                //bytes of data: the header byte and the frame's data
+    uint8_t data[WAVE_CACHE_MAX_LEN + 1];
+    uint32_t last_used;
+    int refs;                   //batches in flight using the wave, it can't be evicted meanwhile
+    int stale;                  //built for an old bit duration, deleted when its last batch is done
+} WaveCacheEntry;
+
+static WaveCacheEntry wave_cache[WAVE_CACHE_SIZE];
+static uint32_t wave_cache_clock;
+
+//base bit duration: the rate every link starts at and the first rung of the rate ladder
+static uint32_t bit_duration_us = BIT_DURATION_US;
+
+//bit durations links can negotiate, each rung 3/4 of the one before so a receiver
+//locked onto one rung still accepts the sync pattern of the next
+static uint32_t rate_ladder[LINK_RATE_STEPS];
+static int num_rates;
+
+//probe payload: runs of full bits, alternating half bits and both mixed
+static const uint8_t probe_pattern[] = {0x00, 0xFF, 0x55, 0x0F};
+
+static pthread_mutex_t tx_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t tx_thread;
+static _Atomic int tx_thread_running;
+
+//completed frames of one port on their way from the edge callback (the only producer)
+//to the worker that owns the port (the only consumer)
+typedef struct {
+    Frame *slots[RX_RING_SIZE];
+    _Atomic uint32_t head;      //next frame the worker takes, written by the worker
+    _Atomic uint32_t tail;      //next free slot, written by the edge callback
+    _Atomic uint32_t max_depth; //written by the edge callback
+    _Atomic uint64_t delivered; //written by the worker
+    _Atomic uint64_t dropped;   //written by the edge callback
+    _Atomic uint64_t overflows; //the drops of a full ring, written by the edge callback
+} RxRing;
+_Static_assert((RX_RING_SIZE & (RX_RING_SIZE - 1)) == 0, "the ring indexes its slots with a mask");
+_Static_assert(4 * RX_RING_SIZE < FRAME_POOL_SIZE, "four full rings leave frames for the stack and the TX queues");
+
+static RxRing rx_rings[4];
+static pthread_t rx_workers[RX_MAX_WORKERS];
+static sem_t rx_wake[RX_MAX_WORKERS];   //posted for every frame pushed to a ring the worker owns
+static int num_rx_workers;             //only changes while no edge callback can push
+static _Atomic int rx_workers_running;
+static _Atomic int rx_pushing;          //edge callbacks between checking rx_workers_running and their push
 
 //function to map a GPIO pin number to the corresponding port index
 static int gpio_to_port(unsigned gpio_pin) {
@@ -51,225 +239,1514 @@ static void reset_channel(ChannelState *ch_state) {
     ch_state->sync_detected = 0;
     ch_state->bit_pos = 0;
     ch_state->msg_pos = 0;
-    memset(ch_state->bit_buffer, 0, sizeof(ch_state->bit_buffer));
-    memset(ch_state->msg_buffer, 0, sizeof(ch_state->msg_buffer));
-    ch_state->margin = BIT_DURATION_US;
+    ch_state->rx_fcs = FCS16_INIT;
+    ch_state->ones = 0;
+    ch_state->hunting = 1;
+    if (ch_state->rx_frame == &ch_state->rx_overflow) {
+        ch_state->rx_frame = NULL;
+    }
+    ch_state->half_bit_q4 = (ch_state->margin << CLOCK_FRAC_BITS) / 2;
 }
 
-//function to compute the checksum
-static uint8_t compute_checksum(uint8_t *data, uint8_t len) {
-    uint16_t sum = 0;
-    for (uint8_t i = 0; i < len; i++) {
-        sum += data[i];
+static int tx_copy(int queue, const uint8_t *data, uint16_t len, uint8_t header, uint32_t bit_us,
+                   tx_done_callback_t done, void *ctx);
+static void rate_report(int ch, uint8_t idx, uint8_t received);
+static void rate_degraded(int ch);
+
+//send a link control frame back to the peer on a port, it goes at the port's negotiated rate
+static void send_ctrl(int ch, const uint8_t *payload, uint8_t len) {
+    tx_copy(ch, payload, len, LINK_CTRL_FLAG, 0, NULL, NULL);
+}
+
+//add to a counter only the edge callback writes, no locked instruction needed
+static inline void rx_count(_Atomic uint64_t *counter, uint64_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+//count a receive error, tell the peer to slow down once they climb. A peer already
+//at the base rate has nowhere to fall back to, so it isn't told
+static void note_rx_error(int ch_index) {
+    ChannelState *ch_state = &port_states[ch_index];
+    if (ch_state->margin >= bit_duration_us) {
+        return;
+    }
+    if (++ch_state->rx_errors >= LINK_DEGRADE_ERRORS) {
+        ch_state->rx_errors = 0;
+        ch_state->rx_good = 0;
+        uint8_t msg[1] = {LINK_CTRL_DEGRADED};
+        send_ctrl(ch_index, msg, sizeof(msg));
     }
-    return (uint8_t)(sum % 256);
 }
 
-//convert received bits into a byte then into character and assemble the message
-static void bit_to_char(int ch_index) {
+static void note_rx_good(int ch_index) {
     ChannelState *ch_state = &port_states[ch_index];
-    uint8_t full_byte = 0;
+    if (++ch_state->rx_good >= LINK_ERROR_WINDOW) {
+        ch_state->rx_errors = 0;
+        ch_state->rx_good = 0;
+    }
+}
 
-    printf("Converting bits to char on port %d: ", ch_index);
+//handle a link control frame from the peer on a port
+static void link_ctrl_rx(int ch_index, const uint8_t *payload, uint16_t len) {
+    ChannelState *ch_state = &port_states[ch_index];
+    if (len == 0) return;
+
+    switch (payload[0]) {
+    case LINK_CTRL_PROBE:
+        if (len >= 3 && payload[2] < LINK_PROBE_COUNT) {
+            uint8_t bit = 1u << payload[2];
+            //a new run of probes starts over
+            if (payload[1] != ch_state->probe_rx_idx || (ch_state->probe_rx_mask & bit)) {
+                ch_state->probe_rx_idx = payload[1];
+                ch_state->probe_rx_mask = 0;
+            }
+            ch_state->probe_rx_mask |= bit;
+            if (payload[2] == LINK_PROBE_COUNT - 1) {
+                uint8_t received = 0;
+                for (int i = 0; i < LINK_PROBE_COUNT; i++) {
+                    received += (ch_state->probe_rx_mask >> i) & 1;
+                }
+                uint8_t msg[3] = {LINK_CTRL_REPORT, payload[1], received};
+                send_ctrl(ch_index, msg, sizeof(msg));
+                ch_state->probe_rx_mask = 0;
+                //errors while the peer was probing don't count against the rate it settles on
+                ch_state->rx_errors = 0;
+                ch_state->rx_good = 0;
+            }
+        }
+        break;
+    case LINK_CTRL_REPORT:
+        if (len >= 3) {
+            rate_report(ch_index, payload[1], payload[2]);
+        }
+        break;
+    case LINK_CTRL_DEGRADED:
+        rate_degraded(ch_index);
+        break;
+    }
+}
+
+//hand a complete frame to the user's handler and drop the link layer's reference. The latency is
+//read off the port's edge clock, the one rx_tick comes from, rather than asking the PHY for the time
+static void deliver_frame(Frame *frame, int ch_index) {
+    uint32_t now = atomic_load_explicit(&port_states[ch_index].edge_clock, memory_order_relaxed);
+    hist_record(&port_states[ch_index].rx_latency_us, now - frame->rx_tick);
+    if (frame->data[0] & LINK_HDR_ARQ) {
+        if (arq_handler != NULL) {
+            arq_handler(frame, ch_index);
+        }
+    } else if (user_frame_handler != NULL) {
+        user_frame_handler(frame, ch_index);
+    } else if (user_msg_handler != NULL) {
+        user_msg_handler(frame_payload(frame), frame_len(frame), ch_index);
+    }
+    frame_release(frame);
+}
+
+//a frame of the port was lost on the way to the handlers, only called from the edge callback
+static void rx_count_drop(int ch_index) {
+    rx_count(&rx_rings[ch_index].dropped, 1);
+}
+
+//queue a complete frame for the port's worker in constant time, a full ring drops it
+static void rx_ring_push(int ch_index, Frame *frame, int num_workers) {
+    RxRing *ring = &rx_rings[ch_index];
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t depth = tail - head;
+    if (depth == RX_RING_SIZE) {
+        rx_count_drop(ch_index);
+        rx_count(&ring->overflows, 1);
+        TRACE(TRACE_RX_QUEUE_FULL, ch_index);
+        frame_release(frame);
+        return;
+    }
+    ring->slots[tail & (RX_RING_SIZE - 1)] = frame;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    if (depth + 1 > atomic_load_explicit(&ring->max_depth, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->max_depth, depth + 1, memory_order_relaxed);
+    }
+    sem_post(&rx_wake[ch_index % num_workers]);
+}
 
-    for (int i = 0; i < 8; i++) {
-        full_byte |= ch_state->bit_buffer[i] << (7 - i);
+//deliver every frame waiting on a port, only called by the port's worker
+static void rx_ring_drain(int ch_index) {
+    RxRing *ring = &rx_rings[ch_index];
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    while (head != tail) {
+        Frame *frame = ring->slots[head & (RX_RING_SIZE - 1)];
+        atomic_store_explicit(&ring->head, ++head, memory_order_release);
+        atomic_store_explicit(&ring->delivered, atomic_load_explicit(&ring->delivered, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+        deliver_frame(frame, ch_index);
     }
+}
 
-    printf(" => 0x%02X\n", full_byte);
+//give up on the frame being received and wait for the next flag, bit sync is kept
+static void rx_abort(int ch_index) {
+    ChannelState *ch_state = &port_states[ch_index];
+    if (ch_state->msg_pos > 0) {
+        TRACE(TRACE_FRAME_ABORT, ch_index, ch_state->msg_pos);
+        rx_count(&ch_state->rx_aborts, 1);
+        note_rx_error(ch_index);
+    }
+    //a pool frame is reused for the next one
+    if (ch_state->rx_frame == &ch_state->rx_overflow) {
+        ch_state->rx_frame = NULL;
+    }
+    ch_state->hunting = 1;
+}
 
-    ch_state->msg_buffer[ch_state->msg_pos++] = full_byte;
+//store a received byte straight into the channel's pool frame
+static void bit_to_char(int ch_index) {
+    ChannelState *ch_state = &port_states[ch_index];
+    uint8_t full_byte = ch_state->rx_byte;
 
-    uint8_t expected_len = ch_state->msg_buffer[0]; //number of data bytes
+    TRACE(TRACE_BYTE_RX, ch_index, full_byte);
 
-    if (ch_state->msg_pos == expected_len + 2) {
-        int msg_len = ch_state->msg_pos;
-        for (int j = 0; j < msg_len; j++) {
-            received_msg[j] = ch_state->msg_buffer[j];
+    ch_state->bit_pos = 0;
+    int max_len = ch_state->rx_fec ? fec_encoded_len(ch_state->rx_fec, BUFFER_SIZE) : BUFFER_SIZE;
+    if (ch_state->msg_pos == max_len) {
+        //longer than any frame, its closing flag was lost
+        rx_abort(ch_index);
+        return;
+    }
+    if (ch_state->rx_frame == NULL) {
+        ch_state->rx_frame = frame_alloc();
+        if (ch_state->rx_frame == NULL) {
+            //every pool frame is held elsewhere: decode into the spare to stay in step with the line
+            ch_state->rx_frame = &ch_state->rx_overflow;
         }
+    }
+    if (ch_state->rx_fec != FEC_NONE) {
+        //encoded, rx_decode turns it into the frame at the closing flag
+        ch_state->rx_coded[ch_state->msg_pos++] = full_byte;
+        return;
+    }
+    ch_state->rx_frame->data[ch_state->msg_pos++] = full_byte;
+    //the FCS is kept up to date byte by byte, by the closing flag it is already checked
+    ch_state->rx_fcs = fcs16_byte(ch_state->rx_fcs, full_byte);
+}
 
-        uint8_t received_checksum = received_msg[expected_len + 1];
-        uint8_t computed_checksum = compute_checksum(&received_msg[1], expected_len);
+//correct and decode a frame received in FEC mode into rx_frame, then check its FCS in one go
+static int rx_decode(int ch_index) {
+    ChannelState *ch_state = &port_states[ch_index];
+    FecResult result = {0, 0};
+    int len = fec_decode(ch_state->rx_fec, ch_state->rx_coded, ch_state->msg_pos, ch_state->rx_frame->data, &result);
+    rx_count(&ch_state->fec_frames, 1);
+    rx_count(&ch_state->fec_corrected, result.corrected);
+    rx_count(&ch_state->fec_uncorrectable, result.uncorrectable);
+    if (len < 0 || len > BUFFER_SIZE) {
+        TRACE(TRACE_FEC_FAILED, ch_index, ch_state->msg_pos);
+        return -1;
+    }
+    if (result.corrected > 0) {
+        TRACE(TRACE_FEC_CORRECTED, ch_index, result.corrected);
+    }
+    ch_state->msg_pos = len;
+    ch_state->rx_fcs = fcs16(FCS16_INIT, ch_state->rx_frame->data, len);
+    return 0;
+}
 
-        printf("msg_len is: %d \n", msg_len);    
-        printf("Received checksum: 0x%02x\n", received_checksum);
-        printf("Computed checksum: 0x%02x\n", computed_checksum);
+//the closing flag of a frame has been seen, deliver the frame if its FCS holds
+static void frame_complete(int ch_index) {
+    ChannelState *ch_state = &port_states[ch_index];
+    Frame *frame = ch_state->rx_frame;
+    TRACE(TRACE_FRAME_RX, ch_index, ch_state->msg_pos, ch_state->rx_fcs);
 
-        if (computed_checksum == received_checksum) {
-            //if checksum matches
-            if (user_msg_handler != NULL) {
-                user_msg_handler(received_msg, ch_index);
+    if (ch_state->rx_fcs == FCS16_GOOD) {
+        //if the FCS matches, the sender's recovered rate becomes where the next frame is expected
+        ch_state->margin = ch_state->half_bit_q4 >> (CLOCK_FRAC_BITS - 1);
+        note_rx_good(ch_index);
+        //the frame leaves the channel, the next one is decoded into a fresh pool frame
+        ch_state->rx_frame = NULL;
+        frame->len = (uint16_t)(ch_state->msg_pos - 1 - LINK_FCS_SIZE);
+        frame->ch = ch_index;
+        frame->rx_tick = ch_state->frame_tick;
+        rx_count(&ch_state->rx_frames, 1);
+        rx_count(&ch_state->rx_bytes, frame->len);
+        if (frame->data[0] & LINK_CTRL_FLAG) {
+            //link control is short and has to work without workers, it stays on this thread
+            link_ctrl_rx(ch_index, frame_payload(frame), frame_len(frame));
+            if (frame != &ch_state->rx_overflow) {
+                frame_release(frame);
             }
+        } else if (frame == &ch_state->rx_overflow) {
+            TRACE(TRACE_POOL_EMPTY, ch_index);
+            rx_count_drop(ch_index);
         } else {
-            //if there's a checksum error
-            printf("\n[Port %d] Checksum mismatch. Discarding message.\n", ch_index);
-            fflush(stdout);
+            //announced before the check, so link_rx_stop waits for the push before tearing down
+            atomic_fetch_add(&rx_pushing, 1);
+            if (atomic_load(&rx_workers_running)) {
+                rx_ring_push(ch_index, frame, num_rx_workers);
+                atomic_fetch_sub(&rx_pushing, 1);
+            } else {
+                atomic_fetch_sub(&rx_pushing, 1);
+                deliver_frame(frame, ch_index);
+            }
+        }
+    } else {
+        //if there's an FCS error, a pool frame is reused for the next one
+        TRACE(TRACE_CHECKSUM_MISMATCH, ch_index);
+        rx_count(&ch_state->rx_fcs_errors, 1);
+        note_rx_error(ch_index);
+        if (frame == &ch_state->rx_overflow) {
+            ch_state->rx_frame = NULL;
         }
-        reset_channel(ch_state);
     }
+}
 
+//a flag closes the frame being received and opens the next one. Its first seven bits are
+//already in rx_byte, so after a whole frame bit_pos is exactly 7
+static void rx_flag(int ch_index) {
+    ChannelState *ch_state = &port_states[ch_index];
+    if (!ch_state->hunting && ch_state->msg_pos > 0) {
+        if (ch_state->bit_pos == 7 && (ch_state->rx_fec == FEC_NONE || rx_decode(ch_index) == 0) &&
+            ch_state->msg_pos >= 1 + LINK_FCS_SIZE) {
+            frame_complete(ch_index);
+        } else {
+            rx_abort(ch_index);
+        }
+    }
+    //flags back to back are idle fill between frames
+    ch_state->hunting = 0;
+    ch_state->frame_tick = ch_state->prev_tick;
     ch_state->bit_pos = 0;
-    memset(ch_state->bit_buffer, 0, sizeof(ch_state->bit_buffer));
+    ch_state->msg_pos = 0;
+    ch_state->rx_fcs = FCS16_INIT;
+    ch_state->rx_fec = atomic_load_explicit(&ch_state->fec_mode, memory_order_relaxed);
+}
+
+//one decoded bit: undo the bit stuffing and find the flags. Five 1s and a 0 is a stuffed 0,
+//six 1s and a 0 is a flag, and seven 1s abort the frame
+static void rx_bit(int ch_index, int bit) {
+    ChannelState *ch_state = &port_states[ch_index];
+    if (bit) {
+        if (ch_state->ones == 6) {
+            if (!ch_state->hunting) {
+                rx_abort(ch_index);
+            }
+            return;
+        }
+        ch_state->ones++;
+    } else {
+        uint8_t ones = ch_state->ones;
+        ch_state->ones = 0;
+        if (ones == 6) {
+            rx_flag(ch_index);
+            return;
+        }
+        if (ones == 5) {
+            return;
+        }
+    }
+    if (ch_state->hunting) {
+        return;
+    }
+    ch_state->rx_byte = (ch_state->rx_byte << 1) | bit;
+    //if 8 bits have been collected, convert them into a byte
+    if (++ch_state->bit_pos == 8) {
+        bit_to_char(ch_index);
+    }
+}
+
+//in FEC mode, a gap inside a frame that fits no Manchester timing is most likely a step of the wave
+//that arrived inverted and merged with its neighbours into one long level. Counted in half bits
+//it keeps the bit clock; the bits it covers can't be read and go in as 0s for the decoder to fix
+static int rx_bridge_gap(int ch_index, int level, uint32_t diff_q4, uint32_t est) {
+    ChannelState *ch_state = &port_states[ch_index];
+    uint32_t slots = (diff_q4 + est / 2) / est;
+    if (slots < 3 || slots > FEC_MAX_GAP_SLOTS) {
+        return -1;
+    }
+    //after a bit was read the gap starts with the rest of it, after a half bit with the next bit
+    int covered = ch_state->half_bit_signal ? (int)slots : (int)slots - 1;
+    TRACE(TRACE_FEC_GAP, ch_index, slots);
+    for (int i = 0; i < covered / 2; i++) {
+        rx_bit(ch_index, 0);
+    }
+    if (covered & 1) {
+        //the gap ends in the middle of a bit, the edge reads it as usual
+        ch_state->half_bit_signal = 0;
+        rx_bit(ch_index, level);
+    } else {
+        ch_state->half_bit_signal = 1;
+    }
+    return 0;
 }
 
 //callback function triggered on edge detection
-static void rx_callback(int pi, unsigned gpio, unsigned level, uint32_t tick) {
+static void rx_callback(unsigned gpio, unsigned level, uint32_t tick) {
+    edge_capture(gpio, level, tick);
     int ch_index = gpio_to_port(gpio); 
     if (ch_index == -1) return;
 
     ChannelState *ch_state = &port_states[ch_index]; 
 
-    //calculate the time difference between the current and previous signal edges (for our purposes to see if it's working)
-    uint32_t time_diff = (tick >= ch_state->prev_tick) ? (tick - ch_state->prev_tick) 
-                                                        : ((UINT32_MAX - ch_state->prev_tick) + tick);
-    //calculate the ratio of the time difference to the expected bit duration (for our purposes to see if it's working)
-    float margin_ratio = (float)time_diff / ch_state->margin; 
+    //time difference between the current and previous signal edges, unsigned math handles tick wrap-around
+    uint32_t time_diff = tick - ch_state->prev_tick;
+    if (time_diff > MAX_EDGE_GAP_US) time_diff = MAX_EDGE_GAP_US;
+    //from here on prev_tick is the edge being decoded
+    ch_state->prev_tick = tick;
+    atomic_store_explicit(&ch_state->edge_clock, tick, memory_order_relaxed);
+    hist_record_owned(&ch_state->edge_us, time_diff);
 
-    printf("RX Callback on port %d: level=%d, tick=%u, time_diff=%u, margin_ratio=%.2f\n", 
-           ch_index, level, tick, time_diff, margin_ratio);
+    //ratio of the gap to the recovered bit time in hundredths, only computed when traced
+    TRACE(TRACE_RX_EDGE, ch_index, level, tick, time_diff,
+          ((time_diff << CLOCK_FRAC_BITS) * 50 / ch_state->half_bit_q4) / 100,
+          ((time_diff << CLOCK_FRAC_BITS) * 50 / ch_state->half_bit_q4) % 100);
 
     if (ch_state->sync_detected) { 
-        printf("Sync detected on port %d\n", ch_index);
+        TRACE(TRACE_SYNC_ACTIVE, ch_index);
 
-        if (margin_ratio > 0.8f && margin_ratio < 1.2f) { 
+        //classify the gap against the recovered half-bit time h: around 2h is a full bit,
+        //around h a half bit, with the decision point at 1.5h
+        uint32_t diff_q4 = time_diff << CLOCK_FRAC_BITS;
+        uint32_t est = ch_state->half_bit_q4;
+        uint32_t sample;
+        int bit = -1;
+
+        if (2 * diff_q4 >= 3 * est && 2 * diff_q4 < 5 * est) { 
             //full bit duration is detected, store the level as a bit
-            printf("full bit detected on link %d\n", ch_index);
-            ch_state->bit_buffer[ch_state->bit_pos++] = level; 
-        } else if (margin_ratio > 0.4f && margin_ratio < 0.6f) {
+            TRACE(TRACE_FULL_BIT, ch_index);
+            bit = level;
+            sample = diff_q4 / 2;
+        } else if (2 * diff_q4 > est && 2 * diff_q4 < 3 * est) {
             //half bit duration is detected, Manchester encoding
-            printf("Half bit detected on link %d\n", ch_index);
+            TRACE(TRACE_HALF_BIT, ch_index);
             if (ch_state->half_bit_signal == 0) {
                 ch_state->half_bit_signal = 1; 
             } else {
                 //combine two half bits to form a full bit
-                ch_state->bit_buffer[ch_state->bit_pos++] = level; 
+                bit = level;
                 ch_state->half_bit_signal = 0;
             }
+            sample = diff_q4;
         } else { 
-            //if the timing is off, reset the channel to resynchronize and start again
-            printf("Timing error on port %d, resetting channel\n", ch_index);
+            if (ch_state->rx_fec != FEC_NONE && !ch_state->hunting && ch_state->msg_pos > 0 &&
+                rx_bridge_gap(ch_index, level, diff_q4, est) == 0) {
+                return;
+            }
+            //if the timing is off, reset the channel to resynchronize on the next sync pattern.
+            //Between frames this is the line going quiet at the end of a wave, not an error
+            if (!ch_state->hunting && ch_state->msg_pos > 0) {
+                TRACE(TRACE_TIMING_ERROR, ch_index);
+                rx_count(&ch_state->rx_timing_errors, 1);
+                note_rx_error(ch_index);
+            } else if (ch_state->hunting) {
+                rx_count(&ch_state->rx_sync_losses, 1);
+            }
             reset_channel(ch_state); 
+            return;
         }
 
-        //if 8 bits have been collected, convert them into a byte
-        if (ch_state->bit_pos == 8) { 
-            bit_to_char(ch_index); 
+        //clock recovery: move the estimate a fraction of the way to what was measured
+        //so it follows the sender's actual rate and drift
+        ch_state->half_bit_q4 = (uint32_t)((int32_t)est + (((int32_t)sample - (int32_t)est) >> CLOCK_GAIN_SHIFT));
+
+        if (bit >= 0) {
+            rx_bit(ch_index, bit);
         }
     } else {
-        //detect the synchronization pattern to start message reception
-        if (margin_ratio > 0.8f && margin_ratio < 1.2f && level == 1) { 
+        //detect the synchronization pattern to start message reception: a rising edge after
+        //a low full bit. Anything from 1/3 to 4 nominal bit durations is accepted and seeds the
+        //clock recovery, so a peer a couple of rungs faster or slower is still locked onto
+        if (level == 1 && 3 * time_diff > ch_state->margin && time_diff <= 4 * ch_state->margin) { 
             ch_state->sync_detected = 1; 
-            printf("Sync pattern detected on port %d\n", ch_index);
+            ch_state->half_bit_q4 = (time_diff << CLOCK_FRAC_BITS) / 2;
+            TRACE(TRACE_SYNC_PATTERN, ch_index);
         }
     }
+}
 
-    //update the timestamp of the last signal edge
-    ch_state->prev_tick = tick;
+//pins driven by a queue: one port, or every port for the broadcast queue
+static uint32_t queue_pins(int queue) {
+    if (queue < 4) {
+        return 1u << tx_pins[queue];
+    }
+    uint32_t gpio_pin = 0;
+    for (int i = 0; i < 4; i++) {
+        gpio_pin |= (1u << tx_pins[i]);
+    }
+    return gpio_pin;
 }
 
-//function to transmit data using Manchester encoding over the network
-void manchester_transmit(int ch, uint8_t *data, uint8_t len) {
-    int32_t gpio_pin = 0;
+//channel reported to the completion callback for a queue
+static int queue_channel(int queue) {
+    return (queue < 4) ? queue : -1;
+}
 
-    if (ch >= 0 && ch < 4) {
-        //transmit to a specific port
-        gpio_pin = 1 << tx_pins[ch];
+//append a bit to a line's stream
+static inline int put_bit(uint8_t *bits, int n, int bit) {
+    uint8_t mask = 0x80 >> (n & 7);
+    bits[n >> 3] = bit ? (bits[n >> 3] | mask) : (bits[n >> 3] & ~mask);
+    return n + 1;
+}
+
+static int put_flag(uint8_t *bits, int n) {
+    for (int i = 7; i >= 0; i--) {
+        n = put_bit(bits, n, (LINK_FLAG >> i) & 1);
+    }
+    return n;
+}
+
+//a byte stuffed after a given run of 1s: its bits with the stuffed 0s (two at most), and the run
+//of 1s it leaves
+typedef struct {
+    uint16_t bits;              //right aligned, first bit highest
+    uint8_t len;
+    uint8_t ones;
+} StuffEntry;
+
+static StuffEntry stuff_table[5][256];
+
+static void init_stuff_table(void) {
+    for (int ones_in = 0; ones_in < 5; ones_in++) {
+        for (int byte = 0; byte < 256; byte++) {
+            StuffEntry e = {0, 0, 0};
+            int ones = ones_in;
+            for (int b = 7; b >= 0; b--) {
+                int bit = (byte >> b) & 1;
+                e.bits = (uint16_t)(e.bits << 1 | bit);
+                e.len++;
+                if (!bit) {
+                    ones = 0;
+                } else if (++ones == 5) {
+                    e.bits <<= 1;
+                    e.len++;
+                    ones = 0;
+                }
+            }
+            e.ones = (uint8_t)ones;
+            stuff_table[ones_in][byte] = e;
+        }
+    }
+}
+
+//bit stuffing: a 0 goes in after five 1s in a row, so the data never looks like a flag. A byte
+//at a time through stuff_table, whole bytes are written out of an accumulator
+static int put_stuffed(uint8_t *bits, int n, const uint8_t *data, int len) {
+    int pos = n >> 3;
+    int fill = n & 7;
+    uint32_t acc = bits[pos] >> (8 - fill);
+    int ones = 0;
+    for (int i = 0; i < len; i++) {
+        const StuffEntry *e = &stuff_table[ones][data[i]];
+        acc = (acc << e->len) | e->bits;
+        fill += e->len;
+        while (fill >= 8) {
+            fill -= 8;
+            bits[pos++] = (uint8_t)(acc >> fill);
+        }
+        acc &= (1u << fill) - 1;
+        ones = e->ones;
+    }
+    if (fill > 0) {
+        bits[pos] = (uint8_t)(acc << (8 - fill));
+    }
+    return pos * 8 + fill;
+}
+
+//append one half-bit slot, a slot that changes nothing is folded into the previous pulse
+static inline void add_slot(int *pulse_idx, uint32_t on, uint32_t off, uint32_t us) {
+    if (*pulse_idx > 0 && tx_pulses[*pulse_idx - 1].gpioOn == on && tx_pulses[*pulse_idx - 1].gpioOff == off) {
+        tx_pulses[*pulse_idx - 1].usDelay += us;
     } else {
-        //transmit to all ports
-        for (int i = 0; i < 4; i++) {
-            gpio_pin |= (1 << tx_pins[i]);
+        tx_pulses[(*pulse_idx)++] = (PhyPulse){.gpioOn = on, .gpioOff = off, .usDelay = us};
+    }
+}
+
+//the frames of a queue on one port's pin, its half-bit slots run at the port's rate
+typedef struct {
+    uint32_t pin;
+    const uint8_t *bits;        //the queue's stuffed bit stream
+    int num_slots;
+    uint32_t half_us;
+    int slot;                   //next slot to put on the line
+    uint32_t next_us;           //when that slot starts, from the start of the wave
+} TxLine;
+
+//sync pulses are high for half a bit, low for a full bit, high for half a bit. The bit stream
+//follows in Manchester code: '1' is low then high, '0' is high then low
+static inline int line_level(const TxLine *line, int slot) {
+    if (slot < SYNC_SLOTS) {
+        return slot == 0 || slot == SYNC_SLOTS - 1;
+    }
+    slot -= SYNC_SLOTS;
+    int bit = (line->bits[slot >> 4] >> (7 - ((slot >> 1) & 7))) & 1;
+    return (slot & 1) ? bit : !bit;
+}
+
+//bit duration of a frame on a port
+static uint32_t line_bit_us(const TxRequest *req, int port) {
+    return req->bit_us ? req->bit_us : rate_ladder[port_states[port].rate_idx];
+}
+
+//whether a queue drives a port's pin
+static inline int queue_on_port(int queue, int port) {
+    return queue == port || queue == TX_BROADCAST;
+}
+
+//the frames of one queue in a batch
+typedef struct {
+    int queue;
+    int first;
+    int count;
+} TxRun;
+
+static int batch_runs(const TxInFlight *batch, TxRun runs[4]) {
+    int num_runs = 0;
+    for (int i = 0; i < batch->num_frames; i++) {
+        if (num_runs == 0 || runs[num_runs - 1].queue != batch->queues[i]) {
+            runs[num_runs++] = (TxRun){.queue = batch->queues[i], .first = i, .count = 0};
         }
+        runs[num_runs - 1].count++;
     }
+    return num_runs;
+}
 
-    //clear any existing waveforms we have 
-    wave_clear(gpio_handle);
+static FecMode port_fec(int port) {
+    return (FecMode)atomic_load_explicit(&port_states[port].fec_mode, memory_order_relaxed);
+}
 
-    //calculate checksum for error detection
-    uint8_t checksum = compute_checksum(data, len);
-    int total_bytes = len + 2; //the length byte + data bytes + checksum byte
+//bytes a frame of len bytes takes on a queue's pins, the most of any port for the broadcast queue
+static int queue_encoded_len(int queue, int len) {
+    int most = len;
+    for (int p = 0; p < 4; p++) {
+        if (queue_on_port(queue, p) && fec_encoded_len(port_fec(p), len) > most) {
+            most = fec_encoded_len(port_fec(p), len);
+        }
+    }
+    return most;
+}
 
-    int num_pulses = 3 + (16 * total_bytes);
+//the HDLC stream of a run: an opening flag, then each frame encoded, stuffed and closed by a
+//flag that also opens the next one
+static int build_run_bits(uint8_t *bits, const TxInFlight *batch, const TxRun *run, FecMode fec) {
+    int n = put_flag(bits, 0);
+    for (int i = run->first; i < run->first + run->count; i++) {
+        const Frame *frame = batch->reqs[i].frame;
+        int len = frame_len(frame) + 1 + LINK_FCS_SIZE;
+        if (fec == FEC_NONE) {
+            n = put_stuffed(bits, n, frame->data, len);
+        } else {
+            n = put_stuffed(bits, n, tx_coded, fec_encode(fec, frame->data, len, tx_coded));
+        }
+        n = put_flag(bits, n);
+    }
+    return n;
+}
 
-    gpioPulse_t pulses[num_pulses];
-    int pulse_idx = 0;
+//encode every queue of the batch on its own pins into tx_pulses, a broadcast run on every port at
+//each port's rate. Lines may run at different rates, so the wave steps through the union of their
+//slot boundaries. A pin whose frames are over goes back to idle high
+static int encode_batch(const TxInFlight *batch) {
+    TxLine lines[4];
+    TxRun runs[4];
+    uint32_t all_pins = 0;
+    int num_lines = 0;
 
-    //sync pulses
-    pulses[pulse_idx++] = (gpioPulse_t){.gpioOn = gpio_pin, .gpioOff = 0, .usDelay = BIT_DURATION_US / 2};
-    pulses[pulse_idx++] = (gpioPulse_t){.gpioOn = 0, .gpioOff = gpio_pin, .usDelay = BIT_DURATION_US};
-    pulses[pulse_idx++] = (gpioPulse_t){.gpioOn = gpio_pin, .gpioOff = 0, .usDelay = BIT_DURATION_US / 2};
+    int num_runs = batch_runs(batch, runs);
+    for (int r = 0; r < num_runs; r++) {
+        //every frame of a run goes at the same bit duration
+        const TxRequest *req = &batch->reqs[runs[r].first];
+        const uint8_t *bits = NULL;
+        int num_bits = 0;
+        FecMode bits_fec = FEC_NONE;
+        for (int p = 0; p < 4; p++) {
+            if (!queue_on_port(runs[r].queue, p)) continue;
+            //a broadcast run is encoded again for a port whose FEC differs from the one before
+            if (bits == NULL || port_fec(p) != bits_fec) {
+                bits_fec = port_fec(p);
+                num_bits = build_run_bits(tx_bits[num_lines], batch, &runs[r], bits_fec);
+                bits = tx_bits[num_lines];
+            }
+            lines[num_lines] = (TxLine){
+                .pin = 1u << tx_pins[p],
+                .bits = bits,
+                .num_slots = SYNC_SLOTS + 2 * num_bits,
+                .half_us = line_bit_us(req, p) / 2,
+            };
+            all_pins |= lines[num_lines++].pin;
+        }
+    }
 
-    printf("Transmitting data on link %d: ", ch);
+    int pulse_idx = 0;
+    uint32_t on = 0;
+    uint32_t now = 0;
+    uint32_t tail_us = 0;
+    for (;;) {
+        uint32_t next = UINT32_MAX;
+        for (int i = 0; i < num_lines; i++) {
+            TxLine *line = &lines[i];
+            if (line->next_us == now) {
+                int level = 1;
+                if (line->slot < line->num_slots) {
+                    level = line_level(line, line->slot++);
+                    line->next_us += line->half_us;
+                } else {
+                    line->next_us = UINT32_MAX;
+                    tail_us = line->half_us;
+                }
+                on = level ? (on | line->pin) : (on & ~line->pin);
+            }
+            if (line->next_us < next) next = line->next_us;
+        }
+        //the last line has finished, hold idle for two bits: a wave chained behind this one then
+        //starts with a gap no receiver takes for data, and they go back to hunting for the sync pattern
+        if (next == UINT32_MAX) {
+            add_slot(&pulse_idx, on, all_pins & ~on, 4 * tail_us);
+            break;
+        }
+        add_slot(&pulse_idx, on, all_pins & ~on, next - now);
+        now = next;
+    }
+    return pulse_idx;
+}
+
+//FNV-1a over what makes a single-frame wave unique
+static uint32_t wave_hash(uint32_t gpio_pin, const uint8_t *data, uint8_t len) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 4; i++) {
+        hash = (hash ^ ((gpio_pin >> (8 * i)) & 0xFF)) * 16777619u;
+    }
+    hash = (hash ^ len) * 16777619u;
     for (uint8_t i = 0; i < len; i++) {
-        printf("%02X ", data[i]);
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int wave_cache_find(uint32_t hash, uint32_t gpio_pin, const uint32_t bit_us[4], const uint8_t fec[4],
+                           const uint8_t *wire, uint8_t len) {
+    for (int i = 0; i < WAVE_CACHE_SIZE; i++) {
+        WaveCacheEntry *e = &wave_cache[i];
+        if (e->wave_id >= 0 && !e->stale && e->hash == hash && e->gpio_pin == gpio_pin && e->len == len &&
+            memcmp(e->bit_us, bit_us, sizeof(e->bit_us)) == 0 && memcmp(e->fec, fec, sizeof(e->fec)) == 0 &&
+            memcmp(e->data, wire, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//pick a free entry, or evict the least recently used wave that isn't in flight
+static int wave_cache_victim(void) {
+    int victim = -1;
+    for (int i = 0; i < WAVE_CACHE_SIZE; i++) {
+        WaveCacheEntry *e = &wave_cache[i];
+        if (e->wave_id < 0) return i;
+        if (e->refs == 0 && (victim < 0 || e->last_used < wave_cache[victim].last_used)) {
+            victim = i;
+        }
+    }
+    if (victim >= 0) {
+        phy_wave_delete(wave_cache[victim].wave_id);
+        wave_cache[victim].wave_id = -1;
+    }
+    return victim;
+}
+
+//a batch is done with its cached wave; a stale one goes once nothing uses it. Call with tx_lock held
+static void wave_cache_put(int idx) {
+    WaveCacheEntry *e = &wave_cache[idx];
+    if (--e->refs == 0 && e->stale) {
+        phy_wave_delete(e->wave_id);
+        e->wave_id = -1;
+        e->stale = 0;
+    }
+}
+
+//drop every cached wave; those still on the wire stay until their batches are done with them
+static void wave_cache_reset(void) {
+    for (int i = 0; i < WAVE_CACHE_SIZE; i++) {
+        WaveCacheEntry *e = &wave_cache[i];
+        if (e->wave_id < 0) continue;
+        if (e->refs > 0) {
+            e->stale = 1;
+        } else {
+            phy_wave_delete(e->wave_id);
+            e->wave_id = -1;
+        }
+    }
+}
+
+//get a wave for the batch: reuse a cached one for a repeated short frame, otherwise encode and upload
+static int build_wave(TxInFlight *batch) {
+    batch->cache_idx = -1;
+    const TxRequest *req = &batch->reqs[0];
+    const uint8_t *wire = req->frame->data;
+    int cacheable = (batch->num_frames == 1 && frame_len(req->frame) + 1 <= WAVE_CACHE_MAX_LEN + 1);
+    uint8_t wire_len = cacheable ? (uint8_t)(frame_len(req->frame) + 1) : 0;
+    uint32_t gpio_pin = queue_pins(batch->queues[0]);
+    uint32_t hash = 0;
+    //the same frame is a different wave once a port's rate or FEC has changed
+    uint32_t bit_us[4] = {0};
+    uint8_t fec[4] = {0};
+
+    if (cacheable) {
+        int num_lines = 0;
+        for (int p = 0; p < 4; p++) {
+            if (queue_on_port(batch->queues[0], p)) {
+                fec[num_lines] = (uint8_t)port_fec(p);
+                bit_us[num_lines++] = line_bit_us(req, p);
+            }
+        }
+        hash = wave_hash(gpio_pin, wire, wire_len);
+        int idx = wave_cache_find(hash, gpio_pin, bit_us, fec, wire, wire_len);
+        if (idx >= 0) {
+            wave_cache[idx].refs++;
+            wave_cache[idx].last_used = ++wave_cache_clock;
+            batch->cache_idx = idx;
+            return wave_cache[idx].wave_id;
+        }
+    }
+
+    int num_pulses = encode_batch(batch);
+    int wave_id = phy_wave_create(tx_pulses, num_pulses);
+    for (int i = 0; i < batch->num_frames; i++) {
+        TRACE(TRACE_TX_FRAME, batch->queues[i], frame_len(batch->reqs[i].frame), num_pulses, wave_id);
+    }
+    if (wave_id < 0 || !cacheable) {
+        return wave_id;
+    }
+
+    int idx = wave_cache_victim();
+    if (idx >= 0) {
+        WaveCacheEntry *e = &wave_cache[idx];
+        e->wave_id = wave_id;
+        e->hash = hash;
+        e->gpio_pin = gpio_pin;
+        memcpy(e->bit_us, bit_us, sizeof(e->bit_us));
+        memcpy(e->fec, fec, sizeof(e->fec));
+        e->len = wire_len;
+        memcpy(e->data, wire, wire_len);
+        e->last_used = ++wave_cache_clock;
+        e->refs = 1;
+        batch->cache_idx = idx;
+    }
+    return wave_id;
+}
+
+static void tx_pop(int queue, TxInFlight *batch) {
+    TxQueue *q = &tx_queues[queue];
+    batch->queues[batch->num_frames] = queue;
+    batch->reqs[batch->num_frames] = q->entries[q->head];
+    batch->num_frames++;
+    q->head = (q->head + 1) % TX_QUEUE_DEPTH;
+    q->count--;
+}
+
+//move a queue's head frame into the batch, and the frames behind it that fit the line budget
+//at the same bit duration, so they go out back to back behind one sync preamble
+static void tx_pop_run(int queue, TxInFlight *batch) {
+    TxQueue *q = &tx_queues[queue];
+    uint32_t bit_us = q->entries[q->head].bit_us;
+    int bits = 8;
+    for (int n = 0; n < TX_LINE_FRAMES && q->count > 0; n++) {
+        const TxRequest *req = &q->entries[q->head];
+        int frame_bits = STUFFED_BITS(queue_encoded_len(queue, frame_len(req->frame) + 1 + LINK_FCS_SIZE));
+        if (n > 0 && (req->bit_us != bit_us || bits + frame_bits > TX_LINE_BUDGET_BITS)) {
+            break;
+        }
+        bits += frame_bits;
+        tx_pop(queue, batch);
+    }
+}
+
+//take the next batch: the head frames of every port queue so all four links run in
+//parallel, or broadcast frames, alternating between the two when both are waiting
+static int tx_take_batch(TxInFlight *batch) {
+    int ports_waiting = 0;
+    for (int i = 0; i < 4; i++) {
+        ports_waiting |= tx_queues[i].count > 0;
+    }
+    int broadcast_waiting = tx_queues[TX_BROADCAST].count > 0;
+
+    batch->num_frames = 0;
+    if (broadcast_waiting && (!ports_waiting || tx_prefer_broadcast)) {
+        tx_pop_run(TX_BROADCAST, batch);
+        tx_prefer_broadcast = 0;
+    } else if (ports_waiting) {
+        for (int i = 0; i < 4; i++) {
+            if (tx_queues[i].count > 0) {
+                tx_pop_run(i, batch);
+            }
+        }
+        tx_prefer_broadcast = 1;
+    }
+    return batch->num_frames;
+}
+
+//queue a frame for a port or the broadcast queue, the queue takes over the caller's reference on success
+static int tx_enqueue(int queue, Frame *frame, uint32_t bit_us, tx_done_callback_t done, void *ctx) {
+    pthread_mutex_lock(&tx_lock);
+    TxQueue *q = &tx_queues[queue];
+    if (q->count == TX_QUEUE_DEPTH) {
+        pthread_mutex_unlock(&tx_lock);
+        for (int port = 0; port < 4; port++) {
+            if (queue_on_port(queue, port)) {
+                atomic_fetch_add_explicit(&tx_stats[port].drops, 1, memory_order_relaxed);
+            }
+        }
+        return -1;
+    }
+    TxRequest *req = &q->entries[(q->head + q->count) % TX_QUEUE_DEPTH];
+    req->frame = frame;
+    req->bit_us = bit_us;
+    req->done = done;
+    req->ctx = ctx;
+    req->queued_tick = tx_clock;
+    q->count++;
+    pthread_mutex_unlock(&tx_lock);
+    return 0;
+}
+
+void link_seal_frame_header(Frame *frame, uint16_t len, uint8_t header) {
+    frame->data[0] = header;
+    frame->len = len;
+    //CRC-16 over the header byte and the data
+    uint16_t fcs = ~fcs16(FCS16_INIT, frame->data, len + 1);
+    frame->data[len + 1] = fcs & 0xFF;
+    frame->data[len + 2] = fcs >> 8;
+}
+
+void link_seal_frame(Frame *frame, uint16_t len) {
+    link_seal_frame_header(frame, len, 0);
+}
+
+//copy data into a pool frame and queue it
+static int tx_copy(int queue, const uint8_t *data, uint16_t len, uint8_t header, uint32_t bit_us,
+                   tx_done_callback_t done, void *ctx) {
+    Frame *frame = frame_alloc();
+    if (frame == NULL) {
+        return -1;
+    }
+    memcpy(frame_payload(frame), data, len);
+    link_seal_frame_header(frame, len, header);
+    if (tx_enqueue(queue, frame, bit_us, done, ctx) != 0) {
+        frame_release(frame);
+        return -1;
+    }
+    return 0;
+}
+
+//queue a frame, the caller never waits for the wire
+int manchester_transmit_async(int ch, const uint8_t *data, uint16_t len, tx_done_callback_t done, void *ctx) {
+    if (len > LINK_MAX_DATA) {
+        return -1;
+    }
+    int queue = (ch >= 0 && ch < 4) ? ch : TX_BROADCAST;
+    return tx_copy(queue, data, len, 0, 0, done, ctx);
+}
+
+//queue a pool frame as it is, nothing is copied
+int link_transmit_frame(int ch, Frame *frame, tx_done_callback_t done, void *ctx) {
+    int queue = (ch >= 0 && ch < 4) ? ch : TX_BROADCAST;
+    frame_ref(frame);
+    if (tx_enqueue(queue, frame, 0, done, ctx) != 0) {
+        frame_release(frame);
+        return -1;
+    }
+    return 0;
+}
+
+//function to transmit data using Manchester encoding over the network
+int manchester_transmit(int ch, uint8_t *data, uint16_t len) {
+    return manchester_transmit_async(ch, data, len, NULL, NULL);
+}
+
+//rungs from the base bit duration down to the fastest rate worth trying
+static void build_rate_ladder(void) {
+    uint32_t us = bit_duration_us;
+    num_rates = 0;
+    do {
+        rate_ladder[num_rates++] = us;
+        us = us * 3 / 4;
+    } while (num_rates < LINK_RATE_STEPS && us >= LINK_MIN_BIT_US);
+}
+
+//stop probing a port and keep the rate it has, call with tx_lock held
+static void rate_settle(int ch) {
+    ChannelState *ch_state = &port_states[ch];
+    ch_state->rate_state = RATE_IDLE;
+    TRACE(TRACE_RATE_SETTLED, ch, rate_ladder[ch_state->rate_idx]);
+}
+
+//start probing the next rung, or settle if this is already the fastest, call with tx_lock held
+static void rate_probe_next(int ch) {
+    ChannelState *ch_state = &port_states[ch];
+    if (ch_state->rate_idx + 1 >= num_rates) {
+        rate_settle(ch);
+        return;
+    }
+    ch_state->probe_idx = ch_state->rate_idx + 1;
+    ch_state->probe_seq = 0;
+    ch_state->rate_state = RATE_PROBE_SEND;
+    TRACE(TRACE_RATE_PROBE, ch, rate_ladder[ch_state->probe_idx]);
+}
+
+//a probe has left the wire: queue the next one, or start waiting for the peer's report
+static void probe_sent(int ch, int status, void *ctx) {
+    (void)ctx;
+    pthread_mutex_lock(&tx_lock);
+    ChannelState *ch_state = &port_states[ch];
+    if (ch_state->rate_state == RATE_PROBE_SENT) {
+        if (status < 0) {
+            rate_settle(ch);
+        } else if (++ch_state->probe_seq < LINK_PROBE_COUNT) {
+            ch_state->rate_state = RATE_PROBE_SEND;
+        } else {
+            ch_state->rate_state = RATE_PROBE_WAIT;
+            ch_state->probe_deadline = phy_tick() + LINK_REPORT_TIMEOUT_BITS * bit_duration_us;
+        }
+    }
+    pthread_mutex_unlock(&tx_lock);
+}
+
+//the peer counted the probes of a rung: take the rung and try the next one if they all arrived
+static void rate_report(int ch, uint8_t idx, uint8_t received) {
+    pthread_mutex_lock(&tx_lock);
+    ChannelState *ch_state = &port_states[ch];
+    if (ch_state->rate_state != RATE_IDLE && idx == ch_state->probe_idx) {
+        TRACE(TRACE_RATE_REPORT, ch, received, LINK_PROBE_COUNT, rate_ladder[idx]);
+        if (received + LINK_PROBE_MAX_LOSS >= LINK_PROBE_COUNT) {
+            ch_state->rate_idx = idx;
+            rate_probe_next(ch);
+        } else {
+            rate_settle(ch);
+        }
+    }
+    pthread_mutex_unlock(&tx_lock);
+}
+
+//the peer sees errors climbing: give up on a probe, or step down one rung
+static void rate_degraded(int ch) {
+    pthread_mutex_lock(&tx_lock);
+    ChannelState *ch_state = &port_states[ch];
+    if (ch_state->rate_state != RATE_IDLE) {
+        //the errors came from the rung being probed
+        rate_settle(ch);
+    } else if (ch_state->rate_idx > 0) {
+        ch_state->rate_idx--;
+        TRACE(TRACE_RATE_FALLBACK, ch, rate_ladder[ch_state->rate_idx]);
+    }
+    pthread_mutex_unlock(&tx_lock);
+}
+
+//queue the probes that are due and give up on reports that never came
+static void rate_poll(uint32_t now) {
+    uint8_t probes[4][3 + LINK_PROBE_PATTERN];
+    uint32_t probe_us[4];
+    int probe_ports[4];
+    int num_probes = 0;
+
+    pthread_mutex_lock(&tx_lock);
+    for (int ch = 0; ch < 4; ch++) {
+        ChannelState *ch_state = &port_states[ch];
+        if (ch_state->rate_state == RATE_PROBE_SEND) {
+            uint8_t *msg = probes[num_probes];
+            msg[0] = LINK_CTRL_PROBE;
+            msg[1] = ch_state->probe_idx;
+            msg[2] = ch_state->probe_seq;
+            for (int i = 0; i < LINK_PROBE_PATTERN; i++) {
+                msg[3 + i] = probe_pattern[i % sizeof(probe_pattern)];
+            }
+            probe_us[num_probes] = rate_ladder[ch_state->probe_idx];
+            probe_ports[num_probes++] = ch;
+            ch_state->rate_state = RATE_PROBE_SENT;
+        } else if (ch_state->rate_state == RATE_PROBE_WAIT && (int32_t)(now - ch_state->probe_deadline) > 0) {
+            rate_settle(ch);
+        }
+    }
+    pthread_mutex_unlock(&tx_lock);
+
+    for (int i = 0; i < num_probes; i++) {
+        int ch = probe_ports[i];
+        if (tx_copy(ch, probes[i], sizeof(probes[i]), LINK_CTRL_FLAG, probe_us[i], probe_sent, NULL) != 0) {
+            //the port queue or the frame pool is full, try again on the next poll
+            pthread_mutex_lock(&tx_lock);
+            if (port_states[ch].rate_state == RATE_PROBE_SENT) {
+                port_states[ch].rate_state = RATE_PROBE_SEND;
+            }
+            pthread_mutex_unlock(&tx_lock);
+        }
     }
-    printf("Checksum: %02X\n", checksum);
+}
+
+void link_negotiate(int ch) {
+    pthread_mutex_lock(&tx_lock);
+    for (int i = 0; i < 4; i++) {
+        if (ch < 0 || ch == i) {
+            rate_probe_next(i);
+        }
+    }
+    pthread_mutex_unlock(&tx_lock);
+}
 
-    for (int i = 0; i < total_bytes; i++) {
-        uint8_t byte_data;
-        if (i == 0) {
-            byte_data = len; 
-        } else if (i == total_bytes - 1) {
-            byte_data = checksum; //the checksum byte
+int link_negotiation_pending(void) {
+    int pending = 0;
+    pthread_mutex_lock(&tx_lock);
+    for (int i = 0; i < 4; i++) {
+        pending += port_states[i].rate_state != RATE_IDLE;
+    }
+    pthread_mutex_unlock(&tx_lock);
+    return pending;
+}
+
+uint32_t get_port_bit_duration(int ch) {
+    if (ch < 0 || ch >= 4) {
+        return bit_duration_us;
+    }
+    pthread_mutex_lock(&tx_lock);
+    uint32_t us = rate_ladder[port_states[ch].rate_idx];
+    pthread_mutex_unlock(&tx_lock);
+    return us;
+}
+
+//move the TX engine forward: retire finished waves and start queued ones
+//count a frame that is done with on every port it went out on
+static void tx_account(int queue, const TxRequest *req, int status, uint32_t now) {
+    for (int port = 0; port < 4; port++) {
+        if (!queue_on_port(queue, port)) continue;
+        TxStats *stats = &tx_stats[port];
+        if (status == 0) {
+            atomic_fetch_add_explicit(&stats->frames, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&stats->bytes, frame_len(req->frame), memory_order_relaxed);
+            hist_record(&stats->latency_us, now - req->queued_tick);
         } else {
-            byte_data = data[i - 1]; //the data bytes
+            atomic_fetch_add_explicit(&stats->errors, 1, memory_order_relaxed);
         }
-        printf("Transmitting byte %d: 0x%02X\n", i, byte_data);
-        for (int bit = 7; bit >= 0; bit--) {
-            uint8_t bit_val = (byte_data >> bit) & 1;
-            printf("Bit %d: %d\n", bit, bit_val);
+    }
+}
+
+void link_tx_poll(void) {
+    TxInFlight finished[TX_MAX_IN_FLIGHT + 1];
+    int num_finished = 0;
 
-            if (bit_val == 1) {
-                //transmit '1' bits (Manchester encoding)
-                pulses[pulse_idx++] = (gpioPulse_t){.gpioOn = 0, .gpioOff = gpio_pin, .usDelay = BIT_DURATION_US / 2};
-                pulses[pulse_idx++] = (gpioPulse_t){.gpioOn = gpio_pin, .gpioOff = 0, .usDelay = BIT_DURATION_US / 2};
+    pthread_mutex_lock(&tx_lock);
+    //one read of the clock a poll, a round trip to pigpiod on the hardware
+    uint32_t now = phy_tick();
+    tx_clock = now;
+
+    //retire waves the generator is done with
+    if (num_in_flight > 0) {
+        if (!phy_wave_tx_busy()) {
+            for (int i = 0; i < num_in_flight; i++) {
+                finished[num_finished++] = in_flight[i];
+            }
+            num_in_flight = 0;
+        } else if (num_in_flight == 2 && phy_wave_tx_at() == in_flight[1].wave_id) {
+            finished[num_finished++] = in_flight[0];
+            in_flight[0] = in_flight[1];
+            num_in_flight = 1;
+        }
+    }
+
+    //keep one wave on the wire and one chained behind it so frames go out back to back
+    while (num_in_flight < TX_MAX_IN_FLIGHT && num_finished < TX_MAX_IN_FLIGHT + 1) {
+        TxInFlight next;
+        if (tx_take_batch(&next) == 0) break;
+
+        next.wave_id = build_wave(&next);
+        if (next.wave_id >= 0 && num_in_flight == 1 && next.wave_id == in_flight[0].wave_id) {
+            //the same cached wave can't be told apart from itself by wave_tx_at, so send it once
+            //the generator is idle; it goes back to the front of the batch order for the next poll
+            if (next.cache_idx >= 0) {
+                wave_cache_put(next.cache_idx);
             } else {
-                //transmit '0' bits
-                pulses[pulse_idx++] = (gpioPulse_t){.gpioOn = gpio_pin, .gpioOff = 0, .usDelay = BIT_DURATION_US / 2};
-                pulses[pulse_idx++] = (gpioPulse_t){.gpioOn = 0, .gpioOff = gpio_pin, .usDelay = BIT_DURATION_US / 2};
+                phy_wave_delete(next.wave_id);
             }
+            for (int i = next.num_frames - 1; i >= 0; i--) {
+                TxQueue *q = &tx_queues[next.queues[i]];
+                q->head = (q->head + TX_QUEUE_DEPTH - 1) % TX_QUEUE_DEPTH;
+                q->entries[q->head] = next.reqs[i];
+                q->count++;
+            }
+            break;
+        }
+        int rc = -1;
+        if (next.wave_id >= 0) {
+            rc = (num_in_flight == 0) ? phy_wave_send_once(next.wave_id) : phy_wave_send_sync(next.wave_id);
+        }
+        if (rc < 0) {
+            //could not be sent, report it straight away
+            next.status = -1;
+            finished[num_finished++] = next;
+            continue;
+        }
+        next.status = 0;
+        in_flight[num_in_flight++] = next;
+    }
+
+    //cached waves stay uploaded, the rest are deleted
+    for (int i = 0; i < num_finished; i++) {
+        if (finished[i].cache_idx >= 0) {
+            wave_cache_put(finished[i].cache_idx);
+        } else if (finished[i].wave_id >= 0) {
+            phy_wave_delete(finished[i].wave_id);
         }
     }
 
-    printf("Total pulses: %d\n", pulse_idx);
+    pthread_mutex_unlock(&tx_lock);
+
+    //completion callbacks run without the lock so they can queue more frames
+    for (int i = 0; i < num_finished; i++) {
+        for (int j = 0; j < finished[i].num_frames; j++) {
+            TxRequest *req = &finished[i].reqs[j];
+            tx_account(finished[i].queues[j], req, finished[i].status, now);
+            if (req->done != NULL) {
+                req->done(queue_channel(finished[i].queues[j]), finished[i].status, req->ctx);
+            }
+            frame_release(req->frame);
+        }
+    }
 
-    wave_add_generic(gpio_handle, pulse_idx, pulses);
+    rate_poll(now);
 
-    int wave_id = wave_create(gpio_handle);
-    printf("Wave ID: %d\n", wave_id);
-    wave_send_once(gpio_handle, wave_id);
-    usleep(BIT_DURATION_US * (2 + (8 * total_bytes) + 2));
+    tx_poll_callback_t poll_handler = atomic_load_explicit(&tx_poll_handler, memory_order_acquire);
+    if (poll_handler != NULL) {
+        poll_handler();
+    }
 }
 
-void print_callback(uint8_t* msg, int ch) {
-    uint8_t msg_len = msg[0]; //the number of data bytes
+int link_tx_pending(void) {
+    pthread_mutex_lock(&tx_lock);
+    int pending = num_in_flight;
+    for (int i = 0; i < TX_NUM_QUEUES; i++) {
+        pending += tx_queues[i].count;
+    }
+    pthread_mutex_unlock(&tx_lock);
+    return pending;
+}
 
+void link_tx_flush(void) {
+    link_tx_poll();
+    while (link_tx_pending() > 0) {
+        phy_sleep_us(TX_POLL_US);
+        link_tx_poll();
+    }
+}
+
+//the TX engine thread does the waiting so the application thread never has to
+static void *tx_thread_main(void *arg) {
+    (void)arg;
+    while (atomic_load(&tx_thread_running)) {
+        link_tx_poll();
+        phy_sleep_us(TX_POLL_US);
+    }
+    return NULL;
+}
+
+int link_tx_start(void) {
+    if (atomic_load(&tx_thread_running)) return 0;
+    atomic_store(&tx_thread_running, 1);
+    if (pthread_create(&tx_thread, NULL, tx_thread_main, NULL) != 0) {
+        atomic_store(&tx_thread_running, 0);
+        return 1;
+    }
+    return 0;
+}
+
+void link_tx_stop(void) {
+    if (!atomic_load(&tx_thread_running)) return;
+    atomic_store(&tx_thread_running, 0);
+    pthread_join(tx_thread, NULL);
+}
+
+//an RX worker sleeps until a port it owns has frames, then runs the handlers for them
+static void *rx_worker_main(void *arg) {
+    int worker = (int)(intptr_t)arg;
+    int num_workers = num_rx_workers;
+    while (atomic_load_explicit(&rx_workers_running, memory_order_acquire)) {
+        sem_wait(&rx_wake[worker]);
+        for (int ch = worker; ch < 4; ch += num_workers) {
+            rx_ring_drain(ch);
+        }
+    }
+    return NULL;
+}
+
+//stop the workers, num_started of which are running, once no edge callback can reach their rings
+static void rx_workers_shutdown(int num_started) {
+    //frames completed from now on are delivered on the edge callback again
+    atomic_store(&rx_workers_running, 0);
+    while (atomic_load(&rx_pushing) > 0) {
+        sched_yield();
+    }
+    for (int i = 0; i < num_started; i++) {
+        sem_post(&rx_wake[i]);
+    }
+    for (int i = 0; i < num_started; i++) {
+        pthread_join(rx_workers[i], NULL);
+    }
+    for (int i = 0; i < num_rx_workers; i++) {
+        sem_destroy(&rx_wake[i]);
+    }
+    //what the workers left behind is delivered here
+    for (int ch = 0; ch < 4; ch++) {
+        rx_ring_drain(ch);
+    }
+    num_rx_workers = 0;
+}
+
+int link_rx_start(int num_workers) {
+    if (atomic_load(&rx_workers_running)) return 0;
+    if (num_workers < 1) num_workers = 1;
+    if (num_workers > RX_MAX_WORKERS) num_workers = RX_MAX_WORKERS;
+
+    num_rx_workers = num_workers;
+    for (int i = 0; i < num_workers; i++) {
+        sem_init(&rx_wake[i], 0, 0);
+    }
+    atomic_store(&rx_workers_running, 1);
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&rx_workers[i], NULL, rx_worker_main, (void *)(intptr_t)i) != 0) {
+            rx_workers_shutdown(i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void link_rx_stop(void) {
+    if (!atomic_load(&rx_workers_running)) return;
+    rx_workers_shutdown(num_rx_workers);
+}
+
+void link_rx_queue_stats(int ch, LinkRxQueueStats *stats) {
+    RxRing *ring = &rx_rings[ch];
+    stats->depth = atomic_load_explicit(&ring->tail, memory_order_acquire) -
+                   atomic_load_explicit(&ring->head, memory_order_acquire);
+    stats->max_depth = atomic_load_explicit(&ring->max_depth, memory_order_relaxed);
+    stats->delivered = atomic_load_explicit(&ring->delivered, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    stats->overflows = atomic_load_explicit(&ring->overflows, memory_order_relaxed);
+}
+
+int link_set_fec(int ch, FecMode mode) {
+    if (ch < 0 || ch > 3 || (int)mode < 0 || (int)mode >= FEC_NUM_MODES) {
+        return -1;
+    }
+    //under the TX lock a wave is never half encoded in the old mode and half in the new one
+    pthread_mutex_lock(&tx_lock);
+    atomic_store_explicit(&port_states[ch].fec_mode, (uint8_t)mode, memory_order_relaxed);
+    pthread_mutex_unlock(&tx_lock);
+    return 0;
+}
+
+FecMode link_get_fec(int ch) {
+    return port_fec(ch);
+}
+
+void link_fec_stats(int ch, LinkFecStats *stats) {
+    ChannelState *ch_state = &port_states[ch];
+    stats->frames = atomic_load_explicit(&ch_state->fec_frames, memory_order_relaxed);
+    stats->corrected = atomic_load_explicit(&ch_state->fec_corrected, memory_order_relaxed);
+    stats->uncorrectable = atomic_load_explicit(&ch_state->fec_uncorrectable, memory_order_relaxed);
+}
+
+void link_get_stats(int ch, LinkStats *stats) {
+    ChannelState *ch_state = &port_states[ch];
+    TxStats *tx = &tx_stats[ch];
+    stats->bit_us = get_port_bit_duration(ch);
+    stats->rx_bit_us = ch_state->margin;
+    stats->tx_frames = atomic_load_explicit(&tx->frames, memory_order_relaxed);
+    stats->tx_bytes = atomic_load_explicit(&tx->bytes, memory_order_relaxed);
+    stats->tx_errors = atomic_load_explicit(&tx->errors, memory_order_relaxed);
+    stats->tx_drops = atomic_load_explicit(&tx->drops, memory_order_relaxed);
+    stats->rx_frames = atomic_load_explicit(&ch_state->rx_frames, memory_order_relaxed);
+    stats->rx_bytes = atomic_load_explicit(&ch_state->rx_bytes, memory_order_relaxed);
+    stats->rx_fcs_errors = atomic_load_explicit(&ch_state->rx_fcs_errors, memory_order_relaxed);
+    stats->rx_aborts = atomic_load_explicit(&ch_state->rx_aborts, memory_order_relaxed);
+    stats->rx_timing_errors = atomic_load_explicit(&ch_state->rx_timing_errors, memory_order_relaxed);
+    stats->rx_sync_losses = atomic_load_explicit(&ch_state->rx_sync_losses, memory_order_relaxed);
+    stats->rx_drops = atomic_load_explicit(&rx_rings[ch].dropped, memory_order_relaxed);
+    stats->rx_queue_drops = atomic_load_explicit(&rx_rings[ch].overflows, memory_order_relaxed);
+    hist_snapshot(&ch_state->edge_us, &stats->edge_us);
+    hist_snapshot(&tx->latency_us, &stats->tx_latency_us);
+    hist_snapshot(&ch_state->rx_latency_us, &stats->rx_latency_us);
+}
+
+void print_callback(uint8_t *data, uint16_t len, int ch) {
     printf("\nOn Port: %d Received: ", ch);
-    for (int i = 1; i <= msg_len; i++) {
-        printf("%c", msg[i]);
+    for (int i = 0; i < len; i++) {
+        printf("%c", data[i]);
     }
     printf("\n");
     fflush(stdout);
 }
 
-int main() {
+void set_msg_callback(msg_callback_t callback) {
+    user_msg_handler = callback;
+}
+
+void set_frame_callback(frame_callback_t callback) {
+    user_frame_handler = callback;
+}
+
+void set_tx_poll_callback(tx_poll_callback_t callback) {
+    atomic_store_explicit(&tx_poll_handler, callback, memory_order_release);
+}
+
+void set_arq_callback(frame_callback_t callback) {
+    arq_handler = callback;
+}
+
+void reset_channel_state(int ch) {
+    if (ch >= 0 && ch < 4) {
+        reset_channel(&port_states[ch]);
+    }
+}
+
+//every port back to the base rate, negotiation starts over
+static void reset_rates(void) {
+    build_rate_ladder();
+    for (int i = 0; i < 4; i++) {
+        port_states[i].rate_idx = 0;
+        port_states[i].rate_state = RATE_IDLE;
+        port_states[i].probe_rx_mask = 0;
+        port_states[i].rx_errors = 0;
+        port_states[i].rx_good = 0;
+        port_states[i].margin = bit_duration_us;
+        reset_channel(&port_states[i]);
+    }
+}
+
+void set_bit_duration(uint32_t us) {
+    pthread_mutex_lock(&tx_lock);
+    bit_duration_us = us;
+    //cached waves were built for the old duration
+    wave_cache_reset();
+    reset_rates();
+    pthread_mutex_unlock(&tx_lock);
+}
+
+uint32_t get_bit_duration(void) {
+    return bit_duration_us;
+}
+
+int initialize_link_layer() {
+    if (phy_start() != 0) {
+        return 1;
+    }
+    init_stuff_table();
+    //a restarted PHY has forgotten every uploaded wave, and the frames queued or on the wire
+    //before it are dropped; their done callbacks belong to the previous run and aren't called
+    pthread_mutex_lock(&tx_lock);
+    tx_clock = phy_tick();
+    for (int i = 0; i < WAVE_CACHE_SIZE; i++) {
+        wave_cache[i].wave_id = -1;
+        wave_cache[i].refs = 0;
+        wave_cache[i].stale = 0;
+    }
+    for (int i = 0; i < num_in_flight; i++) {
+        for (int j = 0; j < in_flight[i].num_frames; j++) {
+            frame_release(in_flight[i].reqs[j].frame);
+        }
+    }
+    num_in_flight = 0;
+    for (int i = 0; i < TX_NUM_QUEUES; i++) {
+        TxQueue *q = &tx_queues[i];
+        for (; q->count > 0; q->count--) {
+            frame_release(q->entries[q->head].frame);
+            q->head = (q->head + 1) % TX_QUEUE_DEPTH;
+        }
+        q->head = 0;
+    }
+    pthread_mutex_unlock(&tx_lock);
+    reset_rates();
+
+    for (int i = 0; i < 4; i++) {
+        TRACE(TRACE_PORT_INIT, i, rx_pins[i], tx_pins[i]);
+        atomic_store(&rx_rings[i].max_depth, 0);
+        atomic_store(&rx_rings[i].delivered, 0);
+        atomic_store(&rx_rings[i].dropped, 0);
+        atomic_store(&rx_rings[i].overflows, 0);
+        atomic_store(&port_states[i].fec_frames, 0);
+        atomic_store(&port_states[i].fec_corrected, 0);
+        atomic_store(&port_states[i].fec_uncorrectable, 0);
+        atomic_store(&port_states[i].rx_frames, 0);
+        atomic_store(&port_states[i].rx_bytes, 0);
+        atomic_store(&port_states[i].rx_fcs_errors, 0);
+        atomic_store(&port_states[i].rx_aborts, 0);
+        atomic_store(&port_states[i].rx_timing_errors, 0);
+        atomic_store(&port_states[i].rx_sync_losses, 0);
+        hist_clear(&port_states[i].edge_us);
+        hist_clear(&port_states[i].rx_latency_us);
+        atomic_store(&tx_stats[i].frames, 0);
+        atomic_store(&tx_stats[i].bytes, 0);
+        atomic_store(&tx_stats[i].errors, 0);
+        atomic_store(&tx_stats[i].drops, 0);
+        hist_clear(&tx_stats[i].latency_us);
+        phy_set_mode(rx_pins[i], PHY_INPUT);    //set RX pin as input
+        phy_set_mode(tx_pins[i], PHY_OUTPUT);   //set TX pin as output
+        phy_write(tx_pins[i], 1);               //set TX pin high
+        phy_callback(rx_pins[i], rx_callback);  //set up callback for RX pin
+    }
+    return 0;
+}
+
+void link_rx_edge(unsigned gpio, unsigned level, uint32_t tick) {
+    rx_callback(gpio, level, tick);
+}
+
+int link_capture_start(const char *path) {
+    EdgeCaptureInfo info = {.bit_us = bit_duration_us};
+    for (int i = 0; i < 4; i++) {
+        info.rx_gpio[i] = (uint8_t)rx_pins[i];
+        info.fec[i] = (uint8_t)link_get_fec(i);
+    }
+    //the simulated wire plays edges out faster than real time, it can wait for the capture instead
+    return edge_capture_start(path, &info, phy_get_backend() == &phy_sim_backend);
+}
+
+#ifndef LINK_LAYER_NO_MAIN
+int main(int argc, char *argv[]) {
     printf("Starting program\n");
-    gpio_handle = pigpio_start(NULL, NULL);
-    if (gpio_handle < 0) {
-        fprintf(stderr, "Failed to start pigpio\n");
+
+    //--sim runs the stack over a simulated wire with every port looped back to itself
+    int simulated = (argc > 1 && strcmp(argv[1], "--sim") == 0);
+    if (simulated) {
+        phy_set_backend(&phy_sim_backend);
+    }
+
+    //KAN_TRACE_FILE=<path> records binary traces for traceDecode, otherwise they are printed
+    if (trace_start(getenv("KAN_TRACE_FILE")) != 0) {
         return 1;
     }
-    printf("pigpio started with handle %d\n", gpio_handle);
 
     user_msg_handler = print_callback;
+    printf("Using %s PHY\n", phy_get_backend()->name);
+    if (initialize_link_layer() != 0) {
+        return 1;
+    }
+    //KAN_EDGE_CAPTURE=<path> records every edge the receiver sees for edgeReplay
+    if (getenv("KAN_EDGE_CAPTURE") != NULL && link_capture_start(getenv("KAN_EDGE_CAPTURE")) != 0) {
+        return 1;
+    }
+    if (simulated) {
+        for (int i = 0; i < 4; i++) {
+            phy_sim_connect(tx_pins[i], rx_pins[i], NULL);
+        }
+    } else if (link_tx_start() != 0 || link_rx_start(1) != 0) {
+        fprintf(stderr, "Failed to start TX engine or RX worker\n");
+        return 1;
+    }
+    phy_sleep_us(100000);
+
+    //bring every link up at the fastest rate it carries
+    link_negotiate(-1);
+    while (link_negotiation_pending() > 0) {
+        if (simulated) {
+            link_tx_poll();
+        }
+        phy_sleep_us(TX_POLL_US);
+    }
     for (int i = 0; i < 4; i++) {
-        printf("Initializing port %d: rx_pin=%d, tx_pin=%d\n", i, rx_pins[i], tx_pins[i]);
-        reset_channel(&port_states[i]);
-        set_mode(gpio_handle, rx_pins[i], PI_INPUT);   //set RX pin as input
-        set_mode(gpio_handle, tx_pins[i], PI_OUTPUT);  //set TX pin as output
-        gpio_write(gpio_handle, tx_pins[i], 1);        //set TX pin high
-        callback(gpio_handle, rx_pins[i], EITHER_EDGE, rx_callback); //set up callback for RX pin
+        printf("Port %d: %u us per bit\n", i, get_port_bit_duration(i));
     }
-    usleep(100000);
 
     while (1) {
         char input_buf[128];
@@ -289,7 +1766,10 @@ int main() {
 
         printf("Sent: %s\n", input_buf);
 
-        manchester_transmit(-1, (uint8_t*)&input_buf[0], len);
+        if (manchester_transmit(-1, (uint8_t*)&input_buf[0], len) != 0) {
+            printf("TX queue full or message too long, dropped\n");
+            continue;
+        }
         printf("Broadcasted: "); 
         for (int i = 0; i < len; i++) {
             printf("%c", input_buf[i]);
@@ -297,10 +1777,19 @@ int main() {
         printf("\n");
         fflush(stdout); 
 
-        usleep(100000);
+        if (simulated) {
+            //nothing else advances virtual time, so play the frame out here
+            link_tx_flush();
+            phy_sim_run();
+        }
     }
 
-    printf("Stopping pigpio\n");
-    pigpio_stop(gpio_handle);
+    link_tx_stop();
+    link_rx_stop();
+    printf("Stopping PHY\n");
+    phy_stop();
+    edge_capture_stop();
+    trace_stop();
     return 0;
 }
+#endif // LINK_LAYER_NO_MAIN
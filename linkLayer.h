@@ -2,13 +2,38 @@
 #define LINK_LAYER_H
 
 #include <stdint.h>
+#include "fcs.h"
+#include "fec.h"
+#include "framePool.h"
+#include "histogram.h"
 
 //constants
-#define BUFFER_SIZE 128
-#define BIT_DURATION_US 5000
+#define LINK_MAX_DATA 1500                              //data bytes in one frame
+#define LINK_FCS_SIZE FCS16_SIZE                        //CRC-16 after the data
+#define BUFFER_SIZE (1 + LINK_MAX_DATA + LINK_FCS_SIZE) //header byte, data and FCS
+#define LINK_FLAG 0x7E                                  //opens and closes every frame, never seen inside one
+#define LINK_HDR_ARQ 0x40                               //set in the header byte of frames for the ARQ layer, see linkArq.h
+#define LINK_HDR_BATCH 0x20                             //set in the header byte of frames carrying several network packets back to back
+#ifndef BIT_DURATION_US
+#define BIT_DURATION_US 5000    //default bit duration, see set_bit_duration
+#endif
 
-//function pointer for message callback
-typedef void (*msg_callback_t)(uint8_t* msg, int ch);
+//GPIO pins of each port
+extern int rx_pins[4];
+extern int tx_pins[4];
+
+//function pointer for message callback, data is only valid during the call
+typedef void (*msg_callback_t)(uint8_t *data, uint16_t len, int ch);
+
+//function pointer for frame callback, the link layer drops its reference when the call returns;
+//take one with frame_ref to keep the frame or pass it on
+typedef void (*frame_callback_t)(Frame *frame, int ch);
+
+//function pointer for transmit completion, status is 0 once the frame has left the wire, negative if it could not be sent
+typedef void (*tx_done_callback_t)(int ch, int status, void *ctx);
+
+//called after every poll of the TX engine, for timers of the layers above
+typedef void (*tx_poll_callback_t)(void);
 
 /**
  * @brief initialize link layer, set up GPIOs and callbacks
@@ -16,6 +41,39 @@ typedef void (*msg_callback_t)(uint8_t* msg, int ch);
  */
 int initialize_link_layer();
 
+/**
+ * @brief set the base bit duration: the rate every port starts at before negotiation, and the
+ * slowest rung of the rate ladder; resets every port to it, call while nothing is being sent
+ * @param us the bit duration in microseconds
+ */
+void set_bit_duration(uint32_t us);
+
+/**
+ * @brief get the base bit duration
+ * @return the bit duration in microseconds
+ */
+uint32_t get_bit_duration(void);
+
+/**
+ * @brief start the link bring-up handshake: probe faster rates on the port one rung at a time
+ * and keep the fastest one the peer received every probe of. The peer must be running the
+ * link layer too; a port falls back a rung on its own when the peer reports errors climbing
+ * @param ch the index of the channel (0-3) or -1 for every channel
+ */
+void link_negotiate(int ch);
+
+/**
+ * @brief number of ports still probing, the TX engine has to be polled for them to finish
+ */
+int link_negotiation_pending(void);
+
+/**
+ * @brief get the bit duration a port transmits at
+ * @param ch the index of the channel (0-3)
+ * @return the bit duration in microseconds
+ */
+uint32_t get_port_bit_duration(int ch);
+
 /**
  * @brief reset the state of the specified channel
  * @param ch index of the channel to reset (0-3) 
@@ -29,26 +87,207 @@ void reset_channel_state(int ch);
 void set_msg_callback(msg_callback_t callback);
 
 /**
- * @brief transmit a message using Manchester encoding on a specific channel
+ * @brief set the callback that gets received frames straight from the frame pool, used instead of
+ * the message callback when set
+ * @param callback the function pointer for the callback (NULL to go back to the message callback)
+ */
+void set_frame_callback(frame_callback_t callback);
+
+/**
+ * @brief set the callback that gets received frames with LINK_HDR_ARQ in their header byte, they
+ * never go to the message or frame callbacks
+ * @param callback the function pointer for the callback (NULL drops such frames)
+ */
+void set_arq_callback(frame_callback_t callback);
+
+/**
+ * @brief set the callback run at the end of every link_tx_poll, on whichever thread polls, without
+ * the TX engine's lock held so it can queue frames
+ * @param callback the function pointer for the callback (NULL for none)
+ */
+void set_tx_poll_callback(tx_poll_callback_t callback);
+
+/**
+ * @brief queue a message for transmission using Manchester encoding on a specific channel, returns without waiting for the wire
  * @param ch the index of the channel (0-3) or -1 to broadcast to all channels 
- * @param data pointer to the data to be transmitted
+ * @param data pointer to the data to be transmitted (copied)
+ * @param len the length of the data to be transmitted (at most LINK_MAX_DATA)
+ * @return 0 if queued, -1 if the queue is full or the message too long
+ */
+int manchester_transmit(int ch, uint8_t *data, uint16_t len);
+
+/**
+ * @brief like manchester_transmit, but calls done once the frame has been sent
+ * @param ch the index of the channel (0-3) or -1 to broadcast to all channels 
+ * @param data pointer to the data to be transmitted (copied)
  * @param len the length of the data to be transmitted
+ * @param done completion callback, called from the thread running link_tx_poll (may be NULL)
+ * @param ctx passed through to done
+ * @return 0 if queued, -1 if the queue is full or the message too long
+ */
+int manchester_transmit_async(int ch, const uint8_t *data, uint16_t len, tx_done_callback_t done, void *ctx);
+
+/**
+ * @brief queue a pool frame for transmission without copying it, e.g. to forward a received frame
+ * to another port. The frame is sent as it is, it must have been received or sealed
+ * @param ch the index of the channel (0-3) or -1 to broadcast to all channels
+ * @param frame the frame, a reference is held until it has been sent
+ * @param done completion callback (may be NULL)
+ * @param ctx passed through to done
+ * @return 0 if queued, -1 if the queue is full
+ */
+int link_transmit_frame(int ch, Frame *frame, tx_done_callback_t done, void *ctx);
+
+/**
+ * @brief set the length, header byte and FCS of a frame built in the pool
+ * @param frame the frame, its data already written to frame_payload
+ * @param len the number of data bytes (at most LINK_MAX_DATA)
+ */
+void link_seal_frame(Frame *frame, uint16_t len);
+
+/**
+ * @brief like link_seal_frame, with a header byte for the layers that use it
+ * @param frame the frame, its data already written to frame_payload
+ * @param len the number of data bytes (at most LINK_MAX_DATA)
+ * @param header the header byte, e.g. LINK_HDR_ARQ and its control bits
+ */
+void link_seal_frame_header(Frame *frame, uint16_t len, uint8_t header);
+
+/**
+ * @brief move the TX engine forward without blocking: retire sent waves, start queued frames
+ */
+void link_tx_poll(void);
+
+/**
+ * @brief number of frames queued or on the wire
+ */
+int link_tx_pending(void);
+
+/**
+ * @brief poll the TX engine until every queued frame has been sent (blocks the caller)
+ */
+void link_tx_flush(void);
+
+/**
+ * @brief start the TX engine thread that polls in the background
+ * @return 0 on success, non-zero if failed
  */
-void manchester_transmit(int ch, uint8_t *data, uint8_t len);
+int link_tx_start(void);
+
+/**
+ * @brief stop the TX engine thread
+ */
+void link_tx_stop(void);
+
+/**
+ * @brief start the RX workers: from then on the edge callbacks only decode and queue complete
+ * frames on a per-port ring, and the workers run the message handlers. Without workers the
+ * handlers run on the edge callback
+ * @param num_workers number of worker threads (1-4), port ch is drained by worker ch % num_workers
+ * @return 0 on success, non-zero if failed
+ */
+int link_rx_start(int num_workers);
+
+/**
+ * @brief stop the RX workers, frames still queued are delivered by the caller
+ */
+void link_rx_stop(void);
+
+//counters of a port's RX queue
+typedef struct {
+    uint32_t depth;         //frames waiting for the worker now
+    uint32_t max_depth;     //most frames that were ever waiting
+    uint64_t delivered;     //frames handed to the handlers by the worker
+    uint64_t dropped;       //frames lost because the queue or the frame pool was full
+    uint64_t overflows;     //of those, frames the full queue turned away
+} LinkRxQueueStats;
 
 /**
- * @brief compute the checksum for the given data 
- * @param data pointer to the data
- * @param len the length of the data array
- * @return the computed checksum.
+ * @brief read the counters of a port's RX queue
+ * @param ch the index of the channel (0-3)
+ * @param stats filled in
+ */
+void link_rx_queue_stats(int ch, LinkRxQueueStats *stats);
+
+/**
+ * @brief set the forward error correction of a port, for the frames it sends and receives. Both
+ * ends of the cable have to use the same mode, frames sent while they differ are lost
+ * @param ch the index of the channel (0-3)
+ * @param mode FEC_NONE, FEC_SECDED or FEC_RS
+ * @return 0 on success, -1 if ch or mode is out of range
+ */
+int link_set_fec(int ch, FecMode mode);
+
+/**
+ * @brief the forward error correction of a port
+ */
+FecMode link_get_fec(int ch);
+
+//counters of a port's FEC decoder
+typedef struct {
+    uint64_t frames;        //frames decoded
+    uint64_t corrected;     //bits (SECDED) or bytes (RS) put right
+    uint64_t uncorrectable; //codewords or blocks that had too many errors, their frames were dropped
+} LinkFecStats;
+
+/**
+ * @brief read the counters of a port's FEC decoder
+ * @param ch the index of the channel (0-3)
+ * @param stats filled in
+ */
+void link_fec_stats(int ch, LinkFecStats *stats);
+
+//counters and distributions of a port, to judge the health of its cable under load
+typedef struct {
+    uint32_t bit_us;            //bit duration the port sends at
+    uint32_t rx_bit_us;         //bit duration the receiver recovered from the peer's last good frame
+    uint64_t tx_frames;         //frames that left the wire, broadcast ones count on every port
+    uint64_t tx_bytes;          //their data bytes
+    uint64_t tx_errors;         //frames the PHY could not send
+    uint64_t tx_drops;          //frames refused because the port's TX queue was full
+    uint64_t rx_frames;         //frames received with a good FCS, link control included
+    uint64_t rx_bytes;          //their data bytes
+    uint64_t rx_fcs_errors;     //frames dropped for a bad FCS
+    uint64_t rx_aborts;         //frames given up on: too long, an abort sequence or a broken closing flag
+    uint64_t rx_timing_errors;  //frames lost to an edge that fit no Manchester timing
+    uint64_t rx_sync_losses;    //times bit sync was lost before a frame started, a false sync or a garbled preamble
+    uint64_t rx_drops;          //good frames lost because the RX queue or the frame pool was full
+    uint64_t rx_queue_drops;    //of those, frames the full RX queue turned away
+    HistSnapshot edge_us;       //gap between edges, peaks at the half and full bit time show the peer's clock
+    HistSnapshot tx_latency_us; //from queueing a frame to it having left the wire, to a TX poll
+    HistSnapshot rx_latency_us; //from a frame's opening flag to its handler being called, to the port's latest edge
+} LinkStats;
+
+/**
+ * @brief take a snapshot of a port's counters, they count from initialize_link_layer
+ * @param ch the index of the channel (0-3)
+ * @param stats filled in
+ */
+void link_get_stats(int ch, LinkStats *stats);
+
+/**
+ * @brief hand an edge to the receive decoder as if the PHY had reported it, to replay captured
+ * edges. The edges of a port must come in order and from one thread at a time
+ * @param gpio the RX pin
+ * @param level the level after the edge
+ * @param tick the time of the edge in microseconds
+ */
+void link_rx_edge(unsigned gpio, unsigned level, uint32_t tick);
+
+/**
+ * @brief capture every edge the receiver sees into a file for edgeReplay, with the base rate
+ * and the ports' FEC modes as they are now; edge_capture_stop ends it
+ * @param path the capture file to write
+ * @return 0 on success, non-zero if failed
  */
-uint8_t compute_checksum(uint8_t *data, uint8_t len);
+int link_capture_start(const char *path);
 
 /**
  * @brief print the received message for debugging purposes
- * @param msg the message data
+ * @param data the message data
+ * @param len number of data bytes
  * @param ch the channel index from which the message was received
  */
-void print_callback(uint8_t* msg, int ch);
+void print_callback(uint8_t *data, uint16_t len, int ch);
 
 #endif // LINK_LAYER_H
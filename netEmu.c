@@ -0,0 +1,731 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "forwardEngine.h"
+#include "linkLayer.h"
+#include "netEmu.h"
+#include "networkLayer.h"
+#include "routingTable.h"
+
+//the shortest frame there is, a one byte advert: header byte, packet header, advert, FCS and the
+//flag closing it. Sets how far ahead a partition may run of the others
+#define EMU_MIN_FRAME_BITS ((1 + NETWORK_HEADER_SIZE + 1 + LINK_FCS_SIZE + 1) * 8)
+
+_Static_assert(EMU_MAX_HOPS == NETWORK_TTL, "looping packets have to be dropped where the network layer drops them");
+
+typedef enum {
+    EMU_BOOT,       //the node starts its routing daemon
+    EMU_TICK,       //the routing daemon's timers
+    EMU_SEND,       //the node's traffic sends a packet
+    EMU_TX_DONE,    //a frame has left a port
+    EMU_ARRIVE      //a frame has arrived on a port
+} EmuEventKind;
+
+//a packet on its way: data packets only carry their header, adverts their bytes too
+typedef struct {
+    uint64_t sent_us;
+    uint8_t src;
+    uint8_t dest;           //NETWORK_ADDR_ROUTING for an advert to the neighbour
+    uint8_t hops;           //links crossed
+    uint8_t len;            //data bytes
+    uint8_t ad[DV_AD_MAX_SIZE];
+} EmuPacket;
+
+typedef struct {
+    uint64_t at_us;
+    uint64_t order;         //node that scheduled it and its count there, so events at the same time run
+                            //in the same order however the nodes are split over partitions
+    uint16_t node;
+    uint8_t kind;
+    uint8_t port;
+    EmuPacket packet;
+} EmuEvent;
+
+typedef struct {
+    EmuEvent *events;
+    int count;
+    int room;
+} EmuEventList;
+
+typedef struct {
+    EmuPacket packets[FWD_QUEUE_DEPTH];
+    int head;
+    int count;
+} EmuQueue;
+
+//a port and the cable on it; adverts go first, like the forwarding engine's control queue
+typedef struct {
+    int peer;               //node at the other end, -1 if there is no cable
+    int peer_port;
+    EmuLinkConfig link;
+    EmuQueue control;
+    EmuQueue data;
+    int busy;
+    uint64_t last_arrival_us;
+    uint64_t busy_us;
+} EmuPort;
+
+typedef struct {
+    uint64_t offered;
+    uint64_t delivered;
+    uint64_t delivered_bytes;
+    uint64_t hops;
+    uint64_t no_route;
+    uint64_t queue_drops;
+    uint64_t wire_losses;
+    uint64_t looped;
+    uint64_t frames;
+    uint64_t adverts;
+    uint64_t advert_bytes;
+} EmuCounters;
+
+struct EmuPartition;
+
+typedef struct {
+    int index;
+    uint8_t address;
+    struct EmuPartition *part;  //the partition running the node
+    DvRouter router;
+    FibEntry fib[ROUTE_NUM_ADDRESSES];
+    EmuPort ports[4];
+    uint64_t random;
+    uint64_t order;
+    uint64_t routes_changed_us;
+    EmuCounters counters;
+} EmuNode;
+
+//the nodes one thread runs: their events, and frames for the other partitions' nodes held back
+//until the window ends
+typedef struct EmuPartition {
+    int index;
+    EmuEventList heap;          //a binary heap on (at_us, order)
+    EmuEventList outbox[EMU_MAX_THREADS];
+    uint64_t now_us;
+    uint64_t next_us;           //first event after taking in the outboxes, read by every partition
+    uint64_t events;
+    Histogram latency;
+    pthread_t thread;
+} EmuPartition;
+
+static EmuNode *nodes;
+static int num_nodes;
+static DvConfig dv_config;
+static EmuTraffic traffic;
+static int booted;
+static uint64_t now_us;
+
+static EmuPartition *partitions;
+static int num_partitions;
+static uint64_t lookahead_us;
+static uint64_t run_until_us;
+static uint64_t windows;
+static pthread_barrier_t window_barrier;
+//the threads wait here until all of them have been created, or are told to give up
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int start_state;         //0 while threads are being created, 1 to run, -1 to give up
+//of partitions gone when the nodes were split again
+static uint64_t past_events;
+static HistSnapshot past_latency;
+
+static uint64_t next_random(EmuNode *node) {
+    //xorshift64*
+    uint64_t x = node->random;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    node->random = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static double random_unit(EmuNode *node) {
+    return (next_random(node) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static uint32_t now_ms(const EmuNode *node) {
+    return (uint32_t)(node->part->now_us / 1000);
+}
+
+static int event_before(const EmuEvent *a, const EmuEvent *b) {
+    return a->at_us < b->at_us || (a->at_us == b->at_us && a->order < b->order);
+}
+
+static void list_push(EmuEventList *list, const EmuEvent *event) {
+    if (list->count == list->room) {
+        int room = list->room ? list->room * 2 : 256;
+        EmuEvent *grown = realloc(list->events, room * sizeof(EmuEvent));
+        if (grown == NULL) {
+            abort();
+        }
+        list->events = grown;
+        list->room = room;
+    }
+    list->events[list->count++] = *event;
+}
+
+static void heap_push(EmuEventList *heap, const EmuEvent *event) {
+    list_push(heap, event);
+    EmuEvent *events = heap->events;
+    int i = heap->count - 1;
+    while (i > 0 && event_before(event, &events[(i - 1) / 2])) {
+        events[i] = events[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    events[i] = *event;
+}
+
+static void heap_pop(EmuEventList *heap, EmuEvent *top) {
+    EmuEvent *events = heap->events;
+    *top = events[0];
+    EmuEvent *last = &events[--heap->count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count && event_before(&events[child + 1], &events[child])) child++;
+        if (!event_before(&events[child], last)) break;
+        events[i] = events[child];
+        i = child;
+    }
+    if (heap->count > 0) events[i] = *last;
+}
+
+//schedule an event for a node; one in another partition waits in the outbox for the window to end
+static void schedule(EmuNode *from, EmuEventKind kind, uint64_t at_us, int node, int port, const EmuPacket *packet) {
+    EmuEvent event = {.at_us = at_us, .order = (uint64_t)from->index << 48 | from->order++, .node = (uint16_t)node,
+                      .kind = (uint8_t)kind, .port = (uint8_t)port};
+    if (packet != NULL) {
+        event.packet = *packet;
+    }
+    EmuPartition *part = from->part;
+    EmuPartition *owner = nodes[node].part;
+    if (owner == part) {
+        heap_push(&part->heap, &event);
+    } else {
+        list_push(&part->outbox[owner->index], &event);
+    }
+}
+
+//put the next queued frame on the wire; a frame sent back to back with the last one shares its wave
+static void start_tx(EmuNode *node, int p, int back_to_back) {
+    EmuPort *port = &node->ports[p];
+    EmuQueue *queue = (port->control.count > 0) ? &port->control : &port->data;
+    if (port->busy || queue->count == 0) {
+        return;
+    }
+    EmuPacket packet = queue->packets[queue->head];
+    queue->head = (queue->head + 1) % FWD_QUEUE_DEPTH;
+    queue->count--;
+
+    uint64_t now = node->part->now_us;
+    uint64_t bits = (uint64_t)(1 + NETWORK_HEADER_SIZE + packet.len + LINK_FCS_SIZE + 1) * 8;
+    if (!back_to_back) bits += EMU_SYNC_BITS;
+    uint64_t done_us = now + bits * port->link.bit_us;
+    port->busy = 1;
+    port->busy_us += done_us - now;
+    node->counters.frames++;
+    schedule(node, EMU_TX_DONE, done_us, node->index, p, NULL);
+
+    //one wrong bit and the FCS throws the frame away
+    if (port->link.bit_error_rate > 0 && random_unit(node) >= exp((double)bits * log1p(-port->link.bit_error_rate))) {
+        node->counters.wire_losses++;
+        return;
+    }
+    uint64_t at_us = done_us + port->link.delay_us;
+    if (port->link.jitter_us > 0) {
+        at_us += next_random(node) % (port->link.jitter_us + 1);
+    }
+    //a cable never reorders frames
+    if (at_us < port->last_arrival_us) at_us = port->last_arrival_us;
+    port->last_arrival_us = at_us;
+    schedule(node, EMU_ARRIVE, at_us, port->peer, port->peer_port, &packet);
+}
+
+static void enqueue(EmuNode *node, int p, EmuQueue *queue, const EmuPacket *packet) {
+    if (queue->count == FWD_QUEUE_DEPTH) {
+        node->counters.queue_drops++;
+        return;
+    }
+    queue->packets[(queue->head + queue->count) % FWD_QUEUE_DEPTH] = *packet;
+    queue->count++;
+    start_tx(node, p, 0);
+}
+
+//a packet whose destination has several ports goes out of one picked by hashing its source and
+//destination, so a flow stays in order, as the network layer does for ports of the same rate
+static int flow_port(uint8_t src, uint8_t dest, uint8_t ports) {
+    uint32_t hash = ((uint32_t)src << 8 | dest) * 0x9E3779B1u;
+    int pick = (int)((hash ^ hash >> 16) % (uint32_t)__builtin_popcount(ports));
+    for (int p = 0; p < 4; p++) {
+        if ((ports & (1 << p)) && pick-- == 0) {
+            return p;
+        }
+    }
+    return ROUTE_NO_PORT;
+}
+
+static void route_packet(EmuNode *node, const EmuPacket *packet) {
+    if (packet->hops >= EMU_MAX_HOPS) {
+        node->counters.looped++;
+        return;
+    }
+    uint8_t ports = FIB_PORTS(node->fib[packet->dest]);
+    if (ports == 0) {
+        node->counters.no_route++;
+        return;
+    }
+    int p = flow_port(packet->src, packet->dest, ports);
+    enqueue(node, p, &node->ports[p].data, packet);
+}
+
+static void send_advert(void *ctx, int port, const uint8_t *ad, int len) {
+    EmuNode *node = ctx;
+    EmuPacket packet = {.sent_us = node->part->now_us, .src = node->address, .dest = NETWORK_ADDR_ROUTING,
+                        .len = (uint8_t)len};
+    memcpy(packet.ad, ad, len);
+    node->counters.adverts++;
+    node->counters.advert_bytes += len;
+    enqueue(node, port, &node->ports[port].control, &packet);
+}
+
+static void route_changed(void *ctx, uint8_t dest, int port, uint8_t ports, uint8_t metric) {
+    EmuNode *node = ctx;
+    node->fib[dest] = (port == ROUTE_NO_PORT) ? 0 : fib_make_entry(ports, metric);
+    node->routes_changed_us = node->part->now_us;
+}
+
+static uint64_t next_send_us(EmuNode *node, uint64_t from_us) {
+    //exponential gaps, so the packets of every node together arrive as a Poisson process
+    double gap_s = -log(1.0 - random_unit(node)) / traffic.packets_per_s;
+    return from_us + 1 + (uint64_t)(gap_s * 1e6);
+}
+
+static void handle(EmuPartition *part, EmuEvent *event) {
+    EmuNode *node = &nodes[event->node];
+    uint64_t now = part->now_us;
+    switch (event->kind) {
+    case EMU_BOOT:
+        dv_start(&node->router, now_ms(node));
+        schedule(node, EMU_TICK, now + ROUTING_TICK_MS * 1000, node->index, 0, NULL);
+        if (traffic.packets_per_s > 0 && num_nodes > 1) {
+            uint64_t start = traffic.start_us > now ? traffic.start_us : now;
+            schedule(node, EMU_SEND, next_send_us(node, start), node->index, 0, NULL);
+        }
+        break;
+    case EMU_TICK:
+        dv_tick(&node->router, now_ms(node));
+        schedule(node, EMU_TICK, now + ROUTING_TICK_MS * 1000, node->index, 0, NULL);
+        break;
+    case EMU_SEND: {
+        int dest = (int)(next_random(node) % (uint64_t)(num_nodes - 1));
+        if (dest >= node->index) dest++;
+        EmuPacket packet = {.sent_us = now, .src = node->address, .dest = nodes[dest].address,
+                            .len = (uint8_t)traffic.packet_len};
+        node->counters.offered++;
+        route_packet(node, &packet);
+        schedule(node, EMU_SEND, next_send_us(node, now), node->index, 0, NULL);
+        break;
+    }
+    case EMU_TX_DONE:
+        node->ports[event->port].busy = 0;
+        start_tx(node, event->port, 1);
+        break;
+    case EMU_ARRIVE: {
+        EmuPacket *packet = &event->packet;
+        packet->hops++;
+        if (packet->dest == NETWORK_ADDR_ROUTING) {
+            dv_receive(&node->router, event->port, packet->ad, packet->len, now_ms(node));
+        } else if (packet->dest == node->address) {
+            uint64_t latency = now - packet->sent_us;
+            hist_record_owned(&part->latency, latency > UINT32_MAX ? UINT32_MAX : (uint32_t)latency);
+            node->counters.delivered++;
+            node->counters.delivered_bytes += packet->len;
+            node->counters.hops += packet->hops;
+        } else {
+            route_packet(node, packet);
+        }
+        break;
+    }
+    }
+}
+
+static int wait_for_start(void) {
+    pthread_mutex_lock(&start_lock);
+    while (start_state == 0) {
+        pthread_cond_wait(&start_cond, &start_lock);
+    }
+    int state = start_state;
+    pthread_mutex_unlock(&start_lock);
+    return state;
+}
+
+static void set_start(int state) {
+    pthread_mutex_lock(&start_lock);
+    start_state = state;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&start_lock);
+}
+
+static void *partition_main(void *arg) {
+    EmuPartition *part = arg;
+    if (wait_for_start() < 0) {
+        return NULL;
+    }
+    for (;;) {
+        //take in the frames the other partitions sent here in the last window
+        for (int q = 0; q < num_partitions; q++) {
+            EmuEventList *inbox = &partitions[q].outbox[part->index];
+            for (int i = 0; i < inbox->count; i++) {
+                heap_push(&part->heap, &inbox->events[i]);
+            }
+            inbox->count = 0;
+        }
+        part->next_us = (part->heap.count > 0) ? part->heap.events[0].at_us : UINT64_MAX;
+        pthread_barrier_wait(&window_barrier);
+
+        //every partition works out the same window: nothing sent in it can arrive in another
+        //partition before it ends
+        uint64_t next_us = UINT64_MAX;
+        for (int q = 0; q < num_partitions; q++) {
+            if (partitions[q].next_us < next_us) next_us = partitions[q].next_us;
+        }
+        if (next_us >= run_until_us) {
+            break;
+        }
+        uint64_t end_us = (run_until_us - next_us > lookahead_us) ? next_us + lookahead_us : run_until_us;
+        if (part->index == 0) windows++;
+
+        while (part->heap.count > 0 && part->heap.events[0].at_us < end_us) {
+            EmuEvent event;
+            heap_pop(&part->heap, &event);
+            part->now_us = event.at_us;
+            part->events++;
+            handle(part, &event);
+        }
+        pthread_barrier_wait(&window_barrier);
+    }
+    part->now_us = run_until_us;
+    return NULL;
+}
+
+static void add_snapshot(HistSnapshot *sum, const HistSnapshot *snap) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        sum->counts[i] += snap->counts[i];
+    }
+    sum->total += snap->total;
+    sum->sum += snap->sum;
+}
+
+static void free_partitions(EmuEventList *keep) {
+    for (int p = 0; p < num_partitions; p++) {
+        EmuPartition *part = &partitions[p];
+        for (int i = 0; i < part->heap.count; i++) {
+            if (keep != NULL) list_push(keep, &part->heap.events[i]);
+        }
+        free(part->heap.events);
+        for (int q = 0; q < EMU_MAX_THREADS; q++) {
+            free(part->outbox[q].events);
+        }
+        past_events += part->events;
+        HistSnapshot snap;
+        hist_snapshot(&part->latency, &snap);
+        add_snapshot(&past_latency, &snap);
+    }
+    free(partitions);
+    partitions = NULL;
+    num_partitions = 0;
+}
+
+//split the nodes into partitions of neighbours, in the order a breadth-first walk over the
+//cables reaches them, and move every pending event to its node's partition
+static int split_nodes(int count) {
+    EmuEventList pending = {0};
+    free_partitions(&pending);
+    partitions = calloc(count, sizeof(EmuPartition));
+    int *order = malloc(num_nodes * sizeof(int));
+    char *seen = calloc(num_nodes, 1);
+    if (partitions == NULL || order == NULL || seen == NULL) {
+        free(pending.events);
+        free(order);
+        free(seen);
+        return 1;
+    }
+    num_partitions = count;
+    for (int p = 0; p < count; p++) {
+        partitions[p].index = p;
+        partitions[p].now_us = now_us;
+        hist_clear(&partitions[p].latency);
+    }
+
+    int tail = 0;
+    for (int root = 0; root < num_nodes; root++) {
+        if (seen[root]) continue;
+        int head = tail;
+        seen[root] = 1;
+        order[tail++] = root;
+        while (head < tail) {
+            EmuNode *node = &nodes[order[head++]];
+            for (int p = 0; p < 4; p++) {
+                int peer = node->ports[p].peer;
+                if (peer >= 0 && !seen[peer]) {
+                    seen[peer] = 1;
+                    order[tail++] = peer;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < num_nodes; i++) {
+        nodes[order[i]].part = &partitions[(int64_t)i * count / num_nodes];
+    }
+    free(order);
+    free(seen);
+
+    //the soonest a frame sent on a cable between two partitions can arrive
+    lookahead_us = UINT64_MAX;
+    for (int i = 0; i < num_nodes; i++) {
+        for (int p = 0; p < 4; p++) {
+            EmuPort *port = &nodes[i].ports[p];
+            if (port->peer >= 0 && nodes[port->peer].part != nodes[i].part) {
+                uint64_t soonest = (uint64_t)EMU_MIN_FRAME_BITS * port->link.bit_us + port->link.delay_us;
+                if (soonest < lookahead_us) lookahead_us = soonest;
+            }
+        }
+    }
+    if (lookahead_us == 0) lookahead_us = 1;
+
+    for (int i = 0; i < pending.count; i++) {
+        heap_push(&nodes[pending.events[i].node].part->heap, &pending.events[i]);
+    }
+    free(pending.events);
+    return 0;
+}
+
+static uint64_t splitmix(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+int emu_init(int num, const DvConfig *dv, uint64_t seed) {
+    emu_free();
+    if (num < 1 || num > EMU_MAX_NODES) {
+        return 1;
+    }
+    nodes = calloc(num, sizeof(EmuNode));
+    if (nodes == NULL) {
+        return 1;
+    }
+    num_nodes = num;
+    dv_config = *dv;
+    memset(&traffic, 0, sizeof(traffic));
+    for (int i = 0; i < num; i++) {
+        EmuNode *node = &nodes[i];
+        node->index = i;
+        node->address = (uint8_t)(i + 1);
+        node->random = splitmix(&seed) | 1;
+        for (int p = 0; p < 4; p++) {
+            node->ports[p].peer = -1;
+        }
+    }
+    return 0;
+}
+
+int emu_connect(int a, int b, const EmuLinkConfig *link) {
+    if (booted || a < 0 || b < 0 || a >= num_nodes || b >= num_nodes || a == b) {
+        return -1;
+    }
+    int pa = 0, pb = 0;
+    while (pa < 4 && nodes[a].ports[pa].peer >= 0) pa++;
+    while (pb < 4 && nodes[b].ports[pb].peer >= 0) pb++;
+    if (pa == 4 || pb == 4) {
+        return -1;
+    }
+    nodes[a].ports[pa].peer = b;
+    nodes[a].ports[pa].peer_port = pb;
+    nodes[a].ports[pa].link = *link;
+    nodes[b].ports[pb].peer = a;
+    nodes[b].ports[pb].peer_port = pa;
+    nodes[b].ports[pb].link = *link;
+    return 0;
+}
+
+int emu_build(EmuTopology topology, const EmuLinkConfig *link) {
+    int rc = 0;
+    switch (topology) {
+    case EMU_LINE:
+    case EMU_RING:
+        for (int i = 0; i + 1 < num_nodes; i++) rc |= emu_connect(i, i + 1, link);
+        if (topology == EMU_RING && num_nodes > 2) rc |= emu_connect(num_nodes - 1, 0, link);
+        break;
+    case EMU_MESH: {
+        int width = 1;
+        while (width * width < num_nodes) width++;
+        for (int i = 0; i < num_nodes; i++) {
+            if (i % width + 1 < width && i + 1 < num_nodes) rc |= emu_connect(i, i + 1, link);
+            if (i + width < num_nodes) rc |= emu_connect(i, i + width, link);
+        }
+        break;
+    }
+    case EMU_TREE:
+        for (int i = 1; i < num_nodes; i++) rc |= emu_connect((i - 1) / 3, i, link);
+        break;
+    }
+    return rc;
+}
+
+int emu_parse_topology(const char *name, EmuTopology *topology) {
+    static const char *names[] = {"line", "ring", "mesh", "tree"};
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *topology = (EmuTopology)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void emu_set_traffic(const EmuTraffic *t) {
+    traffic = *t;
+    if (traffic.packet_len > MAX_PACKET_SIZE) traffic.packet_len = MAX_PACKET_SIZE;
+}
+
+int emu_run(uint64_t until_us, int num_threads) {
+    if (nodes == NULL) {
+        return 1;
+    }
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > EMU_MAX_THREADS) num_threads = EMU_MAX_THREADS;
+    if (num_threads > num_nodes) num_threads = num_nodes;
+    if (num_threads != num_partitions && split_nodes(num_threads) != 0) {
+        return 1;
+    }
+    if (!booted) {
+        booted = 1;
+        for (int i = 0; i < num_nodes; i++) {
+            EmuNode *node = &nodes[i];
+            DvConfig config = dv_config;
+            config.port_mask = 0;
+            for (int p = 0; p < 4; p++) {
+                if (node->ports[p].peer >= 0) config.port_mask |= 1 << p;
+            }
+            dv_init(&node->router, node->address, &config, send_advert, route_changed, node);
+            schedule(node, EMU_BOOT, now_us, i, 0, NULL);
+        }
+    }
+    if (until_us <= now_us) {
+        return 0;
+    }
+
+    run_until_us = until_us;
+    if (pthread_barrier_init(&window_barrier, NULL, num_partitions) != 0) {
+        return 1;
+    }
+    start_state = 0;
+    int started = 1;
+    for (; started < num_partitions; started++) {
+        if (pthread_create(&partitions[started].thread, NULL, partition_main, &partitions[started]) != 0) {
+            break;
+        }
+    }
+    //every partition has to be running for the windows to end, so all of them start or none
+    set_start(started == num_partitions ? 1 : -1);
+    if (started == num_partitions) {
+        partition_main(&partitions[0]);
+    }
+    for (int p = 1; p < started; p++) {
+        pthread_join(partitions[p].thread, NULL);
+    }
+    pthread_barrier_destroy(&window_barrier);
+    if (started < num_partitions) {
+        return 1;
+    }
+    now_us = until_us;
+    return 0;
+}
+
+void emu_get_stats(EmuStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->now_us = now_us;
+    stats->windows = windows;
+    stats->events = past_events;
+    stats->latency_us = past_latency;
+    for (int p = 0; p < num_partitions; p++) {
+        stats->events += partitions[p].events;
+        HistSnapshot snap;
+        hist_snapshot(&partitions[p].latency, &snap);
+        add_snapshot(&stats->latency_us, &snap);
+    }
+    int cabled = 0;
+    for (int i = 0; i < num_nodes; i++) {
+        EmuNode *node = &nodes[i];
+        EmuCounters *c = &node->counters;
+        stats->offered += c->offered;
+        stats->delivered += c->delivered;
+        stats->delivered_bytes += c->delivered_bytes;
+        stats->hops += c->hops;
+        stats->no_route += c->no_route;
+        stats->queue_drops += c->queue_drops;
+        stats->wire_losses += c->wire_losses;
+        stats->looped += c->looped;
+        stats->frames += c->frames;
+        stats->adverts += c->adverts;
+        stats->advert_bytes += c->advert_bytes;
+        if (node->routes_changed_us > stats->routes_changed_us) stats->routes_changed_us = node->routes_changed_us;
+        for (int p = 0; p < 4; p++) {
+            EmuPort *port = &node->ports[p];
+            if (port->peer < 0 || now_us == 0) continue;
+            double busy = (double)port->busy_us / now_us;
+            stats->link_busy += busy;
+            if (busy > stats->max_link_busy) stats->max_link_busy = busy;
+            cabled++;
+        }
+    }
+    if (cabled > 0) stats->link_busy /= cabled;
+}
+
+int emu_converged(void) {
+    int *dist = malloc(num_nodes * sizeof(int));
+    int *queue = malloc(num_nodes * sizeof(int));
+    int converged = (dist != NULL && queue != NULL);
+    for (int s = 0; s < num_nodes && converged; s++) {
+        int head = 0, tail = 0;
+        for (int i = 0; i < num_nodes; i++) dist[i] = DV_INFINITY;
+        dist[s] = 0;
+        queue[tail++] = s;
+        while (head < tail) {
+            int n = queue[head++];
+            for (int p = 0; p < 4; p++) {
+                int peer = nodes[n].ports[p].peer;
+                if (peer >= 0 && dist[peer] == DV_INFINITY && dist[n] + 1 < DV_INFINITY) {
+                    dist[peer] = dist[n] + 1;
+                    queue[tail++] = peer;
+                }
+            }
+        }
+        for (int t = 0; t < num_nodes; t++) {
+            DvRoute *route = &nodes[s].router.routes[nodes[t].address];
+            int reachable = route->in_use && route->metric < DV_INFINITY;
+            if (dist[t] < DV_INFINITY ? (!reachable || route->metric != dist[t]) : reachable) {
+                converged = 0;
+                break;
+            }
+        }
+    }
+    free(dist);
+    free(queue);
+    return converged;
+}
+
+void emu_free(void) {
+    free_partitions(NULL);
+    free(nodes);
+    nodes = NULL;
+    num_nodes = 0;
+    booted = 0;
+    now_us = 0;
+    windows = 0;
+    past_events = 0;
+    memset(&past_latency, 0, sizeof(past_latency));
+}
@@ -0,0 +1,132 @@
+#ifndef NET_EMU_H
+#define NET_EMU_H
+
+#include <stdint.h>
+#include "distanceVector.h"
+#include "histogram.h"
+
+//a model of a network of KAN nodes in one process, in virtual time. It is not the stack: only the
+//routing daemon (a DvRouter, the same code the network layer runs) and the forwarding table are
+//shared. The rest is modelled. Each port has two FIFO egress queues, adverts first, not the
+//forwarding engine, so there is no DRR, RED or batching. No frame goes through the link layer's
+//codec, FCS or receive_packet; the TTL is only mirrored by EMU_MAX_HOPS. Its numbers show how the
+//routing and the load behave at scale; kanBench e2e and batch measure the stack's own code paths.
+//Every node has its own address and four ports. Links are modelled per frame, like bench/benchRouting.c:
+//a frame takes its bits times the bit duration on the wire, then the cable's delay, and is lost
+//with the probability its bits give at the cable's bit error rate, as the FCS would throw it away.
+//A discrete-event scheduler runs the nodes; with several threads the topology is cut into
+//partitions of neighbouring nodes and each thread runs one, in windows as long as the shortest
+//time a frame can take to cross between two partitions. The results don't depend on the threads
+#define EMU_MAX_NODES 254       //addresses 1-254, node i has address i + 1
+#define EMU_MAX_THREADS 64
+#define EMU_MAX_HOPS 32         //NETWORK_TTL: a packet caught in a routing loop is dropped after this many links
+#define EMU_SYNC_BITS 12        //sync preamble, opening flag and idle tail of a wave, in bit times
+
+typedef enum {
+    EMU_LINE,       //each node cabled to the next
+    EMU_RING,       //a line closed into a ring
+    EMU_MESH,       //a square grid, every node cabled to its up to four neighbours
+    EMU_TREE        //a tree, every node cabled to its parent and up to three children
+} EmuTopology;
+
+//one cable, the same both ways
+typedef struct {
+    uint32_t bit_us;            //bit duration on the cable
+    uint32_t delay_us;          //propagation delay
+    uint32_t jitter_us;         //extra delay, uniform up to this; frames still arrive in order
+    double bit_error_rate;      //a frame with any wrong bit is lost
+} EmuLinkConfig;
+
+//traffic every node offers: packets to destinations picked at random among the other nodes
+typedef struct {
+    double packets_per_s;       //per node, sent at random intervals (Poisson), 0 for none
+    uint16_t packet_len;        //data bytes, up to MAX_PACKET_SIZE
+    uint64_t start_us;          //traffic starts here, the routes have the time before to converge
+} EmuTraffic;
+
+typedef struct {
+    uint64_t now_us;            //virtual time reached
+    uint64_t events;            //handled by the scheduler
+    uint64_t windows;           //times the partitions synchronized
+    uint64_t routes_changed_us; //last time any node's best route changed
+    uint64_t adverts;           //routing adverts sent
+    uint64_t advert_bytes;
+    uint64_t offered;           //packets the traffic sent
+    uint64_t delivered;         //packets that reached their destination
+    uint64_t delivered_bytes;
+    uint64_t hops;              //of the delivered packets, summed
+    uint64_t no_route;          //packets dropped for want of a route
+    uint64_t queue_drops;       //packets and adverts dropped at a full egress queue
+    uint64_t wire_losses;       //frames lost to bit errors
+    uint64_t looped;            //packets dropped after EMU_MAX_HOPS
+    uint64_t frames;            //frames put on a wire
+    double link_busy;           //mean share of time the ports with a cable were sending
+    double max_link_busy;       //share of the busiest port
+    HistSnapshot latency_us;    //of the delivered packets, from being sent to arriving
+} EmuStats;
+
+/**
+ * @brief set up an emulator of nodes without cables, replacing any earlier one
+ * @param num_nodes the nodes, up to EMU_MAX_NODES
+ * @param dv the routing daemon's timers, port_mask is set from the cables
+ * @param seed for the traffic and the cables' errors and jitter
+ * @return 0 on success, non-zero if failed
+ */
+int emu_init(int num_nodes, const DvConfig *dv, uint64_t seed);
+
+/**
+ * @brief cable two nodes together, each on its first free port, before emu_run
+ * @param a one node (0 to num_nodes - 1)
+ * @param b the other
+ * @param link the cable
+ * @return 0 on success, -1 if a node has no free port
+ */
+int emu_connect(int a, int b, const EmuLinkConfig *link);
+
+/**
+ * @brief cable every node into a topology, with the same cable everywhere
+ * @param topology the topology
+ * @param link the cable
+ * @return 0 on success, -1 if it doesn't fit in four ports
+ */
+int emu_build(EmuTopology topology, const EmuLinkConfig *link);
+
+/**
+ * @brief parse a topology name: line, ring, mesh or tree
+ * @return 0 on success, -1 if unknown
+ */
+int emu_parse_topology(const char *name, EmuTopology *topology);
+
+/**
+ * @brief set the traffic the nodes offer, before emu_run
+ * @param traffic the traffic
+ */
+void emu_set_traffic(const EmuTraffic *traffic);
+
+/**
+ * @brief run the network until a virtual time; the first run boots every node at time 0, later
+ * runs carry on where the last one stopped
+ * @param until_us virtual time to stop at
+ * @param num_threads threads to spread the nodes over, at most EMU_MAX_THREADS
+ * @return 0 on success, non-zero if failed
+ */
+int emu_run(uint64_t until_us, int num_threads);
+
+/**
+ * @brief totals of every node since emu_init, between runs
+ * @param stats filled in
+ */
+void emu_get_stats(EmuStats *stats);
+
+/**
+ * @brief 1 if every node has the shortest route, in hops, to every node it can reach and no
+ * route to the rest, between runs
+ */
+int emu_converged(void);
+
+/**
+ * @brief release the emulator
+ */
+void emu_free(void);
+
+#endif // NET_EMU_H
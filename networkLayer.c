@@ -1,78 +1,572 @@
-#include "network_layer.h"
+#include "networkLayer.h"
+#include "distanceVector.h"
+#include "forwardEngine.h"
+#include "fragment.h"
+#include "phy.h"
+#include "routingTable.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <stdio.h>
 
-//static routing table (pre-configured)
-typedef struct {
-    uint8_t dest_addr;  //1-byte destination address
-    int channel;        //corresponding channel (0-3)
-} RoutingTableEntry;
+_Static_assert(DV_AD_MAX_SIZE <= MAX_PACKET_SIZE, "a routing advert has to fit a packet");
+_Static_assert(NETWORK_HEADER_SIZE + MAX_PACKET_SIZE <= LINK_MAX_DATA, "a packet has to fit a link frame");
+_Static_assert(NETWORK_MAX_MESSAGE <= FRAG_MAX_MESSAGE, "a message has to fit a reassembly slot");
 
-#define STATIC_ROUTING_TABLE_SIZE 2
+//data bytes in every fragment but the last, a whole number of units
+#define FRAG_DATA_SIZE ((MAX_PACKET_SIZE - FRAG_HEADER_SIZE) / FRAG_UNIT * FRAG_UNIT)
+//fragments of a message a port may have queued before the next one waits, well below where RED
+//starts dropping
+#define FRAG_QUEUE_LIMIT (FWD_RED_MIN / 2)
+#define FRAG_WAIT_US 1000
 
-static RoutingTableEntry routing_table[STATIC_ROUTING_TABLE_SIZE] = {
-    {2, 0}, //computer with address 2 mapped to channel 0
-    {3, 1}, //computer with address 3 mapped to channel 1
-    {4, 2}, //computer with address 4 mapped to channel 2
-    {5, 3}  //computer with address 5 mapped to channel 3 
-};
+//local device address, see network_set_address
+static uint8_t local_address = 1;
 
-//local device address (hardcoded)
-static uint8_t local_address = 1;  //local device has address 1
+//codecs this node uses, and the ones each address said it accepts in its last packet
+static _Atomic uint8_t local_codecs = NETWORK_CODECS_ALL;
+static _Atomic uint8_t peer_codecs[MAX_ADDRESS + 1];
+//the compressor keeps its hash table and window between packets, one sender at a time
+static CompressState compressor;
+static uint8_t compress_buf[MAX_PACKET_SIZE];
+static pthread_mutex_t compress_lock = PTHREAD_MUTEX_INITIALIZER;
 
-//helper function to find the channel for a given destination address
-static int find_route(uint8_t dest_addr) {
-    for (int i = 0; i < STATIC_ROUTING_TABLE_SIZE; i++) {
-        if (routing_table[i].dest_addr == dest_addr) {
-            return routing_table[i].channel;
+//messages sent in fragments get an id each, and those arriving are put together here
+static _Atomic uint16_t next_message_id;
+static ReasmTable reasm;
+static pthread_mutex_t reasm_lock = PTHREAD_MUTEX_INITIALIZER;
+static network_msg_t message_callback = NULL;
+//milliseconds for the reassembly timers, counted from the wrapping microsecond tick under reasm_lock
+static uint32_t reasm_ms;
+static uint32_t reasm_tick;
+static uint32_t reasm_frac_us;
+
+//the counters of network_get_stats, packets are sent and received on several threads
+static struct {
+    _Atomic uint64_t sent;
+    _Atomic uint64_t sent_bytes;
+    _Atomic uint64_t received;
+    _Atomic uint64_t received_bytes;
+    _Atomic uint64_t forwarded;
+    _Atomic uint64_t adverts;
+    _Atomic uint64_t no_route;
+    _Atomic uint64_t ttl_expired;
+    _Atomic uint64_t queue_drops;
+    _Atomic uint64_t malformed;
+    _Atomic uint64_t messages_sent;
+    _Atomic uint64_t messages_delivered;
+} counters;
+
+static void count(_Atomic uint64_t *counter, uint64_t n) {
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+static uint32_t reasm_clock_ms(void) {
+    uint32_t tick = phy_tick();
+    reasm_frac_us += tick - reasm_tick;
+    reasm_tick = tick;
+    reasm_ms += reasm_frac_us / 1000;
+    reasm_frac_us %= 1000;
+    return reasm_ms;
+}
+
+//the routing daemon: adverts arrive on the receive path, timers run on routing_thread
+static DvRouter router;
+static pthread_mutex_t router_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t routing_thread;
+static _Atomic int routing_running;
+static uint32_t routing_ms;    //milliseconds since the daemon started, under router_lock
+
+//put the data in a packet with the codec that makes it smallest of those both ends have, or as
+//it is if none saves a byte; returns the codec and sets len to the bytes written
+static CompressCodec pack_data(uint8_t dest_addr, const uint8_t *data, uint8_t *len, uint8_t *out) {
+    uint8_t codecs = atomic_load_explicit(&local_codecs, memory_order_relaxed) &
+                     atomic_load_explicit(&peer_codecs[dest_addr], memory_order_relaxed);
+    CompressCodec best = COMPRESS_NONE;
+    int best_len = *len;
+    if (codecs != 0) {
+        pthread_mutex_lock(&compress_lock);
+        for (int codec = COMPRESS_NONE + 1; codec < COMPRESS_NUM_CODECS; codec++) {
+            if (!(codecs & (1 << codec))) continue;
+            //it only has to fit if it beats the best so far
+            int n = compress_packet(&compressor, codec, data, *len, compress_buf, best_len - 1);
+            if (n >= 0) {
+                best = codec;
+                best_len = n;
+                memcpy(out, compress_buf, n);
+            }
         }
+        pthread_mutex_unlock(&compress_lock);
+    }
+    if (best == COMPRESS_NONE) {
+        memcpy(out, data, *len);
     }
-    return -1; //if route not found
+    *len = (uint8_t)best_len;
+    return best;
+}
+
+//build a packet in a link frame and queue it on a channel, returns 0 if it was queued.
+//frag is the fragment header for a fragment of a message, NULL for a packet on its own
+static int transmit_packet(int channel, uint8_t dest_addr, const uint8_t *data, uint8_t len, FwdClass cls,
+                           const uint8_t *frag, uint8_t frag_flags) {
+    Frame *frame = frame_alloc();
+    if (frame == NULL) {
+        count(&counters.queue_drops, 1);
+        return -1;
+    }
+    uint8_t *packet = frame_payload(frame); //src_addr, dest_addr, data_len, flags, ttl, data
+    int frag_len = (frag != NULL) ? FRAG_HEADER_SIZE : 0;
+    packet[0] = local_address;            //add source address
+    packet[1] = dest_addr;                //add destination address
+    if (frag != NULL) {
+        memcpy(&packet[NETWORK_HEADER_SIZE], frag, FRAG_HEADER_SIZE);
+    }
+    CompressCodec codec = pack_data(dest_addr, data, &len, &packet[NETWORK_HEADER_SIZE + frag_len]); //add data
+    packet[2] = (uint8_t)(len + frag_len); //add length byte
+    packet[3] = (uint8_t)(codec | frag_flags |
+                          atomic_load_explicit(&local_codecs, memory_order_relaxed) << NET_FLAG_ACCEPTS_SHIFT);
+    packet[4] = NETWORK_TTL;              //add the links it may cross
+    link_seal_frame(frame, packet[2] + NETWORK_HEADER_SIZE);
+
+    int rc = fwd_enqueue(channel, frame, FWD_SOURCE_LOCAL, cls);
+    if (rc == 0) {
+        count(&counters.sent, 1);
+        count(&counters.sent_bytes, packet[2]);
+    } else {
+        count(&counters.queue_drops, 1);
+    }
+    frame_release(frame);
+    return rc;
+}
+
+//adverts only go to the neighbour on the port, so they are never routed
+static void send_advert(void *ctx, int port, const uint8_t *ad, int len) {
+    (void)ctx;
+    transmit_packet(port, NETWORK_ADDR_ROUTING, ad, (uint8_t)len, FWD_CLASS_CONTROL, NULL, 0);
+}
+
+static void install_route(void *ctx, uint8_t dest, int port, uint8_t ports, uint8_t metric) {
+    (void)ctx;
+    if (port == ROUTE_NO_PORT) {
+        route_withdraw(dest);
+    } else {
+        route_insert_multipath(dest, ports, metric);
+    }
+}
+
+static void *routing_thread_main(void *arg) {
+    (void)arg;
+    uint32_t last_tick = phy_tick();
+    uint32_t elapsed_us = 0;
+    while (atomic_load(&routing_running)) {
+        phy_sleep_us(ROUTING_TICK_MS * 1000);
+        uint32_t tick = phy_tick();
+        elapsed_us += tick - last_tick;
+        last_tick = tick;
+
+        pthread_mutex_lock(&router_lock);
+        routing_ms += elapsed_us / 1000;
+        elapsed_us %= 1000;
+        dv_tick(&router, routing_ms);
+        pthread_mutex_unlock(&router_lock);
+
+        pthread_mutex_lock(&reasm_lock);
+        reasm_expire(&reasm, reasm_clock_ms());
+        pthread_mutex_unlock(&reasm_lock);
+    }
+    return NULL;
+}
+
+void network_set_address(uint8_t address) {
+    local_address = address;
+}
+
+void network_set_message_callback(network_msg_t callback) {
+    message_callback = callback;
+}
+
+void network_reasm_stats(ReasmStats *stats) {
+    pthread_mutex_lock(&reasm_lock);
+    *stats = reasm.stats;
+    pthread_mutex_unlock(&reasm_lock);
+}
+
+void network_get_stats(NetworkStats *stats) {
+    stats->sent = atomic_load_explicit(&counters.sent, memory_order_relaxed);
+    stats->sent_bytes = atomic_load_explicit(&counters.sent_bytes, memory_order_relaxed);
+    stats->received = atomic_load_explicit(&counters.received, memory_order_relaxed);
+    stats->received_bytes = atomic_load_explicit(&counters.received_bytes, memory_order_relaxed);
+    stats->forwarded = atomic_load_explicit(&counters.forwarded, memory_order_relaxed);
+    stats->adverts = atomic_load_explicit(&counters.adverts, memory_order_relaxed);
+    stats->no_route = atomic_load_explicit(&counters.no_route, memory_order_relaxed);
+    stats->ttl_expired = atomic_load_explicit(&counters.ttl_expired, memory_order_relaxed);
+    stats->queue_drops = atomic_load_explicit(&counters.queue_drops, memory_order_relaxed);
+    stats->malformed = atomic_load_explicit(&counters.malformed, memory_order_relaxed);
+    stats->messages_sent = atomic_load_explicit(&counters.messages_sent, memory_order_relaxed);
+    stats->messages_delivered = atomic_load_explicit(&counters.messages_delivered, memory_order_relaxed);
+}
+
+void network_set_compression(uint8_t codecs) {
+    atomic_store_explicit(&local_codecs, codecs & NETWORK_CODECS_ALL, memory_order_relaxed);
 }
 
 //initialize the network layer
 void network_layer_init() {
-    //set the link layer's message callback to the network layer's receive handler
-    set_msg_callback(receive_packet);
+    //set the link layer's frame callback to the network layer's receive handler
+    set_frame_callback(receive_frame);
+
+    //no routes until the neighbours have been heard from
+    route_clear();
+    memset(&counters, 0, sizeof(counters));
+    fwd_init();
+    //small packets that queue up for a port share a frame
+    fwd_set_batching(-1, 0, FWD_BATCH_BYTES);
+    //nothing is compressed for an address until it has said what it accepts
+    for (int i = 0; i <= MAX_ADDRESS; i++) {
+        atomic_store_explicit(&peer_codecs[i], 0, memory_order_relaxed);
+    }
+    pthread_mutex_lock(&compress_lock);
+    compress_init(&compressor);
+    pthread_mutex_unlock(&compress_lock);
+    pthread_mutex_lock(&reasm_lock);
+    reasm_init(&reasm, FRAG_TIMEOUT_MS);
+    reasm_tick = phy_tick();
+    pthread_mutex_unlock(&reasm_lock);
+    DvConfig config;
+    dv_default_config(&config);
+    pthread_mutex_lock(&router_lock);
+    dv_init(&router, local_address, &config, send_advert, install_route, NULL);
+    routing_ms = 0;
+    pthread_mutex_unlock(&router_lock);
 }
 
-//send a packet to a specific destination address
-void send_packet(uint8_t dest_addr, uint8_t* data, uint8_t len) {
-    if (len > MAX_PACKET_SIZE) {
-        printf("Data too large to send\n");
-        return;
+int network_routing_start(void) {
+    if (atomic_load(&routing_running)) return 0;
+    pthread_mutex_lock(&router_lock);
+    dv_start(&router, routing_ms);
+    pthread_mutex_unlock(&router_lock);
+    atomic_store(&routing_running, 1);
+    if (pthread_create(&routing_thread, NULL, routing_thread_main, NULL) != 0) {
+        atomic_store(&routing_running, 0);
+        return 1;
+    }
+    return 0;
+}
+
+void network_routing_stop(void) {
+    if (!atomic_load(&routing_running)) return;
+    atomic_store(&routing_running, 0);
+    pthread_join(routing_thread, NULL);
+}
+
+//wait until a port has room for another fragment; the TX engine is polled here too, in case no
+//thread runs it. Returns -1 if the port stayed full for the reassembly timeout
+static int wait_for_room(int port) {
+    uint32_t start = phy_tick();
+    for (;;) {
+        FwdStats stats;
+        fwd_get_stats(port, &stats);
+        if (stats.depth < FRAG_QUEUE_LIMIT) {
+            return 0;
+        }
+        if (phy_tick() - start > FRAG_TIMEOUT_MS * 1000u) {
+            return -1;
+        }
+        link_tx_poll();
+        phy_sleep_us(FRAG_WAIT_US);
     }
+}
 
-    //create the network packet to send
-    uint8_t packet[MAX_PACKET_SIZE + 3];  //src_addr, dest_addr, data_len, data
-    packet[0] = local_address;            //add source address
-    packet[1] = dest_addr;                //add destination address
-    packet[2] = len;                      //add length byte
-    memcpy(&packet[3], data, len);        //add data
+//the ports worth spreading traffic over. Every port's frames go out in the same wave, one frame
+//per port, and the wave lasts as long as its slowest line, so a slow port holds the others back:
+//the k fastest ports are used for the k that sends the most frames per wave time
+static uint8_t usable_ports(uint8_t ports, const uint32_t bit_us[4]) {
+    uint8_t used = 0;
+    uint8_t best = 0;
+    uint32_t best_k = 0, best_us = 1;
+    for (int k = 1; k <= __builtin_popcount(ports); k++) {
+        //add the fastest port not used yet; the slowest so far is then this one
+        int fastest = -1;
+        for (int port = 0; port < 4; port++) {
+            if ((ports & ~used & (1 << port)) && (fastest < 0 || bit_us[port] < bit_us[fastest])) {
+                fastest = port;
+            }
+        }
+        used |= (uint8_t)(1 << fastest);
+        if ((uint64_t)k * best_us > (uint64_t)best_k * bit_us[fastest]) {
+            best = used;
+            best_k = (uint32_t)k;
+            best_us = bit_us[fastest];
+        }
+    }
+    return best;
+}
+
+//a packet between a source and destination keeps to one of the ports, so they arrive in order;
+//the pairs are hashed over the ports in proportion to each one's bit rate
+static int flow_port(uint8_t src_addr, uint8_t dest_addr, uint8_t ports, const uint32_t bit_us[4]) {
+    uint32_t weight[4] = {0};
+    uint32_t total = 0;
+    for (int port = 0; port < 4; port++) {
+        if (ports & (1 << port)) {
+            weight[port] = 1000000 / bit_us[port];
+            total += weight[port];
+        }
+    }
+    uint32_t hash = ((uint32_t)src_addr << 8 | dest_addr) * 0x9E3779B1u;
+    uint32_t pick = (uint32_t)(((uint64_t)(hash ^ hash >> 16) * total) >> 32);
+    for (int port = 0; port < 4; port++) {
+        if (pick < weight[port]) {
+            return port;
+        }
+        pick -= weight[port];
+    }
+    return __builtin_ctz(ports);
+}
+
+//a fragment may take any of them, reassembly puts the message back in order: it goes where it
+//will be through first, after the frames queued there and in the link layer at that port's bit rate
+static int fragment_port(uint8_t ports, const uint32_t bit_us[4]) {
+    int best = ROUTE_NO_PORT;
+    uint64_t best_us = UINT64_MAX;
+    for (int port = 0; port < 4; port++) {
+        if (!(ports & (1 << port))) continue;
+        FwdStats stats;
+        fwd_get_stats(port, &stats);
+        uint64_t finish_us = (uint64_t)(stats.depth + stats.in_link + 1) * bit_us[port];
+        if (finish_us < best_us) {
+            best = port;
+            best_us = finish_us;
+        }
+    }
+    return best;
+}
+
+//the port a packet to an address goes out on, of those with a route of the best metric but the
+//one it arrived on (-1 for our own packets); ROUTE_NO_PORT if there is none
+static int select_port(uint8_t src_addr, uint8_t dest_addr, int fragment, int arrived_on) {
+    uint8_t ports = route_lookup_ports(dest_addr);
+    if (arrived_on >= 0) {
+        ports &= (uint8_t)~(1 << arrived_on);
+    }
+    if (ports == 0) {
+        return ROUTE_NO_PORT;
+    }
+    if ((ports & (ports - 1)) == 0) {
+        return __builtin_ctz(ports);
+    }
+    uint32_t bit_us[4];
+    for (int port = 0; port < 4; port++) {
+        bit_us[port] = get_port_bit_duration(port);
+    }
+    ports = usable_ports(ports, bit_us);
+    return fragment ? fragment_port(ports, bit_us) : flow_port(src_addr, dest_addr, ports, bit_us);
+}
+
+//a message too long for one packet goes in fragments. Each one is routed on its own, so they
+//follow a route change, are spread over parallel links and are forwarded as they come, and waits
+//for room on its port so a long message paces itself instead of overflowing the forwarding queue
+static int send_fragments(uint8_t dest_addr, const uint8_t *data, size_t len) {
+    uint16_t id = atomic_fetch_add_explicit(&next_message_id, 1, memory_order_relaxed);
+    for (size_t offset = 0; offset < len; offset += FRAG_DATA_SIZE) {
+        size_t n = (len - offset < FRAG_DATA_SIZE) ? len - offset : FRAG_DATA_SIZE;
+        int channel = select_port(local_address, dest_addr, 1, -1);
+        if (channel == ROUTE_NO_PORT) {
+            count(&counters.no_route, 1);
+            return -1;
+        }
+        if (wait_for_room(channel) != 0) {
+            count(&counters.queue_drops, 1);
+            return -1;
+        }
+        uint8_t frag[FRAG_HEADER_SIZE] = {(uint8_t)(id >> 8), (uint8_t)id, (uint8_t)(offset >> 8), (uint8_t)offset};
+        uint8_t flags = NET_FLAG_FRAGMENT | ((offset + n < len) ? NET_FLAG_MORE : 0);
+        if (transmit_packet(channel, dest_addr, data + offset, (uint8_t)n, FWD_CLASS_DATA, frag, flags) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//send a packet to a specific destination address
+int send_packet(uint8_t dest_addr, const uint8_t *data, size_t len) {
+    if (len > NETWORK_MAX_MESSAGE) {
+        printf("Message of %zu bytes is longer than %d, not sent\n", len, NETWORK_MAX_MESSAGE);
+        return -1;
+    }
 
     //find the right channel to send the packet
-    int channel = find_route(dest_addr);
-    if (channel == -1) {
+    int channel = select_port(local_address, dest_addr, 0, -1);
+    if (channel == ROUTE_NO_PORT) {
         printf("No route found to destination address %d\n", dest_addr);
+        count(&counters.no_route, 1);
+        return -1;
+    }
+
+    //create the network packet straight in a link frame and transmit it
+    int rc = (len <= MAX_PACKET_SIZE)
+                 ? transmit_packet(channel, dest_addr, data, (uint8_t)len, FWD_CLASS_DATA, NULL, 0)
+                 : send_fragments(dest_addr, data, len);
+    if (rc != 0) {
+        printf("No free frame or queue full, packet dropped\n");
+    } else {
+        count(&counters.messages_sent, 1);
+    }
+    return rc;
+}
+
+static void deliver_message(uint8_t src_addr, const uint8_t *data, size_t len, int ch) {
+    count(&counters.messages_delivered, 1);
+    if (message_callback != NULL) {
+        message_callback(src_addr, data, len, ch);
         return;
     }
+    printf("Received packet from address: %d on channel %d\n", src_addr, ch);
+    printf("Data: %.*s\n", (int)len, data);
+}
+
+//put a fragment in its place in the message's slot, decompressing it there, and deliver the
+//message once it is complete
+static void receive_fragment(uint8_t src_addr, const uint8_t *data, int len, uint8_t flags, int ch) {
+    if (len <= FRAG_HEADER_SIZE) {
+        return;
+    }
+    uint16_t id = (uint16_t)(data[0] << 8 | data[1]);
+    uint32_t offset = (uint32_t)(data[2] << 8 | data[3]);
+    CompressCodec codec = (CompressCodec)(flags & NET_FLAG_CODEC);
+    data += FRAG_HEADER_SIZE;
+    len -= FRAG_HEADER_SIZE;
+
+    pthread_mutex_lock(&reasm_lock);
+    ReasmSlot *slot = NULL;
+    uint8_t *place = reasm_place(&reasm, src_addr, id, offset, reasm_clock_ms(), &slot);
+    int complete = 0;
+    if (place != NULL) {
+        int room = FRAG_MAX_MESSAGE - (int)offset;
+        if (room > MAX_PACKET_SIZE) room = MAX_PACKET_SIZE;
+        if (codec != COMPRESS_NONE) {
+            len = decompress_packet(codec, data, len, place, room);
+        } else if (len <= room) {
+            memcpy(place, data, len);
+        } else {
+            len = -1;
+        }
+        complete = reasm_commit(&reasm, slot, offset, len, (flags & NET_FLAG_MORE) != 0) == 1;
+    }
+    pthread_mutex_unlock(&reasm_lock);
 
-    //transmit the packet using the link layer
-    manchester_transmit(channel, packet, len + 3); //send the packet (address + length + data)
+    //a complete slot is left alone until it is released, so it is delivered without the lock
+    if (complete) {
+        deliver_message(src_addr, slot->data, slot->total, ch);
+        pthread_mutex_lock(&reasm_lock);
+        reasm_release(&reasm, slot);
+        pthread_mutex_unlock(&reasm_lock);
+    }
+}
+
+//pass a packet on, the forwarding engine holds its frame until it has been sent. Its TTL has gone
+//down, so the frame is sealed again: the FCS it arrived with no longer covers it. A packet out of
+//a batch gets a frame of its own, it may leave by another port than the rest
+static int forward_packet(int channel, Frame *frame, const uint8_t *msg, int ch) {
+    if (frame != NULL) {
+        link_seal_frame(frame, NETWORK_HEADER_SIZE + msg[2]);
+        return fwd_enqueue(channel, frame, ch, FWD_CLASS_DATA);
+    }
+    Frame *copy = frame_alloc();
+    if (copy == NULL) {
+        return -1;
+    }
+    uint16_t len = NETWORK_HEADER_SIZE + msg[2];
+    memcpy(frame_payload(copy), msg, len);
+    link_seal_frame(copy, len);
+    int rc = fwd_enqueue(channel, copy, ch, FWD_CLASS_DATA);
+    frame_release(copy);
+    return rc;
 }
 
-//callback function to handle incoming messages from the link layer
-void receive_packet(uint8_t* msg, int ch) {
+//one packet that arrived, frame is the frame it filled or NULL if it shared one with others in a batch
+static void receive_packet(Frame *frame, uint8_t *msg, int ch) {
     uint8_t src_addr = msg[0];      //first byte is the source address
     uint8_t dest_addr = msg[1];     //second byte is the destination address
     uint8_t data_len = msg[2];      //third byte is the length of the data
-    uint8_t* data = &msg[3];        //remaining bytes are the actual data
+    uint8_t flags = msg[3];         //fourth byte is the codec and what the source accepts
+    uint8_t ttl = msg[4];           //fifth byte is how many more links the packet may cross
+    uint8_t* data = &msg[5];        //remaining bytes are the actual data
+
+    atomic_store_explicit(&peer_codecs[src_addr], (flags >> NET_FLAG_ACCEPTS_SHIFT) & NETWORK_CODECS_ALL,
+                          memory_order_relaxed);
+
+    //routing adverts are for the neighbour on this port only
+    if (dest_addr == NETWORK_ADDR_ROUTING) {
+        count(&counters.adverts, 1);
+        pthread_mutex_lock(&router_lock);
+        dv_receive(&router, ch, data, data_len, routing_ms);
+        pthread_mutex_unlock(&router_lock);
+        return;
+    }
 
     //check if the packet is addressed to this device
     if (dest_addr == local_address) {
-        printf("Received packet from address: %d on channel %d\n", src_addr, ch);
-        printf("Data: %.*s\n", data_len, data);
+        count(&counters.received, 1);
+        count(&counters.received_bytes, data_len);
+        if (flags & NET_FLAG_FRAGMENT) {
+            receive_fragment(src_addr, data, data_len, flags, ch);
+            return;
+        }
+        uint8_t plain[MAX_PACKET_SIZE];
+        CompressCodec codec = (CompressCodec)(flags & NET_FLAG_CODEC);
+        if (codec != COMPRESS_NONE) {
+            int plain_len = decompress_packet(codec, data, data_len, plain, MAX_PACKET_SIZE);
+            if (plain_len < 0) {
+                printf("Packet from %d could not be decompressed, dropped.\n", src_addr);
+                count(&counters.malformed, 1);
+                return;
+            }
+            data = plain;
+            data_len = (uint8_t)plain_len;
+        }
+        deliver_message(src_addr, data, data_len, ch);
+    } else if (ttl <= 1) {
+        //the next link would be one too many, the routes are most likely still settling into a loop
+        TRACE(TRACE_NET_TTL_EXPIRED, src_addr, dest_addr, ch);
+        count(&counters.ttl_expired, 1);
     } else {
-        printf("Packet not for this device, ignoring.\n");
+        msg[4] = ttl - 1;
+        //why a frame was dropped is counted in the forwarding engine, by class and source
+        int channel = select_port(src_addr, dest_addr, (flags & NET_FLAG_FRAGMENT) != 0, ch);
+        if (channel == ROUTE_NO_PORT) {
+            printf("No route to %d, packet dropped.\n", dest_addr);
+            count(&counters.no_route, 1);
+        } else if (forward_packet(channel, frame, msg, ch) == 0) {
+            count(&counters.forwarded, 1);
+        } else {
+            count(&counters.queue_drops, 1);
+        }
+    }
+}
+
+//callback function to handle incoming frames from the link layer
+void receive_frame(Frame *frame, int ch) {
+    uint8_t *msg = frame_payload(frame);
+    int len = frame_len(frame);
+    if (!(frame->data[0] & LINK_HDR_BATCH)) {
+        if (len < NETWORK_HEADER_SIZE || msg[2] > len - NETWORK_HEADER_SIZE) {
+            count(&counters.malformed, 1);
+            return;
+        }
+        receive_packet(frame, msg, ch);
+        return;
+    }
+    //a batch is packets back to back, each handled where it lies; a bad length loses the rest
+    while (len > 0) {
+        if (len < NETWORK_HEADER_SIZE || msg[2] > len - NETWORK_HEADER_SIZE) {
+            count(&counters.malformed, 1);
+            return;
+        }
+        int packet_len = NETWORK_HEADER_SIZE + msg[2];
+        receive_packet(NULL, msg, ch);
+        msg += packet_len;
+        len -= packet_len;
     }
 }
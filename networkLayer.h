@@ -2,32 +2,115 @@
 #define NETWORK_LAYER_H
 
 #include <stdint.h>
-#include "link_layer.h"
+#include <stddef.h>
+#include "compress.h"
+#include "fragment.h"
+#include "linkLayer.h"
 
 #define MAX_ADDRESS 255          //max value for 1-byte addresses
-#define MAX_PACKET_SIZE 255      //max packet size for data
-#define MAX_ROUTING_TABLE_ENTRIES 10 //max routing table entries
+#define NETWORK_HEADER_SIZE 5    //src_addr, dest_addr, data_len, flags, ttl
+#define MAX_PACKET_SIZE 255      //max packet size for data, data_len is one byte
+#define NETWORK_MAX_MESSAGE FRAG_MAX_MESSAGE //longer messages than a packet go in fragments
+#define NETWORK_ADDR_ROUTING 0   //destination of routing adverts, never a node's address
+#define ROUTING_TICK_MS 100      //how often the routing daemon runs its timers
+#define NETWORK_TTL 32           //links a packet may cross, one caught in a routing loop is dropped after them
+
+//flags byte of the header: the codec the data is compressed with, and the codecs the sender
+//decompresses, one bit each (1 << codec) from NET_FLAG_ACCEPTS_SHIFT. Every packet carries the
+//latter, so a node compresses for a destination once it has heard from it
+#define NET_FLAG_CODEC 0x03
+#define NET_FLAG_FRAGMENT 0x04   //the data starts with a fragment header, see fragment.h
+#define NET_FLAG_MORE 0x08       //more fragments of the message follow this one
+#define NET_FLAG_ACCEPTS_SHIFT 4
+#define NETWORK_CODECS_ALL ((1 << COMPRESS_LZ) | (1 << COMPRESS_HUFFMAN))
+
+//a message for this node, whole: data is only valid during the call
+typedef void (*network_msg_t)(uint8_t src_addr, const uint8_t *data, size_t len, int ch);
+
+//counters of the network layer, see network_get_stats
+typedef struct {
+    uint64_t sent;                  //packets this node queued, fragments and adverts included
+    uint64_t sent_bytes;            //their data bytes, compressed
+    uint64_t received;              //packets for this node
+    uint64_t received_bytes;        //their data bytes, compressed
+    uint64_t forwarded;             //packets passed on towards another node
+    uint64_t adverts;               //routing adverts received
+    uint64_t no_route;              //packets dropped for want of a route
+    uint64_t ttl_expired;           //packets dropped with their TTL used up, in a routing loop most likely
+    uint64_t queue_drops;           //packets that got no frame, or that the forwarding engine refused
+    uint64_t malformed;             //packets shorter than their header says, or that didn't decompress
+    uint64_t messages_sent;         //messages send_packet queued whole
+    uint64_t messages_delivered;    //messages handed to the application, long ones once put together
+} NetworkStats;
 
 //network layer functions
+/**
+ * @brief set this node's address, before network_layer_init
+ * @param address the address (1-255)
+ */
+void network_set_address(uint8_t address);
+
+/**
+ * @brief choose the codecs this node compresses with and accepts, all of them by default.
+ * A packet is compressed with whichever codec the destination accepts that makes it smallest,
+ * and sent as it is if none makes it smaller
+ * @param codecs (1 << codec) for each CompressCodec, 0 to send everything uncompressed
+ */
+void network_set_compression(uint8_t codecs);
+
+/**
+ * @brief set the handler for messages addressed to this node, NULL prints them
+ */
+void network_set_message_callback(network_msg_t callback);
+
+/**
+ * @brief read the counters of the reassembly of fragmented messages
+ */
+void network_reasm_stats(ReasmStats *stats);
+
+/**
+ * @brief take a snapshot of the network layer's counters, they count from network_layer_init
+ */
+void network_get_stats(NetworkStats *stats);
+
 /**
  * @brief initialize network layer
  */
 void network_layer_init();
 
 /**
- * @brief send a packet to a specific destination address
+ * @brief start the distance-vector routing daemon: it asks the neighbours for their routes,
+ * advertises its own on every port and keeps the routing table up to date from then on.
+ * The link layer has to be running
+ * @return 0 on success, 1 if the thread could not be started
+ */
+int network_routing_start(void);
+
+/**
+ * @brief stop the routing daemon, the routes it learned stay in the table
+ */
+void network_routing_stop(void);
+
+/**
+ * @brief send a packet to a specific destination address, compressed if that pays. A message
+ * longer than MAX_PACKET_SIZE goes in fragments; the call waits for room on the egress port
+ * between them
  * @param dest_addr the address we want to send to
  * @param data pointer to the data being transmitted 
- * @param len the length of the data being transmitted 
+ * @param len the length of the data being transmitted, at most NETWORK_MAX_MESSAGE
+ * @return 0 if every packet was queued, -1 if there was no route or something was dropped
  */
-void send_packet(uint8_t dest_addr, uint8_t* data, uint8_t len);
+int send_packet(uint8_t dest_addr, const uint8_t *data, size_t len);
 
 /**
- * @brief callback function to handle incoming messages from the link layer
- * @param msg pointer to the message recieved 
+ * @brief callback function to handle incoming frames from the link layer, packets for other
+ * addresses are forwarded in the same frame without copying, compressed ones as they are.
+ * A frame with LINK_HDR_BATCH holds several packets; they are handled where they lie, and only
+ * those forwarded are copied, into frames of their own
+ * @param frame the frame recieved, its data is the packet, or packets back to back
  * @param ch the channel the message has been received on 
  */
-void receive_packet(uint8_t* msg, int ch);
+void receive_frame(Frame *frame, int ch);
 
 #endif // NETWORK_LAYER_H
 
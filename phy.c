@@ -0,0 +1,77 @@
+#include <stddef.h>
+#include "phy.h"
+
+//backend used by all calls, the real hardware unless told otherwise
+static const PhyBackend *phy = PHY_DEFAULT_BACKEND;
+
+void phy_set_backend(const PhyBackend *backend) {
+    phy = (backend != NULL) ? backend : PHY_DEFAULT_BACKEND;
+}
+
+const PhyBackend *phy_get_backend(void) {
+    return phy;
+}
+
+int phy_start(void) {
+    return phy->start();
+}
+
+void phy_stop(void) {
+    phy->stop();
+}
+
+int phy_set_mode(unsigned gpio, unsigned mode) {
+    return phy->set_mode(gpio, mode);
+}
+
+int phy_set_pull_up_down(unsigned gpio, unsigned pud) {
+    return phy->set_pull_up_down(gpio, pud);
+}
+
+int phy_write(unsigned gpio, unsigned level) {
+    return phy->write(gpio, level);
+}
+
+int phy_read(unsigned gpio) {
+    return phy->read(gpio);
+}
+
+int phy_callback(unsigned gpio, phy_edge_callback_t cb) {
+    return phy->callback(gpio, cb);
+}
+
+int phy_wave_clear(void) {
+    return phy->wave_clear();
+}
+
+int phy_wave_create(const PhyPulse *pulses, int num_pulses) {
+    return phy->wave_create(pulses, num_pulses);
+}
+
+int phy_wave_delete(unsigned wave_id) {
+    return phy->wave_delete(wave_id);
+}
+
+int phy_wave_send_once(unsigned wave_id) {
+    return phy->wave_send_once(wave_id);
+}
+
+int phy_wave_send_sync(unsigned wave_id) {
+    return phy->wave_send_sync(wave_id);
+}
+
+int phy_wave_tx_at(void) {
+    return phy->wave_tx_at();
+}
+
+int phy_wave_tx_busy(void) {
+    return phy->wave_tx_busy();
+}
+
+uint32_t phy_tick(void) {
+    return phy->tick();
+}
+
+void phy_sleep_us(uint32_t us) {
+    phy->sleep_us(us);
+}
@@ -0,0 +1,159 @@
+#ifndef PHY_H
+#define PHY_H
+
+#include <stdint.h>
+
+//gpio modes and pull settings (same values as pigpio)
+#define PHY_INPUT 0
+#define PHY_OUTPUT 1
+#define PHY_PUD_OFF 0
+#define PHY_PUD_DOWN 1
+#define PHY_PUD_UP 2
+
+//one step of a waveform, same layout as pigpio's gpioPulse_t
+typedef struct {
+    uint32_t gpioOn;    //mask of gpios switched high at the start of the step
+    uint32_t gpioOff;   //mask of gpios switched low at the start of the step
+    uint32_t usDelay;   //how long the step lasts in microseconds
+} PhyPulse;
+
+//callback for an edge on an input gpio
+typedef void (*phy_edge_callback_t)(unsigned gpio, unsigned level, uint32_t tick);
+
+//set of operations every PHY backend has to provide
+typedef struct {
+    const char *name;
+    int (*start)(void);
+    void (*stop)(void);
+    int (*set_mode)(unsigned gpio, unsigned mode);
+    int (*set_pull_up_down)(unsigned gpio, unsigned pud);
+    int (*write)(unsigned gpio, unsigned level);
+    int (*read)(unsigned gpio);
+    int (*callback)(unsigned gpio, phy_edge_callback_t cb);
+    int (*wave_clear)(void);
+    int (*wave_create)(const PhyPulse *pulses, int num_pulses);
+    int (*wave_delete)(unsigned wave_id);
+    int (*wave_send_once)(unsigned wave_id);
+    int (*wave_send_sync)(unsigned wave_id);
+    int (*wave_tx_at)(void);
+    int (*wave_tx_busy)(void);
+    uint32_t (*tick)(void);
+    void (*sleep_us)(uint32_t us);
+} PhyBackend;
+
+//the real hardware through the pigpio daemon, left out of builds with -DPHY_NO_PIGPIO for
+//machines without pigpio, where the simulated wire is the default instead
+#ifndef PHY_NO_PIGPIO
+extern const PhyBackend phy_pigpio_backend;
+#define PHY_DEFAULT_BACKEND (&phy_pigpio_backend)
+#else
+#define PHY_DEFAULT_BACKEND (&phy_sim_backend)
+#endif
+
+//an in-process simulated wire running in virtual time
+extern const PhyBackend phy_sim_backend;
+
+//properties of one simulated wire
+typedef struct {
+    uint32_t delay_us;      //propagation delay
+    uint32_t jitter_us;     //each edge is moved by a random amount in [-jitter_us, +jitter_us]
+    int32_t skew_ppm;       //receiver clock runs this many parts per million fast (negative is slow)
+    double error_rate;      //probability that a waveform step arrives inverted
+} PhySimLinkConfig;
+
+/**
+ * @brief select the backend used by all phy_* calls, must be called before phy_start
+ * @param backend the backend, NULL for PHY_DEFAULT_BACKEND (pigpio unless built without it)
+ */
+void phy_set_backend(const PhyBackend *backend);
+
+/**
+ * @brief get the currently selected backend
+ * @return the backend
+ */
+const PhyBackend *phy_get_backend(void);
+
+/**
+ * @brief start the selected backend
+ * @return 0 on success, non-zero if failed
+ */
+int phy_start(void);
+
+/**
+ * @brief stop the selected backend
+ */
+void phy_stop(void);
+
+int phy_set_mode(unsigned gpio, unsigned mode);
+int phy_set_pull_up_down(unsigned gpio, unsigned pud);
+int phy_write(unsigned gpio, unsigned level);
+int phy_read(unsigned gpio);
+
+/**
+ * @brief call cb on every rising and falling edge of gpio
+ * @param gpio the input gpio
+ * @param cb the edge handler
+ * @return 0 on success, negative if failed
+ */
+int phy_callback(unsigned gpio, phy_edge_callback_t cb);
+
+int phy_wave_clear(void);
+
+/**
+ * @brief upload a waveform
+ * @param pulses the steps of the waveform
+ * @param num_pulses the number of steps
+ * @return the wave id, negative if failed
+ */
+int phy_wave_create(const PhyPulse *pulses, int num_pulses);
+
+int phy_wave_delete(unsigned wave_id);
+int phy_wave_send_once(unsigned wave_id);
+
+/**
+ * @brief send a waveform once, starting right after the one currently being sent
+ * @param wave_id the wave to send
+ * @return 0 on success, negative if failed
+ */
+int phy_wave_send_sync(unsigned wave_id);
+
+/**
+ * @brief id of the waveform currently being sent
+ * @return the wave id, negative if nothing is being sent
+ */
+int phy_wave_tx_at(void);
+
+int phy_wave_tx_busy(void);
+
+/**
+ * @brief current time of the backend in microseconds (wraps around like pigpio ticks)
+ */
+uint32_t phy_tick(void);
+
+/**
+ * @brief wait for the given time, with the simulated backend this advances virtual time
+ * @param us the time to wait in microseconds
+ */
+void phy_sleep_us(uint32_t us);
+
+/**
+ * @brief connect a simulated transmit gpio to a simulated receive gpio
+ * @param tx_gpio the gpio driving the wire
+ * @param rx_gpio the gpio seeing the wire
+ * @param cfg the properties of the wire, NULL for an ideal wire
+ * @return 0 on success, negative if failed
+ */
+int phy_sim_connect(unsigned tx_gpio, unsigned rx_gpio, const PhySimLinkConfig *cfg);
+
+/**
+ * @brief seed the random generator used for jitter and errors
+ * @param seed the seed
+ */
+void phy_sim_seed(uint64_t seed);
+
+/**
+ * @brief deliver every pending simulated edge, advancing virtual time as needed
+ */
+void phy_sim_run(void);
+
+#endif // PHY_H
@@ -0,0 +1,126 @@
+#include <pigpiod_if2.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "phy.h"
+
+//the pigpio daemon expects its own pulse type, ours has to stay identical
+_Static_assert(sizeof(PhyPulse) == sizeof(gpioPulse_t), "PhyPulse must match gpioPulse_t");
+
+#define PIGPIO_MAX_GPIO 32
+
+static int gpio_handle = -1;
+
+//user handlers for each gpio, pigpio's callback is routed through these
+static phy_edge_callback_t edge_handlers[PIGPIO_MAX_GPIO];
+
+static void pigpio_edge(int pi, unsigned gpio, unsigned level, uint32_t tick) {
+    (void)pi;
+    //level 2 is a watchdog timeout, not an edge
+    if (gpio >= PIGPIO_MAX_GPIO || level > 1) return;
+    if (edge_handlers[gpio] != NULL) {
+        edge_handlers[gpio](gpio, level, tick);
+    }
+}
+
+static int pigpio_phy_start(void) {
+    gpio_handle = pigpio_start(NULL, NULL);
+    if (gpio_handle < 0) {
+        fprintf(stderr, "Failed to start pigpio\n");
+        return 1;
+    }
+    printf("pigpio started with handle %d\n", gpio_handle);
+    return 0;
+}
+
+static void pigpio_phy_stop(void) {
+    if (gpio_handle >= 0) {
+        pigpio_stop(gpio_handle);
+        gpio_handle = -1;
+    }
+}
+
+static int pigpio_phy_set_mode(unsigned gpio, unsigned mode) {
+    return set_mode(gpio_handle, gpio, mode);
+}
+
+static int pigpio_phy_set_pull_up_down(unsigned gpio, unsigned pud) {
+    return set_pull_up_down(gpio_handle, gpio, pud);
+}
+
+static int pigpio_phy_write(unsigned gpio, unsigned level) {
+    return gpio_write(gpio_handle, gpio, level);
+}
+
+static int pigpio_phy_read(unsigned gpio) {
+    return gpio_read(gpio_handle, gpio);
+}
+
+static int pigpio_phy_callback(unsigned gpio, phy_edge_callback_t cb) {
+    if (gpio >= PIGPIO_MAX_GPIO) return -1;
+    edge_handlers[gpio] = cb;
+    return callback(gpio_handle, gpio, EITHER_EDGE, pigpio_edge);
+}
+
+static int pigpio_phy_wave_clear(void) {
+    return wave_clear(gpio_handle);
+}
+
+static int pigpio_phy_wave_create(const PhyPulse *pulses, int num_pulses) {
+    int rc = wave_add_new(gpio_handle);
+    if (rc < 0) return rc;
+    //the wave is made of every pulse added since wave_add_new, a short count would send part of it
+    rc = wave_add_generic(gpio_handle, num_pulses, (gpioPulse_t *)pulses);
+    if (rc < 0) return rc;
+    if (rc != num_pulses) return -1;
+    return wave_create(gpio_handle);
+}
+
+static int pigpio_phy_wave_delete(unsigned wave_id) {
+    return wave_delete(gpio_handle, wave_id);
+}
+
+static int pigpio_phy_wave_send_once(unsigned wave_id) {
+    return wave_send_once(gpio_handle, wave_id);
+}
+
+static int pigpio_phy_wave_send_sync(unsigned wave_id) {
+    return wave_send_using_mode(gpio_handle, wave_id, PI_WAVE_MODE_ONE_SHOT_SYNC);
+}
+
+static int pigpio_phy_wave_tx_at(void) {
+    int wave_id = wave_tx_at(gpio_handle);
+    //9999 means no wave is being sent, 9998 a wave not created by wave_create
+    return (wave_id >= 9998) ? -1 : wave_id;
+}
+
+static int pigpio_phy_wave_tx_busy(void) {
+    return wave_tx_busy(gpio_handle);
+}
+
+static uint32_t pigpio_phy_tick(void) {
+    return get_current_tick(gpio_handle);
+}
+
+static void pigpio_phy_sleep_us(uint32_t us) {
+    usleep(us);
+}
+
+const PhyBackend phy_pigpio_backend = {
+    .name = "pigpio",
+    .start = pigpio_phy_start,
+    .stop = pigpio_phy_stop,
+    .set_mode = pigpio_phy_set_mode,
+    .set_pull_up_down = pigpio_phy_set_pull_up_down,
+    .write = pigpio_phy_write,
+    .read = pigpio_phy_read,
+    .callback = pigpio_phy_callback,
+    .wave_clear = pigpio_phy_wave_clear,
+    .wave_create = pigpio_phy_wave_create,
+    .wave_delete = pigpio_phy_wave_delete,
+    .wave_send_once = pigpio_phy_wave_send_once,
+    .wave_send_sync = pigpio_phy_wave_send_sync,
+    .wave_tx_at = pigpio_phy_wave_tx_at,
+    .wave_tx_busy = pigpio_phy_wave_tx_busy,
+    .tick = pigpio_phy_tick,
+    .sleep_us = pigpio_phy_sleep_us,
+};
@@ -0,0 +1,478 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "phy.h"
+
+//simulated wire: waveforms are turned into edge events on a virtual clock and
+//delivered to the receive callbacks whenever the virtual clock is advanced, so
+//everything runs as fast as the CPU allows instead of in real time
+
+#define SIM_MAX_GPIO 32
+#define SIM_MAX_WAVES 64
+#define SIM_MAX_LINKS 32
+#define SIM_MAX_SCHEDULED 8
+
+//an edge scheduled to arrive on a receive gpio
+typedef struct {
+    uint64_t time;      //virtual arrival time in microseconds
+    uint64_t sent;      //virtual time the transmitter drove it
+    uint64_t seq;       //insertion order, keeps edges with equal times in order
+    uint8_t link;       //index of the wire carrying the edge
+    uint8_t level;      //new level of the receive gpio
+} SimEdge;
+
+//a wire from one transmit gpio to one receive gpio
+typedef struct {
+    unsigned tx_gpio;
+    unsigned rx_gpio;
+    PhySimLinkConfig cfg;
+    uint8_t level;      //level the receiver will see after the last scheduled edge
+    uint64_t last_edge; //arrival time of the last scheduled edge
+} SimLink;
+
+typedef struct {
+    PhyPulse *pulses;
+    int num_pulses;
+} SimWave;
+
+//time window in which a wave is on the wire, used to answer wave_tx_at
+typedef struct {
+    int wave_id;
+    uint64_t start;
+    uint64_t end;
+} SimScheduled;
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t sim_now;
+static uint64_t tx_end;
+static uint64_t edge_seq;
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint8_t levels[SIM_MAX_GPIO];
+static phy_edge_callback_t edge_handlers[SIM_MAX_GPIO];
+static SimLink links[SIM_MAX_LINKS];
+static int num_links;
+static SimWave waves[SIM_MAX_WAVES];
+static SimScheduled scheduled[SIM_MAX_SCHEDULED];
+static int num_scheduled;
+
+//min-heap of pending edges ordered by arrival time
+static SimEdge *edges;
+static size_t num_edges;
+static size_t edge_capacity;
+
+//xorshift64* generator, deterministic for a given seed
+static uint64_t sim_rand(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+//uniform random number in [0, 1)
+static double sim_rand_unit(void) {
+    return (sim_rand() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int edge_before(const SimEdge *a, const SimEdge *b) {
+    return (a->time < b->time) || (a->time == b->time && a->seq < b->seq);
+}
+
+//sift an edge up from the heap's end, there has to be room for it
+static void heap_insert(SimEdge e) {
+    size_t i = num_edges++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!edge_before(&e, &edges[parent])) break;
+        edges[i] = edges[parent];
+        i = parent;
+    }
+    edges[i] = e;
+}
+
+static int push_edge(uint64_t time, uint64_t sent, int link, uint8_t level) {
+    if (num_edges == edge_capacity) {
+        size_t new_capacity = edge_capacity ? edge_capacity * 2 : 1024;
+        SimEdge *grown = realloc(edges, new_capacity * sizeof(SimEdge));
+        if (grown == NULL) return -1;
+        edges = grown;
+        edge_capacity = new_capacity;
+    }
+    heap_insert((SimEdge){.time = time, .sent = sent, .seq = edge_seq++, .link = (uint8_t)link, .level = level});
+    return 0;
+}
+
+static SimEdge pop_edge(void) {
+    SimEdge top = edges[0];
+    SimEdge last = edges[--num_edges];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= num_edges) break;
+        if (child + 1 < num_edges && edge_before(&edges[child + 1], &edges[child])) child++;
+        if (!edge_before(&edges[child], &last)) break;
+        edges[i] = edges[child];
+        i = child;
+    }
+    if (num_edges > 0) edges[i] = last;
+    return top;
+}
+
+//schedule what the receiver of a wire sees when its transmitter is at 'level' from time t
+static void drive_link(int l, uint8_t level, uint64_t t, int allow_errors) {
+    SimLink *link = &links[l];
+    if (allow_errors && link->cfg.error_rate > 0.0 && sim_rand_unit() < link->cfg.error_rate) {
+        level ^= 1;
+    }
+    if (level == link->level) return;
+
+    int64_t arrival = (int64_t)(t + link->cfg.delay_us);
+    if (link->cfg.jitter_us > 0) {
+        arrival += (int64_t)(sim_rand() % (2 * (uint64_t)link->cfg.jitter_us + 1)) - link->cfg.jitter_us;
+    }
+    //jitter must never reorder edges or move them into the past
+    if (arrival <= (int64_t)link->last_edge) arrival = (int64_t)link->last_edge + 1;
+    if (arrival < (int64_t)sim_now) arrival = (int64_t)sim_now;
+
+    if (push_edge((uint64_t)arrival, t, l, level) == 0) {
+        link->level = level;
+        link->last_edge = (uint64_t)arrival;
+    }
+}
+
+//drive a gpio to a level at time t and propagate it to every wire it feeds
+static void drive_gpio(unsigned gpio, uint8_t level, uint64_t t) {
+    levels[gpio] = level;
+    for (int l = 0; l < num_links; l++) {
+        if (links[l].tx_gpio == gpio) {
+            drive_link(l, level, t, 0);
+        }
+    }
+}
+
+//receiver timestamp of an edge, including the receiver's clock skew
+static uint32_t rx_tick(const SimLink *link, uint64_t time) {
+    int64_t skew = ((int64_t)time * link->cfg.skew_ppm) / 1000000;
+    return (uint32_t)((int64_t)time + skew);
+}
+
+//deliver every edge arriving up to 'until', then move the clock there
+static void advance_to(uint64_t until) {
+    pthread_mutex_lock(&sim_lock);
+    while (num_edges > 0 && edges[0].time <= until) {
+        SimEdge e = pop_edge();
+        SimLink *link = &links[e.link];
+        if (e.time > sim_now) sim_now = e.time;
+        levels[link->rx_gpio] = e.level;
+        phy_edge_callback_t handler = edge_handlers[link->rx_gpio];
+        unsigned gpio = link->rx_gpio;
+        uint32_t tick = rx_tick(link, e.time);
+
+        //the handler may transmit, so it runs without the lock held
+        pthread_mutex_unlock(&sim_lock);
+        if (handler != NULL) {
+            handler(gpio, e.level, tick);
+        }
+        pthread_mutex_lock(&sim_lock);
+    }
+    if (until > sim_now) sim_now = until;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+static void free_waves(void) {
+    for (int i = 0; i < SIM_MAX_WAVES; i++) {
+        free(waves[i].pulses);
+        waves[i].pulses = NULL;
+        waves[i].num_pulses = 0;
+    }
+}
+
+static int sim_start(void) {
+    pthread_mutex_lock(&sim_lock);
+    sim_now = 0;
+    tx_end = 0;
+    edge_seq = 0;
+    num_edges = 0;
+    num_links = 0;
+    num_scheduled = 0;
+    memset(levels, 0, sizeof(levels));
+    memset(edge_handlers, 0, sizeof(edge_handlers));
+    free_waves();
+    pthread_mutex_unlock(&sim_lock);
+    return 0;
+}
+
+static void sim_stop(void) {
+    pthread_mutex_lock(&sim_lock);
+    free_waves();
+    free(edges);
+    edges = NULL;
+    num_edges = 0;
+    edge_capacity = 0;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+static int sim_set_mode(unsigned gpio, unsigned mode) {
+    (void)mode;
+    return (gpio < SIM_MAX_GPIO) ? 0 : -1;
+}
+
+static int sim_set_pull_up_down(unsigned gpio, unsigned pud) {
+    (void)pud;
+    return (gpio < SIM_MAX_GPIO) ? 0 : -1;
+}
+
+static int sim_write(unsigned gpio, unsigned level) {
+    if (gpio >= SIM_MAX_GPIO) return -1;
+    pthread_mutex_lock(&sim_lock);
+    drive_gpio(gpio, level ? 1 : 0, sim_now);
+    pthread_mutex_unlock(&sim_lock);
+    return 0;
+}
+
+static int sim_read(unsigned gpio) {
+    if (gpio >= SIM_MAX_GPIO) return -1;
+    pthread_mutex_lock(&sim_lock);
+    int level = levels[gpio];
+    pthread_mutex_unlock(&sim_lock);
+    return level;
+}
+
+static int sim_callback(unsigned gpio, phy_edge_callback_t cb) {
+    if (gpio >= SIM_MAX_GPIO) return -1;
+    pthread_mutex_lock(&sim_lock);
+    edge_handlers[gpio] = cb;
+    pthread_mutex_unlock(&sim_lock);
+    return 0;
+}
+
+static int sim_wave_clear(void) {
+    pthread_mutex_lock(&sim_lock);
+    free_waves();
+    pthread_mutex_unlock(&sim_lock);
+    return 0;
+}
+
+static int sim_wave_create(const PhyPulse *pulses, int num_pulses) {
+    if (num_pulses <= 0) return -1;
+    pthread_mutex_lock(&sim_lock);
+    int wave_id = -1;
+    for (int i = 0; i < SIM_MAX_WAVES; i++) {
+        if (waves[i].pulses == NULL) {
+            wave_id = i;
+            break;
+        }
+    }
+    if (wave_id >= 0) {
+        waves[wave_id].pulses = malloc(num_pulses * sizeof(PhyPulse));
+        if (waves[wave_id].pulses == NULL) {
+            wave_id = -1;
+        } else {
+            memcpy(waves[wave_id].pulses, pulses, num_pulses * sizeof(PhyPulse));
+            waves[wave_id].num_pulses = num_pulses;
+        }
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return wave_id;
+}
+
+static int sim_wave_delete(unsigned wave_id) {
+    if (wave_id >= SIM_MAX_WAVES) return -1;
+    pthread_mutex_lock(&sim_lock);
+    free(waves[wave_id].pulses);
+    waves[wave_id].pulses = NULL;
+    waves[wave_id].num_pulses = 0;
+    pthread_mutex_unlock(&sim_lock);
+    return 0;
+}
+
+//play a waveform starting at virtual time 'start', all of its edges are scheduled up front
+static int play_wave(unsigned wave_id, uint64_t start) {
+    if (wave_id >= SIM_MAX_WAVES) return -1;
+    SimWave *wave = &waves[wave_id];
+    if (wave->pulses == NULL) return -1;
+
+    //gpios touched by this wave, only those wires see errors
+    uint32_t wave_pins = 0;
+    for (int i = 0; i < wave->num_pulses; i++) {
+        wave_pins |= wave->pulses[i].gpioOn | wave->pulses[i].gpioOff;
+    }
+
+    uint64_t t = start;
+    for (int i = 0; i < wave->num_pulses; i++) {
+        const PhyPulse *p = &wave->pulses[i];
+        for (unsigned gpio = 0; gpio < SIM_MAX_GPIO; gpio++) {
+            if (p->gpioOn & (1u << gpio)) levels[gpio] = 1;
+            if (p->gpioOff & (1u << gpio)) levels[gpio] = 0;
+        }
+        for (int l = 0; l < num_links; l++) {
+            if (wave_pins & (1u << links[l].tx_gpio)) {
+                drive_link(l, levels[links[l].tx_gpio], t, 1);
+            }
+        }
+        t += p->usDelay;
+    }
+
+    //the line settles back to the driven level once the wave is over
+    for (int l = 0; l < num_links; l++) {
+        if (wave_pins & (1u << links[l].tx_gpio)) {
+            drive_link(l, levels[links[l].tx_gpio], t, 0);
+        }
+    }
+
+    //forget windows that are over, then remember this one
+    int kept = 0;
+    for (int i = 0; i < num_scheduled; i++) {
+        if (scheduled[i].end > sim_now) scheduled[kept++] = scheduled[i];
+    }
+    num_scheduled = kept;
+    if (num_scheduled < SIM_MAX_SCHEDULED) {
+        scheduled[num_scheduled++] = (SimScheduled){.wave_id = (int)wave_id, .start = start, .end = t};
+    }
+    tx_end = t;
+    return 0;
+}
+
+//stop the waves on the wire now: the edges they were to drive later never happen, and each wire
+//they cut short is left at the level its last remaining edge brings. Call with sim_lock held
+static void cancel_waves(void) {
+    int cut[SIM_MAX_LINKS] = {0};
+    size_t kept = 0;
+    for (size_t i = 0; i < num_edges; i++) {
+        if (edges[i].sent > sim_now) {
+            cut[edges[i].link] = 1;
+        } else {
+            edges[kept++] = edges[i];
+        }
+    }
+    //the edges left keep their times and order, the heap is rebuilt from them
+    size_t n = kept;
+    num_edges = 0;
+    for (size_t i = 0; i < n; i++) {
+        heap_insert(edges[i]);
+    }
+    for (int l = 0; l < num_links; l++) {
+        if (!cut[l]) continue;
+        const SimEdge *last = NULL;
+        for (size_t i = 0; i < num_edges; i++) {
+            if (edges[i].link == l && (last == NULL || edge_before(last, &edges[i]))) {
+                last = &edges[i];
+            }
+        }
+        links[l].level = (last != NULL) ? last->level : levels[links[l].rx_gpio];
+        links[l].last_edge = (last != NULL) ? last->time : 0;
+    }
+    num_scheduled = 0;
+    tx_end = sim_now;
+}
+
+//like pigpio, a new wave replaces whatever is being sent
+static int sim_wave_send_once(unsigned wave_id) {
+    pthread_mutex_lock(&sim_lock);
+    cancel_waves();
+    int rc = play_wave(wave_id, sim_now);
+    pthread_mutex_unlock(&sim_lock);
+    return rc;
+}
+
+static int sim_wave_send_sync(unsigned wave_id) {
+    pthread_mutex_lock(&sim_lock);
+    int rc = play_wave(wave_id, (tx_end > sim_now) ? tx_end : sim_now);
+    pthread_mutex_unlock(&sim_lock);
+    return rc;
+}
+
+static int sim_wave_tx_at(void) {
+    pthread_mutex_lock(&sim_lock);
+    int wave_id = -1;
+    for (int i = 0; i < num_scheduled; i++) {
+        if (scheduled[i].start <= sim_now && sim_now < scheduled[i].end) {
+            wave_id = scheduled[i].wave_id;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sim_lock);
+    return wave_id;
+}
+
+static int sim_wave_tx_busy(void) {
+    pthread_mutex_lock(&sim_lock);
+    int busy = sim_now < tx_end;
+    pthread_mutex_unlock(&sim_lock);
+    return busy;
+}
+
+static uint32_t sim_tick(void) {
+    pthread_mutex_lock(&sim_lock);
+    uint32_t now = (uint32_t)sim_now;
+    pthread_mutex_unlock(&sim_lock);
+    return now;
+}
+
+static void sim_sleep_us(uint32_t us) {
+    pthread_mutex_lock(&sim_lock);
+    uint64_t until = sim_now + us;
+    pthread_mutex_unlock(&sim_lock);
+    advance_to(until);
+}
+
+int phy_sim_connect(unsigned tx_gpio, unsigned rx_gpio, const PhySimLinkConfig *cfg) {
+    if (tx_gpio >= SIM_MAX_GPIO || rx_gpio >= SIM_MAX_GPIO) return -1;
+    pthread_mutex_lock(&sim_lock);
+    if (num_links == SIM_MAX_LINKS) {
+        pthread_mutex_unlock(&sim_lock);
+        return -1;
+    }
+    SimLink *link = &links[num_links++];
+    memset(link, 0, sizeof(*link));
+    link->tx_gpio = tx_gpio;
+    link->rx_gpio = rx_gpio;
+    if (cfg != NULL) {
+        link->cfg = *cfg;
+    }
+    link->level = levels[tx_gpio];
+    link->last_edge = sim_now;
+    levels[rx_gpio] = link->level;
+    pthread_mutex_unlock(&sim_lock);
+    return 0;
+}
+
+void phy_sim_seed(uint64_t seed) {
+    pthread_mutex_lock(&sim_lock);
+    rng_state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+    pthread_mutex_unlock(&sim_lock);
+}
+
+void phy_sim_run(void) {
+    pthread_mutex_lock(&sim_lock);
+    uint64_t until = tx_end;
+    if (num_edges > 0) {
+        //the heap is only ordered at the top, find the last pending arrival
+        for (size_t i = 0; i < num_edges; i++) {
+            if (edges[i].time > until) until = edges[i].time;
+        }
+    }
+    pthread_mutex_unlock(&sim_lock);
+    advance_to(until);
+}
+
+const PhyBackend phy_sim_backend = {
+    .name = "sim",
+    .start = sim_start,
+    .stop = sim_stop,
+    .set_mode = sim_set_mode,
+    .set_pull_up_down = sim_set_pull_up_down,
+    .write = sim_write,
+    .read = sim_read,
+    .callback = sim_callback,
+    .wave_clear = sim_wave_clear,
+    .wave_create = sim_wave_create,
+    .wave_delete = sim_wave_delete,
+    .wave_send_once = sim_wave_send_once,
+    .wave_send_sync = sim_wave_send_sync,
+    .wave_tx_at = sim_wave_tx_at,
+    .wave_tx_busy = sim_wave_tx_busy,
+    .tick = sim_tick,
+    .sleep_us = sim_sleep_us,
+};
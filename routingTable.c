@@ -0,0 +1,107 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "routingTable.h"
+
+//a route as the control plane keeps it, zeroed when there is none
+typedef struct {
+    uint8_t valid;
+    uint8_t port;       //the first of ports
+    uint8_t ports;
+    uint8_t metric;
+} RouteInfo;
+
+//two tables: the forwarding path reads the active one while the next one is built in the other.
+//An entry is a single atomic word, so a reader still on the previous table after the swap
+//sees a complete old or new entry, never a torn one
+static Fib fibs[2];
+Fib *_Atomic route_active_fib = &fibs[0];
+
+//routes as configured, only touched with route_lock held
+static RouteInfo routes[ROUTE_NUM_ADDRESSES];
+static RouteInfo default_route;
+static pthread_mutex_t route_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static FibEntry make_entry(const RouteInfo *route, int is_default) {
+    if (!route->valid) {
+        return 0;
+    }
+    return fib_make_entry(route->ports, route->metric) | ((FibEntry)is_default << 16);
+}
+
+//build the next table with the default route folded in and swap it in, call with route_lock held
+static void publish(void) {
+    Fib *active = atomic_load_explicit(&route_active_fib, memory_order_relaxed);
+    Fib *next = (active == &fibs[0]) ? &fibs[1] : &fibs[0];
+    for (int i = 0; i < ROUTE_NUM_ADDRESSES; i++) {
+        FibEntry entry = routes[i].valid ? make_entry(&routes[i], 0) : make_entry(&default_route, 1);
+        atomic_store_explicit(&next->entries[i], entry, memory_order_relaxed);
+    }
+    atomic_store_explicit(&route_active_fib, next, memory_order_release);
+}
+
+void route_clear(void) {
+    pthread_mutex_lock(&route_lock);
+    memset(routes, 0, sizeof(routes));
+    memset(&default_route, 0, sizeof(default_route));
+    publish();
+    pthread_mutex_unlock(&route_lock);
+}
+
+int route_insert(uint8_t dest, int port, uint8_t metric) {
+    if (port < 0 || port >= 4) {
+        return -1;
+    }
+    return route_insert_multipath(dest, (uint8_t)(1 << port), metric);
+}
+
+int route_insert_multipath(uint8_t dest, uint8_t ports, uint8_t metric) {
+    ports &= 0x0F;
+    if (ports == 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&route_lock);
+    routes[dest] = (RouteInfo){.valid = 1, .port = (uint8_t)__builtin_ctz(ports), .ports = ports, .metric = metric};
+    publish();
+    pthread_mutex_unlock(&route_lock);
+    return 0;
+}
+
+int route_withdraw(uint8_t dest) {
+    pthread_mutex_lock(&route_lock);
+    if (!routes[dest].valid) {
+        pthread_mutex_unlock(&route_lock);
+        return -1;
+    }
+    routes[dest].valid = 0;
+    publish();
+    pthread_mutex_unlock(&route_lock);
+    return 0;
+}
+
+int route_set_default(int port, uint8_t metric) {
+    if (port != ROUTE_NO_PORT && (port < 0 || port >= 4)) {
+        return -1;
+    }
+    pthread_mutex_lock(&route_lock);
+    default_route = (RouteInfo){.valid = (port != ROUTE_NO_PORT), .port = (uint8_t)port,
+                                .ports = (port != ROUTE_NO_PORT) ? (uint8_t)(1 << port) : 0, .metric = metric};
+    publish();
+    pthread_mutex_unlock(&route_lock);
+    return 0;
+}
+
+void route_dump(void) {
+    pthread_mutex_lock(&route_lock);
+    printf("dest port metric ports\n");
+    for (int i = 0; i < ROUTE_NUM_ADDRESSES; i++) {
+        if (routes[i].valid) {
+            printf("%4d %4d %6u  0x%x\n", i, routes[i].port, routes[i].metric, routes[i].ports);
+        }
+    }
+    if (default_route.valid) {
+        printf(" def %4d %6u\n", default_route.port, default_route.metric);
+    }
+    pthread_mutex_unlock(&route_lock);
+}
@@ -0,0 +1,115 @@
+#ifndef ROUTING_TABLE_H
+#define ROUTING_TABLE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define ROUTE_NUM_ADDRESSES 256  //the whole 1-byte address space
+#define ROUTE_NO_PORT -1         //port of an address nothing routes to
+#define ROUTE_METRIC_INFINITY 255
+
+//a forwarding entry packed into one word so it is always read and written whole:
+//bits 0-7 port plus one (0 for none, so a zeroed table has no routes), bits 8-15 metric,
+//bit 16 set if it came from the default route, bits 20-23 every port with a route of that
+//metric (bit n for port n), the first port among them
+typedef uint32_t FibEntry;
+
+#define FIB_PORT(entry) ((int)((entry) & 0xFF) - 1)
+#define FIB_METRIC(entry) ((uint8_t)((entry) >> 8))
+#define FIB_IS_DEFAULT(entry) (((entry) >> 16) & 1)
+#define FIB_PORTS(entry) ((uint8_t)(((entry) >> 20) & 0x0F))
+
+/**
+ * @brief pack a forwarding entry, also for tables kept outside this module such as the emulator's
+ * @param ports bit n set for each port n the route goes through, 0 for no route
+ * @param metric cost of the route
+ * @return the entry, not from the default route
+ */
+static inline FibEntry fib_make_entry(uint8_t ports, uint8_t metric) {
+    ports &= 0x0F;
+    if (ports == 0) {
+        return 0;
+    }
+    return (FibEntry)(__builtin_ctz(ports) + 1) | ((FibEntry)metric << 8) | ((FibEntry)ports << 20);
+}
+
+//one forwarding table, every address has an entry so a lookup is a single load
+typedef struct {
+    _Atomic FibEntry entries[ROUTE_NUM_ADDRESSES];
+} Fib;
+
+//the table the forwarding path reads, swapped whole when the routes change
+extern Fib *_Atomic route_active_fib;
+
+/**
+ * @brief forwarding entry for an address, never blocks; the default route is already folded in
+ * @param dest the destination address
+ * @return the entry, FIB_PORT is ROUTE_NO_PORT when there is no route
+ */
+static inline FibEntry route_lookup_entry(uint8_t dest) {
+    Fib *fib = atomic_load_explicit(&route_active_fib, memory_order_acquire);
+    return atomic_load_explicit(&fib->entries[dest], memory_order_relaxed);
+}
+
+/**
+ * @brief port to send to for an address
+ * @param dest the destination address
+ * @return the port (0-3), or ROUTE_NO_PORT
+ */
+static inline int route_lookup(uint8_t dest) {
+    return FIB_PORT(route_lookup_entry(dest));
+}
+
+/**
+ * @brief every port with a route to an address, for spreading traffic over parallel links
+ * @param dest the destination address
+ * @return bit n set for port n, 0 when there is no route
+ */
+static inline uint8_t route_lookup_ports(uint8_t dest) {
+    return FIB_PORTS(route_lookup_entry(dest));
+}
+
+/**
+ * @brief remove every route, including the default one
+ */
+void route_clear(void);
+
+/**
+ * @brief add or replace the route to an address
+ * @param dest the destination address
+ * @param port the port it is reached through (0-3)
+ * @param metric cost of the route, lower is better
+ * @return 0 on success, -1 if the port is invalid
+ */
+int route_insert(uint8_t dest, int port, uint8_t metric);
+
+/**
+ * @brief add or replace the route to an address through several ports of the same cost
+ * @param dest the destination address
+ * @param ports bit n set for each port n it is reached through
+ * @param metric cost of the route, lower is better
+ * @return 0 on success, -1 if no valid port is set
+ */
+int route_insert_multipath(uint8_t dest, uint8_t ports, uint8_t metric);
+
+/**
+ * @brief remove the route to an address, it falls back to the default route
+ * @param dest the destination address
+ * @return 0 on success, -1 if there was no route
+ */
+int route_withdraw(uint8_t dest);
+
+/**
+ * @brief set the route used for every address without a route of its own
+ * @param port the port (0-3), or ROUTE_NO_PORT to remove the default route
+ * @param metric cost of the route
+ * @return 0 on success, -1 if the port is invalid
+ */
+int route_set_default(int port, uint8_t metric);
+
+/**
+ * @brief print the routes for debugging
+ */
+void route_dump(void);
+
+#endif // ROUTING_TABLE_H
@@ -0,0 +1,145 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "linkLayer.h"
+#include "networkLayer.h"
+#include "phy.h"
+#include "statsDump.h"
+
+#define STATS_STEP_US 100000    //the dump thread sleeps in steps this long so it stops promptly
+
+static pthread_t dump_thread;
+static _Atomic int dump_running;
+static FILE *dump_file;
+static uint32_t dump_interval_ms;
+static StatsFormat dump_format;
+
+static void dump_text(FILE *out, const LinkStats *ports, const NetworkStats *net) {
+    fprintf(out, "port bit_us rx_bit %9s %10s %6s %7s %9s %10s %6s %6s %6s %6s %7s %7s\n", "tx_frames", "tx_bytes",
+            "tx_err", "tx_drop", "rx_frames", "rx_bytes", "fcs", "abort", "timing", "sync", "rx_drop", "rx_full");
+    for (int i = 0; i < 4; i++) {
+        const LinkStats *s = &ports[i];
+        fprintf(out, "%4d %6u %6u %9llu %10llu %6llu %7llu %9llu %10llu %6llu %6llu %6llu %6llu %7llu %7llu\n", i,
+                s->bit_us, s->rx_bit_us, (unsigned long long)s->tx_frames, (unsigned long long)s->tx_bytes,
+                (unsigned long long)s->tx_errors, (unsigned long long)s->tx_drops, (unsigned long long)s->rx_frames,
+                (unsigned long long)s->rx_bytes, (unsigned long long)s->rx_fcs_errors,
+                (unsigned long long)s->rx_aborts, (unsigned long long)s->rx_timing_errors,
+                (unsigned long long)s->rx_sync_losses, (unsigned long long)s->rx_drops,
+                (unsigned long long)s->rx_queue_drops);
+    }
+    //the edge gaps cluster at the peer's half and full bit time, so p10 and p90 sit on the two peaks
+    fprintf(out, "port %10s %8s %8s %10s %8s %8s %10s %8s %8s\n", "edge_p10", "p50", "p90", "tx_lat_p50", "p99", "max",
+            "rx_lat_p50", "p99", "max");
+    for (int i = 0; i < 4; i++) {
+        const LinkStats *s = &ports[i];
+        fprintf(out, "%4d %10u %8u %8u %10u %8u %8u %10u %8u %8u\n", i, hist_percentile(&s->edge_us, 10),
+                hist_percentile(&s->edge_us, 50), hist_percentile(&s->edge_us, 90),
+                hist_percentile(&s->tx_latency_us, 50), hist_percentile(&s->tx_latency_us, 99),
+                hist_percentile(&s->tx_latency_us, 100), hist_percentile(&s->rx_latency_us, 50),
+                hist_percentile(&s->rx_latency_us, 99), hist_percentile(&s->rx_latency_us, 100));
+    }
+    fprintf(out, "network: sent %llu (%llu B), received %llu (%llu B), forwarded %llu, adverts %llu, no route %llu, "
+                 "TTL expired %llu, queue drops %llu, malformed %llu, messages sent %llu, delivered %llu\n",
+            (unsigned long long)net->sent, (unsigned long long)net->sent_bytes, (unsigned long long)net->received,
+            (unsigned long long)net->received_bytes, (unsigned long long)net->forwarded,
+            (unsigned long long)net->adverts, (unsigned long long)net->no_route, (unsigned long long)net->ttl_expired,
+            (unsigned long long)net->queue_drops, (unsigned long long)net->malformed,
+            (unsigned long long)net->messages_sent, (unsigned long long)net->messages_delivered);
+}
+
+static void dump_json(FILE *out, const LinkStats *ports, const NetworkStats *net) {
+    fprintf(out, "{\"tick_us\":%u,\"ports\":[", phy_tick());
+    for (int i = 0; i < 4; i++) {
+        const LinkStats *s = &ports[i];
+        fprintf(out, "%s{\"port\":%d,\"bit_us\":%u,\"rx_bit_us\":%u,\"tx_frames\":%llu,\"tx_bytes\":%llu,"
+                     "\"tx_errors\":%llu,\"tx_drops\":%llu,\"rx_frames\":%llu,\"rx_bytes\":%llu,\"rx_fcs_errors\":%llu,"
+                     "\"rx_aborts\":%llu,\"rx_timing_errors\":%llu,\"rx_sync_losses\":%llu,\"rx_drops\":%llu,"
+                     "\"rx_queue_drops\":%llu,",
+                i ? "," : "", i, s->bit_us, s->rx_bit_us, (unsigned long long)s->tx_frames,
+                (unsigned long long)s->tx_bytes, (unsigned long long)s->tx_errors, (unsigned long long)s->tx_drops,
+                (unsigned long long)s->rx_frames, (unsigned long long)s->rx_bytes,
+                (unsigned long long)s->rx_fcs_errors, (unsigned long long)s->rx_aborts,
+                (unsigned long long)s->rx_timing_errors, (unsigned long long)s->rx_sync_losses,
+                (unsigned long long)s->rx_drops, (unsigned long long)s->rx_queue_drops);
+        fprintf(out, "\"edge_us\":");
+        hist_print_json(out, &s->edge_us);
+        fprintf(out, ",\"tx_latency_us\":");
+        hist_print_json(out, &s->tx_latency_us);
+        fprintf(out, ",\"rx_latency_us\":");
+        hist_print_json(out, &s->rx_latency_us);
+        fprintf(out, "}");
+    }
+    fprintf(out, "],\"network\":{\"sent\":%llu,\"sent_bytes\":%llu,\"received\":%llu,\"received_bytes\":%llu,"
+                 "\"forwarded\":%llu,\"adverts\":%llu,\"no_route\":%llu,\"ttl_expired\":%llu,\"queue_drops\":%llu,"
+                 "\"malformed\":%llu,\"messages_sent\":%llu,\"messages_delivered\":%llu}}\n",
+            (unsigned long long)net->sent, (unsigned long long)net->sent_bytes, (unsigned long long)net->received,
+            (unsigned long long)net->received_bytes, (unsigned long long)net->forwarded,
+            (unsigned long long)net->adverts, (unsigned long long)net->no_route, (unsigned long long)net->ttl_expired,
+            (unsigned long long)net->queue_drops, (unsigned long long)net->malformed,
+            (unsigned long long)net->messages_sent, (unsigned long long)net->messages_delivered);
+}
+
+void stats_dump(FILE *out, StatsFormat format) {
+    //the four ports' snapshots with their histograms are about 45 KB, kept off the caller's stack
+    static LinkStats ports[4];
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    NetworkStats net;
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < 4; i++) {
+        link_get_stats(i, &ports[i]);
+    }
+    network_get_stats(&net);
+    if (format == STATS_JSON) {
+        dump_json(out, ports, &net);
+    } else {
+        dump_text(out, ports, &net);
+    }
+    fflush(out);
+    pthread_mutex_unlock(&lock);
+}
+
+static void *dump_main(void *arg) {
+    (void)arg;
+    uint64_t waited_us = 0;
+    while (atomic_load(&dump_running)) {
+        usleep(STATS_STEP_US);
+        waited_us += STATS_STEP_US;
+        if (waited_us >= (uint64_t)dump_interval_ms * 1000) {
+            stats_dump(dump_file, dump_format);
+            waited_us = 0;
+        }
+    }
+    stats_dump(dump_file, dump_format);
+    return NULL;
+}
+
+int stats_dump_start(const char *path, uint32_t interval_ms, StatsFormat format) {
+    if (atomic_load(&dump_running)) return 0;
+    dump_file = stdout;
+    if (path != NULL) {
+        dump_file = fopen(path, "a");
+        if (dump_file == NULL) {
+            perror("stats file");
+            return 1;
+        }
+    }
+    dump_interval_ms = interval_ms;
+    dump_format = format;
+    atomic_store(&dump_running, 1);
+    if (pthread_create(&dump_thread, NULL, dump_main, NULL) != 0) {
+        atomic_store(&dump_running, 0);
+        if (dump_file != stdout) fclose(dump_file);
+        return 1;
+    }
+    return 0;
+}
+
+void stats_dump_stop(void) {
+    if (!atomic_load(&dump_running)) return;
+    atomic_store(&dump_running, 0);
+    pthread_join(dump_thread, NULL);
+    if (dump_file != stdout) {
+        fclose(dump_file);
+    }
+    dump_file = NULL;
+}
@@ -0,0 +1,35 @@
+#ifndef STATS_DUMP_H
+#define STATS_DUMP_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define STATS_DUMP_INTERVAL_MS 10000    //default time between periodic dumps
+
+typedef enum {
+    STATS_TEXT,     //tables for people
+    STATS_JSON      //one JSON object per dump on a line of its own, histograms with their buckets
+} StatsFormat;
+
+/**
+ * @brief write a snapshot of every port's link statistics and the network layer's counters
+ * @param out where to write it
+ * @param format STATS_TEXT or STATS_JSON
+ */
+void stats_dump(FILE *out, StatsFormat format);
+
+/**
+ * @brief start a background thread that dumps the statistics periodically
+ * @param path file the dumps are appended to, NULL for stdout
+ * @param interval_ms time between dumps
+ * @param format STATS_TEXT or STATS_JSON
+ * @return 0 on success, non-zero if failed
+ */
+int stats_dump_start(const char *path, uint32_t interval_ms, StatsFormat format);
+
+/**
+ * @brief write a last dump and stop the background thread
+ */
+void stats_dump_stop(void);
+
+#endif // STATS_DUMP_H
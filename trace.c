@@ -0,0 +1,169 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+
+#define TRACE_RING_SIZE 4096    //records, must be a power of two
+#define TRACE_IDLE_US 10000     //how long the drain thread sleeps when the ring is empty
+
+//bounded multi-producer ring: a slot is free for position p when its seq is p,
+//and holds a record for position p when its seq is p + 1. seq is stored minus the
+//slot index so the zero-initialized ring is already valid
+typedef struct {
+    _Atomic uint32_t seq;
+    TraceRecord rec;
+} TraceSlot;
+
+static TraceSlot ring[TRACE_RING_SIZE];
+static _Atomic uint32_t enqueue_pos;
+static uint32_t dequeue_pos;
+static _Atomic uint32_t dropped;
+
+static pthread_t drain_thread;
+static _Atomic int drain_running;
+static FILE *trace_file;
+
+#define TRACE_FORMAT(name, level, fmt) fmt,
+static const char *event_formats[TRACE_NUM_EVENTS] = {
+    TRACE_EVENTS(TRACE_FORMAT)
+};
+#undef TRACE_FORMAT
+
+#define TRACE_LEVEL_OF(name, level, fmt) level,
+static const uint8_t event_levels[TRACE_NUM_EVENTS] = {
+    TRACE_EVENTS(TRACE_LEVEL_OF)
+};
+#undef TRACE_LEVEL_OF
+
+static uint32_t slot_seq(uint32_t idx) {
+    return atomic_load_explicit(&ring[idx].seq, memory_order_acquire) + idx;
+}
+
+static void set_slot_seq(uint32_t idx, uint32_t seq) {
+    atomic_store_explicit(&ring[idx].seq, seq - idx, memory_order_release);
+}
+
+static uint32_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+void trace_emit(TraceEvent event, const uint32_t *args, int num_args) {
+    uint32_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    uint32_t idx;
+    for (;;) {
+        idx = pos & (TRACE_RING_SIZE - 1);
+        uint32_t seq = slot_seq(idx);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            //ring full, never block the caller
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    TraceRecord *rec = &ring[idx].rec;
+    if (num_args > TRACE_MAX_ARGS) num_args = TRACE_MAX_ARGS;
+    rec->time_us = now_us();
+    rec->event = (uint16_t)event;
+    rec->level = event_levels[event];
+    rec->num_args = (uint8_t)num_args;
+    for (int i = 0; i < TRACE_MAX_ARGS; i++) {
+        rec->args[i] = (i < num_args) ? args[i] : 0;
+    }
+    set_slot_seq(idx, pos + 1);
+}
+
+//take the oldest record, only the drain thread calls this
+static int ring_pop(TraceRecord *rec) {
+    uint32_t idx = dequeue_pos & (TRACE_RING_SIZE - 1);
+    if (slot_seq(idx) != dequeue_pos + 1) return 0;
+    *rec = ring[idx].rec;
+    set_slot_seq(idx, dequeue_pos + TRACE_RING_SIZE);
+    dequeue_pos++;
+    return 1;
+}
+
+int trace_format(const TraceRecord *rec, char *buf, size_t size) {
+    if (rec->event >= TRACE_NUM_EVENTS) {
+        return snprintf(buf, size, "unknown trace event %u", rec->event);
+    }
+    const uint32_t *a = rec->args;
+    //unused arguments are zero and ignored by the format
+    return snprintf(buf, size, event_formats[rec->event], a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+static void drain(void) {
+    TraceRecord rec;
+    char line[256];
+    while (ring_pop(&rec)) {
+        if (trace_file != NULL) {
+            fwrite(&rec, sizeof(rec), 1, trace_file);
+        } else {
+            trace_format(&rec, line, sizeof(line));
+            printf("%s\n", line);
+        }
+    }
+    if (trace_file != NULL) {
+        fflush(trace_file);
+    } else {
+        fflush(stdout);
+    }
+}
+
+static void *drain_main(void *arg) {
+    (void)arg;
+    while (atomic_load(&drain_running)) {
+        drain();
+        usleep(TRACE_IDLE_US);
+    }
+    drain();
+    return NULL;
+}
+
+int trace_start(const char *path) {
+    if (atomic_load(&drain_running)) return 0;
+    trace_file = NULL;
+    if (path != NULL) {
+        trace_file = fopen(path, "wb");
+        if (trace_file == NULL) {
+            perror("trace file");
+            return 1;
+        }
+        //header: magic and record size so the decoder can reject foreign files
+        uint32_t rec_size = sizeof(TraceRecord);
+        fwrite(TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC), 1, trace_file);
+        fwrite(&rec_size, sizeof(rec_size), 1, trace_file);
+    }
+    atomic_store(&drain_running, 1);
+    if (pthread_create(&drain_thread, NULL, drain_main, NULL) != 0) {
+        atomic_store(&drain_running, 0);
+        return 1;
+    }
+    return 0;
+}
+
+void trace_stop(void) {
+    if (!atomic_load(&drain_running)) return;
+    atomic_store(&drain_running, 0);
+    pthread_join(drain_thread, NULL);
+    if (trace_file != NULL) {
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+}
+
+uint32_t trace_dropped(void) {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
@@ -0,0 +1,94 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//trace levels, an event is kept when its level is at most TRACE_LEVEL
+#define TRACE_LEVEL_OFF 0
+#define TRACE_LEVEL_ERROR 1
+#define TRACE_LEVEL_WARN 2
+#define TRACE_LEVEL_INFO 3
+#define TRACE_LEVEL_DEBUG 4
+#define TRACE_LEVEL_TRACE 5
+
+//compile-time level, per-edge events are only compiled in with -DTRACE_LEVEL=5
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_LEVEL_WARN
+#endif
+
+#include "traceEvents.h"
+
+#define TRACE_MAX_ARGS 6
+#define TRACE_FILE_MAGIC "KANTRC1"
+
+#define TRACE_ENUM(name, level, fmt) name,
+typedef enum {
+    TRACE_EVENTS(TRACE_ENUM)
+    TRACE_NUM_EVENTS
+} TraceEvent;
+#undef TRACE_ENUM
+
+//level of each event as a compile-time constant so disabled events vanish
+#define TRACE_LEVEL_ENUM(name, level, fmt) name##_LEVEL = level,
+enum {
+    TRACE_EVENTS(TRACE_LEVEL_ENUM)
+};
+#undef TRACE_LEVEL_ENUM
+
+//one binary trace record, 32 bytes
+typedef struct {
+    uint32_t time_us;   //monotonic time the record was made
+    uint16_t event;     //TraceEvent
+    uint8_t level;
+    uint8_t num_args;
+    uint32_t args[TRACE_MAX_ARGS];
+} TraceRecord;
+
+/**
+ * @brief record an event without blocking or formatting, use the TRACE macro instead
+ * @param event the event
+ * @param args the event's arguments
+ * @param num_args the number of arguments (at most TRACE_MAX_ARGS)
+ */
+void trace_emit(TraceEvent event, const uint32_t *args, int num_args);
+
+#if TRACE_LEVEL > TRACE_LEVEL_OFF
+#define TRACE(event, ...) do { \
+        if (event##_LEVEL <= TRACE_LEVEL) { \
+            const uint32_t trace_args_[] = {__VA_ARGS__}; \
+            trace_emit(event, trace_args_, (int)(sizeof(trace_args_) / sizeof(trace_args_[0]))); \
+        } \
+    } while (0)
+#else
+#define TRACE(event, ...) ((void)0)
+#endif
+
+/**
+ * @brief start the background thread draining trace records
+ * @param path binary trace file to write, NULL to print the records as text on stdout
+ * @return 0 on success, non-zero if failed
+ */
+int trace_start(const char *path);
+
+/**
+ * @brief drain what is left and stop the background thread
+ */
+void trace_stop(void);
+
+/**
+ * @brief number of records lost because the ring was full
+ */
+uint32_t trace_dropped(void);
+
+/**
+ * @brief turn a record back into its human readable line
+ * @param rec the record
+ * @param buf where to write the text
+ * @param size the size of buf
+ * @return the length of the text
+ */
+int trace_format(const TraceRecord *rec, char *buf, size_t size);
+
+#endif // TRACE_H
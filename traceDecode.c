@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+
+//turns a binary trace file written by trace_start back into the human readable log
+//usage: traceDecode <trace file> [-t]   (-t prefixes every line with its time in microseconds)
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace file> [-t]\n", argv[0]);
+        return 1;
+    }
+    int show_time = (argc > 2 && strcmp(argv[2], "-t") == 0);
+
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    char magic[sizeof(TRACE_FILE_MAGIC)];
+    uint32_t rec_size = 0;
+    if (fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, TRACE_FILE_MAGIC, sizeof(magic)) != 0 ||
+        fread(&rec_size, sizeof(rec_size), 1, f) != 1 || rec_size != sizeof(TraceRecord)) {
+        fprintf(stderr, "%s is not a trace file from this build\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+
+    TraceRecord rec;
+    char line[256];
+    while (fread(&rec, sizeof(rec), 1, f) == 1) {
+        trace_format(&rec, line, sizeof(line));
+        if (show_time) {
+            printf("[%10u] %s\n", rec.time_us, line);
+        } else {
+            printf("%s\n", line);
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
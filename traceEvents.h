@@ -0,0 +1,30 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+//every trace event: name, level and the format used to turn it back into text.
+//arguments are stored as uint32_t, so formats may only use unsigned conversions
+#define TRACE_EVENTS(X) \
+    X(TRACE_PORT_INIT,         TRACE_LEVEL_INFO,  "Initializing port %u: rx_pin=%u, tx_pin=%u") \
+    X(TRACE_RX_EDGE,           TRACE_LEVEL_TRACE, "RX Callback on port %u: level=%u, tick=%u, time_diff=%u, margin_ratio=%u.%02u") \
+    X(TRACE_SYNC_ACTIVE,       TRACE_LEVEL_TRACE, "Sync detected on port %u") \
+    X(TRACE_FULL_BIT,          TRACE_LEVEL_TRACE, "full bit detected on link %u") \
+    X(TRACE_HALF_BIT,          TRACE_LEVEL_TRACE, "Half bit detected on link %u") \
+    X(TRACE_SYNC_PATTERN,      TRACE_LEVEL_DEBUG, "Sync pattern detected on port %u") \
+    X(TRACE_BYTE_RX,           TRACE_LEVEL_DEBUG, "Converting bits to char on port %u:  => 0x%02X") \
+    X(TRACE_FRAME_RX,          TRACE_LEVEL_DEBUG, "Port %u: msg_len is: %u \nFCS residue: 0x%04x") \
+    X(TRACE_TX_FRAME,          TRACE_LEVEL_DEBUG, "Transmitting data on queue %u: %u bytes, %u pulses, wave %u") \
+    X(TRACE_RATE_PROBE,        TRACE_LEVEL_DEBUG, "Port %u probing %u us per bit") \
+    X(TRACE_RATE_REPORT,       TRACE_LEVEL_DEBUG, "Port %u peer received %u of %u probes at %u us per bit") \
+    X(TRACE_RATE_SETTLED,      TRACE_LEVEL_INFO,  "Port %u settled at %u us per bit") \
+    X(TRACE_RATE_FALLBACK,     TRACE_LEVEL_WARN,  "Port %u errors climbing, falling back to %u us per bit") \
+    X(TRACE_TIMING_ERROR,      TRACE_LEVEL_WARN,  "Timing error on port %u, resetting channel") \
+    X(TRACE_CHECKSUM_MISMATCH, TRACE_LEVEL_WARN,  "\n[Port %u] Checksum mismatch. Discarding message.") \
+    X(TRACE_POOL_EMPTY,        TRACE_LEVEL_WARN,  "Port %u: frame pool empty, dropping frame") \
+    X(TRACE_RX_QUEUE_FULL,     TRACE_LEVEL_WARN,  "Port %u: RX queue full, dropping frame") \
+    X(TRACE_FRAME_ABORT,       TRACE_LEVEL_WARN,  "Port %u: frame aborted after %u bytes, waiting for the next flag") \
+    X(TRACE_FEC_GAP,           TRACE_LEVEL_WARN,  "Port %u: bad gap of %u half bits clocked through for FEC") \
+    X(TRACE_FEC_CORRECTED,     TRACE_LEVEL_INFO,  "Port %u: FEC corrected %u errors") \
+    X(TRACE_FEC_FAILED,        TRACE_LEVEL_WARN,  "Port %u: FEC could not correct a frame of %u encoded bytes") \
+    X(TRACE_NET_TTL_EXPIRED,   TRACE_LEVEL_WARN,  "Packet from %u to %u dropped on port %u, its TTL ran out")
+
+#endif // TRACE_EVENTS_H
@@ -1,17 +1,60 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include "network_layer.h"
+#include <unistd.h>
+#include "edgeCapture.h"
+#include "forwardEngine.h"
+#include "networkLayer.h"
+#include "phy.h"
+#include "statsDump.h"
 
-int main() {
-    //initialize network layer
+int main(int argc, char *argv[]) {
+    //the node's address is given on the command line, 1 if it isn't
+    if (argc > 1) {
+        network_set_address((uint8_t)atoi(argv[1]));
+    }
+
+    //bring up the link layer with every port at the fastest rate it carries
+    if (initialize_link_layer() != 0) {
+        return 1;
+    }
+    //KAN_EDGE_CAPTURE=<path> records every edge the receiver sees for edgeReplay
+    if (getenv("KAN_EDGE_CAPTURE") != NULL && link_capture_start(getenv("KAN_EDGE_CAPTURE")) != 0) {
+        return 1;
+    }
+    if (link_tx_start() != 0 || link_rx_start(1) != 0) {
+        fprintf(stderr, "Failed to start TX engine or RX worker\n");
+        return 1;
+    }
+    link_negotiate(-1);
+    while (link_negotiation_pending() > 0) {
+        phy_sleep_us(1000);
+    }
+
+    //initialize network layer, routes are learned from the neighbours
     network_layer_init();
+    if (network_routing_start() != 0) {
+        fprintf(stderr, "Failed to start routing\n");
+        return 1;
+    }
+    //KAN_STATS_FILE=<path> appends a JSON line of statistics every KAN_STATS_INTERVAL_MS (10 s by default)
+    if (getenv("KAN_STATS_FILE") != NULL) {
+        uint32_t interval_ms = STATS_DUMP_INTERVAL_MS;
+        if (getenv("KAN_STATS_INTERVAL_MS") != NULL && atoi(getenv("KAN_STATS_INTERVAL_MS")) > 0) {
+            interval_ms = (uint32_t)atoi(getenv("KAN_STATS_INTERVAL_MS"));
+        }
+        if (stats_dump_start(getenv("KAN_STATS_FILE"), interval_ms, STATS_JSON) != 0) {
+            return 1;
+        }
+    }
 
-    char input_buf[256];
+    //a line may be a whole message, up to what fits in fragments
+    static char input_buf[NETWORK_MAX_MESSAGE + 2];
     uint8_t dest_addr;
 
     while (1) {
         //ask the user for destination device
-        printf("> Enter destination device (1-255, or 'exit' to quit): ");
+        printf("> Enter destination device (1-255, 'stats' for link and queue counters, 'fec <port> <mode>', 'batch <delay_us> <bytes>', 'file <dest> <path>', or 'exit' to quit): ");
         fflush(stdout);
 
         if (fgets(input_buf, sizeof(input_buf), stdin) == NULL) {
@@ -28,6 +71,71 @@ int main() {
         if (strcmp(input_buf, "exit") == 0) {
             break;
         }
+        if (strcmp(input_buf, "stats") == 0) {
+            stats_dump(stdout, STATS_TEXT);
+            fwd_dump_stats();
+            continue;
+        }
+        //"fec <port> <none|secded|rs>" sets a port's FEC, the peer on that cable has to match
+        if (strncmp(input_buf, "fec ", 4) == 0) {
+            int port;
+            char mode_name[16];
+            int mode = -1;
+            if (sscanf(input_buf + 4, "%d %15s", &port, mode_name) == 2) {
+                for (int m = 0; m < FEC_NUM_MODES; m++) {
+                    if (strcmp(mode_name, fec_mode_name((FecMode)m)) == 0) mode = m;
+                }
+            }
+            if (mode < 0 || link_set_fec(port, (FecMode)mode) != 0) {
+                printf("Usage: fec <port 0-3> <none|secded|rs>\n");
+                continue;
+            }
+            LinkFecStats stats;
+            link_fec_stats(port, &stats);
+            printf("Port %d FEC %s, so far %llu frames decoded, %llu errors corrected, %llu uncorrectable\n", port,
+                   fec_mode_name((FecMode)mode), (unsigned long long)stats.frames,
+                   (unsigned long long)stats.corrected, (unsigned long long)stats.uncorrectable);
+            continue;
+        }
+
+        //"batch <delay_us> <bytes>" packs small packets for the same port into frames of up to that
+        //many bytes, a packet waiting up to delay_us for others; 0 bytes sends every packet alone
+        if (strncmp(input_buf, "batch ", 6) == 0) {
+            unsigned delay_us, bytes;
+            if (sscanf(input_buf + 6, "%u %u", &delay_us, &bytes) != 2 || bytes > LINK_MAX_DATA) {
+                printf("Usage: batch <delay_us> <bytes 0-%d>\n", LINK_MAX_DATA);
+                continue;
+            }
+            fwd_set_batching(-1, delay_us, (uint16_t)bytes);
+            printf("Batching %s\n", bytes ? "on" : "off");
+            continue;
+        }
+
+        //"file <dest> <path>" sends a file as one message, in fragments if it is long
+        if (strncmp(input_buf, "file ", 5) == 0) {
+            int dest;
+            char path[200];
+            if (sscanf(input_buf + 5, "%d %199s", &dest, path) != 2 || dest < 1 || dest > MAX_ADDRESS) {
+                printf("Usage: file <dest 1-255> <path>\n");
+                continue;
+            }
+            FILE *file = fopen(path, "rb");
+            if (file == NULL) {
+                printf("Can't open %s\n", path);
+                continue;
+            }
+            static uint8_t file_buf[NETWORK_MAX_MESSAGE + 1];
+            size_t file_len = fread(file_buf, 1, sizeof(file_buf), file);
+            fclose(file);
+            if (file_len > NETWORK_MAX_MESSAGE) {
+                printf("%s is longer than %d bytes\n", path, NETWORK_MAX_MESSAGE);
+                continue;
+            }
+            if (send_packet((uint8_t)dest, file_buf, file_len) == 0) {
+                printf("[Sent]: %s, %zu bytes to Device: %d\n", path, file_len, dest);
+            }
+            continue;
+        }
 
         //convert destination input to a 1-byte address
         dest_addr = (uint8_t)atoi(input_buf);
@@ -51,7 +159,7 @@ int main() {
         }
 
         //send the packet using the network layer
-        send_packet(dest_addr, (uint8_t*)input_buf, (uint8_t)strlen(input_buf));
+        send_packet(dest_addr, (uint8_t*)input_buf, strlen(input_buf));
 
         printf("[Sent]: %s to Device: %d\n", input_buf, dest_addr);
         fflush(stdout);
@@ -59,5 +167,11 @@ int main() {
         usleep(100000); //sleep to allow time for transmission
     }
 
+    stats_dump_stop();
+    network_routing_stop();
+    link_tx_stop();
+    link_rx_stop();
+    phy_stop();
+    edge_capture_stop();
     return 0;
 }